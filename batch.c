@@ -0,0 +1,130 @@
+/**
+ * IAED-23 Project 2
+ * File: batch.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the batch mode. Inside
+ * a batch, the state derived from the lines' routes (the stops' lines and
+ * the lines' total values) is only marked as outdated, and it's rebuilt
+ * when it's read or when the batch is committed.
+*/
+
+#include "main.h"
+
+
+/* ------------------------------- Batch mode ------------------------------- */
+
+/**
+ * Begins a batch of commands. Every line's values are up to date.
+*/
+void beginBatch(System *sys) {
+
+    Node* ptr;
+
+    if (sys->batch)
+        return;
+
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next)
+        ((Line*)ptr->data)->removals = sys->removals;
+
+    sys->batch = YES;
+}
+
+/**
+ * Commits the running batch of commands, rebuilding the outdated values of
+ * the lines and the lines of the stops in a single pass over each.
+*/
+void commitBatch(System *sys) {
+
+    Node* ptr;
+
+    if (!sys->batch)
+        return;
+
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next)
+        refreshLineValues(sys, (Line*)ptr->data);
+
+    for (ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next)
+        if (((Stop*)ptr->data)->duplicates)
+            cleanStopLines((Stop*)ptr->data);
+
+    sys->batch = NO;
+}
+
+/**
+ * Brings the values of the given line up to date. Outside a batch, removing
+ * a stop updates the values of its lines and of every line with 2 or more
+ * links; inside a batch, its lines are marked as outdated and the removal is
+ * counted, and each line is updated when it's next used, since its links
+ * didn't change meanwhile. An up to date line isn't written to.
+*/
+void refreshLineValues(System *sys, Line* line) {
+
+    if (!line->outdated && line->removals == sys->removals)
+        return;
+
+    if (line->outdated || line->links_list->count >= 2)
+        updateLineValues(line);
+
+    line->outdated = NO;
+    line->removals = sys->removals;
+}
+
+/**
+ * Removes the duplicates from the lines of the given stop, which are
+ * sorted by name.
+*/
+void cleanStopLines(Stop* stop) {
+
+    Node *ptr, *next;
+
+    sortList(stop->lines, compareLines);
+
+    for (ptr = stop->lines->first; ptr != NULL; ptr = next) {
+
+        next = ptr->next;
+
+        if (next != NULL && next->data == ptr->data) {
+            listRemoveNode(stop->lines, next);
+            next = ptr;
+        }
+    }
+
+    stop->lines->sorted = SORTED;
+    stop->duplicates = NO;
+    dropView(&stop->view);
+}
+
+/**
+ * Rearranges the lines of the given stop to skip it, like 'rearrangeAll',
+ * inside a batch. Only the stop's lines are visited, and the values of the
+ * other lines are left outdated.
+*/
+void rearrangeStopLines(System *sys, Stop* stop) {
+
+    Line** lines;
+    Node* ptr;
+    int i, count;
+
+    if (stop->duplicates)
+        cleanStopLines(stop);
+
+    if ((count = stop->lines->count) == 0)
+        return;
+
+    /* The stop's lines are removed while they're rearranged. */
+    lines = (Line**)tryMalloc(count * sizeof(Line*));
+    for (i = 0, ptr = stop->lines->first; ptr != NULL; ptr = ptr->next)
+        lines[i++] = (Line*)ptr->data;
+
+    for (i = 0; i < count; i++) {
+
+        if (lines[i]->num_stops != 0) {
+            refreshLineValues(sys, lines[i]);
+            lines[i]->outdated = rearrangeLine(lines[i], stop, NO);
+        }
+    }
+
+    free(lines);
+    sys->removals++;
+}
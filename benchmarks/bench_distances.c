@@ -0,0 +1,121 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_distances.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the distance kernels. Compares the scalar, SSE2
+ * and AVX2 kernels, checking their distances against the haversine formula
+ * computed with the math library.
+ * Usage: ./bench_distances [stops] [queries]
+*/
+
+#include <math.h>
+#include "main.h"
+
+
+#define DEFAULT_STOPS 1000000
+#define DEFAULT_QUERIES 20
+#define MAX_ERROR_KM 1e-6       /* Largest error accepted. */
+
+
+/**
+ * Returns a random number in [low, high).
+*/
+double randomIn(double low, double high) {
+
+    return low + (high - low) * (rand() / (RAND_MAX + 1.0));
+}
+
+/**
+ * Returns the milliseconds elapsed since the given clock.
+*/
+double elapsedMs(clock_t start) {
+
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/**
+ * Returns the distance (in kilometres) between the two given coordinates
+ * (in degrees) by the haversine formula, with the math library.
+*/
+double haversine(double lat1, double lon1, double lat2, double lon2) {
+
+    double rad = GEO_PI / 180.0;
+    double dlat = sin((lat2 - lat1) * rad / 2.0);
+    double dlon = sin((lon2 - lon1) * rad / 2.0);
+    double hav = dlat * dlat + cos(lat1 * rad) * cos(lat2 * rad) * dlon * dlon;
+
+    return 2.0 * GEO_EARTH_RADIUS * asin(sqrt(hav < 1.0 ? hav : 1.0));
+}
+
+/**
+ * Runs the given number of random queries with the given kernel, presenting
+ * its time and its largest error against the haversine formula. Returns the
+ * milliseconds per query, or a negative value if the error is too large.
+*/
+double runKernel(System *sys, DistanceKernel kernel, char* name,
+                                                int queries, double scalar) {
+
+    StopColumns* columns = sys->columns;
+    double ms = 0, error = 0, diff, point[3], lat, lon;
+    int i, j;
+    clock_t start;
+    Stop* stop;
+
+    srand(42);
+
+    for (i = 0; i < queries; i++) {
+
+        lat = randomIn(-90.0, 90.0);
+        lon = randomIn(-180.0, 180.0);
+        geoPosition(lat, lon, point);
+
+        start = clock();
+        kernel(columns, point, columns->dist);
+        ms += elapsedMs(start);
+
+        for (j = 0; j < columns->count; j++) {
+
+            stop = columns->stops[j];
+            diff = fabs(columns->dist[j] - haversine(lat, lon,
+                                        stop->latitude, stop->longitude));
+            if (diff > error)
+                error = diff;
+        }
+    }
+
+    ms /= queries;
+    printf("%8d stops  %-6s  %8.3f ms/query  %6.2f ns/stop  speedup %5.2fx"
+            "  max error %.2e km  %s\n", columns->count, name, ms,
+            ms * 1e6 / (columns->count ? columns->count : 1),
+            scalar > 0 && ms > 0 ? scalar / ms : 1.0, error,
+            error <= MAX_ERROR_KM ? "ok" : "TOO LARGE");
+
+    return error <= MAX_ERROR_KM ? ms : -1.0;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int queries = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES;
+    System* sys = systemInit();
+    double scalar, sse2, avx2;
+    char name[32];
+    int i;
+
+    srand(2023);
+
+    for (i = 0; i < stops; i++) {
+        sprintf(name, "stop%d", i);
+        addStop(sys, name, randomIn(-90.0, 90.0), randomIn(-180.0, 180.0));
+    }
+
+    scalar = runKernel(sys, distancesScalar, "scalar", queries, 0);
+    sse2 = runKernel(sys, distancesSSE2, "sse2", queries, scalar);
+    avx2 = (sys->columns->kernel == distancesAVX2) ?
+            runKernel(sys, distancesAVX2, "avx2", queries, scalar) : 0;
+
+    exitProgram(sys);
+
+    return scalar < 0 || sse2 < 0 || avx2 < 0;
+}
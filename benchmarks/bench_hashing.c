@@ -0,0 +1,352 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_hashing.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the keyed hashes of the hashtables against the
+ * unkeyed ones they replaced (DJB for the slot, Jenkins' one-at-a-time for
+ * the step), copied here as the reference. First, the hashes per second of
+ * both on the names of the normal inputs. Then, a flood of names crafted
+ * against the reference: built of blocks with the same DJB hash ("Aa" and
+ * "B@"), and kept if their Jenkins hash gives the same step in a new
+ * hashtable, so that they all probe the same slots. The normal names and
+ * the flood are added to a table probed as the hashtables do, with each
+ * hash, presenting the probes and time of each lookup, and then added as
+ * stops and looked up. The system's lookups must stay short (under
+ * HT_PROBE_LENGTHS probes); otherwise, it fails.
+ * Usage: ./bench_hashing [names] [blocks]
+*/
+
+/* Wall clock time (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_NAMES 200000
+#define DEFAULT_BLOCKS 22       /* Of the crafted names (2^22 candidates). */
+#define MAX_BLOCKS 28
+#define ROUNDS 20               /* Of the hashes of the names. */
+#define NAME_LENGTH 64
+
+
+/* Structure of a table of names in their slots, probed as the hashtables
+   do, with the reference or the keyed hashes. */
+typedef struct {
+    char** slots;
+    int size;
+    int keyed;                  /* If it uses the keyed hashes. */
+    long int probes, lookups;
+    int max_probes;
+} RefTable;
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Reference slot hash (DJB), as the hashtables had it.
+*/
+unsigned int referenceHash(char* key) {
+
+    unsigned int hash = 5381;
+    int c;
+
+    while ((c = *(key++)) != 0)
+        hash = ((hash << 5) + hash) + c;
+
+    return hash;
+}
+
+/**
+ * Reference step hash (Jenkins' one-at-a-time), as the hashtables had it.
+*/
+unsigned int referenceStep(char* key) {
+
+    unsigned int hash = 0;
+    int i = 0;
+
+    while (key[i] != '\0') {
+        hash += key[i++];
+        hash += hash << 10;
+        hash ^= hash >> 6;
+    }
+
+    hash += hash << 3;
+    hash ^= hash >> 11;
+    hash += hash << 15;
+
+    return hash;
+}
+
+/**
+ * Writes the name of the given number of blocks, each "Aa" or "B@" by the
+ * bits of the given number: all of them have the same DJB hash.
+*/
+void craftName(char* name, long int bits, int blocks) {
+
+    int i;
+
+    for (i = 0; i < blocks; i++) {
+        name[2 * i] = (bits >> i) & 1 ? 'B' : 'A';
+        name[2 * i + 1] = (bits >> i) & 1 ? '@' : 'a';
+    }
+
+    name[2 * blocks] = '\0';
+}
+
+/**
+ * Crafts the names of the given number of blocks whose reference hashes
+ * give the same slot and step in a new hashtable, at most the given
+ * number. Returns them, and their number in 'count'.
+*/
+char** craftFlood(int blocks, int max, int* count) {
+
+    char** names = (char**)tryMalloc(max * sizeof(char*));
+    char name[NAME_LENGTH];
+    unsigned int target;
+    long int bits;
+
+    craftName(name, 0, blocks);
+    target = referenceStep(name) % HT_START_SIZE;
+    *count = 0;
+
+    for (bits = 0; bits < 1L << blocks && *count < max; bits++) {
+
+        craftName(name, bits, blocks);
+
+        if (referenceStep(name) % HT_START_SIZE == target) {
+            names[*count] = (char*)tryMalloc(strlen(name) + 1);
+            strcpy(names[(*count)++], name);
+        }
+    }
+
+    return names;
+}
+
+/**
+ * Writes the normal name of the given number: as the stops of the public
+ * tests and of ./workload, of a few words.
+*/
+void normalName(char* name, int i) {
+
+    char* words[] = {"Praca", "Rua", "Avenida", "Estacao", "Largo",
+                        "Terminal", "Cais", "Alameda"};
+
+    if (i % 2)
+        sprintf(name, "S%d", i);
+    else
+        sprintf(name, "%s%d-%s", words[i % 8], i, words[(i / 8) % 8]);
+}
+
+/**
+ * Presents the hashes per second of the reference and keyed hashes on the
+ * given names.
+*/
+void benchHashes(char** names, int count) {
+
+    struct timespec start;
+    unsigned int hashes[3], sink = 0;
+    double ms;
+    int round, i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (round = 0; round < ROUNDS; round++)
+        for (i = 0; i < count; i++)
+            sink += referenceHash(names[i]) + referenceStep(names[i]);
+
+    ms = elapsedMs(&start);
+    printf("reference  %12.0f hashes/s  %6.2f ns/hash\n",
+            ROUNDS * (double)count / (ms / 1000.0),
+            ms * 1e6 / (ROUNDS * (double)count));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < count; i++) {
+            calcHashtableHashes(names[i], HT_START_SIZE, hashes);
+            sink += hashes[0] + hashes[2];
+        }
+    }
+
+    ms = elapsedMs(&start);
+    printf("keyed      %12.0f hashes/s  %6.2f ns/hash  (%u)\n",
+            ROUNDS * (double)count / (ms / 1000.0),
+            ms * 1e6 / (ROUNDS * (double)count), sink % 2);
+}
+
+/**
+ * Returns the slot of the given name in the table, or of the first free
+ * slot of its probe sequence, counting the probes if asked.
+*/
+int refProbe(RefTable* table, char* name, int count) {
+
+    unsigned int hashes[3], h;
+    int i = 1;
+
+    if (table->keyed) {
+        calcHashtableHashes(name, table->size, hashes);
+    } else {
+        hashes[0] = referenceHash(name);
+        hashes[2] = referenceStep(name) % table->size;
+        hashes[2] = hashes[2] == 0 ? 1 : hashes[2];
+    }
+
+    h = hashes[0] % table->size;
+
+    while (table->slots[h] != NULL && strcmp(table->slots[h], name) != 0) {
+        h = (hashes[0] + i * hashes[2]) % table->size;
+        i++;
+    }
+
+    if (count) {
+        table->probes += i;
+        table->lookups++;
+        table->max_probes = i > table->max_probes ? i : table->max_probes;
+    }
+
+    return h;
+}
+
+/**
+ * Adds and looks up the given names in a table with the reference or the
+ * keyed hashes, as given, presenting the probes and time of each lookup.
+*/
+void benchTable(char** names, int count, char* label, int keyed) {
+
+    RefTable table;
+    struct timespec start;
+    double ms;
+    int i;
+
+    table.keyed = keyed;
+    table.size = HT_START_SIZE;
+    table.slots = (char**)tryMalloc(table.size * sizeof(char*));
+    table.probes = table.lookups = table.max_probes = 0;
+
+    for (i = 0; i < table.size; i++)
+        table.slots[i] = NULL;
+
+    for (i = 0; i < count; i++)
+        table.slots[refProbe(&table, names[i], NO)] = names[i];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < count; i++)
+        refProbe(&table, names[i], YES);
+
+    ms = elapsedMs(&start);
+    printf("%-6s %-9s  %6d names  %8.2f probes/lookup  %6d max  "
+            "%10.1f ns/lookup\n", label, keyed ? "keyed" : "reference", count,
+            (double)table.probes / table.lookups, table.max_probes,
+            ms * 1e6 / count);
+
+    free(table.slots);
+}
+
+/**
+ * Adds the given names as stops and looks them up, presenting the probes
+ * and time of each lookup. Returns the lookups of HT_PROBE_LENGTHS probes
+ * or more.
+*/
+long int benchKeyed(char** names, int count, char* label) {
+
+    System* sys = systemInit();
+    HashStats* stats = sys->stops_table->stats;
+    long int probes = 0, hits, longest;
+    struct timespec start;
+    double ms;
+    int i, max = 0;
+
+    sys->out = fopen("/dev/null", "w");
+
+    for (i = 0; i < count; i++)
+        addStop(sys, names[i], 0.0, 0.0);
+
+    memset(stats, 0, sizeof(HashStats));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < count; i++)
+        getStop(sys, names[i]);
+
+    ms = elapsedMs(&start);
+    hits = stats->hits;
+    longest = stats->probes[HT_PROBE_LENGTHS - 1];
+
+    for (i = 0; i < HT_PROBE_LENGTHS; i++) {
+        probes += (i + 1) * stats->probes[i];
+        max = stats->probes[i] != 0 ? i + 1 : max;
+    }
+
+    printf("%-6s %-9s  %6d names  %8.2f probes/lookup  %5d%s max  "
+            "%10.1f ns/lookup  %s\n", label, "stops", count,
+            hits ? (double)probes / hits : 0.0, max,
+            max == HT_PROBE_LENGTHS ? "+" : " ", ms * 1e6 / count,
+            longest == 0 && hits == count ? "ok" : "FAILED");
+
+    fclose(sys->out);
+    sys->out = stdout;
+    exitProgram(sys);
+
+    return longest + (hits != count);
+}
+
+int main(int argc, char* argv[]) {
+
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_NAMES;
+    int blocks = argc > 2 ? atoi(argv[2]) : DEFAULT_BLOCKS;
+    char **names, **flood, name[NAME_LENGTH];
+    int i, flooded, normal = HT_START_SIZE * HT_MAX_LOAD - 1;
+    long int failed;
+
+    if (count < 1 || blocks < 1 || blocks > MAX_BLOCKS) {
+        fprintf(stderr, "usage: %s [names] [blocks]\n", argv[0]);
+        return 1;
+    }
+
+    names = (char**)tryMalloc(count * sizeof(char*));
+
+    for (i = 0; i < count; i++) {
+        normalName(name, i);
+        names[i] = (char*)tryMalloc(strlen(name) + 1);
+        strcpy(names[i], name);
+    }
+
+    printf("%d normal names, hashed %d times\n", count, ROUNDS);
+    benchHashes(names, count);
+
+    flood = craftFlood(blocks, normal, &flooded);
+    printf("%d names crafted of %d blocks (%ld candidates), with the same "
+            "reference slot and step in %d slots\n", flooded, blocks,
+            1L << blocks, HT_START_SIZE);
+
+    normal = normal < count ? normal : count;
+    benchTable(names, normal, "normal", NO);
+    benchTable(names, normal, "normal", YES);
+    failed = benchKeyed(names, normal, "normal");
+    benchTable(flood, flooded, "flood", NO);
+    benchTable(flood, flooded, "flood", YES);
+    failed += benchKeyed(flood, flooded, "flood");
+
+    for (i = 0; i < count; i++)
+        free(names[i]);
+
+    for (i = 0; i < flooded; i++)
+        free(flood[i]);
+
+    free(names);
+    free(flood);
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_import.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the bulk import. Imports a generated network
+ * dump with 1 to the given number of threads and compares it with running
+ * its commands one at a time, checking that the messages and the final
+ * state (the lines, stops and intersections listed) are the same.
+ * Usage: ./bench_import [stops] [lines] [links] [threads]
+*/
+
+/* Wall clock time and memory streams (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 50000
+#define DEFAULT_LINES 2000
+#define DEFAULT_LINKS 200000
+#define DEFAULT_THREADS 4
+#define DUMP_FILE "bench_import.dump"
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Writes a network dump with the given number of stops, lines and links
+ * to the dump file. The links extend the lines in turns, and a few of them
+ * fail, like a few repeated stops.
+*/
+void writeDump(int stops, int lines, int links) {
+
+    FILE* file = fopen(DUMP_FILE, "w");
+    int* last = (int*)tryMalloc(lines * sizeof(int));
+    int i, line, next;
+
+    for (i = 0; i < stops; i++) {
+        fprintf(file, "p s%d %d.%03d %d.%03d\n", i, rand() % 80,
+                            rand() % 1000, rand() % 170, rand() % 1000);
+        if (i % 1000 == 999)
+            fprintf(file, "p s%d 1 1\n", rand() % stops);
+    }
+
+    for (i = 0; i < lines; i++) {
+        fprintf(file, "c L%d\n", i);
+        last[i] = rand() % stops;
+    }
+
+    for (i = 0; i < links; i++) {
+
+        line = i % lines;
+        next = rand() % stops;
+
+        if (i % 997 == 0)
+            fprintf(file, "l L%d s%d s%d 1 2\n", line, next, rand() % stops);
+        else
+            fprintf(file, "l L%d s%d s%d %d.5 %d\n", line, last[line], next,
+                                                    rand() % 9, rand() % 60);
+        last[line] = next;
+    }
+
+    free(last);
+    fclose(file);
+}
+
+/**
+ * Runs the given command line, keeping its output in 'output'.
+*/
+void keepOutput(System *sys, char* line, char** output, size_t* length) {
+
+    sys->out = open_memstream(output, length);
+    runCommandLine(sys, line);
+    fclose(sys->out);
+    sys->out = stdout;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int lines = argc > 2 ? atoi(argv[2]) : DEFAULT_LINES;
+    int links = argc > 3 ? atoi(argv[3]) : DEFAULT_LINKS;
+    int threads = argc > 4 ? atoi(argv[4]) : DEFAULT_THREADS;
+    char *expected, *output, *messages, *imported, *text;
+    size_t expected_length, output_length, messages_length, imported_length;
+    double serial_ms, ms;
+    struct timespec start;
+    System* sys;
+    int t, same, ok = YES;
+
+    srand(2023);
+    writeDump(stops, lines, links);
+
+    /* One command at a time. */
+    sys = systemInit();
+    text = readDump(DUMP_FILE);
+    sys->out = open_memstream(&messages, &messages_length);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runCommandLine(sys, text);
+    serial_ms = elapsedMs(&start);
+    fclose(sys->out);
+    free(text);
+    keepOutput(sys, "c\np\ni\n", &expected, &expected_length);
+    exitProgram(sys);
+
+    printf("%d stops, %d lines, %d links, %ld processors online\n", stops,
+                            lines, links, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("replay     %10.1f ms\n", serial_ms);
+
+    for (t = 1; t <= threads; t++) {
+
+        sys = systemInit();
+        sys->workers = createWorkerPool(sys, t);
+
+        sys->out = open_memstream(&imported, &imported_length);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        importDump(sys, DUMP_FILE);
+        ms = elapsedMs(&start);
+        fclose(sys->out);
+
+        keepOutput(sys, "c\np\ni\n", &output, &output_length);
+        exitProgram(sys);
+
+        same = output_length == expected_length &&
+                    memcmp(output, expected, output_length) == 0 &&
+                    imported_length == messages_length &&
+                    memcmp(imported, messages, messages_length) == 0;
+        ok &= same;
+
+        printf("%3d threads %10.1f ms  speedup %5.2fx  %s\n", t, ms,
+                serial_ms / ms, same ? "same state and messages" : "DIFFERENT");
+
+        free(output);
+        free(imported);
+    }
+
+    free(expected);
+    free(messages);
+    remove(DUMP_FILE);
+
+    return ok ? 0 : 1;
+}
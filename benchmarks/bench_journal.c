@@ -0,0 +1,206 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_journal.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the journal. Runs the commands of a generated
+ * dump without a journal, with a journal and no checkpoints and with a
+ * checkpoint every given number of commands, syncing the journal every given
+ * number of commands. Then it recovers the network from each journal,
+ * presenting the time of each and checking that the lines, stops and
+ * intersections listed are the same.
+ * Usage: ./bench_journal [stops] [lines] [links] [checkpoint] [group]
+*/
+
+/* Wall clock time and memory streams (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 50000
+#define DEFAULT_LINES 2000
+#define DEFAULT_LINKS 200000
+#define DEFAULT_CHECKPOINT 100000
+#define NO_CHECKPOINTS 2000000000
+#define JOURNAL_FILE "bench_journal.log"
+#define SNAPSHOT_FILE "bench_journal.log.snap"
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Returns the commands of a network dump with the given number of stops,
+ * lines and links, where a stop is removed every thousand links.
+*/
+char* createDump(int stops, int lines, int links) {
+
+    char* text;
+    size_t length;
+    FILE* dump = open_memstream(&text, &length);
+    int* last = (int*)tryMalloc(lines * sizeof(int));
+    int i, line, next;
+
+    for (i = 0; i < stops; i++)
+        fprintf(dump, "p s%d %d.%03d %d.%03d\n", i, rand() % 80,
+                            rand() % 1000, rand() % 170, rand() % 1000);
+
+    for (i = 0; i < lines; i++) {
+        fprintf(dump, "c L%d\n", i);
+        last[i] = rand() % stops;
+    }
+
+    for (i = 0; i < links; i++) {
+
+        line = i % lines;
+        next = rand() % stops;
+        fprintf(dump, "l L%d s%d s%d %d.5 %d\n", line, last[line], next,
+                                                    rand() % 9, rand() % 60);
+        last[line] = next;
+
+        if (i % 1000 == 999)
+            fprintf(dump, "e s%d\n", rand() % stops);
+    }
+
+    free(last);
+    fclose(dump);
+
+    return text;
+}
+
+/**
+ * Runs the given commands, discarding their messages.
+*/
+void runQuietly(System *sys, char* text) {
+
+    char* output;
+    size_t length;
+
+    sys->out = open_memstream(&output, &length);
+    runCommandLine(sys, text);
+    fclose(sys->out);
+    sys->out = stdout;
+    free(output);
+}
+
+/**
+ * Returns the lines, stops and intersections listed by the system.
+*/
+char* listState(System *sys) {
+
+    char* output;
+    size_t length;
+
+    sys->out = open_memstream(&output, &length);
+    runCommandLine(sys, "c\np\ni\n");
+    fclose(sys->out);
+    sys->out = stdout;
+
+    return output;
+}
+
+/**
+ * Runs the commands of the dump with a journal taking a checkpoint every
+ * 'checkpoint' commands, and then recovers the network from the journal.
+ * Returns YES if the recovered network is the expected one.
+*/
+int benchJournal(char* text, char* expected, long int checkpoint,
+                                            long int group, double plain_ms) {
+
+    System* sys = systemInit();
+    struct timespec start;
+    double run_ms, recover_ms;
+    long int syncs, checkpoints;
+    char* output;
+    int same;
+
+    remove(JOURNAL_FILE);
+    remove(SNAPSHOT_FILE);
+
+    sys->journal = openJournal(sys, JOURNAL_FILE);
+    sys->journal->checkpoint_every = checkpoint;
+    sys->journal->group_size = group;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runQuietly(sys, text);
+    syncJournal(sys->journal);
+    run_ms = elapsedMs(&start);
+
+    syncs = sys->journal->syncs;
+    checkpoints = sys->journal->checkpoints;
+    exitProgram(sys);
+
+    /* Recovery, as if the program had stopped after the last command. */
+    sys = systemInit();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sys->journal = openJournal(sys, JOURNAL_FILE);
+    recover_ms = elapsedMs(&start);
+
+    output = listState(sys);
+    same = strcmp(output, expected) == 0;
+
+    if (checkpoint == NO_CHECKPOINTS)
+        printf("no checkpoints:\n");
+    else
+        printf("checkpoint every %ld commands:\n", checkpoint);
+
+    printf("  run      %10.1f ms  (%+.1f%%, %ld syncs, %ld checkpoints)\n",
+            run_ms, (run_ms / plain_ms - 1.0) * 100.0, syncs, checkpoints);
+    printf("  recover  %10.1f ms  (%.2fx faster than replay)  %s\n",
+            recover_ms, plain_ms / recover_ms,
+            same ? "same state" : "DIFFERENT STATE");
+
+    free(output);
+    exitProgram(sys);
+
+    return same;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int lines = argc > 2 ? atoi(argv[2]) : DEFAULT_LINES;
+    int links = argc > 3 ? atoi(argv[3]) : DEFAULT_LINKS;
+    long int checkpoint = argc > 4 ? atol(argv[4]) : DEFAULT_CHECKPOINT;
+    long int group = argc > 5 ? atol(argv[5]) : JOURNAL_GROUP;
+    System* sys = systemInit();
+    struct timespec start;
+    char *text, *expected;
+    double plain_ms;
+    int ok;
+
+    srand(2023);
+    text = createDump(stops, lines, links);
+
+    /* Without a journal, which is also the time of a full replay. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runQuietly(sys, text);
+    plain_ms = elapsedMs(&start);
+    expected = listState(sys);
+    exitProgram(sys);
+
+    printf("%d stops, %d lines, %d links, synced every %ld commands\n",
+                                                stops, lines, links, group);
+    printf("no journal %10.1f ms  (full replay)\n", plain_ms);
+
+    ok = benchJournal(text, expected, NO_CHECKPOINTS, group, plain_ms);
+    ok = benchJournal(text, expected, checkpoint, group, plain_ms) && ok;
+
+    free(text);
+    free(expected);
+    remove(JOURNAL_FILE);
+    remove(SNAPSHOT_FILE);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_lookups.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark and stress test of the lookups of the stops taking
+ * no locks. Reader threads look up stops by name while a writer adds and
+ * removes other stops, so that the hashtable reuses deleted slots and grows
+ * meanwhile. The lookups run once with a reader-writer lock around each one
+ * and once inside the grace periods of the hashtable, with 1 to the given
+ * number of readers, presenting the lookups per second. Every stop that is
+ * never removed must be found with its coordinates, and every stop found
+ * must have the name looked up; otherwise it fails. Built with
+ * ThreadSanitizer by 'make tsan'.
+ * Usage: ./bench_lookups [stops] [lookups] [readers]
+*/
+
+/* Wall clock time (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 50000
+#define DEFAULT_LOOKUPS 1000000
+#define DEFAULT_READERS 8
+#define CHURN_WINDOW 100        /* Stops added by the writer and kept. */
+#define SMALL_TABLE 17          /* Starting slots, so that it grows. */
+
+
+/* Structure of the lookups run at once. */
+typedef struct {
+    System* sys;
+    RWLock lock;
+    int use_lock;               /* If the lookups take the lock. */
+    int stops, lookups;
+    char** names;               /* Of the stops never removed. */
+    int readers_done;
+    long int errors;
+    long int added;             /* Stops added by the writer. */
+} BenchLookups;
+
+/* Structure of benchmark reader. */
+typedef struct {
+    pthread_t thread;
+    BenchLookups* bench;
+    int id;
+    unsigned int seed;
+} BenchReader;
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Returns the latitude of the stop with the given number, which is never
+ * removed.
+*/
+double stopLatitude(int i) {
+
+    return i % 80 + 0.25;
+}
+
+/**
+ * Looks up the stops of a reader: mostly stops that are never removed,
+ * which must be found with their coordinates, and some of the writer's,
+ * which must have the name looked up if they're found.
+*/
+void* lookupThread(void* arg) {
+
+    BenchReader* reader = arg;
+    BenchLookups* bench = reader->bench;
+    char churn[BUFLEN], *name;
+    Stop* stop;
+    long int errors = 0;
+    int i, number, kept;
+
+    for (i = 0; i < bench->lookups; i++) {
+
+        kept = rand_r(&reader->seed) % 10 != 0;
+        number = rand_r(&reader->seed) % (kept ? bench->stops :
+                                                        2 * CHURN_WINDOW);
+
+        if (kept) {
+            name = bench->names[number];
+        } else {
+            name = churn;
+            sprintf(name, "x%ld", __atomic_load_n(&bench->added,
+                                        __ATOMIC_RELAXED) / 2 + number);
+        }
+
+        if (bench->use_lock)
+            readLock(&bench->lock);
+        else
+            enterEpoch(bench->sys->epochs, reader->id);
+
+        stop = getStop(bench->sys, name);
+
+        if (stop != NULL) {
+            errors += strcmp(nameChars(&stop->name), name) != 0 || (kept &&
+                                stop->latitude != stopLatitude(number));
+        } else {
+            errors += kept;
+        }
+
+        if (bench->use_lock)
+            readUnlock(&bench->lock);
+        else
+            leaveEpoch(bench->sys->epochs, reader->id);
+    }
+
+    __atomic_add_fetch(&bench->errors, errors, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bench->readers_done, 1, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+/**
+ * Adds and removes stops until every reader is done: each step adds two
+ * stops and removes the oldest, so that the hashtable keeps growing.
+*/
+void runWriter(BenchLookups* bench, int num_readers) {
+
+    System* sys = bench->sys;
+    char name[BUFLEN];
+    long int added = 0, removed = 0;
+
+    while (__atomic_load_n(&bench->readers_done, __ATOMIC_ACQUIRE) <
+                                                                num_readers) {
+
+        if (bench->use_lock)
+            writeLock(&bench->lock);
+
+        sprintf(name, "x%ld", added++);
+        addStop(sys, name, -1.0, -1.0);
+        sprintf(name, "x%ld", added++);
+        addStop(sys, name, -1.0, -1.0);
+
+        if (added > CHURN_WINDOW) {
+            sprintf(name, "x%ld", removed++);
+            removeStop(sys, name);
+        }
+
+        if (bench->use_lock)
+            writeUnlock(&bench->lock);
+        else
+            reclaimMemory(sys->epochs);
+
+        __atomic_store_n(&bench->added, added, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Runs the lookups of the given number of readers, with the lock or inside
+ * grace periods, presenting the lookups per second. Returns YES if every
+ * lookup found what it should.
+*/
+int benchLookups(int stops, int lookups, int num_readers, int use_lock) {
+
+    BenchLookups bench;
+    BenchReader* readers = (BenchReader*)tryMalloc(num_readers *
+                                                        sizeof(BenchReader));
+    struct timespec start;
+    long int retired = 0, reclaimed = 0;
+    char name[BUFLEN];
+    double ms;
+    int i, slots;
+
+    bench.sys = systemInit();
+    bench.use_lock = use_lock;
+    bench.stops = stops;
+    bench.lookups = lookups;
+    bench.names = (char**)tryMalloc(stops * sizeof(char*));
+    bench.readers_done = 0;
+    bench.errors = 0;
+    bench.added = 0;
+    initRWLock(&bench.lock);
+
+    resetHashtable(bench.sys->stops_table, SMALL_TABLE);
+
+    for (i = 0; i < stops; i++) {
+        sprintf(name, "s%d", i);
+        addStop(bench.sys, name, stopLatitude(i), i % 170 + 0.5);
+        bench.names[i] = nameChars(&getStop(bench.sys, name)->name);
+    }
+
+    if (!use_lock) {
+        bench.sys->epochs = createEpochs(num_readers);
+        bench.sys->stops_table->epochs = bench.sys->epochs;
+    }
+
+    slots = bench.sys->stops_table->slots->size;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_readers; i++) {
+        readers[i].bench = &bench;
+        readers[i].id = i;
+        readers[i].seed = 2023 + i;
+        pthread_create(&readers[i].thread, NULL, lookupThread, &readers[i]);
+    }
+
+    runWriter(&bench, num_readers);
+
+    for (i = 0; i < num_readers; i++)
+        pthread_join(readers[i].thread, NULL);
+
+    ms = elapsedMs(&start);
+
+    if (!use_lock) {
+        retired = bench.sys->epochs->retired_count;
+        reclaimed = bench.sys->epochs->reclaimed;
+        bench.sys->stops_table->epochs = NULL;
+        destroyEpochs(bench.sys->epochs);
+        bench.sys->epochs = NULL;
+    }
+
+    printf("%-6s %3d readers %11.0f lookups/s  %6ld stops added  %6d to %6d "
+            "slots  %6ld retired (%ld reclaimed)  %s\n",
+            use_lock ? "lock" : "epochs", num_readers,
+            (double)num_readers * lookups / (ms / 1000.0), bench.added, slots,
+            bench.sys->stops_table->slots->size, retired, reclaimed,
+            bench.errors == 0 ? "ok" : "FAILED");
+
+    destroyRWLock(&bench.lock);
+    exitProgram(bench.sys);
+    free(bench.names);
+    free(readers);
+
+    return bench.errors == 0;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int lookups = argc > 2 ? atoi(argv[2]) : DEFAULT_LOOKUPS;
+    int max_readers = argc > 3 ? atoi(argv[3]) : DEFAULT_READERS;
+    int readers, ok = YES;
+
+    printf("%d stops, %d lookups per reader, %ld processors online\n",
+                        stops, lookups, sysconf(_SC_NPROCESSORS_ONLN));
+
+    for (readers = 1; readers <= max_readers; readers *= 2) {
+        ok = benchLookups(stops, lookups, readers, YES) && ok;
+        ok = benchLookups(stops, lookups, readers, NO) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
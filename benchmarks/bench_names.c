@@ -0,0 +1,249 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_names.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the compact names of the stops (inline if
+ * short, or else interned) against the names they replaced (a pointer to a
+ * copy of each, allocated on its own), copied here as the reference. The
+ * names are as the stops of the public tests, mostly short, with the given
+ * percentage of long ones. First, the bytes of each stop with its name:
+ * accounted (the stop and the bytes of its name) and resident (the memory
+ * the process grew by, with the allocator's). Then, the time of comparing
+ * each name with a key of the probes of a lookup, in a shuffled order: the
+ * stop's own name (a hit) and another stop's (a miss), which the compact
+ * names tell apart by their hashes alone. Every compare must be right;
+ * otherwise, it fails.
+ * Usage: ./bench_names [stops] [long percentage]
+*/
+
+/* Wall clock time (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 200000
+#define DEFAULT_LONG 10         /* Percentage of long names. */
+#define ROUNDS 10               /* Of the compares of the names. */
+#define NAME_LENGTH 64
+
+
+/* Structure of a stop of the reference, with the name it had. */
+typedef struct {
+    char* name;
+    char rest[sizeof(Stop) - sizeof(Name)];
+} RefStop;
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Writes the name of the stop of the given number: as the stops of the
+ * public tests, short, or long if drawn so with the given percentage.
+*/
+void stopName(char* name, int i, int percentage) {
+
+    char* words[] = {"Praca", "Rua", "Avenida", "Estacao", "Largo",
+                        "Terminal", "Cais", "Alameda"};
+
+    if ((i * 37) % 100 < percentage)
+        sprintf(name, "Terminal Rodoviario %s %d de %s", words[i % 8], i,
+                                                        words[(i / 8) % 8]);
+    else if (i % 2)
+        sprintf(name, "S%d", i);
+    else
+        sprintf(name, "%s%d", words[i % 8], i);
+}
+
+/**
+ * Shuffles the given order of the given number of stops.
+*/
+void shuffle(int* order, int count) {
+
+    unsigned long seed = 2023;
+    int i, j, tmp;
+
+    for (i = 0; i < count; i++)
+        order[i] = i;
+
+    for (i = count - 1; i > 0; i--) {
+        seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+        j = (int)((seed >> 1) % (i + 1));
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+}
+
+/**
+ * Presents the bytes of each of the given number of stops: accounted and
+ * resident (from the given resident memory, in kilobytes, before).
+*/
+void printBytes(char* label, int count, double accounted, long int before) {
+
+    printf("%-9s %7.1f bytes/stop accounted  %7.1f bytes/stop resident\n",
+            label, accounted / count,
+            (residentMemory() - before) * 1024.0 / count);
+}
+
+/**
+ * Compares the key of each stop, in the given order, with its name and
+ * with the name of the next one, in the reference stops. Returns the wrong
+ * compares.
+*/
+long int compareRef(RefStop** stops, char** keys, int* order, int count) {
+
+    struct timespec start;
+    long int wrong = 0;
+    int round, i, k;
+    double ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < count; i++) {
+            k = order[i];
+            wrong += strcmp(stops[k]->name, keys[k]) != 0;
+            wrong += strcmp(stops[order[(i + 1) % count]]->name, keys[k]) == 0;
+        }
+    }
+
+    ms = elapsedMs(&start);
+    printf("reference %7.1f ns/compare  (strcmp)\n",
+                                    ms * 1e6 / (2.0 * ROUNDS * count));
+
+    return wrong;
+}
+
+/**
+ * Compares the key of each stop, in the given order, with its name and
+ * with the name of the next one, in the stops of compact names, as the
+ * hashtables do: with the length and hash of the key, calculated by the
+ * lookup before it probes. Returns the wrong compares.
+*/
+long int compareCompact(Stop** stops, char** keys, int* order, int count) {
+
+    unsigned int* hashes = (unsigned int*)tryMalloc(2 * count * 
+                                                        sizeof(unsigned int));
+    int* lengths = (int*)tryMalloc(count * sizeof(int));
+    struct timespec start;
+    long int wrong = 0;
+    int round, i, k;
+    double ms;
+
+    for (i = 0; i < count; i++)
+        lengths[i] = keyedHash(keys[i], &hashes[2 * i]);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < count; i++) {
+            k = order[i];
+            wrong += !nameEquals(&stops[k]->name, keys[k], lengths[k],
+                                                            hashes[2 * k]);
+            wrong += nameEquals(&stops[order[(i + 1) % count]]->name, keys[k],
+                                                lengths[k], hashes[2 * k]);
+        }
+    }
+
+    ms = elapsedMs(&start);
+    printf("compact   %7.1f ns/compare  (length and hash first)\n",
+                                    ms * 1e6 / (2.0 * ROUNDS * count));
+
+    free(hashes);
+    free(lengths);
+
+    return wrong;
+}
+
+int main(int argc, char* argv[]) {
+
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int percentage = argc > 2 ? atoi(argv[2]) : DEFAULT_LONG;
+    char name[NAME_LENGTH], **keys;
+    RefStop** ref_stops;
+    Stop** stops;
+    NameArena* arena;
+    long int before, wrong, ref_bytes = 0;
+    int* order;
+    int i, longer = 0;
+
+    if (count < 2 || percentage < 0 || percentage > 100) {
+        fprintf(stderr, "usage: %s [stops] [long percentage]\n", argv[0]);
+        return 1;
+    }
+
+    keys = (char**)tryMalloc(count * sizeof(char*));
+    order = (int*)tryMalloc(count * sizeof(int));
+    ref_stops = (RefStop**)tryMalloc(count * sizeof(RefStop*));
+    stops = (Stop**)tryMalloc(count * sizeof(Stop*));
+
+    for (i = 0; i < count; i++) {
+        stopName(name, i, percentage);
+        keys[i] = (char*)tryMalloc(strlen(name) + 1);
+        strcpy(keys[i], name);
+        longer += strlen(name) >= NAME_INLINE;
+    }
+
+    printf("%d stops, %d names of %d bytes or more, %d bytes of a name "
+            "(inline up to %d)\n", count, longer, NAME_INLINE,
+            (int)sizeof(Name), NAME_INLINE - 1);
+
+    before = residentMemory();
+
+    for (i = 0; i < count; i++) {
+        ref_stops[i] = (RefStop*)tryMalloc(sizeof(RefStop));
+        ref_stops[i]->name = (char*)tryMalloc(strlen(keys[i]) + 1);
+        strcpy(ref_stops[i]->name, keys[i]);
+        ref_bytes += sizeof(RefStop) + strlen(keys[i]) + 1;
+    }
+
+    printBytes("reference", count, ref_bytes, before);
+
+    before = residentMemory();
+    arena = createNameArena();
+
+    for (i = 0; i < count; i++) {
+        stops[i] = (Stop*)tryMalloc(sizeof(Stop));
+        populateName(&stops[i]->name, keys[i], arena);
+    }
+
+    printBytes("compact", count, (double)count * sizeof(Stop) + arena->bytes,
+                                                                    before);
+
+    shuffle(order, count);
+    wrong = compareRef(ref_stops, keys, order, count);
+    wrong += compareCompact(stops, keys, order, count);
+
+    for (i = 0; i < count; i++) {
+        wrong += strcmp(nameChars(&stops[i]->name), keys[i]) != 0;
+        releaseName(&stops[i]->name);
+        free(stops[i]);
+        free(ref_stops[i]->name);
+        free(ref_stops[i]);
+        free(keys[i]);
+    }
+
+    wrong += arena->count != 0;
+    printf("%s\n", wrong == 0 ? "ok" : "FAILED");
+
+    destroyNameArena(arena);
+    free(keys);
+    free(order);
+    free(ref_stops);
+    free(stops);
+
+    return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_ranges.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the range queries. Compares the range index
+ * with a scan of every stop, checking that both find the same stops, and
+ * presents the memory used by the index per stop.
+ * Usage: ./bench_ranges [stops] [queries]
+*/
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 1000000
+#define DEFAULT_QUERIES 100
+#define BOX_DEGREES 2.0         /* Side of the query rectangles. */
+#define RADIUS_KM 100.0         /* Radius of the query circles. */
+
+
+/**
+ * Returns a random number in [low, high).
+*/
+double randomIn(double low, double high) {
+
+    return low + (high - low) * (rand() / (RAND_MAX + 1.0));
+}
+
+/**
+ * Returns the milliseconds elapsed since the given clock.
+*/
+double elapsedMs(clock_t start) {
+
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/**
+ * Adds to 'found' the stops of the system inside the rectangle (if 'km' is
+ * negative) or within 'km' of its first corner, by comparing every stop.
+*/
+void scanStops(System *sys, double low[2], double high[2], double km,
+                                                        StopArray* found) {
+
+    Node* ptr;
+    Stop* stop;
+
+    for (ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next) {
+
+        stop = (Stop*)ptr->data;
+
+        if (km < 0 ? stop->latitude >= low[0] && stop->latitude <= high[0] &&
+                stop->longitude >= low[1] && stop->longitude <= high[1] :
+                geoDistance(low[0], low[1], stop->latitude,
+                                                stop->longitude) <= km)
+            appendStop(found, stop);
+    }
+}
+
+/**
+ * Runs the given number of random rectangle (if 'km' is negative) or circle
+ * queries with the range index and with the scan, presenting the time of
+ * both. Returns NO if they found different stops, or YES otherwise.
+*/
+int compareQueries(System *sys, int queries, double km) {
+
+    StopArray *by_index = createStopArray(), *by_scan = createStopArray();
+    double index_ms = 0, scan_ms = 0, low[2], high[2];
+    int i, j, ok = YES;
+    long int found = 0;
+    clock_t start;
+
+    for (i = 0; i < queries; i++) {
+
+        low[0] = randomIn(-90.0, 90.0 - BOX_DEGREES);
+        low[1] = randomIn(-180.0, 180.0 - BOX_DEGREES);
+        high[0] = low[0] + BOX_DEGREES;
+        high[1] = low[1] + BOX_DEGREES;
+        by_index->count = 0;
+        by_scan->count = 0;
+
+        start = clock();
+        if (km < 0)
+            rangeSearch(sys->ranges, low, high, by_index);
+        else
+            stopsWithin(sys->ranges, low[0], low[1], km, by_index);
+        sortStopArray(by_index);
+        index_ms += elapsedMs(start);
+
+        start = clock();
+        scanStops(sys, low, high, km, by_scan);
+        scan_ms += elapsedMs(start);
+
+        found += by_index->count;
+        if (by_index->count != by_scan->count)
+            ok = NO;
+        for (j = 0; ok && j < by_index->count; j++)
+            if (by_index->items[j] != by_scan->items[j])
+                ok = NO;
+    }
+
+    printf("%8d stops  %-6s  %6.1f found  index %9.4f ms/query "
+            "(%8.0f queries/s)  scan %9.4f ms/query  %s\n",
+            sys->stops_list->count, km < 0 ? "box" : "radius",
+            (double)found / queries, index_ms / queries,
+            index_ms > 0 ? queries * 1000.0 / index_ms : 0.0,
+            scan_ms / queries, ok ? "same stops" : "DIFFERENT STOPS");
+
+    destroyStopArray(by_index);
+    destroyStopArray(by_scan);
+
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int queries = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES;
+    System* sys = systemInit();
+    char name[32];
+    clock_t start;
+    int i, ok = YES;
+
+    srand(2023);
+
+    start = clock();
+    for (i = 0; i < stops; i++) {
+        sprintf(name, "stop%d", i);
+        addStop(sys, name, randomIn(-90.0, 90.0), randomIn(-180.0, 180.0));
+    }
+    printf("inserted %d stops in %.1f ms, range index %.1f bytes/stop\n",
+            stops, elapsedMs(start),
+            (double)rangeIndexMemory(sys->ranges) / (stops ? stops : 1));
+
+    ok &= compareQueries(sys, queries, -1.0);
+    ok &= compareQueries(sys, queries, RADIUS_KM);
+
+    /* Remove three quarters of the stops, forcing a rebuild. */
+    start = clock();
+    for (i = 0; i < stops; i++) {
+        if (i % 4 != 0) {
+            sprintf(name, "stop%d", i);
+            removeStop(sys, name);
+        }
+    }
+    printf("removed %d stops in %.1f ms, range index %.1f bytes/stop\n",
+            stops - (stops + 3) / 4, elapsedMs(start),
+            (double)rangeIndexMemory(sys->ranges) /
+            (sys->stops_list->count ? sys->stops_list->count : 1));
+
+    ok &= compareQueries(sys, queries, -1.0);
+    ok &= compareQueries(sys, queries, RADIUS_KM);
+
+    exitProgram(sys);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,471 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_server.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: load generator of the server mode. Starts a server with a
+ * generated network in its own process, then connects an increasing number
+ * of clients, each sending commands one after the other: mostly reading
+ * commands, a share of links extending a line of its own and, for the first
+ * client, the names frozen now and then ('z freeze'). Presents the
+ * throughput and the median and 99th percentile latency of each number of
+ * clients, next to the time a process per command would take replaying the
+ * network. With 100% writes, the clients only link their own lines, which
+ * the server runs in parallel. Before that, two clients extend the same line
+ * at once, from either end, and the line and the stops are checked against
+ * the same links run one at a time.
+ * Usage: ./bench_server [stops] [commands] [clients] [threads] [writes %]
+*/
+
+/* Wall clock time, sockets and processes (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+
+#define DEFAULT_STOPS 20000
+#define DEFAULT_COMMANDS 2000
+#define DEFAULT_CLIENTS 16
+#define DEFAULT_WRITES 10
+#define LINK_STOPS 50
+#define FREEZE_EVERY 500
+#define SOCKET_FILE "bench_server.sock"
+#define SHARED_LINE "shared"
+
+
+/* Structure of benchmark client (thread sending commands to the server). */
+typedef struct {
+    pthread_t thread;
+    int id, stops, commands, writes;
+    unsigned int seed;
+    double* latency;            /* Of each command, in milliseconds. */
+    int ok;                     /* If every reply was read. */
+} BenchClient;
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Returns the commands of a network with the given number of stops, with
+ * lines of consecutive stops.
+*/
+char* createNetwork(int stops) {
+
+    char* text;
+    size_t length;
+    FILE* out = open_memstream(&text, &length);
+    int i;
+
+    for (i = 0; i < stops; i++)
+        fprintf(out, "p s%d %d.%03d %d.%03d\n", i, rand() % 80,
+                            rand() % 1000, rand() % 170, rand() % 1000);
+
+    for (i = 0; i + 1 < stops; i++) {
+        if (i % LINK_STOPS == 0)
+            fprintf(out, "c L%d\n", i / LINK_STOPS);
+        fprintf(out, "l L%d s%d s%d 1 2\n", i / LINK_STOPS, i, i + 1);
+    }
+
+    fclose(out);
+
+    return text;
+}
+
+/**
+ * Connects to the server, trying again while it doesn't listen yet.
+ * Returns the descriptor of the connection, or ERR if it can't connect.
+*/
+int connectServer() {
+
+    struct sockaddr_un address;
+    struct timespec pause = {0, 10000000};
+    int fd, tries;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, SOCKET_FILE);
+
+    for (tries = 0; tries < 500; tries++) {
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0)
+            return fd;
+
+        close(fd);
+        nanosleep(&pause, NULL);
+    }
+
+    return ERR;
+}
+
+/**
+ * Sends the given data to the server. Returns YES if it was all sent, or NO
+ * if the server is gone.
+*/
+int sendAll(int fd, char* data, size_t length) {
+
+    ssize_t count;
+
+    while (length > 0) {
+
+        if ((count = send(fd, data, length, MSG_NOSIGNAL)) < 0) {
+
+            if (errno == EINTR)
+                continue;
+
+            return NO;
+        }
+
+        data += count;
+        length -= count;
+    }
+
+    return YES;
+}
+
+/**
+ * Sends the given command to the server and reads the reply, discarding
+ * its output. Returns YES if the whole reply was read.
+*/
+int request(int fd, FILE* replies, char* command) {
+
+    unsigned long length, i;
+
+    if (!sendAll(fd, command, strlen(command)) ||
+                                fscanf(replies, "%lu", &length) != 1 ||
+                                fgetc(replies) != '\n')
+        return NO;
+
+    for (i = 0; i < length; i++)
+        if (fgetc(replies) == EOF)
+            return NO;
+
+    return YES;
+}
+
+/**
+ * Sends the given command to the server and reads the reply. Returns its
+ * output, or NULL if the whole reply wasn't read.
+*/
+char* requestOutput(int fd, FILE* replies, char* command) {
+
+    unsigned long length;
+    char* output;
+
+    if (!sendAll(fd, command, strlen(command)) ||
+                                fscanf(replies, "%lu", &length) != 1 ||
+                                fgetc(replies) != '\n')
+        return NULL;
+
+    output = (char*)tryMalloc(length + 1);
+
+    if (fread(output, 1, length, replies) != length) {
+        free(output);
+        return NULL;
+    }
+
+    output[length] = '\0';
+
+    return output;
+}
+
+/**
+ * Writes to the given buffer the given link of the shared line, by the
+ * given client: the first extends its end with the stops of odd numbers,
+ * and the second its start with those of even numbers. Neither changes the
+ * end of the other, so each link is valid whatever order they run in.
+*/
+void sharedLink(char* command, int id, int i) {
+
+    if (id == 0)
+        sprintf(command, "l %s s%d s%d 1 2\n", SHARED_LINE, 2 * i + 1,
+                                                                2 * i + 3);
+    else
+        sprintf(command, "l %s s%d s%d 1 2\n", SHARED_LINE, 2 * i + 2,
+                                                                    2 * i);
+}
+
+/**
+ * Sends the links of the shared line of a client, reading the line now and
+ * then. Every link must have no output.
+*/
+void* editorThread(void* arg) {
+
+    BenchClient* client = arg;
+    char command[BUFLEN], *output;
+    int fd = connectServer(), i;
+    FILE* replies;
+
+    client->ok = NO;
+
+    if (fd == ERR)
+        return NULL;
+
+    replies = fdopen(fd, "r");
+    client->ok = YES;
+
+    for (i = 0; i < client->commands && client->ok; i++) {
+
+        sharedLink(command, client->id, i);
+        output = requestOutput(fd, replies, command);
+        client->ok = output != NULL && output[0] == '\0';
+        free(output);
+
+        if (client->ok && i % 10 == 0)
+            client->ok = request(fd, replies, "c " SHARED_LINE "\n");
+    }
+
+    fclose(replies);
+
+    return NULL;
+}
+
+/**
+ * Checks the links of a line added by two clients at once, with the given
+ * number of links each, on the given network: the line and the lines of
+ * the stops must be those of the same links added one at a time. Returns
+ * YES if so.
+*/
+int checkSharedLine(char* network, int links) {
+
+    BenchClient clients[2];
+    char command[BUFLEN], *expected, *line, *stops;
+    size_t length;
+    System* sys;
+    FILE* replies;
+    int fd, i, id, ok;
+
+    /* One at a time: the links of the first client, then the second's. */
+    sys = systemInit();
+    runCommandLine(sys, network);
+    strcpy(command, "c " SHARED_LINE "\nl " SHARED_LINE " s0 s1 1 2\n");
+    runCommandLine(sys, command);
+
+    for (id = 0; id < 2; id++)
+        for (i = 0; i < links; i++) {
+            sharedLink(command, id, i);
+            runCommandLine(sys, command);
+        }
+
+    sys->out = open_memstream(&expected, &length);
+    strcpy(command, "c " SHARED_LINE "\np\n");
+    runCommandLine(sys, command);
+    fclose(sys->out);
+    sys->out = stdout;
+    exitProgram(sys);
+
+    if ((fd = connectServer()) == ERR) {
+        free(expected);
+        return NO;
+    }
+
+    replies = fdopen(fd, "r");
+    ok = request(fd, replies, "c " SHARED_LINE "\n") &&
+                    request(fd, replies, "l " SHARED_LINE " s0 s1 1 2\n");
+
+    for (id = 0; id < 2; id++) {
+        clients[id].id = id;
+        clients[id].commands = links;
+        pthread_create(&clients[id].thread, NULL, editorThread,
+                                                            &clients[id]);
+    }
+
+    for (id = 0; id < 2; id++) {
+        pthread_join(clients[id].thread, NULL);
+        ok &= clients[id].ok;
+    }
+
+    line = requestOutput(fd, replies, "c " SHARED_LINE "\n");
+    stops = requestOutput(fd, replies, "p\n");
+
+    ok = ok && line != NULL && stops != NULL &&
+            strlen(line) + strlen(stops) == length &&
+            strncmp(expected, line, strlen(line)) == 0 &&
+            strcmp(expected + strlen(line), stops) == 0;
+
+    printf("2 clients linking one line (%d links each): %s\n", links,
+                                    ok ? "same as one at a time" : "FAILED");
+
+    free(line);
+    free(stops);
+    free(expected);
+    fclose(replies);
+
+    return ok;
+}
+
+/**
+ * Sends the commands of a client: its line is created, and then each
+ * command reads a line or a stop (by name, or listing the lines), or
+ * extends its line. The first client also freezes the names, once every
+ * FREEZE_EVERY commands, while the others look them up.
+*/
+void* clientThread(void* arg) {
+
+    BenchClient* client = arg;
+    char command[BUFLEN];
+    struct timespec start;
+    int fd = connectServer(), last = 0, next, i, kind, lines;
+    FILE* replies;
+
+    client->ok = NO;
+
+    if (fd == ERR)
+        return NULL;
+
+    replies = fdopen(fd, "r");
+    lines = client->stops / LINK_STOPS;
+    sprintf(command, "c W%d\n", client->id);
+    client->ok = request(fd, replies, command);
+
+    for (i = 0; i < client->commands && client->ok; i++) {
+
+        kind = rand_r(&client->seed) % 100;
+
+        if (client->id % 1000 == 0 && i % FREEZE_EVERY == FREEZE_EVERY - 1) {
+            sprintf(command, "z freeze\n");
+        } else if (kind < client->writes) {
+            next = rand_r(&client->seed) % client->stops;
+            sprintf(command, "l W%d s%d s%d 1 2\n", client->id, last, next);
+            last = next;
+        } else if (kind < 50) {
+            sprintf(command, "c L%d\n", rand_r(&client->seed) % lines);
+        } else if (kind < 98) {
+            sprintf(command, "p s%d\n", rand_r(&client->seed) % client->stops);
+        } else {
+            sprintf(command, "c\n");
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        client->ok = request(fd, replies, command);
+        client->latency[i] = elapsedMs(&start);
+    }
+
+    fclose(replies);
+
+    return NULL;
+}
+
+/**
+ * Compares two latencies.
+*/
+int compareLatency(const void* first, const void* second) {
+
+    double a = *(double*)first, b = *(double*)second;
+
+    return a < b ? -1 : a > b;
+}
+
+/**
+ * Runs the given number of clients at once, presenting the throughput and
+ * the latency. Returns YES if every reply was read.
+*/
+int benchClients(int num_clients, int stops, int commands, int writes) {
+
+    BenchClient* clients = (BenchClient*)tryMalloc(num_clients *
+                                                        sizeof(BenchClient));
+    double* latency = (double*)tryMalloc(num_clients * commands *
+                                                            sizeof(double));
+    struct timespec start;
+    double ms;
+    int i, total = num_clients * commands, ok = YES;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_clients; i++) {
+        clients[i].id = num_clients * 1000 + i;
+        clients[i].stops = stops;
+        clients[i].commands = commands;
+        clients[i].writes = writes;
+        clients[i].seed = 2023 + i;
+        clients[i].latency = latency + i * commands;
+        pthread_create(&clients[i].thread, NULL, clientThread, &clients[i]);
+    }
+
+    for (i = 0; i < num_clients; i++) {
+        pthread_join(clients[i].thread, NULL);
+        ok &= clients[i].ok;
+    }
+
+    ms = elapsedMs(&start);
+    qsort(latency, total, sizeof(double), compareLatency);
+
+    printf("%3d clients %10.0f commands/s  p50 %7.3f ms  p99 %7.3f ms  %s\n",
+            num_clients, total / (ms / 1000.0), latency[total / 2],
+            latency[total * 99 / 100], ok ? "ok" : "FAILED");
+
+    free(latency);
+    free(clients);
+
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int commands = argc > 2 ? atoi(argv[2]) : DEFAULT_COMMANDS;
+    int max_clients = argc > 3 ? atoi(argv[3]) : DEFAULT_CLIENTS;
+    int threads = argc > 4 ? atoi(argv[4]) : SERVER_THREADS;
+    int writes = argc > 5 ? atoi(argv[5]) : DEFAULT_WRITES;
+    char* text;
+    System* sys;
+    struct timespec start;
+    double replay_ms;
+    pid_t pid;
+    int clients, ok = YES;
+
+    srand(2023);
+    text = createNetwork(stops);
+
+    /* What a process per command pays before running it. */
+    sys = systemInit();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runCommandLine(sys, text);
+    replay_ms = elapsedMs(&start);
+    exitProgram(sys);
+
+    printf("%d stops, %d commands per client (%d%% writes), %d threads, "
+            "%ld processors online\n", stops, commands, writes, threads,
+            sysconf(_SC_NPROCESSORS_ONLN));
+    printf("process per command: %.1f ms of replay each\n", replay_ms);
+    fflush(stdout);
+
+    if ((pid = fork()) == 0) {
+
+        sys = systemInit();
+        runCommandLine(sys, text);
+        freopen("/dev/null", "w", stderr);
+        runServer(sys, SOCKET_FILE, threads);
+        exitProgram(sys);
+        exit(0);
+    }
+
+    ok = checkSharedLine(text, (stops - 3) / 2 < commands ?
+                                            (stops - 3) / 2 : commands);
+
+    for (clients = 1; clients <= max_clients; clients *= 2)
+        ok = benchClients(clients, stops, commands, writes) && ok;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    free(text);
+
+    return ok ? 0 : 1;
+}
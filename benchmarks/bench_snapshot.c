@@ -0,0 +1,207 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_snapshot.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the snapshots. Builds a network by running the
+ * commands of a generated dump and saves its snapshot, then loads it, each
+ * in its own process, presenting the time and the peak memory of both, and
+ * checks that the lines, stops and intersections listed are the same.
+ * Usage: ./bench_snapshot [stops] [lines] [links]
+*/
+
+/* Wall clock time, memory streams and processes (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+#define DEFAULT_STOPS 50000
+#define DEFAULT_LINES 2000
+#define DEFAULT_LINKS 200000
+#define DUMP_FILE "bench_snapshot.dump"
+#define SNAPSHOT_FILE "bench_snapshot.snap"
+#define REPLAY_STATE "bench_snapshot.replay"
+#define LOAD_STATE "bench_snapshot.load"
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Returns the peak memory of this process, in kilobytes.
+*/
+long int peakMemory() {
+
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+/**
+ * Returns the size of the file with the given name, in bytes.
+*/
+long int fileSize(char* file_name) {
+
+    FILE* file = fopen(file_name, "rb");
+    long int size;
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+
+    return size;
+}
+
+/**
+ * Writes a network dump with the given number of stops, lines and links
+ * to the dump file. The links extend the lines in turns.
+*/
+void writeDump(int stops, int lines, int links) {
+
+    FILE* file = fopen(DUMP_FILE, "w");
+    int* last = (int*)tryMalloc(lines * sizeof(int));
+    int i, line, next;
+
+    for (i = 0; i < stops; i++)
+        fprintf(file, "p s%d %d.%03d %d.%03d\n", i, rand() % 80,
+                            rand() % 1000, rand() % 170, rand() % 1000);
+
+    for (i = 0; i < lines; i++) {
+        fprintf(file, "c L%d\n", i);
+        last[i] = rand() % stops;
+    }
+
+    for (i = 0; i < links; i++) {
+
+        line = i % lines;
+        next = rand() % stops;
+        fprintf(file, "l L%d s%d s%d %d.5 %d\n", line, last[line], next,
+                                                    rand() % 9, rand() % 60);
+        last[line] = next;
+    }
+
+    free(last);
+    fclose(file);
+}
+
+/**
+ * Writes the lines, stops and intersections listed by the system to the
+ * file with the given name.
+*/
+void writeState(System *sys, char* file_name) {
+
+    sys->out = fopen(file_name, "w");
+    runCommandLine(sys, "c\np\ni\n");
+    fclose(sys->out);
+    sys->out = stdout;
+}
+
+/**
+ * Builds the network by running the commands of the dump, and saves its
+ * snapshot and its state. Run in its own process.
+*/
+void replayChild() {
+
+    System* sys = systemInit();
+    char* text = readDump(DUMP_FILE);
+    struct timespec start;
+    double replay_ms, save_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runCommandLine(sys, text);
+    replay_ms = elapsedMs(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    saveSnapshot(sys, SNAPSHOT_FILE);
+    save_ms = elapsedMs(&start);
+
+    printf("replay     %10.1f ms  peak %8ld KB  (save %.1f ms)\n",
+                                        replay_ms, peakMemory(), save_ms);
+
+    free(text);
+    writeState(sys, REPLAY_STATE);
+    exitProgram(sys);
+}
+
+/**
+ * Loads the snapshot and saves the state. Run in its own process.
+*/
+void loadChild() {
+
+    System* sys = systemInit();
+    struct timespec start;
+    double load_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    loadSnapshot(sys, SNAPSHOT_FILE);
+    load_ms = elapsedMs(&start);
+
+    printf("load       %10.1f ms  peak %8ld KB\n", load_ms, peakMemory());
+
+    writeState(sys, LOAD_STATE);
+    exitProgram(sys);
+}
+
+/**
+ * Runs the given function in a new process and waits for it.
+*/
+void runChild(void (*child)()) {
+
+    pid_t pid;
+
+    fflush(stdout);
+
+    if ((pid = fork()) == 0) {
+        child();
+        exit(0);
+    }
+
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int lines = argc > 2 ? atoi(argv[2]) : DEFAULT_LINES;
+    int links = argc > 3 ? atoi(argv[3]) : DEFAULT_LINKS;
+    char *expected, *output;
+    int same;
+
+    srand(2023);
+    writeDump(stops, lines, links);
+
+    printf("%d stops, %d lines, %d links\n", stops, lines, links);
+    runChild(replayChild);
+    runChild(loadChild);
+
+    expected = readDump(REPLAY_STATE);
+    output = readDump(LOAD_STATE);
+    same = expected != NULL && output != NULL && strcmp(expected, output) == 0;
+
+    printf("dump %ld bytes, snapshot %ld bytes, %s\n", fileSize(DUMP_FILE),
+            fileSize(SNAPSHOT_FILE), same ? "same state" : "DIFFERENT STATE");
+
+    free(expected);
+    free(output);
+    remove(DUMP_FILE);
+    remove(SNAPSHOT_FILE);
+    remove(REPLAY_STATE);
+    remove(LOAD_STATE);
+
+    return same ? 0 : 1;
+}
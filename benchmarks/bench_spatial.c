@@ -0,0 +1,123 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_spatial.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the nearest stops queries. Compares the spatial
+ * index with a scan of every stop, checking that both find the same stops.
+ * Usage: ./bench_spatial [stops] [queries]
+*/
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 200000
+#define DEFAULT_QUERIES 2000
+
+
+/**
+ * Returns a random number in [low, high).
+*/
+double randomIn(double low, double high) {
+
+    return low + (high - low) * (rand() / (RAND_MAX + 1.0));
+}
+
+/**
+ * Returns the milliseconds elapsed since the given clock.
+*/
+double elapsedMs(clock_t start) {
+
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/**
+ * Runs the given number of random queries of 'k' stops with the spatial
+ * index and with the scan, presenting the time of both. Returns NO if they
+ * found different stops, or YES otherwise.
+*/
+int compareQueries(System *sys, int queries, int k) {
+
+    Neighbour* by_index = (Neighbour*)tryMalloc(queries * k *
+                                                    sizeof(Neighbour));
+    Neighbour* by_scan = (Neighbour*)tryMalloc(queries * k *
+                                                    sizeof(Neighbour));
+    double index_ms, scan_ms, *lat, *lon;
+    int i, j, ok = YES;
+    clock_t start;
+
+    lat = (double*)tryMalloc(queries * sizeof(double));
+    lon = (double*)tryMalloc(queries * sizeof(double));
+
+    for (i = 0; i < queries; i++) {
+        lat[i] = randomIn(-90.0, 90.0);
+        lon[i] = randomIn(-180.0, 180.0);
+    }
+
+    start = clock();
+    for (i = 0; i < queries; i++)
+        nearestStops(sys->spatial, lat[i], lon[i], k, &by_index[i * k]);
+    index_ms = elapsedMs(start);
+
+    start = clock();
+    for (i = 0; i < queries; i++)
+        nearestStopsScan(sys, lat[i], lon[i], k, &by_scan[i * k]);
+    scan_ms = elapsedMs(start);
+
+    for (i = 0; i < queries * k; i++)
+        if (by_index[i].stop != by_scan[i].stop)
+            ok = NO;
+
+    j = sys->stops_list->count;
+    printf("%8d stops  k=%-3d  index %9.4f ms/query  scan %9.4f ms/query  "
+            "speedup %7.1fx  %s\n", j, k, index_ms / queries,
+            scan_ms / queries, scan_ms / (index_ms > 0 ? index_ms : 1e-9),
+            ok ? "same stops" : "DIFFERENT STOPS");
+
+    free(by_index);
+    free(by_scan);
+    free(lat);
+    free(lon);
+
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int queries = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES;
+    System* sys = systemInit();
+    char name[32];
+    clock_t start;
+    int i, ok = YES;
+
+    srand(2023);
+
+    start = clock();
+    for (i = 0; i < stops; i++) {
+        sprintf(name, "stop%d", i);
+        addStop(sys, name, randomIn(-90.0, 90.0), randomIn(-180.0, 180.0));
+    }
+    printf("inserted %d stops in %.1f ms\n", stops, elapsedMs(start));
+
+    ok &= compareQueries(sys, queries, 1);
+    ok &= compareQueries(sys, queries, 10);
+
+    /* Remove three quarters of the stops, forcing rebuilds. */
+    start = clock();
+    for (i = 0; i < stops; i++) {
+        if (i % 4 != 0) {
+            sprintf(name, "stop%d", i);
+            removeStop(sys, name);
+        }
+    }
+    printf("removed %d stops in %.1f ms\n", stops - (stops + 3) / 4,
+                                                        elapsedMs(start));
+
+    ok &= compareQueries(sys, queries, 1);
+    ok &= compareQueries(sys, queries, 10);
+
+    exitProgram(sys);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,869 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_structures.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: microbenchmarks of the structures of structures.c, each on
+ * its own: the hashtables inserting, finding, missing and removing keys at
+ * a few loads, growing from a small size and churning (keys removed and
+ * others inserted, leaving deleted slots behind), frozen and looked up in
+ * their frozen indexes (alone, or falling back after churning), their
+ * hashes and primes,
+ * and the lists sorted at a few sizes, searched and emptied. Each case is
+ * sampled a few times after a warm up, presenting the median time of each
+ * operation, its median absolute deviation and the fastest sample. Compared
+ * with a saved baseline (JSON), a case whose median grows more than the
+ * given percentage, and beyond the deviations, is a regression, and it
+ * fails.
+ * Usage: ./bench_structures [-b baseline] [-save] [-t percentage]
+ *        [-r samples] [-n elements]
+*/
+
+/* Wall clock time (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_BASELINE "structures.json"
+#define DEFAULT_THRESHOLD 10.0
+#define DEFAULT_SAMPLES 11
+#define DEFAULT_ELEMENTS 100000
+#define MAX_SAMPLES 101
+#define KEY_LENGTH 16
+#define SMALL_TABLE 17          /* Starting slots, so that it grows. */
+#define PRIME_CALLS 1000        /* Primes found by each sample. */
+#define NOISE_DEVIATIONS 3      /* A regression grows beyond these MADs. */
+
+
+/* Structure of the data shared by the cases. */
+typedef struct {
+    int n;                      /* Elements of each case. */
+    char* hits;                 /* Keys inserted, KEY_LENGTH each. */
+    char* misses;               /* Keys never inserted before churning. */
+    Name *hit_names, *miss_names;   /* The keys, as the hashtables keep. */
+    NameArena* arena;
+    int* order;                 /* Of the elements, shuffled. */
+    int* values;                /* Sorted by the lists. */
+    unsigned long seed;
+    unsigned long sink;         /* Results, so that they're not skipped. */
+    long int errors;
+} MicroBench;
+
+/* Structure of a case: its sample runs it, returning the nanoseconds of
+   each operation. */
+typedef struct {
+    char* name;
+    double (*sample)(MicroBench*, double);
+    double param;
+} MicroCase;
+
+
+/**
+ * Returns the nanoseconds elapsed since the given time.
+*/
+double elapsedNs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1e9 +
+                                        (now.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * Returns the next pseudo-random number of the benchmark, in [0, 2^31).
+*/
+long int nextRandom(MicroBench* bench) {
+
+    bench->seed = (bench->seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+
+    return (long int)(bench->seed >> 1);
+}
+
+/**
+ * Orders the numbers up to the given range, shuffling the first given
+ * number of them (each drawn from all of the range).
+*/
+void shuffleOrder(MicroBench* bench, int count, int range) {
+
+    int i, j, tmp;
+
+    for (i = 0; i < range; i++)
+        bench->order[i] = i;
+
+    for (i = 0; i < count; i++) {
+        j = i + nextRandom(bench) % (range - i);
+        tmp = bench->order[i];
+        bench->order[i] = bench->order[j];
+        bench->order[j] = tmp;
+    }
+}
+
+/**
+ * Returns the key with the given number of the given keys.
+*/
+char* keyOf(char* keys, int i) {
+
+    return keys + i * KEY_LENGTH;
+}
+
+/**
+ * Returns the key of the given data, which is the key itself.
+*/
+Name* benchKey(void* data) {
+
+    return (Name*)data;
+}
+
+/**
+ * Compares the given values, as 'sortList' does.
+*/
+int compareInts(void* first, void* second) {
+
+    return *(int*)first - *(int*)second;
+}
+
+/**
+ * Returns a hashtable with every key inserted, at the given load.
+*/
+Hashtable* buildTable(MicroBench* bench, double load) {
+
+    Hashtable* table = createHashtable(getPrime((int)(bench->n / load) + 1));
+    int i;
+
+    for (i = 0; i < bench->n; i++)
+        hashtableInsert(table, &bench->hit_names[i],
+                                        &bench->hit_names[i], benchKey);
+
+    return table;
+}
+
+/**
+ * Removes the first key of the table and inserts the first key never
+ * inserted, for each element, so that the same number of keys are left.
+*/
+void churnTable(MicroBench* bench, Hashtable* table) {
+
+    int i;
+
+    for (i = 0; i < bench->n; i++) {
+        hashtableRemove(table, keyOf(bench->hits, i), benchKey);
+        hashtableInsert(table, &bench->miss_names[i],
+                                        &bench->miss_names[i], benchKey);
+    }
+}
+
+/**
+ * Returns a list of the given number of values.
+*/
+List* buildList(MicroBench* bench, int size) {
+
+    List* list = createList();
+    int i;
+
+    for (i = 0; i < size; i++)
+        append(list, &bench->values[i]);
+
+    return list;
+}
+
+/**
+ * Frees the given list and its nodes.
+*/
+void destroyBenchList(List* list) {
+
+    while (list->first != NULL)
+        listRemoveNode(list, list->first);
+
+    listDestroy(list);
+}
+
+
+/* ----------------------------- Hashtables ------------------------------ */
+
+/**
+ * Inserts every key in a hashtable that ends at the given load.
+*/
+double sampleInsert(MicroBench* bench, double load) {
+
+    Hashtable* table = createHashtable(getPrime((int)(bench->n / load) + 1));
+    struct timespec start;
+    double ns;
+    int i;
+
+    shuffleOrder(bench, bench->n, bench->n);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        hashtableInsert(table, &bench->hit_names[bench->order[i]],
+                            &bench->hit_names[bench->order[i]], benchKey);
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Inserts every key in a small hashtable, which grows meanwhile.
+*/
+double sampleGrow(MicroBench* bench, double unused) {
+
+    Hashtable* table = createHashtable(SMALL_TABLE);
+    struct timespec start;
+    double ns;
+    int i;
+
+    (void)unused;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        hashtableInsert(table, &bench->hit_names[i],
+                                        &bench->hit_names[i], benchKey);
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Finds every key, in a shuffled order, in a hashtable at the given load.
+*/
+double sampleGetHit(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    shuffleOrder(bench, bench->n, bench->n);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        bench->errors += hashtableGet(table,
+                keyOf(bench->hits, bench->order[i]), benchKey) == NULL;
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Looks up as many keys not inserted in a hashtable at the given load.
+*/
+double sampleGetMiss(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        bench->errors += hashtableGet(table, keyOf(bench->misses, i),
+                                                        benchKey) != NULL;
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Removes every key, in a shuffled order, of a hashtable at the given load.
+*/
+double sampleRemove(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    shuffleOrder(bench, bench->n, bench->n);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        hashtableRemove(table, keyOf(bench->hits, bench->order[i]),
+                                                                benchKey);
+
+    ns = elapsedNs(&start);
+    bench->errors += table->elem_num != 0;
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Churns a hashtable at the given load: each operation removes a key and
+ * inserts another, leaving a deleted slot behind or reusing one.
+*/
+double sampleChurn(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    churnTable(bench, table);
+    ns = elapsedNs(&start);
+
+    bench->errors += table->elem_num != bench->n;
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Finds every key of a hashtable at the given load after churning it, its
+ * probes crossing the deleted slots.
+*/
+double sampleChurnedGet(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    churnTable(bench, table);
+    shuffleOrder(bench, bench->n, bench->n);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        bench->errors += hashtableGet(table,
+                keyOf(bench->misses, bench->order[i]), benchKey) == NULL;
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Freezes a hashtable at the given load, building its frozen index.
+*/
+double sampleFreeze(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bench->errors += !freezeHashtable(table, benchKey);
+    ns = elapsedNs(&start);
+
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Finds every key, in a shuffled order, in the frozen index of a hashtable
+ * at the given load.
+*/
+double sampleFrozenGetHit(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    bench->errors += !freezeHashtable(table, benchKey);
+    shuffleOrder(bench, bench->n, bench->n);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        bench->errors += hashtableGet(table,
+                keyOf(bench->hits, bench->order[i]), benchKey) == NULL;
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Looks up as many keys not inserted in the frozen index of a hashtable at
+ * the given load, which tells them missing alone.
+*/
+double sampleFrozenGetMiss(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    bench->errors += !freezeHashtable(table, benchKey);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        bench->errors += hashtableGet(table, keyOf(bench->misses, i),
+                                                        benchKey) != NULL;
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Finds every key of a hashtable at the given load churned after it was
+ * frozen, each lookup missing the index and falling back to the hashtable.
+*/
+double sampleFrozenChurnedGet(MicroBench* bench, double load) {
+
+    Hashtable* table = buildTable(bench, load);
+    struct timespec start;
+    double ns;
+    int i;
+
+    bench->errors += !freezeHashtable(table, benchKey);
+    churnTable(bench, table);
+    shuffleOrder(bench, bench->n, bench->n);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        bench->errors += hashtableGet(table,
+                keyOf(bench->misses, bench->order[i]), benchKey) == NULL;
+
+    ns = elapsedNs(&start);
+    destroyHashtable(table);
+
+    return ns / bench->n;
+}
+
+/**
+ * Calculates the hashes of every key, for a hashtable of the given size.
+*/
+double sampleHashes(MicroBench* bench, double size) {
+
+    struct timespec start;
+    unsigned int hashes[3];
+    double ns;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++) {
+        calcHashtableHashes(keyOf(bench->hits, i), (int)size, hashes);
+        bench->sink += hashes[0] % (int)size + hashes[2];
+    }
+
+    ns = elapsedNs(&start);
+
+    return ns / bench->n;
+}
+
+/**
+ * Finds the primes after numbers close to the given one, as the hashtables
+ * do when they grow to about that size.
+*/
+double samplePrime(MicroBench* bench, double size) {
+
+    struct timespec start;
+    double ns;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < PRIME_CALLS; i++)
+        bench->sink += getPrime((int)size + nextRandom(bench) % 1000);
+
+    ns = elapsedNs(&start);
+
+    return ns / PRIME_CALLS;
+}
+
+
+/* -------------------------------- Lists -------------------------------- */
+
+/**
+ * Sorts shuffled lists of the given size, as many as fit in the elements.
+ * Returns the time of each element sorted.
+*/
+double sampleSort(MicroBench* bench, double size) {
+
+    List* list = buildList(bench, (int)size);
+    int rounds = bench->n / (int)size, round, i;
+    struct timespec start;
+    double ns = 0;
+    Node* node;
+
+    for (round = 0; round < (rounds < 1 ? 1 : rounds); round++) {
+
+        shuffleOrder(bench, (int)size, (int)size);
+
+        for (node = list->first, i = 0; node != NULL; node = node->next)
+            node->data = &bench->values[bench->order[i++]];
+
+        list->sorted = UNSORTED;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sortList(list, compareInts);
+        ns += elapsedNs(&start);
+    }
+
+    for (node = list->first; node != NULL && node->next != NULL;
+                                                            node = node->next)
+        bench->errors += compareInts(node->data, node->next->data) > 0;
+
+    bench->errors += list->last->next != NULL;
+    destroyBenchList(list);
+
+    return ns / ((rounds < 1 ? 1 : rounds) * size);
+}
+
+/**
+ * Sorts a list of the given size whose values are sorted already.
+ * Returns the time of each element sorted.
+*/
+double sampleSortSorted(MicroBench* bench, double size) {
+
+    List* list = createList();
+    struct timespec start;
+    double ns;
+    int i;
+
+    shuffleOrder(bench, 0, (int)size);
+
+    for (i = 0; i < (int)size; i++)
+        append(list, &bench->order[i]);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sortList(list, compareInts);
+    ns = elapsedNs(&start);
+
+    destroyBenchList(list);
+
+    return ns / size;
+}
+
+/**
+ * Searches a list of the given size for values of it, as many times as
+ * fit in twenty times the elements.
+*/
+double sampleSearch(MicroBench* bench, double size) {
+
+    List* list = buildList(bench, (int)size);
+    int searches = (int)(20.0 * bench->n / size), i;
+    struct timespec start;
+    double ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < searches; i++)
+        bench->errors += searchList(list, &bench->values[nextRandom(bench) %
+                                                        (int)size]) == NULL;
+
+    ns = elapsedNs(&start);
+    destroyBenchList(list);
+
+    return ns / searches;
+}
+
+/**
+ * Removes half of the values of a list of the given size, in a shuffled
+ * order, each searched first.
+*/
+double sampleRemoveData(MicroBench* bench, double size) {
+
+    List* list = buildList(bench, (int)size);
+    int removals = (int)size / 2, i;
+    struct timespec start;
+    double ns;
+
+    shuffleOrder(bench, removals, (int)size);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < removals; i++)
+        listRemoveData(list, &bench->values[bench->order[i]]);
+
+    ns = elapsedNs(&start);
+    bench->errors += list->count != (int)size - removals;
+    destroyBenchList(list);
+
+    return ns / removals;
+}
+
+/**
+ * Appends every value to a list.
+*/
+double sampleAppend(MicroBench* bench, double unused) {
+
+    List* list = createList();
+    struct timespec start;
+    double ns;
+    int i;
+
+    (void)unused;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < bench->n; i++)
+        append(list, &bench->values[i]);
+
+    ns = elapsedNs(&start);
+    destroyBenchList(list);
+
+    return ns / bench->n;
+}
+
+
+/* ------------------------------- Samples ------------------------------- */
+
+/**
+ * Compares two samples, for 'qsort'.
+*/
+int compareSamples(const void* first, const void* second) {
+
+    double a = *(const double*)first, b = *(const double*)second;
+
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/**
+ * Returns the median of the given sorted samples.
+*/
+double median(double* samples, int count) {
+
+    return count % 2 ? samples[count / 2] :
+                        (samples[count / 2 - 1] + samples[count / 2]) / 2;
+}
+
+/**
+ * Runs the given case the given number of times, after a warm up, and
+ * finds the median, median absolute deviation and fastest of its samples.
+*/
+void runCase(MicroBench* bench, MicroCase* micro, int count, double* med,
+                                                double* mad, double* min) {
+
+    double samples[MAX_SAMPLES], deviations[MAX_SAMPLES];
+    int i;
+
+    micro->sample(bench, micro->param);
+
+    for (i = 0; i < count; i++)
+        samples[i] = micro->sample(bench, micro->param);
+
+    qsort(samples, count, sizeof(double), compareSamples);
+    *med = median(samples, count);
+    *min = samples[0];
+
+    for (i = 0; i < count; i++)
+        deviations[i] = samples[i] > *med ? samples[i] - *med :
+                                                        *med - samples[i];
+
+    qsort(deviations, count, sizeof(double), compareSamples);
+    *mad = median(deviations, count);
+}
+
+/**
+ * Finds the given case in the baseline, reading its median and median
+ * absolute deviation. Returns NO if it isn't there.
+*/
+int findBaseline(FILE* baseline, char* name, double* med, double* mad) {
+
+    char line[BUFLEN], key[BUFLEN];
+    double min;
+
+    if (baseline == NULL)
+        return NO;
+
+    rewind(baseline);
+
+    while (fgets(line, BUFLEN, baseline) != NULL)
+        if (sscanf(line, " {\"name\": \"%255[^\"]\", \"median_ns\": %lf, "
+                    "\"mad_ns\": %lf, \"min_ns\": %lf", key, med, mad,
+                    &min) == 4 && strcmp(key, name) == 0)
+            return YES;
+
+    return NO;
+}
+
+/**
+ * Presents the given case, compared with the baseline. Returns YES if it's
+ * a regression: its median grew more than the threshold and more than the
+ * deviations of both.
+*/
+int reportCase(char* name, double med, double mad, double min,
+                                        FILE* baseline, double threshold) {
+
+    double base_med, base_mad, change;
+
+    printf("  %-28s %10.2f ns/op  mad %8.2f  min %10.2f", name, med, mad,
+                                                                        min);
+
+    if (!findBaseline(baseline, name, &base_med, &base_mad)) {
+        printf("\n");
+        return NO;
+    }
+
+    change = base_med > 0 ? (med / base_med - 1) * 100 : 0;
+    printf("  %+6.1f%%", change);
+
+    if (change > threshold &&
+                        med - base_med > NOISE_DEVIATIONS * (mad + base_mad)) {
+        printf("  REGRESSION\n");
+        return YES;
+    }
+
+    printf("\n");
+
+    return NO;
+}
+
+/**
+ * Initializes the keys and values shared by the cases.
+*/
+void initBench(MicroBench* bench, int n) {
+
+    int i;
+
+    bench->n = n;
+    bench->seed = 2023;
+    bench->sink = 0;
+    bench->errors = 0;
+    bench->hits = (char*)tryMalloc(n * KEY_LENGTH);
+    bench->misses = (char*)tryMalloc(n * KEY_LENGTH);
+    bench->hit_names = (Name*)tryMalloc(n * sizeof(Name));
+    bench->miss_names = (Name*)tryMalloc(n * sizeof(Name));
+    bench->arena = createNameArena();
+    bench->order = (int*)tryMalloc(n * sizeof(int));
+    bench->values = (int*)tryMalloc(n * sizeof(int));
+
+    for (i = 0; i < n; i++) {
+        sprintf(keyOf(bench->hits, i), "S%d", i);
+        sprintf(keyOf(bench->misses, i), "M%d", i);
+        populateName(&bench->hit_names[i], keyOf(bench->hits, i), 
+                                                            bench->arena);
+        populateName(&bench->miss_names[i], keyOf(bench->misses, i), 
+                                                            bench->arena);
+        bench->values[i] = nextRandom(bench) % (10 * n);
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    MicroCase cases[] = {
+        {"hash_insert/load=0.10", sampleInsert, 0.10},
+        {"hash_insert/load=0.25", sampleInsert, 0.25},
+        {"hash_insert/load=0.45", sampleInsert, 0.45},
+        {"hash_insert/grow", sampleGrow, 0},
+        {"hash_get_hit/load=0.10", sampleGetHit, 0.10},
+        {"hash_get_hit/load=0.25", sampleGetHit, 0.25},
+        {"hash_get_hit/load=0.45", sampleGetHit, 0.45},
+        {"hash_get_miss/load=0.10", sampleGetMiss, 0.10},
+        {"hash_get_miss/load=0.25", sampleGetMiss, 0.25},
+        {"hash_get_miss/load=0.45", sampleGetMiss, 0.45},
+        {"hash_remove/load=0.25", sampleRemove, 0.25},
+        {"hash_remove/load=0.45", sampleRemove, 0.45},
+        {"hash_churn/load=0.25", sampleChurn, 0.25},
+        {"hash_churn/load=0.45", sampleChurn, 0.45},
+        {"hash_churned_get/load=0.25", sampleChurnedGet, 0.25},
+        {"hash_churned_get/load=0.45", sampleChurnedGet, 0.45},
+        {"hash_freeze/load=0.45", sampleFreeze, 0.45},
+        {"hash_frozen_hit/load=0.45", sampleFrozenGetHit, 0.45},
+        {"hash_frozen_miss/load=0.45", sampleFrozenGetMiss, 0.45},
+        {"hash_frozen_delta/load=0.45", sampleFrozenChurnedGet, 0.45},
+        {"hash_hashes", sampleHashes, HT_START_SIZE},
+        {"prime/20000", samplePrime, 20000},
+        {"prime/1000000", samplePrime, 1000000},
+        {"prime/10000000", samplePrime, 10000000},
+        {"sort/size=100", sampleSort, 100},
+        {"sort/size=1000", sampleSort, 1000},
+        {"sort/size=10000", sampleSort, 10000},
+        {"sort/size=100000", sampleSort, 100000},
+        {"sort_sorted/size=10000", sampleSortSorted, 10000},
+        {"list_append", sampleAppend, 0},
+        {"list_search/size=100", sampleSearch, 100},
+        {"list_search/size=10000", sampleSearch, 10000},
+        {"list_remove/size=100", sampleRemoveData, 100},
+        {"list_remove/size=10000", sampleRemoveData, 10000}
+    };
+    int num_cases = sizeof(cases) / sizeof(MicroCase);
+    char* baseline_file = DEFAULT_BASELINE;
+    double threshold = DEFAULT_THRESHOLD, med, mad, min;
+    int i, c, do_save = NO, samples = DEFAULT_SAMPLES, regressions = 0;
+    int n = DEFAULT_ELEMENTS, saved = 0;
+    FILE *baseline, *save = NULL;
+    MicroBench bench;
+
+    for (i = 1; i < argc; i++) {
+
+        if (strcmp(argv[i], "-save") == 0)
+            do_save = YES;
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            baseline_file = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            samples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            n = atoi(argv[++i]);
+        else
+            break;
+    }
+
+    if (i < argc || samples < 1 || samples > MAX_SAMPLES || n < 200) {
+        fprintf(stderr, "usage: %s [-b baseline] [-save] [-t percentage] "
+                            "[-r samples] [-n elements]\n", argv[0]);
+        return 1;
+    }
+
+    baseline = do_save ? NULL : fopen(baseline_file, "r");
+
+    if (do_save && (save = fopen(baseline_file, "w")) == NULL) {
+        perror(baseline_file);
+        return 1;
+    }
+
+    initBench(&bench, n);
+
+    printf("%d elements, %s %s (regressions over %.1f%%, median of %d "
+            "samples)\n", n, do_save ? "saving to" : baseline != NULL ?
+            "compared with" : "no baseline in", baseline_file, threshold,
+            samples);
+
+    if (save != NULL)
+        fprintf(save, "{\"elements\": %d, \"samples\": %d, \"results\": [\n",
+                                                                n, samples);
+
+    for (c = 0; c < num_cases; c++) {
+
+        /* The sorts and the lists can't be larger than the elements. */
+        if (cases[c].sample != sampleHashes && cases[c].sample !=
+                            samplePrime && cases[c].param > n)
+            continue;
+
+        runCase(&bench, &cases[c], samples, &med, &mad, &min);
+        regressions += reportCase(cases[c].name, med, mad, min, baseline,
+                                                                threshold);
+
+        if (save != NULL)
+            fprintf(save, "%s  {\"name\": \"%s\", \"median_ns\": %.3f, "
+                    "\"mad_ns\": %.3f, \"min_ns\": %.3f}", saved++ ? ",\n" :
+                    "", cases[c].name, med, mad, min);
+    }
+
+    if (save != NULL) {
+        fprintf(save, "\n]}\n");
+        fclose(save);
+    }
+
+    if (baseline != NULL)
+        fclose(baseline);
+
+    printf("%ld errors, %d regressions\n", bench.errors, regressions);
+
+    free(bench.hits);
+    free(bench.misses);
+    free(bench.hit_names);
+    free(bench.miss_names);
+    destroyNameArena(bench.arena);
+    free(bench.order);
+    free(bench.values);
+
+    return bench.errors > 0 || regressions > 0 ? 1 : 0;
+}
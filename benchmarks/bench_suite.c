@@ -0,0 +1,337 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_suite.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: end-to-end benchmark of command streams in the format of the
+ * public tests' inputs, such as the ones written by ./workload. Each file
+ * runs in its own process, its output discarded, timing every command.
+ * Presents, for each file, the commands of each type run per second and the
+ * mean time of each, and the peak resident memory of the process. Compared
+ * with a saved baseline, a command type whose mean time, or a peak memory,
+ * grows more than the given percentage is a regression, and it fails. Each
+ * file runs a few times, keeping the fastest.
+ * Usage: ./bench_suite [-b baseline] [-save] [-t percentage] [-r repeats]
+ *        files...
+*/
+
+/* Wall clock time, processes and resource usage (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+#include <ctype.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+#define DEFAULT_BASELINE "suite.baseline"
+#define DEFAULT_THRESHOLD 10.0
+#define DEFAULT_REPEATS 3       /* Runs of each file, keeping the fastest. */
+#define NUM_TYPES 128           /* Commands, by their character. */
+#define MIN_BASELINE_MS 5.0     /* Below it, times are too short to compare. */
+
+
+/* Structure of the run of a file (sent by its process through a pipe). */
+typedef struct {
+    long int count[NUM_TYPES];
+    double ms[NUM_TYPES];
+    long int rss;               /* Peak resident memory, in kilobytes. */
+    int ok;                     /* If the file was read. */
+} SuiteRun;
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Runs the commands of the given file, timing each by its type, and writes
+ * the run to the given descriptor. Runs in the process of the file.
+*/
+void runFile(char* file, int fd) {
+
+    SuiteRun run;
+    System* sys = systemInit();
+    char* text = readDump(file), *command;
+    struct timespec start;
+    struct rusage usage;
+    FILE* result;
+    int more = 1, type;
+
+    memset(&run, 0, sizeof(run));
+    run.ok = text != NULL;
+    sys->out = fopen("/dev/null", "w");
+    freopen("/dev/null", "w", stderr);
+    sys->input = text;
+
+    while (more && sys->input != NULL && *sys->input != '\0') {
+
+        for (command = sys->input; isspace((unsigned char)*command); )
+            command++;
+
+        type = (unsigned char)*command % NUM_TYPES;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        more = handleCommand(sys);
+        run.ms[type] += elapsedMs(&start);
+        run.count[type]++;
+    }
+
+    sys->input = NULL;
+    fclose(sys->out);
+    sys->out = stdout;
+    exitProgram(sys);
+    free(text);
+
+    getrusage(RUSAGE_SELF, &usage);
+    run.rss = usage.ru_maxrss;
+
+    result = fdopen(fd, "w");
+    fwrite(&run, sizeof(run), 1, result);
+    fclose(result);
+}
+
+/**
+ * Runs the given file in a process of its own, so that its peak memory is
+ * its own. Returns NO if the run failed.
+*/
+int runProcess(char* file, SuiteRun* run) {
+
+    int fds[2];
+    ssize_t got = 0, n;
+    pid_t pid;
+
+    if (pipe(fds) != 0)
+        return NO;
+
+    fflush(NULL);
+
+    if ((pid = fork()) == 0) {
+        close(fds[0]);
+        runFile(file, fds[1]);
+        exit(0);
+    }
+
+    close(fds[1]);
+
+    while (got < (ssize_t)sizeof(*run) &&
+                (n = read(fds[0], (char*)run + got, sizeof(*run) - got)) > 0)
+        got += n;
+
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    return got == (ssize_t)sizeof(*run) && run->ok;
+}
+
+/**
+ * Runs the given file the given number of times, keeping the fastest time of
+ * each command type and the smallest peak memory, which vary the least
+ * between runs. Returns NO if a run failed.
+*/
+int benchFile(char* file, SuiteRun* run, int repeats) {
+
+    SuiteRun other;
+    int i, type;
+
+    if (!runProcess(file, run))
+        return NO;
+
+    for (i = 1; i < repeats; i++) {
+
+        if (!runProcess(file, &other))
+            return NO;
+
+        for (type = 0; type < NUM_TYPES; type++)
+            if (other.ms[type] < run->ms[type])
+                run->ms[type] = other.ms[type];
+
+        if (other.rss < run->rss)
+            run->rss = other.rss;
+    }
+
+    return YES;
+}
+
+/**
+ * Returns the name of the given file, without its directories.
+*/
+char* baseName(char* file) {
+
+    char* slash = strrchr(file, '/');
+
+    return slash != NULL ? slash + 1 : file;
+}
+
+/**
+ * Finds the given file's command type (or "total", or "rss") in the
+ * baseline, and reads its count and value. Returns NO if it isn't there.
+*/
+int findBaseline(FILE* baseline, char* file, char* type, long int* count,
+                                                            double* value) {
+
+    char name[BUFLEN], key[BUFLEN];
+
+    if (baseline == NULL)
+        return NO;
+
+    rewind(baseline);
+
+    while (fscanf(baseline, "%255s %255s %ld %lf", name, key, count,
+                                                                value) == 4)
+        if (strcmp(name, baseName(file)) == 0 && strcmp(key, type) == 0)
+            return YES;
+
+    return NO;
+}
+
+/**
+ * Compares the given mean with the baseline's, presenting the difference.
+ * Returns YES if it grew more than the threshold.
+*/
+int isRegression(double mean, double base_mean, double base_total,
+                                                        double threshold) {
+
+    double change = base_mean > 0 ? (mean / base_mean - 1) * 100 : 0;
+
+    printf("  %+6.1f%%", change);
+
+    if (change > threshold && base_total >= MIN_BASELINE_MS) {
+        printf("  REGRESSION");
+        return YES;
+    }
+
+    return NO;
+}
+
+/**
+ * Presents the run of the given file, compared with the baseline, and
+ * saves it. Returns the number of regressions.
+*/
+int reportFile(char* file, SuiteRun* run, FILE* baseline, FILE* save,
+                                                        double threshold) {
+
+    long int total_count = 0, base_count;
+    double total_ms = 0, base_ms;
+    int type, regressions = 0;
+    char key[2] = {0, 0};
+
+    printf("%s\n", file);
+
+    for (type = 0; type < NUM_TYPES; type++) {
+
+        if (run->count[type] == 0)
+            continue;
+
+        key[0] = type > ' ' ? type : '?';
+        total_count += run->count[type];
+        total_ms += run->ms[type];
+        printf("  %c %9ld commands %10.1f ms %12.0f commands/s %10.2f us",
+                key[0], run->count[type], run->ms[type],
+                run->count[type] / (run->ms[type] / 1000.0 + 1e-9),
+                run->ms[type] * 1000.0 / run->count[type]);
+
+        if (findBaseline(baseline, file, key, &base_count, &base_ms))
+            regressions += isRegression(run->ms[type] / run->count[type],
+                                    base_ms / base_count, base_ms, threshold);
+
+        printf("\n");
+
+        if (save != NULL)
+            fprintf(save, "%s %s %ld %.3f\n", baseName(file), key,
+                                            run->count[type], run->ms[type]);
+    }
+
+    printf("  total %5ld commands %10.1f ms %12.0f commands/s",
+            total_count, total_ms, total_count / (total_ms / 1000.0 + 1e-9));
+
+    if (findBaseline(baseline, file, "total", &base_count, &base_ms))
+        isRegression(total_ms / total_count, base_ms / base_count, 0,
+                                                                threshold);
+
+    printf("\n  peak memory %ld KB", run->rss);
+
+    if (findBaseline(baseline, file, "rss", &base_count, &base_ms))
+        regressions += isRegression(run->rss, base_ms, MIN_BASELINE_MS,
+                                                                threshold);
+
+    printf("\n");
+
+    if (save != NULL) {
+        fprintf(save, "%s total %ld %.3f\n", baseName(file), total_count,
+                                                                total_ms);
+        fprintf(save, "%s rss 1 %ld\n", baseName(file), run->rss);
+    }
+
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+
+    char* baseline_file = DEFAULT_BASELINE;
+    double threshold = DEFAULT_THRESHOLD;
+    int i, do_save = NO, repeats = DEFAULT_REPEATS, regressions = 0;
+    int failed = 0;
+    FILE *baseline, *save = NULL;
+    SuiteRun run;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+
+        if (strcmp(argv[i], "-save") == 0)
+            do_save = YES;
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            baseline_file = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else
+            break;
+    }
+
+    if (i == argc || argv[i][0] == '-') {
+        fprintf(stderr, "usage: %s [-b baseline] [-save] [-t percentage] "
+                                    "[-r repeats] files...\n", argv[0]);
+        return 1;
+    }
+
+    baseline = do_save ? NULL : fopen(baseline_file, "r");
+
+    if (do_save && (save = fopen(baseline_file, "w")) == NULL) {
+        perror(baseline_file);
+        return 1;
+    }
+
+    printf("%s %s (regressions over %.1f%%, best of %d runs)\n",
+            do_save ? "saving to" : baseline != NULL ? "compared with" :
+            "no baseline in", baseline_file, threshold, repeats);
+
+    for (; i < argc; i++) {
+
+        if (benchFile(argv[i], &run, repeats)) {
+            regressions += reportFile(argv[i], &run, baseline, save,
+                                                                threshold);
+        } else {
+            printf("%s: FAILED\n", argv[i]);
+            failed++;
+        }
+    }
+
+    if (baseline != NULL)
+        fclose(baseline);
+
+    if (save != NULL)
+        fclose(save);
+
+    printf("%d regressions\n", regressions);
+
+    return regressions > 0 || failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_versions.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the versions read by the worker pool. Runs a
+ * sequence where long listings ('c', 'p' and 'i') alternate with commands
+ * changing the network ('l' and 'e'), once one command at a time and then
+ * with the worker pool, with 1 to the given number of threads, where the
+ * listings read a version while the next commands run. Checks that the
+ * output is the same, presenting the versions published and replaced, and
+ * the time spent publishing them against the time the listings take on
+ * their own (the serial run less a run of the same commands without them).
+ * Usage: ./bench_versions [stops] [rounds] [writes] [threads]
+*/
+
+/* Wall clock time and memory streams (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 50000
+#define DEFAULT_ROUNDS 40
+#define DEFAULT_WRITES 200
+#define DEFAULT_THREADS 4
+#define LINK_STOPS 50
+#define COMMANDS_FILE "bench_versions.in"
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Writes the commands of the benchmark to the commands file: a network of
+ * the given number of stops, with lines of consecutive stops, followed by
+ * rounds of listings (left out if not asked for) and of the given number of
+ * links added to random lines, a few stops being removed.
+*/
+void writeCommands(int stops, int rounds, int writes, int listings) {
+
+    FILE* file = fopen(COMMANDS_FILE, "w");
+    int lines = stops / LINK_STOPS + 1, i, j, line, next;
+    int* last = (int*)tryMalloc(lines * sizeof(int));
+
+    for (i = 0; i < stops; i++)
+        fprintf(file, "p s%d %d.%03d %d.%03d\n", i, rand() % 80,
+                            rand() % 1000, rand() % 170, rand() % 1000);
+
+    for (i = 0; i < lines; i++) {
+        fprintf(file, "c L%d\n", i);
+        last[i] = i * LINK_STOPS;
+    }
+
+    for (i = 0; i + 1 < stops; i++)
+        fprintf(file, "l L%d s%d s%d 1 2\n", i / LINK_STOPS, i, i + 1);
+
+    for (i = 0; i + 1 < stops; i++)
+        last[i / LINK_STOPS] = i + 1;
+
+    for (i = 0; i < rounds; i++) {
+
+        line = rand() % lines;
+        next = rand() % stops;
+        if (listings)
+            fprintf(file, "c\np\ni\nc L%d\np s%d\n", line, next);
+
+        for (j = 0; j < writes; j++) {
+
+            line = rand() % lines;
+
+            if (j % 100 == 99) {
+                fprintf(file, "e s%d\n", rand() % stops);
+            } else {
+                next = rand() % stops;
+                fprintf(file, "l L%d s%d s%d 1 2\n", line, last[line], next);
+                last[line] = next;
+            }
+        }
+    }
+
+    fprintf(file, listings ? "c\np\ni\nq\n" : "q\n");
+
+    free(last);
+    fclose(file);
+}
+
+/**
+ * Runs the commands file one command at a time, leaving its output in the
+ * given buffer. Returns the milliseconds it took.
+*/
+double runSerial(char** output, size_t* length) {
+
+    System* sys = systemInit();
+    char* text = readDump(COMMANDS_FILE);
+    struct timespec start;
+    double ms;
+
+    sys->out = open_memstream(output, length);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runCommandLine(sys, text);
+    ms = elapsedMs(&start);
+    fclose(sys->out);
+    sys->out = stdout;
+    free(text);
+    exitProgram(sys);
+
+    return ms;
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+    int writes = argc > 3 ? atoi(argv[3]) : DEFAULT_WRITES;
+    int threads = argc > 4 ? atoi(argv[4]) : DEFAULT_THREADS;
+    char *expected, *output, *text;
+    size_t expected_length, output_length;
+    double serial_ms, writes_ms, ms;
+    struct timespec start;
+    VersionSet* set;
+    System* sys;
+    int t, same, ok = YES;
+
+    /* The same writes, without the listings. */
+    srand(2023);
+    writeCommands(stops, rounds, writes, NO);
+    writes_ms = runSerial(&text, &output_length);
+    free(text);
+
+    /* One command at a time. */
+    srand(2023);
+    writeCommands(stops, rounds, writes, YES);
+    serial_ms = runSerial(&expected, &expected_length);
+
+    printf("%d stops, %d rounds of listings and %d writes, "
+                "%ld processors online\n", stops, rounds, writes,
+                sysconf(_SC_NPROCESSORS_ONLN));
+    printf("serial     %10.1f ms  (listings %.1f ms)\n", serial_ms,
+                                                    serial_ms - writes_ms);
+
+    for (t = 1; t <= threads; t++) {
+
+        sys = systemInit();
+        sys->workers = createWorkerPool(sys, t);
+        freopen(COMMANDS_FILE, "r", stdin);
+
+        sys->out = open_memstream(&output, &output_length);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        runWorkers(sys);
+        ms = elapsedMs(&start);
+        fclose(sys->out);
+        sys->out = stdout;
+
+        same = output_length == expected_length &&
+                            memcmp(output, expected, output_length) == 0;
+        ok &= same;
+
+        set = sys->workers->versions;
+        printf("%3d threads %10.1f ms  %4ld versions (%ld reused, %ld "
+                "replaced, %.1f ms publishing)  %s\n", t, ms,
+                set->published, set->reused, set->replaced, set->publish_ms,
+                same ? "same output" : "DIFFERENT OUTPUT");
+
+        free(output);
+        exitProgram(sys);
+    }
+
+    free(expected);
+    remove(COMMANDS_FILE);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/**
+ * IAED-23 Project 2
+ * File: bench_workers.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: benchmark of the worker pool. Runs a sequence of reading
+ * commands with 1 to the given number of threads, presenting the scaling
+ * curve, and checks that the output is the same as running them one by one.
+ * Usage: ./bench_workers [stops] [queries] [threads]
+*/
+
+/* Wall clock time and memory streams (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+#define DEFAULT_STOPS 20000
+#define DEFAULT_QUERIES 120
+#define DEFAULT_THREADS 8
+#define LINK_STOPS 50
+
+
+/**
+ * Returns the milliseconds elapsed since the given time.
+*/
+double elapsedMs(struct timespec* start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+                                (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Returns a new copy of the given command line.
+*/
+char* copyLine(char* line) {
+
+    char* copy = (char*)tryMalloc(strlen(line) + 1);
+
+    return strcpy(copy, line);
+}
+
+/**
+ * Stores in 'line' the i-th reading command of the benchmark, going
+ * through every kind of reading command.
+*/
+void queryLine(char* line, int i, int stops) {
+
+    int lines = stops / LINK_STOPS;
+
+    switch (i % 6) {
+
+        case 0: sprintf(line, "c L%d\n", i % lines);
+            break;
+        case 1: sprintf(line, "c L%d inverso\n", i % lines);
+            break;
+        case 2: sprintf(line, "p s%d\n", i % stops);
+            break;
+        case 3: sprintf(line, "i\n");
+            break;
+        case 4: sprintf(line, "c\n");
+            break;
+        default: sprintf(line, "p\n");
+            break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    int stops = argc > 1 ? atoi(argv[1]) : DEFAULT_STOPS;
+    int queries = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES;
+    int threads = argc > 3 ? atoi(argv[3]) : DEFAULT_THREADS;
+    System* sys = systemInit();
+    Query* run;
+    char line[BUFLEN], *expected, *output;
+    size_t expected_length, output_length;
+    double serial_ms, ms;
+    struct timespec start;
+    int ends[LINK_STOPS], origin, i, t, count, same, ok = YES;
+
+    srand(2023);
+
+    for (i = 0; i < stops; i++) {
+        sprintf(line, "p s%d %d.%d %d.%d\n", i, rand() % 80, rand() % 1000,
+                                            rand() % 170, rand() % 1000);
+        runCommandLine(sys, line);
+    }
+
+    for (i = 0; i <= stops / LINK_STOPS; i++) {
+        sprintf(line, "c L%d\n", i);
+        runCommandLine(sys, line);
+        sprintf(line, "c R%d\n", i % LINK_STOPS);
+        runCommandLine(sys, line);
+    }
+
+    for (i = 0; i < LINK_STOPS; i++)
+        ends[i] = rand() % stops;
+
+    /* Lines of consecutive stops, sharing some with random lines. */
+    for (i = 0; i + 1 < stops; i++) {
+        sprintf(line, "l L%d s%d s%d 1 2\n", i / LINK_STOPS, i, i + 1);
+        runCommandLine(sys, line);
+        origin = ends[i % LINK_STOPS];
+        ends[i % LINK_STOPS] = (origin + 1 + rand() % (stops - 1)) % stops;
+        sprintf(line, "l R%d s%d s%d 1 2\n", i % LINK_STOPS, origin,
+                                                    ends[i % LINK_STOPS]);
+        runCommandLine(sys, line);
+    }
+
+    /* One by one, without the worker pool, once the lines are sorted. */
+    sys->out = open_memstream(&expected, &expected_length);
+    runCommandLine(sys, "i\n");
+    fclose(sys->out);
+    free(expected);
+
+    sys->out = open_memstream(&expected, &expected_length);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < queries; i++) {
+        queryLine(line, i, stops);
+        runCommandLine(sys, line);
+    }
+    serial_ms = elapsedMs(&start);
+    fclose(sys->out);
+
+    printf("%d stops, %d queries, %ld processors online\n", stops, queries,
+                                            sysconf(_SC_NPROCESSORS_ONLN));
+    printf("serial     %10.1f ms\n", serial_ms);
+
+    for (t = 1; t <= threads; t++) {
+
+        sys->workers = createWorkerPool(sys, t);
+        sys->out = open_memstream(&output, &output_length);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (i = 0; i < queries; i += count) {
+            run = (Query*)tryMalloc(WORKER_MAX_RUN * sizeof(Query));
+            for (count = 0; count < WORKER_MAX_RUN && i + count < queries;
+                                                                count++) {
+                queryLine(line, i + count, stops);
+                run[count].line = copyLine(line);
+            }
+            runQueries(sys->workers, run, count);
+        }
+
+        finishQueries(sys->workers, YES);
+        ms = elapsedMs(&start);
+        fclose(sys->out);
+        destroyWorkerPool(sys->workers);
+        sys->workers = NULL;
+
+        same = output_length == expected_length &&
+                            memcmp(output, expected, output_length) == 0;
+        ok &= same;
+
+        printf("%3d threads %10.1f ms  speedup %5.2fx  %s\n", t, ms,
+                serial_ms / ms, same ? "same output" : "DIFFERENT OUTPUT");
+
+        free(output);
+    }
+
+    sys->out = stdout;
+    free(expected);
+    exitProgram(sys);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+/**
+ * IAED-23 Project 2
+ * File: workload.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: generator of synthetic workloads, in the format of the
+ * public tests' inputs. It writes a network of the given number of stops,
+ * lines and links, the lengths of the routes following the given
+ * distribution and their stops chosen with the given skew towards the hubs
+ * (the first stops), and then the given number of commands, mixing links,
+ * lines and stops shown, intersections and removals of lines, stops and
+ * everything by the given weights. The state of the network is followed,
+ * so that the commands name existing lines and stops and the links extend
+ * their routes. The same options and seed write the same workload.
+ * Usage: ./workload [-s stops] [-l lines] [-k links] [-d fixed|uniform|
+ *        geometric] [-z skew] [-n commands] [-m l=60,c=15,p=15,i=1,r=2,e=5,
+ *        a=0] [-x seed] > file.in
+*/
+
+#include "main.h"
+#include <math.h>
+
+
+#define DEFAULT_STOPS 20000
+#define DEFAULT_LINES 1000
+#define DEFAULT_LINKS 100000
+#define DEFAULT_SKEW 0.8
+#define DEFAULT_COMMANDS 20000
+#define DEFAULT_MIX "l=60,c=15,p=15,i=1,r=2,e=5,a=0"
+#define MIX_COMMANDS "lcpirea"      /* Commands of the mix, in order. */
+#define NUM_MIX 7
+
+
+/* Structure of generated route (stops of a line, in order). */
+typedef struct {
+    int* stops;
+    int length, size;
+    int exists;                 /* If the line exists. */
+} GenRoute;
+
+/* Structure of workload being generated. */
+typedef struct {
+    int num_stops, num_lines, num_links;
+    char distribution;          /* 'f'ixed, 'u'niform or 'g'eometric. */
+    double skew;                /* Of the stops towards the hubs. */
+    int weights[NUM_MIX];       /* Of each command of the mix. */
+    unsigned long seed;
+    double* cumulative;         /* Weight of the stops up to each one. */
+    int* stop_exists;
+    GenRoute* routes;
+} Workload;
+
+
+/**
+ * Returns the next pseudo-random number of the workload, in [0, 2^31), the
+ * same on every platform.
+*/
+long int nextRandom(Workload* work) {
+
+    work->seed = (work->seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+
+    return (long int)(work->seed >> 1);
+}
+
+/**
+ * Returns a pseudo-random number in [0, 1).
+*/
+double nextUniform(Workload* work) {
+
+    return nextRandom(work) / 2147483648.0;
+}
+
+/**
+ * Returns a stop, the first stops being chosen more often as the skew
+ * grows (the weight of each stop is 1 / (number + 1) ^ skew).
+*/
+int skewedStop(Workload* work) {
+
+    double target = nextUniform(work) *
+                                    work->cumulative[work->num_stops - 1];
+    int low = 0, high = work->num_stops - 1, middle;
+
+    while (low < high) {
+
+        middle = (low + high) / 2;
+
+        if (work->cumulative[middle] <= target)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+/**
+ * Returns the length of a route, given the distribution and the mean
+ * number of links of each line.
+*/
+int routeLength(Workload* work) {
+
+    double mean = (double)work->num_links / work->num_lines;
+
+    if (work->distribution == 'u')
+        return 1 + (int)(nextUniform(work) * (2 * mean - 1));
+
+    if (work->distribution == 'g')
+        return 1 + (int)(-(mean - 1) * log(1.0 - nextUniform(work)));
+
+    return (int)(mean + 0.5);
+}
+
+/**
+ * Writes the command creating the given stop, if it doesn't exist.
+*/
+void createStop(Workload* work, int stop) {
+
+    double latitude, longitude;
+
+    if (!work->stop_exists[stop]) {
+        latitude = nextUniform(work) * 180 - 90;
+        longitude = nextUniform(work) * 360 - 180;
+        printf("p S%d %.6f %.6f\n", stop, latitude, longitude);
+        work->stop_exists[stop] = 1;
+    }
+}
+
+/**
+ * Writes the command of a link extending the route of the given line:
+ * appended to its last stop or pushed before its first, towards a stop
+ * chosen by the skew. An empty route gets its first link.
+*/
+void extendRoute(Workload* work, int line) {
+
+    GenRoute* route = &work->routes[line];
+    int append = nextRandom(work) % 2 == 0, stop, end, i;
+    long int cost, duration;
+
+    if (route->length + 2 > route->size) {
+        route->size = (route->length + 2) * 2;
+        route->stops = (int*)tryRealloc(route->stops,
+                                                route->size * sizeof(int));
+    }
+
+    if (route->length == 0) {
+        route->stops[0] = skewedStop(work);
+        route->length = 1;
+        createStop(work, route->stops[0]);
+    }
+
+    end = append ? route->stops[route->length - 1] : route->stops[0];
+
+    /* Pushing the last stop would close the route, appending instead. */
+    while ((stop = skewedStop(work)) == end ||
+                    (!append && stop == route->stops[route->length - 1])) { }
+
+    createStop(work, stop);
+
+    if (append) {
+        route->stops[route->length++] = stop;
+    } else {
+        for (i = route->length++; i > 0; i--)
+            route->stops[i] = route->stops[i - 1];
+        route->stops[0] = stop;
+    }
+
+    cost = nextRandom(work) % 1000;
+    duration = nextRandom(work) % 60;
+    printf("l L%d S%d S%d %ld.%02ld %ld\n", line, append ? end : stop,
+            append ? stop : end, cost / 100, cost % 100, duration);
+}
+
+/**
+ * Writes the commands of the network: its stops, its lines and the links
+ * of their routes, each line adding a link in turn until its route has the
+ * length drawn for it.
+*/
+void writeNetwork(Workload* work) {
+
+    int* lengths = (int*)tryMalloc(work->num_lines * sizeof(int));
+    int i, added = 1;
+
+    for (i = 0; i < work->num_stops; i++)
+        createStop(work, i);
+
+    for (i = 0; i < work->num_lines; i++) {
+        printf("c L%d\n", i);
+        work->routes[i].exists = 1;
+        lengths[i] = routeLength(work);
+    }
+
+    while (added) {
+
+        added = 0;
+
+        for (i = 0; i < work->num_lines; i++) {
+
+            if (work->routes[i].length < lengths[i] + 1) {
+                extendRoute(work, i);
+                added = 1;
+            }
+        }
+    }
+
+    free(lengths);
+}
+
+/**
+ * Writes the command removing a stop, chosen with no skew, and removes it
+ * from the routes, which then skip it.
+*/
+void removeStopOfRoutes(Workload* work) {
+
+    int stop = nextRandom(work) % work->num_stops, i, j, k;
+    GenRoute* route;
+
+    printf("e S%d\n", stop);
+    work->stop_exists[stop] = 0;
+
+    for (i = 0; i < work->num_lines; i++) {
+
+        route = &work->routes[i];
+
+        for (j = k = 0; j < route->length; j++)
+            if (route->stops[j] != stop)
+                route->stops[k++] = route->stops[j];
+
+        route->length = k < 2 ? 0 : k;
+    }
+}
+
+/**
+ * Writes the given number of commands, chosen by the weights of the mix.
+ * After 'a', the network is written again.
+*/
+void writeCommands(Workload* work, int count) {
+
+    int total = 0, i, j, pick, line;
+
+    for (j = 0; j < NUM_MIX; j++)
+        total += work->weights[j];
+
+    for (i = 0; i < count && total > 0; i++) {
+
+        pick = nextRandom(work) % total;
+
+        for (j = 0; pick >= work->weights[j]; j++)
+            pick -= work->weights[j];
+
+        line = nextRandom(work) % work->num_lines;
+
+        switch (MIX_COMMANDS[j]) {
+
+            case 'l':
+                if (!work->routes[line].exists) {
+                    printf("c L%d\n", line);
+                    work->routes[line].exists = 1;
+                }
+                extendRoute(work, line);
+                break;
+            case 'c':
+                printf("c L%d%s\n", line, nextRandom(work) % 4 ? "" :
+                                                                " inverso");
+                work->routes[line].exists = 1;
+                break;
+            case 'p':
+                printf("p S%d\n", skewedStop(work));
+                break;
+            case 'i':
+                printf("i\n");
+                break;
+            case 'r':
+                printf("r L%d\n", line);
+                work->routes[line].exists = 0;
+                work->routes[line].length = 0;
+                break;
+            case 'e':
+                removeStopOfRoutes(work);
+                break;
+            case 'a':
+                printf("a\n");
+                for (line = 0; line < work->num_lines; line++)
+                    work->routes[line].length = work->routes[line].exists = 0;
+                memset(work->stop_exists, 0, work->num_stops * sizeof(int));
+                writeNetwork(work);
+                break;
+        }
+    }
+}
+
+/**
+ * Reads the weights of the mix from the given text ("l=60,c=15,..."),
+ * where the commands left out weigh 0. Returns NO if it's invalid.
+*/
+int readMix(Workload* work, char* text) {
+
+    char* command;
+    int j, weight, length;
+
+    for (j = 0; j < NUM_MIX; j++)
+        work->weights[j] = 0;
+
+    while (*text != '\0') {
+
+        if (sscanf(text, "%*c=%d%n", &weight, &length) != 1 || weight < 0 ||
+                        (command = strchr(MIX_COMMANDS, text[0])) == NULL)
+            return NO;
+
+        work->weights[command - MIX_COMMANDS] = weight;
+        text += length;
+
+        if (*text == ',')
+            text++;
+    }
+
+    return YES;
+}
+
+int main(int argc, char* argv[]) {
+
+    Workload work;
+    int commands = DEFAULT_COMMANDS, i;
+    double weight = 0.0;
+
+    work.num_stops = DEFAULT_STOPS;
+    work.num_lines = DEFAULT_LINES;
+    work.num_links = DEFAULT_LINKS;
+    work.distribution = 'u';
+    work.skew = DEFAULT_SKEW;
+    work.seed = 2023;
+    readMix(&work, DEFAULT_MIX);
+
+    for (i = 1; i + 1 < argc; i += 2) {
+
+        if (strcmp(argv[i], "-s") == 0)
+            work.num_stops = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-l") == 0)
+            work.num_lines = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-k") == 0)
+            work.num_links = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            work.distribution = argv[i + 1][0];
+        else if (strcmp(argv[i], "-z") == 0)
+            work.skew = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            commands = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-x") == 0)
+            work.seed = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-m") != 0 || !readMix(&work, argv[i + 1]))
+            break;
+    }
+
+    if (i < argc || work.num_stops < 2 || work.num_lines < 1 ||
+                                                    work.num_links < 0) {
+        fprintf(stderr, "usage: %s [-s stops] [-l lines] [-k links] "
+                "[-d fixed|uniform|geometric] [-z skew] [-n commands] "
+                "[-m %s] [-x seed]\n", argv[0], DEFAULT_MIX);
+        return 1;
+    }
+
+    work.cumulative = (double*)tryMalloc(work.num_stops * sizeof(double));
+    work.stop_exists = (int*)tryMalloc(work.num_stops * sizeof(int));
+    work.routes = (GenRoute*)tryMalloc(work.num_lines * sizeof(GenRoute));
+
+    for (i = 0; i < work.num_stops; i++) {
+        weight += 1.0 / pow(i + 1, work.skew);
+        work.cumulative[i] = weight;
+        work.stop_exists[i] = 0;
+    }
+
+    for (i = 0; i < work.num_lines; i++) {
+        work.routes[i].stops = NULL;
+        work.routes[i].length = work.routes[i].size = 0;
+        work.routes[i].exists = 0;
+    }
+
+    writeNetwork(&work);
+    writeCommands(&work, commands);
+    printf("q\n");
+
+    for (i = 0; i < work.num_lines; i++)
+        free(work.routes[i].stops);
+
+    free(work.routes);
+    free(work.stop_exists);
+    free(work.cumulative);
+
+    return 0;
+}
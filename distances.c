@@ -0,0 +1,331 @@
+/**
+ * IAED-23 Project 2
+ * File: distances.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the distance columns,
+ * a structure-of-arrays copy of the stops' positions, and of the kernels
+ * that compute the distance from a point to every stop in bulk, with SSE2
+ * and AVX2 versions chosen when the program starts.
+*/
+
+#include "main.h"
+
+/* The vector kernels are only built for x86 processors with GCC. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DIST_X86
+#include <immintrin.h>
+#endif
+
+
+/* ---------------------------- Distance query ------------------------------ */
+
+/**
+ * Shows in the standard output, by order of creation, the stops within the
+ * given distance (in kilometres) of the given coordinates, with their
+ * distance. Every distance is computed by the distance kernel.
+*/
+void showStopsInDistance(System *sys, double latitude, double longitude,
+                                                                double km) {
+
+    StopColumns* columns = sys->columns;
+    StopArray* found = createStopArray();
+    double point[3];
+    int i;
+
+    geoPosition(latitude, longitude, point);
+    columns->kernel(columns, point, columns->dist);
+
+    for (i = 0; i < columns->count; i++)
+        if (columns->dist[i] <= km)
+            appendStop(found, columns->stops[i]);
+
+    sortStopArray(found);
+
+    for (i = 0; i < found->count; i++)
+        fprintf(sys->out, "%s: %.3f\n", nameChars(&found->items[i]->name),
+                                columns->dist[found->items[i]->column]);
+
+    destroyStopArray(found);
+}
+
+
+/* --------------------------- Distance columns ----------------------------- */
+
+/**
+ * Creates new empty distance columns and returns their respective pointer.
+ * The fastest kernel supported by the processor is chosen.
+*/
+StopColumns* createStopColumns() {
+
+    StopColumns* columns = (StopColumns*)tryMalloc(sizeof(StopColumns));
+
+    columns->size = SPATIAL_START_SIZE;
+    columns->count = 0;
+    columns->x = (double*)tryMalloc(columns->size * sizeof(double));
+    columns->y = (double*)tryMalloc(columns->size * sizeof(double));
+    columns->z = (double*)tryMalloc(columns->size * sizeof(double));
+    columns->dist = (double*)tryMalloc(columns->size * sizeof(double));
+    columns->stops = (Stop**)tryMalloc(columns->size * sizeof(Stop*));
+    columns->kernel = selectDistanceKernel();
+
+    return columns;
+}
+
+/**
+ * Appends the position of the given stop to the columns, doubling their
+ * size if they're full.
+*/
+void columnsInsert(StopColumns* columns, Stop* stop) {
+
+    double point[3];
+    int i = columns->count;
+
+    if (i == columns->size) {
+
+        columns->size *= 2;
+        columns->x = (double*)tryRealloc(columns->x,
+                                        columns->size * sizeof(double));
+        columns->y = (double*)tryRealloc(columns->y,
+                                        columns->size * sizeof(double));
+        columns->z = (double*)tryRealloc(columns->z,
+                                        columns->size * sizeof(double));
+        columns->dist = (double*)tryRealloc(columns->dist,
+                                        columns->size * sizeof(double));
+        columns->stops = (Stop**)tryRealloc(columns->stops,
+                                        columns->size * sizeof(Stop*));
+    }
+
+    geoPosition(stop->latitude, stop->longitude, point);
+    columns->x[i] = point[0];
+    columns->y[i] = point[1];
+    columns->z[i] = point[2];
+    columns->stops[i] = stop;
+    stop->column = columns->count++;
+}
+
+/**
+ * Removes the given stop from the columns, moving the last stop
+ * to its place.
+*/
+void columnsRemove(StopColumns* columns, Stop* stop) {
+
+    int i = stop->column, last = --columns->count;
+
+    columns->x[i] = columns->x[last];
+    columns->y[i] = columns->y[last];
+    columns->z[i] = columns->z[last];
+    columns->stops[i] = columns->stops[last];
+    columns->stops[i]->column = i;
+}
+
+/**
+ * Frees all the allocated memory in the given columns. The stops are
+ * not deleted.
+*/
+void destroyStopColumns(StopColumns* columns) {
+
+    free(columns->x);
+    free(columns->y);
+    free(columns->z);
+    free(columns->dist);
+    free(columns->stops);
+    free(columns);
+}
+
+
+/* --------------------------- Distance kernels ----------------------------- */
+
+/**
+ * Returns the fastest distance kernel supported by the processor.
+*/
+DistanceKernel selectDistanceKernel() {
+
+#ifdef DIST_X86
+    if (__builtin_cpu_supports("avx2"))
+        return distancesAVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return distancesSSE2;
+#endif
+
+    return distancesScalar;
+}
+
+/**
+ * Stores in 'coef' the coefficients of the Taylor series of the arc sine,
+ * asin(y) = y * (coef[0] + coef[1] * y^2 + coef[2] * y^4 + ...).
+*/
+void asinCoefficients(double coef[DIST_SERIES_TERMS]) {
+
+    double term = 1.0;
+    int i;
+
+    for (i = 0; i < DIST_SERIES_TERMS; i++) {
+        coef[i] = term / (2 * i + 1);
+        term *= (2 * i + 1) / (2.0 * i + 2);
+    }
+}
+
+/**
+ * Returns the distance (in kilometres) between the given point of the unit
+ * sphere and the stop in the given position of the columns. The haversine
+ * of the angle between them is a quarter of their squared chord, so the
+ * distance is 2R * asin(sqrt(hav)). Above 0.5, the arc sine uses
+ * asin(h) = pi/2 - 2 * asin(sqrt((1 - h) / 2)), like 'geoAsin'.
+*/
+double columnDistance(StopColumns* columns, int i, double point[3],
+                                        double coef[DIST_SERIES_TERMS]) {
+
+    double dx = columns->x[i] - point[0], dy = columns->y[i] - point[1];
+    double dz = columns->z[i] - point[2], hav, h, y, y2, sum;
+    int j;
+
+    hav = (dx * dx + dy * dy + dz * dz) / 4.0;
+    h = geoSqrt(hav < 1.0 ? hav : 1.0);
+    y = h <= 0.5 ? h : geoSqrt((1.0 - h) / 2.0);
+    y2 = y * y;
+
+    sum = coef[DIST_SERIES_TERMS - 1];
+    for (j = DIST_SERIES_TERMS - 2; j >= 0; j--)
+        sum = sum * y2 + coef[j];
+    sum *= y;
+
+    sum = h <= 0.5 ? sum : GEO_PI / 2.0 - 2.0 * sum;
+
+    return 2.0 * GEO_EARTH_RADIUS * sum;
+}
+
+/**
+ * Stores in 'dist' the distance (in kilometres) from the given point of the
+ * unit sphere to each stop of the columns, one stop at a time.
+*/
+void distancesScalar(StopColumns* columns, double point[3], double* dist) {
+
+    double coef[DIST_SERIES_TERMS];
+    int i;
+
+    asinCoefficients(coef);
+
+    for (i = 0; i < columns->count; i++)
+        dist[i] = columnDistance(columns, i, point, coef);
+}
+
+#ifdef DIST_X86
+
+/**
+ * Stores in 'dist' the distance from the given point to each stop of the
+ * columns, two stops at a time with SSE2 instructions. The branches of the
+ * arc sine are both computed and the right one is selected by a mask.
+*/
+__attribute__((target("sse2")))
+void distancesSSE2(StopColumns* columns, double point[3], double* dist) {
+
+    double coef[DIST_SERIES_TERMS];
+    __m128d px = _mm_set1_pd(point[0]), py = _mm_set1_pd(point[1]);
+    __m128d pz = _mm_set1_pd(point[2]), one = _mm_set1_pd(1.0);
+    __m128d half = _mm_set1_pd(0.5), quarter = _mm_set1_pd(0.25);
+    __m128d d, hav, h, y, y2, sum, small;
+    int i, j;
+
+    asinCoefficients(coef);
+
+    for (i = 0; i + 2 <= columns->count; i += 2) {
+
+        d = _mm_sub_pd(_mm_loadu_pd(columns->x + i), px);
+        hav = _mm_mul_pd(d, d);
+        d = _mm_sub_pd(_mm_loadu_pd(columns->y + i), py);
+        hav = _mm_add_pd(hav, _mm_mul_pd(d, d));
+        d = _mm_sub_pd(_mm_loadu_pd(columns->z + i), pz);
+        hav = _mm_add_pd(hav, _mm_mul_pd(d, d));
+        hav = _mm_min_pd(_mm_mul_pd(hav, quarter), one);
+
+        h = _mm_sqrt_pd(hav);
+        small = _mm_cmple_pd(h, half);
+        y = _mm_sqrt_pd(_mm_mul_pd(_mm_sub_pd(one, h), half));
+        y = _mm_or_pd(_mm_and_pd(small, h), _mm_andnot_pd(small, y));
+        y2 = _mm_mul_pd(y, y);
+
+        sum = _mm_set1_pd(coef[DIST_SERIES_TERMS - 1]);
+        for (j = DIST_SERIES_TERMS - 2; j >= 0; j--)
+            sum = _mm_add_pd(_mm_mul_pd(sum, y2), _mm_set1_pd(coef[j]));
+        sum = _mm_mul_pd(sum, y);
+
+        y = _mm_sub_pd(_mm_set1_pd(GEO_PI / 2.0), _mm_add_pd(sum, sum));
+        sum = _mm_or_pd(_mm_and_pd(small, sum), _mm_andnot_pd(small, y));
+        _mm_storeu_pd(dist + i, _mm_mul_pd(sum,
+                                _mm_set1_pd(2.0 * GEO_EARTH_RADIUS)));
+    }
+
+    for (; i < columns->count; i++)
+        dist[i] = columnDistance(columns, i, point, coef);
+}
+
+/**
+ * Stores in 'dist' the distance from the given point to each stop of the
+ * columns, four stops at a time with AVX2 instructions, like
+ * 'distancesSSE2'.
+*/
+__attribute__((target("avx2")))
+void distancesAVX2(StopColumns* columns, double point[3], double* dist) {
+
+    double coef[DIST_SERIES_TERMS];
+    __m256d px = _mm256_set1_pd(point[0]), py = _mm256_set1_pd(point[1]);
+    __m256d pz = _mm256_set1_pd(point[2]), one = _mm256_set1_pd(1.0);
+    __m256d half = _mm256_set1_pd(0.5), quarter = _mm256_set1_pd(0.25);
+    __m256d d, hav, h, y, y2, sum, small;
+    int i, j;
+
+    asinCoefficients(coef);
+
+    for (i = 0; i + 4 <= columns->count; i += 4) {
+
+        d = _mm256_sub_pd(_mm256_loadu_pd(columns->x + i), px);
+        hav = _mm256_mul_pd(d, d);
+        d = _mm256_sub_pd(_mm256_loadu_pd(columns->y + i), py);
+        hav = _mm256_add_pd(hav, _mm256_mul_pd(d, d));
+        d = _mm256_sub_pd(_mm256_loadu_pd(columns->z + i), pz);
+        hav = _mm256_add_pd(hav, _mm256_mul_pd(d, d));
+        hav = _mm256_min_pd(_mm256_mul_pd(hav, quarter), one);
+
+        h = _mm256_sqrt_pd(hav);
+        small = _mm256_cmp_pd(h, half, _CMP_LE_OQ);
+        y = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(one, h), half));
+        y = _mm256_blendv_pd(y, h, small);
+        y2 = _mm256_mul_pd(y, y);
+
+        sum = _mm256_set1_pd(coef[DIST_SERIES_TERMS - 1]);
+        for (j = DIST_SERIES_TERMS - 2; j >= 0; j--)
+            sum = _mm256_add_pd(_mm256_mul_pd(sum, y2),
+                                                _mm256_set1_pd(coef[j]));
+        sum = _mm256_mul_pd(sum, y);
+
+        y = _mm256_sub_pd(_mm256_set1_pd(GEO_PI / 2.0),
+                                                _mm256_add_pd(sum, sum));
+        sum = _mm256_blendv_pd(y, sum, small);
+        _mm256_storeu_pd(dist + i, _mm256_mul_pd(sum,
+                                _mm256_set1_pd(2.0 * GEO_EARTH_RADIUS)));
+    }
+
+    for (; i < columns->count; i++)
+        dist[i] = columnDistance(columns, i, point, coef);
+}
+
+#else
+
+/**
+ * Without vector instructions, the SSE2 kernel is the scalar one.
+*/
+void distancesSSE2(StopColumns* columns, double point[3], double* dist) {
+
+    distancesScalar(columns, point, dist);
+}
+
+/**
+ * Without vector instructions, the AVX2 kernel is the scalar one.
+*/
+void distancesAVX2(StopColumns* columns, double point[3], double* dist) {
+
+    distancesScalar(columns, point, dist);
+}
+
+#endif
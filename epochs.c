@@ -0,0 +1,138 @@
+/**
+ * IAED-23 Project 2
+ * File: epochs.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the grace periods of the readers that take
+ * no locks, such as the lookups of the hashtables in server mode. Each
+ * reader enters the current epoch before reading and leaves it after. The
+ * memory a writer unlinks is retired in the current epoch, which then ends,
+ * and is only freed once every reader inside an epoch entered a later one
+ * (epoch based reclamation). Without grace periods, memory is freed at once.
+*/
+
+#include "main.h"
+
+
+/* Readers' epochs apart, so that each reader writes its own cache line. */
+#define EPOCH_STRIDE (CACHE_LINE / sizeof(long int))
+
+
+/**
+ * Creates new grace periods for the given number of readers, and returns
+ * their respective pointer.
+*/
+Epochs* createEpochs(int num_readers) {
+
+    Epochs* epochs = (Epochs*)tryMalloc(sizeof(Epochs));
+    int i;
+
+    epochs->epoch = 1;
+    epochs->num_readers = num_readers;
+    epochs->pinned = (long int*)tryMalloc(num_readers * EPOCH_STRIDE *
+                                                        sizeof(long int));
+    epochs->retired = NULL;
+    epochs->retired_count = epochs->reclaimed = 0;
+
+    for (i = 0; i < num_readers; i++)
+        epochs->pinned[i * EPOCH_STRIDE] = 0;
+
+    return epochs;
+}
+
+/**
+ * Enters the given reader in the current epoch. What it reads until it
+ * leaves isn't freed meanwhile.
+*/
+void enterEpoch(Epochs* epochs, int reader) {
+
+    long int epoch = __atomic_load_n(&epochs->epoch, __ATOMIC_SEQ_CST);
+
+    /* Exchanged, so that the reads that follow come after it. */
+    __atomic_exchange_n(&epochs->pinned[reader * EPOCH_STRIDE], epoch,
+                                                        __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Makes the given reader leave its epoch.
+*/
+void leaveEpoch(Epochs* epochs, int reader) {
+
+    __atomic_store_n(&epochs->pinned[reader * EPOCH_STRIDE], 0,
+                                                        __ATOMIC_RELEASE);
+}
+
+/**
+ * Retires the given memory, already unlinked from what the readers reach,
+ * to be freed with the given function once their grace period ends, which
+ * is at once if there are no grace periods. Called by a single writer at a
+ * time.
+*/
+void retireMemory(Epochs* epochs, void* ptr, void (*destroy)(void*)) {
+
+    Retired* retired;
+
+    if (epochs == NULL) {
+        destroy(ptr);
+        return;
+    }
+
+    retired = (Retired*)tryMalloc(sizeof(Retired));
+    retired->ptr = ptr;
+    retired->destroy = destroy;
+    retired->epoch = __atomic_fetch_add(&epochs->epoch, 1, __ATOMIC_SEQ_CST);
+    retired->next = epochs->retired;
+    epochs->retired = retired;
+    epochs->retired_count++;
+}
+
+/**
+ * Frees the retired memory older than the epoch of every reader inside
+ * one. Called by the writer.
+*/
+void reclaimMemory(Epochs* epochs) {
+
+    long int oldest = __atomic_load_n(&epochs->epoch, __ATOMIC_SEQ_CST);
+    long int epoch;
+    Retired **ptr = &epochs->retired, *retired;
+    int i;
+
+    for (i = 0; i < epochs->num_readers; i++) {
+
+        epoch = __atomic_load_n(&epochs->pinned[i * EPOCH_STRIDE],
+                                                        __ATOMIC_SEQ_CST);
+
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+
+    while ((retired = *ptr) != NULL) {
+
+        if (retired->epoch < oldest) {
+            *ptr = retired->next;
+            retired->destroy(retired->ptr);
+            free(retired);
+            epochs->reclaimed++;
+        } else {
+            ptr = &retired->next;
+        }
+    }
+}
+
+/**
+ * Frees all the allocated memory in the given grace periods, and the memory
+ * retired in them, which no reader holds anymore.
+*/
+void destroyEpochs(Epochs* epochs) {
+
+    Retired* retired;
+
+    while ((retired = epochs->retired) != NULL) {
+        epochs->retired = retired->next;
+        retired->destroy(retired->ptr);
+        free(retired);
+    }
+
+    free(epochs->pinned);
+    free(epochs);
+}
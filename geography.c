@@ -0,0 +1,172 @@
+/**
+ * IAED-23 Project 2
+ * File: geography.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the geographic
+ * functions over the stops' coordinates. The program isn't linked with the
+ * math library, so the trigonometric functions are computed here.
+*/
+
+#include "main.h"
+
+
+/* ------------------------- Geographic functions --------------------------- */
+
+/**
+ * Calculates the position of the given coordinates (in degrees) in the
+ * unit sphere, storing it in the given point.
+*/
+void geoPosition(double latitude, double longitude, double point[3]) {
+
+    double lat = latitude * GEO_PI / 180.0, lon = longitude * GEO_PI / 180.0;
+
+    point[0] = geoCos(lat) * geoCos(lon);
+    point[1] = geoCos(lat) * geoSin(lon);
+    point[2] = geoSin(lat);
+}
+
+/**
+ * Returns the squared distance between two points of the unit sphere
+ * (the squared chord).
+*/
+double geoChord(double first[3], double second[3]) {
+
+    double x = first[0] - second[0];
+    double y = first[1] - second[1];
+    double z = first[2] - second[2];
+
+    return x * x + y * y + z * z;
+}
+
+/**
+ * Converts the given squared chord of the unit sphere into the great
+ * circle distance between its ends, in kilometres.
+*/
+double geoChordToKm(double chord) {
+
+    double half = geoSqrt(chord) / 2.0;
+
+    /* Rounding may push the chord slightly beyond the diameter. */
+    if (half > 1.0)
+        half = 1.0;
+
+    return 2.0 * GEO_EARTH_RADIUS * geoAsin(half);
+}
+
+/**
+ * Returns the great circle distance between the two given coordinates
+ * (in degrees), in kilometres.
+*/
+double geoDistance(double lat1, double lon1, double lat2, double lon2) {
+
+    double first[3], second[3];
+
+    geoPosition(lat1, lon1, first);
+    geoPosition(lat2, lon2, second);
+
+    return geoChordToKm(geoChord(first, second));
+}
+
+
+
+/* ------------------------- Elementary functions --------------------------- */
+
+/**
+ * Returns the sine of the given angle (in radians). The angle is reduced to
+ * [-pi/2, pi/2], where the Taylor series converges fast.
+*/
+double geoSin(double x) {
+
+    double term, sum, x2;
+    int i;
+
+    /* Reduce to [-pi, pi]. */
+    if (x > GEO_PI || x < -GEO_PI)
+        x -= 2.0 * GEO_PI * (double)(long)((x + (x > 0 ? GEO_PI : -GEO_PI)) /
+                                                            (2.0 * GEO_PI));
+
+    /* Reduce to [-pi/2, pi/2], since sin(pi - x) = sin(x). */
+    if (x > GEO_PI / 2.0)
+        x = GEO_PI - x;
+    else if (x < -GEO_PI / 2.0)
+        x = -GEO_PI - x;
+
+    x2 = x * x;
+    term = x;
+    sum = x;
+
+    for (i = 1; i <= GEO_SERIES_TERMS; i++) {
+        term *= -x2 / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/**
+ * Returns the cosine of the given angle (in radians).
+*/
+double geoCos(double x) {
+
+    return geoSin(x + GEO_PI / 2.0);
+}
+
+/**
+ * Returns the square root of the given non negative number. The number is
+ * scaled into [1, 4) by powers of 4, where Newton's method converges in a
+ * few iterations.
+*/
+double geoSqrt(double x) {
+
+    double scale = 1.0, root;
+    int i;
+
+    if (x <= 0.0)
+        return 0.0;
+
+    while (x >= 4.0) {
+        x /= 4.0;
+        scale *= 2.0;
+    }
+
+    while (x < 1.0) {
+        x *= 4.0;
+        scale /= 2.0;
+    }
+
+    root = (x + 1.0) / 2.0;
+
+    for (i = 0; i < GEO_NEWTON_STEPS; i++)
+        root = (root + x / root) / 2.0;
+
+    return root * scale;
+}
+
+/**
+ * Returns the arc sine (in radians) of the given number, in [-1, 1]. Above
+ * 0.5, it uses asin(x) = pi/2 - 2 * asin(sqrt((1 - x) / 2)), so that the
+ * Taylor series is only summed up to 0.5.
+*/
+double geoAsin(double x) {
+
+    double term, sum, x2;
+    int i;
+
+    if (x < 0.0)
+        return -geoAsin(-x);
+
+    if (x > 0.5)
+        return GEO_PI / 2.0 - 2.0 * geoAsin(geoSqrt((1.0 - x) / 2.0));
+
+    x2 = x * x;
+    term = x;
+    sum = x;
+
+    for (i = 1; i <= 2 * GEO_SERIES_TERMS; i++) {
+        term *= x2 * (2 * i - 1) * (2 * i - 1) / ((2.0 * i) * (2 * i + 1));
+        sum += term;
+    }
+
+    return sum;
+}
@@ -0,0 +1,99 @@
+/**
+ * IAED-23 Project 2
+ * File: graph.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the network graph,
+ * a compact adjacency representation of the links of every line, used
+ * by the journey queries.
+*/
+
+#include "main.h"
+
+
+/* ---------------------------- Graph functions ----------------------------- */
+
+/**
+ * Builds the network graph of the system. Every stop is given an index by
+ * order of creation and every link of every line becomes an edge leaving
+ * its origin stop. Returns a pointer to the new graph.
+*/
+Graph* buildGraph(System *sys) {
+
+    Graph* graph = (Graph*)tryMalloc(sizeof(Graph));
+    Node *ptr, *link_ptr;
+    Line* line;
+    Link* link;
+    int i;
+
+    graph->num_stops = sys->stops_list->count;
+    graph->num_edges = 0;
+
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next)
+        graph->num_edges += ((Line*)ptr->data)->links_list->count;
+
+    graph->stops = (Stop**)tryMalloc((graph->num_stops + 1) * sizeof(Stop*));
+    graph->first_edge = (int*)tryMalloc((graph->num_stops + 1) * sizeof(int));
+    graph->edge_dest = (int*)tryMalloc((graph->num_edges + 1) * sizeof(int));
+    graph->edge_value =
+            (Values*)tryMalloc((graph->num_edges + 1) * sizeof(Values));
+    graph->edge_line =
+            (Line**)tryMalloc((graph->num_edges + 1) * sizeof(Line*));
+
+    /* Index the stops by order of creation. */
+    for (i = 0, ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next) {
+
+        graph->stops[i] = (Stop*)ptr->data;
+        graph->stops[i]->index = i;
+        graph->first_edge[i++] = 0;
+    }
+
+    graph->first_edge[graph->num_stops] = 0;
+
+    /* Count the edges leaving each stop. */
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
+
+        line = (Line*)ptr->data;
+
+        for (link_ptr = line->links_list->first; link_ptr != NULL;
+                                                link_ptr = link_ptr->next)
+            graph->first_edge[((Stop*)((Link*)link_ptr->data)->orig)->index]++;
+    }
+
+    /* Turn the counts into the end position of each stop's edges. */
+    for (i = 1; i <= graph->num_stops; i++)
+        graph->first_edge[i] += graph->first_edge[i - 1];
+
+    /* Fill the edges backwards, leaving each stop's first edge in place. */
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
+
+        line = (Line*)ptr->data;
+
+        for (link_ptr = line->links_list->first; link_ptr != NULL;
+                                                link_ptr = link_ptr->next) {
+
+            link = (Link*)link_ptr->data;
+            i = --graph->first_edge[((Stop*)link->orig)->index];
+
+            graph->edge_dest[i] = ((Stop*)link->dest)->index;
+            graph->edge_value[i] = link->value;
+            graph->edge_line[i] = line;
+        }
+    }
+
+    return graph;
+}
+
+/**
+ * Frees all the allocated memory in the given graph. The stops and
+ * lines it refers to are not deleted.
+*/
+void destroyGraph(Graph* graph) {
+
+    free(graph->stops);
+    free(graph->first_edge);
+    free(graph->edge_dest);
+    free(graph->edge_value);
+    free(graph->edge_line);
+    free(graph);
+}
@@ -0,0 +1,923 @@
+/**
+ * IAED-23 Project 2
+ * File: hierarchy.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the route queries,
+ * which find the cheapest journey between two stops (ties broken by the
+ * duration) with a bidirectional search. The search runs over the plain
+ * network or, if it was preprocessed, over its contraction hierarchy.
+*/
+
+#include "main.h"
+
+
+/* ---------------------------- Route functions ----------------------------- */
+
+/**
+ * Shows in the standard output the cheapest journey between the two stops
+ * with the given names, in the same format of the 'j' command. The search
+ * is added to the search statistics.
+*/
+void showRoute(System *sys, char* orig_name, char* dest_name) {
+
+    Stop *orig = getStop(sys, orig_name), *dest = getStop(sys, dest_name);
+    Hierarchy* hier = sys->hierarchy;
+    long int start = latencyClock();
+    int meet, plain;
+
+    if (orig == NULL) {
+        fprintf(sys->out, NO_SUCH_STOP, orig_name);
+        return;
+    } else if (dest == NULL) {
+        fprintf(sys->out, NO_SUCH_STOP, dest_name);
+        return;
+    }
+
+    /* Without preprocessing, the search runs over the plain network. */
+    if (hier == NULL)
+        hier = createHierarchy(sys);
+
+    if (orig == dest) {
+        fprintf(sys->out, "%.2f %.2f: %s\n", 0.00, 0.00, 
+                                                    nameChars(&orig->name));
+    } else if (!isStopInHierarchy(hier, orig) ||
+                !isStopInHierarchy(hier, dest) ||
+                (meet = searchRoute(hier, orig->index, dest->index)) == ERR) {
+        fprintf(sys->out, NO_JOURNEY);
+    } else {
+        printRoute(sys->out, hier, orig->index, dest->index, meet);
+    }
+
+    plain = !hier->contracted;
+    __atomic_add_fetch(&sys->searches->routes[plain], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&sys->searches->settled[plain], hier->settled,
+                                                        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&sys->searches->route_ns[plain],
+                                latencyClock() - start, __ATOMIC_RELAXED);
+
+    if (hier != sys->hierarchy)
+        destroyHierarchy(hier);
+}
+
+/**
+ * Preprocesses the network, replacing the system's contraction hierarchy.
+ * The preprocessing is added to the search statistics.
+*/
+void buildSystemHierarchy(System *sys) {
+
+    long int start = latencyClock();
+
+    invalidateHierarchy(sys);
+    sys->hierarchy = createHierarchy(sys);
+    contractHierarchy(sys->hierarchy);
+
+    sys->searches->builds++;
+    sys->searches->build_ns += latencyClock() - start;
+}
+
+/**
+ * Presents in the 'out' stream the hierarchies built so far, with the size
+ * of the system's hierarchy, if it's up to date (or 0).
+*/
+void printHierarchyStats(FILE* out, System *sys) {
+
+    Hierarchy* hier = sys->hierarchy;
+
+    fprintf(out, HIERARCHY_STATS, sys->searches->builds,
+                hier != NULL ? hier->num_stops : 0,
+                hier != NULL ? hier->num_edges : 0,
+                hier != NULL ? hier->shortcuts : 0,
+                hier != NULL ? hier->memory : 0L,
+                sys->searches->build_ns / 1000000.0);
+}
+
+/**
+ * Discards the system's contraction hierarchy, if there's one. Must be
+ * called whenever the routes of the network change.
+*/
+void invalidateHierarchy(System *sys) {
+
+    if (sys->hierarchy != NULL) {
+        destroyHierarchy(sys->hierarchy);
+        sys->hierarchy = NULL;
+    }
+}
+
+/**
+ * Checks if the given stop existed when the hierarchy was created.
+ * Returns YES if so. Else, returns NO.
+*/
+int isStopInHierarchy(Hierarchy* hier, Stop* stop) {
+
+    if (stop->index >= 0 && stop->index < hier->num_stops &&
+                                        hier->stops[stop->index] == stop)
+        return YES;
+
+    return NO;
+}
+
+
+/* --------------------------- Hierarchy creation --------------------------- */
+
+/**
+ * Creates the hierarchy of the current network, with every link as an edge
+ * and no stop contracted: the forward search goes through every edge leaving
+ * a stop and the backward search through every edge arriving at it. Returns a
+ * pointer to the new hierarchy.
+*/
+Hierarchy* createHierarchy(System *sys) {
+
+    Hierarchy* hier = (Hierarchy*)tryMalloc(sizeof(Hierarchy));
+    Graph* graph = buildGraph(sys);
+    int i, j, num = graph->num_stops;
+
+    hier->num_stops = num;
+    hier->num_edges = 0;
+    hier->size_edges = graph->num_edges + 1;
+    hier->shortcuts = 0;
+    hier->contracted = NO;
+    hier->settled = 0;
+    hier->stops = graph->stops;
+    hier->edges = (HierEdge*)tryMalloc(hier->size_edges * sizeof(HierEdge));
+
+    for (i = 0; i < num; i++) {
+        for (j = graph->first_edge[i]; j < graph->first_edge[i + 1]; j++) {
+
+            /* Loops are never part of a cheapest journey. */
+            if (graph->edge_dest[j] != i)
+                addHierEdge(hier, i, graph->edge_dest[j], graph->edge_value[j],
+                                        graph->edge_line[j], ERR, ERR);
+        }
+    }
+
+    /* The graph's stops are kept by the hierarchy. */
+    graph->stops = NULL;
+    destroyGraph(graph);
+
+    hier->rank = (int*)tryMalloc((num + 1) * sizeof(int));
+    hier->dist = (Values*)tryMalloc(2 * (num + 1) * sizeof(Values));
+    hier->parent = (int*)tryMalloc(2 * (num + 1) * sizeof(int));
+    hier->reached = (int*)tryMalloc(2 * (num + 1) * sizeof(int));
+    hier->queue = createStopQueue(2 * (num + 1));
+    hier->queue_bwd = createStopQueue(2 * (num + 1));
+    hier->search_id = 0;
+
+    for (i = 0; i < num; i++)
+        hier->rank[i] = 0;
+
+    for (i = 0; i < 2 * (num + 1); i++)
+        hier->reached[i] = 0;
+
+    indexHierarchy(hier);
+
+    return hier;
+}
+
+/**
+ * Adds a new edge to the hierarchy. A shortcut replaces the 'first' edge,
+ * arriving at the skipped stop, and the 'second' edge, leaving it. Links have
+ * ERR as both. Returns the index of the new edge.
+*/
+int addHierEdge(Hierarchy* hier, int from, int to, Values value, Line* line,
+                                                    int first, int second) {
+
+    HierEdge* edge;
+
+    if (hier->num_edges == hier->size_edges) {
+        hier->size_edges *= 2;
+        hier->edges = (HierEdge*)tryRealloc(hier->edges,
+                                        hier->size_edges * sizeof(HierEdge));
+    }
+
+    edge = &hier->edges[hier->num_edges];
+    edge->from = from;
+    edge->to = to;
+    edge->value = value;
+    edge->line = line;
+    edge->first = first;
+    edge->second = second;
+
+    return hier->num_edges++;
+}
+
+/**
+ * Groups the edges of the hierarchy by stop for the bidirectional search. The
+ * forward search uses the edges leaving each stop to a higher ranked stop and
+ * the backward search the edges arriving at each stop from a higher ranked
+ * stop. In the plain network, every stop has the same rank.
+*/
+void indexHierarchy(Hierarchy* hier) {
+
+    int i, num = hier->num_stops;
+    HierEdge* edge;
+
+    hier->first_fwd = (int*)tryMalloc((num + 1) * sizeof(int));
+    hier->first_bwd = (int*)tryMalloc((num + 1) * sizeof(int));
+    hier->fwd_edge = (int*)tryMalloc((hier->num_edges + 1) * sizeof(int));
+    hier->bwd_edge = (int*)tryMalloc((hier->num_edges + 1) * sizeof(int));
+
+    for (i = 0; i <= num; i++) {
+        hier->first_fwd[i] = 0;
+        hier->first_bwd[i] = 0;
+    }
+
+    for (i = 0; i < hier->num_edges; i++) {
+
+        edge = &hier->edges[i];
+
+        if (hier->rank[edge->from] <= hier->rank[edge->to])
+            hier->first_fwd[edge->from]++;
+        if (hier->rank[edge->from] >= hier->rank[edge->to])
+            hier->first_bwd[edge->to]++;
+    }
+
+    for (i = 1; i <= num; i++) {
+        hier->first_fwd[i] += hier->first_fwd[i - 1];
+        hier->first_bwd[i] += hier->first_bwd[i - 1];
+    }
+
+    for (i = hier->num_edges - 1; i >= 0; i--) {
+
+        edge = &hier->edges[i];
+
+        if (hier->rank[edge->from] <= hier->rank[edge->to])
+            hier->fwd_edge[--hier->first_fwd[edge->from]] = i;
+        if (hier->rank[edge->from] >= hier->rank[edge->to])
+            hier->bwd_edge[--hier->first_bwd[edge->to]] = i;
+    }
+
+    hier->memory = sizeof(Hierarchy) +
+                    hier->size_edges * sizeof(HierEdge) +
+                    2 * (hier->num_edges + 1) * sizeof(int) +
+                    (num + 1) * (4 * sizeof(int) + sizeof(Stop*)) +
+                    2 * (num + 1) * (sizeof(Values) + 6 * sizeof(int));
+}
+
+/**
+ * Frees all the allocated memory in the given hierarchy. The stops and
+ * lines it refers to are not deleted.
+*/
+void destroyHierarchy(Hierarchy* hier) {
+
+    free(hier->stops);
+    free(hier->edges);
+    free(hier->rank);
+    free(hier->first_fwd);
+    free(hier->first_bwd);
+    free(hier->fwd_edge);
+    free(hier->bwd_edge);
+    free(hier->dist);
+    free(hier->parent);
+    free(hier->reached);
+    destroyStopQueue(hier->queue);
+    destroyStopQueue(hier->queue_bwd);
+    free(hier);
+}
+
+
+/* -------------------------- Hierarchy contraction ------------------------- */
+
+/**
+ * Contracts the stops of the hierarchy one at a time, by increasing order of
+ * importance, adding shortcuts between their remaining neighbours whenever
+ * the cheapest journey goes through them. The importance of a stop is the
+ * number of shortcuts it needs minus its edges, plus the number of its
+ * neighbours already contracted. It is only updated when the stop is about
+ * to be contracted. The stops are ranked by order of contraction. When the
+ * least important stop needs too many shortcuts, the remaining stops are left
+ * uncontracted as the core of the hierarchy, with the highest rank.
+*/
+void contractHierarchy(Hierarchy* hier) {
+
+    int i, stop, to, next_rank = 1, num = hier->num_stops;
+    int* neighbours = (int*)tryMalloc((num + 1) * sizeof(int));
+    Values* priority = (Values*)tryMalloc((num + 1) * sizeof(Values));
+    StopQueue* order = createStopQueue(num + 1);
+
+    /* The edges of each stop are regrouped as edges are added. */
+    hier->out_edges = createEdgeLists(num);
+    hier->in_edges = createEdgeLists(num);
+
+    for (i = 0; i < hier->num_edges; i++)
+        addToEdgeLists(hier, i);
+
+    for (i = 0; i < num; i++) {
+        neighbours[i] = 0;
+        priority[i].cost = contractStop(hier, i, YES);
+        priority[i].duration = i;
+        stopQueuePush(order, i, priority);
+    }
+
+    while ((stop = stopQueuePop(order, priority)) != ERR) {
+
+        /* Lazy update: if the stop became less important, skip it. */
+        priority[stop].cost = contractStop(hier, stop, YES) + neighbours[stop];
+
+        if (order->count > 0 &&
+                compareValues(priority[stop], priority[order->heap[0]]) > 0) {
+            stopQueuePush(order, stop, priority);
+            continue;
+        }
+
+        /* The remaining stops are too connected: they're left as a core. */
+        if (priority[stop].cost - neighbours[stop] > HIER_CORE_BALANCE) {
+            stopQueuePush(order, stop, priority);
+            break;
+        }
+
+        contractStop(hier, stop, NO);
+        hier->rank[stop] = next_rank++;
+
+        /* The neighbours drop their edges to contracted stops. */
+        for (i = 0; i < hier->out_edges[stop].count; i++) {
+            to = hier->edges[hier->out_edges[stop].items[i]].to;
+            neighbours[to]++;
+            dropContractedEdges(hier, &hier->in_edges[to], NO);
+        }
+        for (i = 0; i < hier->in_edges[stop].count; i++) {
+            to = hier->edges[hier->in_edges[stop].items[i]].from;
+            neighbours[to]++;
+            dropContractedEdges(hier, &hier->out_edges[to], YES);
+        }
+    }
+
+    /* The core stops share the highest rank. */
+    while ((stop = stopQueuePop(order, priority)) != ERR)
+        hier->rank[stop] = next_rank;
+
+    destroyEdgeLists(hier->out_edges, num);
+    destroyEdgeLists(hier->in_edges, num);
+    destroyStopQueue(order);
+    free(neighbours);
+    free(priority);
+
+    free(hier->first_fwd);
+    free(hier->first_bwd);
+    free(hier->fwd_edge);
+    free(hier->bwd_edge);
+    hier->contracted = YES;
+    indexHierarchy(hier);
+}
+
+/**
+ * Contracts the given stop, adding a shortcut for each pair of edges through
+ * it with no cheaper (or as cheap) witness journey avoiding it. If 'simulate'
+ * is YES, no shortcut is added. Returns the number of shortcuts needed minus
+ * the number of edges of the stop.
+*/
+int contractStop(Hierarchy* hier, int stop, int simulate) {
+
+    EdgeList *in = &hier->in_edges[stop], *out = &hier->out_edges[stop];
+    HierEdge *first, *second;
+    Values via, limit;
+    int i, j, from, to, balance = 0, count_out = out->count;
+
+    for (i = 0; i < in->count; i++) {
+
+        first = &hier->edges[in->items[i]];
+        from = first->from;
+
+        if (hier->rank[from] != 0)
+            continue; /* Already contracted. */
+
+        balance--;
+
+        /* Longest journey the witness search must look for. */
+        limit.cost = NONE;
+        for (j = 0; j < count_out; j++) {
+
+            second = &hier->edges[out->items[j]];
+            via = addValues(first->value, second->value);
+
+            if (hier->rank[second->to] == 0 && second->to != from &&
+                    (limit.cost == NONE || compareValues(via, limit) > 0))
+                limit = via;
+        }
+
+        if (limit.cost == NONE)
+            continue;
+
+        witnessSearch(hier, from, stop, limit, 
+                        simulate ? HIER_SIMULATE_LIMIT : HIER_SETTLE_LIMIT);
+
+        for (j = 0; j < count_out; j++) {
+
+            second = &hier->edges[out->items[j]];
+            to = second->to;
+            via = addValues(first->value, second->value);
+
+            if (hier->rank[to] != 0 || to == from ||
+                (hier->reached[to] == hier->search_id &&
+                    compareValues(hier->dist[to], via) <= 0))
+                continue; /* There's a witness. */
+
+            balance++;
+
+            if (!simulate) {
+                hier->shortcuts++;
+                addToEdgeLists(hier, addHierEdge(hier, from, to, via, NULL,
+                                                in->items[i], out->items[j]));
+                /* The edges may have been moved. */
+                first = &hier->edges[in->items[i]];
+            }
+        }
+    }
+
+    for (j = 0; j < count_out; j++)
+        if (hier->rank[hier->edges[out->items[j]].to] == 0)
+            balance--;
+
+    return balance;
+}
+
+/**
+ * Searches the cheapest journeys from the given stop through the stops not
+ * yet contracted, avoiding the 'skip' stop. The search stops when the next
+ * journey is more expensive than 'limit' or 'max_settled' stops were settled.
+*/
+void witnessSearch(Hierarchy* hier, int orig, int skip, Values limit, 
+                                                        int max_settled) {
+
+    EdgeList* out;
+    HierEdge* edge;
+    int i, stop, settled = 0;
+
+    startSearch(hier);
+    reachStop(hier, hier->queue, orig, zeroValues(), ERR);
+
+    while ((stop = stopQueuePop(hier->queue, hier->dist)) != ERR) {
+
+        if (compareValues(hier->dist[stop], limit) > 0 ||
+                                            ++settled > max_settled)
+            break;
+
+        out = &hier->out_edges[stop];
+
+        for (i = 0; i < out->count; i++) {
+
+            edge = &hier->edges[out->items[i]];
+
+            if (edge->to != skip && hier->rank[edge->to] == 0)
+                reachStop(hier, hier->queue, edge->to,
+                    addValues(hier->dist[stop], edge->value), out->items[i]);
+        }
+    }
+
+    clearStopQueue(hier->queue);
+}
+
+/**
+ * Removes from the given list of edges the ones whose other stop (the
+ * destination if 'out' is YES, or else the origin) is already contracted.
+*/
+void dropContractedEdges(Hierarchy* hier, EdgeList* list, int out) {
+
+    int i, count = 0;
+    HierEdge* edge;
+
+    for (i = 0; i < list->count; i++) {
+
+        edge = &hier->edges[list->items[i]];
+
+        if (hier->rank[out ? edge->to : edge->from] == 0)
+            list->items[count++] = list->items[i];
+    }
+
+    list->count = count;
+}
+
+/**
+ * Creates an empty list of edges for each of the given number of stops.
+ * Returns a pointer to the lists.
+*/
+EdgeList* createEdgeLists(int num) {
+
+    EdgeList* lists = (EdgeList*)tryMalloc((num + 1) * sizeof(EdgeList));
+    int i;
+
+    for (i = 0; i < num; i++) {
+        lists[i].items = NULL;
+        lists[i].count = 0;
+        lists[i].size = 0;
+    }
+
+    return lists;
+}
+
+/**
+ * Adds the edge with the given index to the edges leaving its origin
+ * and to the edges arriving at its destination.
+*/
+void addToEdgeLists(Hierarchy* hier, int edge) {
+
+    appendEdge(&hier->out_edges[hier->edges[edge].from], edge);
+    appendEdge(&hier->in_edges[hier->edges[edge].to], edge);
+}
+
+/**
+ * Appends the edge index to the given list, doubling its size if it's full.
+*/
+void appendEdge(EdgeList* list, int edge) {
+
+    if (list->count == list->size) {
+        list->size = list->size == 0 ? 4 : list->size * 2;
+        list->items = (int*)tryRealloc(list->items, list->size * sizeof(int));
+    }
+
+    list->items[list->count++] = edge;
+}
+
+/**
+ * Frees all the allocated memory in the given lists of edges.
+*/
+void destroyEdgeLists(EdgeList* lists, int num) {
+
+    int i;
+
+    for (i = 0; i < num; i++)
+        free(lists[i].items);
+
+    free(lists);
+}
+
+
+/* ---------------------------- Route search -------------------------------- */
+
+/**
+ * Bidirectional search of the cheapest journey between the two stops. Each
+ * step settles the closest stop of the forward or backward search. In the
+ * plain network, the search stops when the distances of both searches add up
+ * to the best journey found; in the hierarchy, each search stops when its
+ * distance reaches it. Returns the stop where the journeys of both searches
+ * meet, or ERR if there's none.
+*/
+int searchRoute(Hierarchy* hier, int orig, int dest) {
+
+    int side, meet = ERR, offset = hier->num_stops + 1;
+    StopQueue* queue[2];
+    int done[2];
+    Values best;
+
+    queue[0] = hier->queue;
+    queue[1] = hier->queue_bwd;
+    hier->settled = 0;
+    startSearch(hier);
+    reachStop(hier, queue[0], orig, zeroValues(), ERR);
+    reachStop(hier, queue[1], offset + dest, zeroValues(), ERR);
+
+    while (YES) {
+
+        for (side = 0; side < 2; side++)
+            done[side] = queue[side]->count == 0 || (meet != ERR &&
+                compareValues(hier->dist[queue[side]->heap[0]], best) >= 0);
+
+        if (hier->contracted && done[0] && done[1])
+            break;
+
+        if (!hier->contracted && (queue[0]->count == 0 ||
+                queue[1]->count == 0 || (meet != ERR &&
+                compareValues(addValues(hier->dist[queue[0]->heap[0]],
+                            hier->dist[queue[1]->heap[0]]), best) >= 0)))
+            break;
+
+        /* Settle the closest stop of the searches still running. */
+        side = done[0] || (!done[1] && compareValues(
+                                    hier->dist[queue[1]->heap[0]],
+                                    hier->dist[queue[0]->heap[0]]) < 0);
+
+        relaxRouteEdges(hier, stopQueuePop(queue[side], hier->dist),
+                                                            &meet, &best);
+        hier->settled++;
+    }
+
+    clearStopQueue(queue[0]);
+    clearStopQueue(queue[1]);
+
+    return meet;
+}
+
+/**
+ * Relaxes the edges of the given stop in its search (the backward search
+ * stops are offset by the number of stops), updating the best journey found
+ * and the stop where it meets the other search.
+*/
+void relaxRouteEdges(Hierarchy* hier, int stop, int* meet, Values* best) {
+
+    int i, side, offset = hier->num_stops + 1, end, next, other;
+    int *first, *edges;
+    HierEdge* edge;
+    Values value;
+
+    side = stop >= offset;
+    first = side ? hier->first_bwd : hier->first_fwd;
+    edges = side ? hier->bwd_edge : hier->fwd_edge;
+    end = stop - side * offset;
+
+    /* Journey through the stop itself. */
+    other = side ? end : end + offset;
+    if (hier->reached[other] == hier->search_id) {
+
+        value = addValues(hier->dist[stop], hier->dist[other]);
+
+        if (*meet == ERR || compareValues(value, *best) < 0) {
+            *best = value;
+            *meet = end;
+        }
+    }
+
+    for (i = first[end]; i < first[end + 1]; i++) {
+
+        edge = &hier->edges[edges[i]];
+        next = side ? edge->from : edge->to;
+
+        reachStop(hier, side ? hier->queue_bwd : hier->queue,
+                    next + side * offset,
+                    addValues(hier->dist[stop], edge->value), edges[i]);
+
+        /* Journey through the edge. */
+        other = side ? next : next + offset;
+        if (hier->reached[other] == hier->search_id) {
+
+            value = addValues(hier->dist[next + side * offset],
+                                hier->dist[other]);
+
+            if (*meet == ERR || compareValues(value, *best) < 0) {
+                *best = value;
+                *meet = next;
+            }
+        }
+    }
+}
+
+/**
+ * Shows in the 'out' stream the journey found by the route search, going
+ * backwards from the meeting stop to the origin and then forward to the
+ * destination, unpacking the shortcuts into the links they replaced.
+*/
+void printRoute(FILE* out, Hierarchy* hier, int orig, int dest, int meet) {
+
+    List* path = createList();
+    Values total = zeroValues();
+    int stop, offset = hier->num_stops + 1;
+    Node* ptr;
+    HierEdge* edge;
+
+    for (stop = meet; stop != orig; stop = hier->edges[hier->parent[stop]].from)
+        unpackEdge(hier, path, hier->parent[stop], NO);
+
+    for (stop = meet; stop != dest;
+                        stop = hier->edges[hier->parent[stop + offset]].to)
+        unpackEdge(hier, path, hier->parent[stop + offset], YES);
+
+    for (ptr = path->first; ptr != NULL; ptr = ptr->next)
+        total = addValues(total, ((HierEdge*)ptr->data)->value);
+
+    fprintf(out, "%.2f %.2f: %s", total.cost, total.duration,
+                                nameChars(&hier->stops[orig]->name));
+
+    for (ptr = path->first; ptr != NULL; ptr = ptr->next) {
+
+        edge = (HierEdge*)ptr->data;
+        fprintf(out, " -> %s (%s)", nameChars(&hier->stops[edge->to]->name),
+                                            nameChars(&edge->line->name));
+    }
+
+    putc('\n', out);
+
+    while (path->first != NULL)
+        listRemoveNode(path, path->first);
+
+    listDestroy(path);
+}
+
+/**
+ * Adds the links replaced by the given edge to the journey, either to its
+ * end ('to_end' is YES) or to its beginning.
+*/
+void unpackEdge(Hierarchy* hier, List* path, int edge, int to_end) {
+
+    HierEdge* ptr = &hier->edges[edge];
+
+    if (ptr->first == ERR) {
+
+        if (to_end)
+            append(path, ptr);
+        else
+            push(path, ptr);
+
+    } else if (to_end) {
+
+        unpackEdge(hier, path, ptr->first, YES);
+        unpackEdge(hier, path, ptr->second, YES);
+
+    } else {
+
+        unpackEdge(hier, path, ptr->second, NO);
+        unpackEdge(hier, path, ptr->first, NO);
+    }
+}
+
+
+/* ---------------------------- Search auxiliary ---------------------------- */
+
+/**
+ * Starts a new search: every stop becomes unreached.
+*/
+void startSearch(Hierarchy* hier) {
+
+    int i;
+
+    if (++hier->search_id == HIER_MAX_SEARCH) {
+
+        for (i = 0; i < 2 * (hier->num_stops + 1); i++)
+            hier->reached[i] = 0;
+
+        hier->search_id = 1;
+    }
+}
+
+/**
+ * Reaches the given stop with the given distance through the given edge,
+ * if it wasn't reached yet or the distance is smaller, queueing it in the
+ * given queue.
+*/
+void reachStop(Hierarchy* hier, StopQueue* queue, int stop, Values dist, 
+                                                                int edge) {
+
+    if (hier->reached[stop] == hier->search_id &&
+                                compareValues(dist, hier->dist[stop]) >= 0)
+        return;
+
+    hier->reached[stop] = hier->search_id;
+    hier->dist[stop] = dist;
+    hier->parent[stop] = edge;
+    stopQueuePush(queue, stop, hier->dist);
+}
+
+/**
+ * Compares two values by their cost and, if tied, by their duration. Returns
+ * a negative value if the first value comes first, 0 if they're tied or a
+ * positive value if the second value comes first.
+*/
+int compareValues(Values first, Values second) {
+
+    int result = compareDoubles(first.cost, second.cost);
+
+    if (result != 0)
+        return result;
+
+    return compareDoubles(first.duration, second.duration);
+}
+
+/**
+ * Compares two doubles. Doubles closer than the rounding errors of adding
+ * them up in a different order are tied. Returns -1 if the first is smaller,
+ * 0 if they're tied or 1 if the second is smaller.
+*/
+int compareDoubles(double first, double second) {
+
+    double diff = first - second;
+    double tolerance = VALUES_EPSILON * 
+                    ((first < 0 ? -first : first) + 
+                    (second < 0 ? -second : second) + 1.00);
+
+    if (diff > tolerance)
+        return 1;
+
+    if (diff < -tolerance)
+        return -1;
+
+    return 0;
+}
+
+/**
+ * Returns the sum of the two given values.
+*/
+Values addValues(Values first, Values second) {
+
+    first.cost += second.cost;
+    first.duration += second.duration;
+
+    return first;
+}
+
+/**
+ * Returns a value with no cost and no duration.
+*/
+Values zeroValues() {
+
+    Values value;
+
+    value.cost = 0.00;
+    value.duration = 0.00;
+
+    return value;
+}
+
+
+/* ------------------------------- Stop queue ------------------------------- */
+
+/**
+ * Creates a new empty queue for the given number of stops. The queue is a
+ * binary heap of stop indexes ordered by a given array of values, which
+ * knows the position of each stop, so that the stop can be moved up when
+ * its value decreases. Returns a pointer to the new queue.
+*/
+StopQueue* createStopQueue(int num) {
+
+    StopQueue* queue = (StopQueue*)tryMalloc(sizeof(StopQueue));
+    int i;
+
+    queue->heap = (int*)tryMalloc(num * sizeof(int));
+    queue->pos = (int*)tryMalloc(num * sizeof(int));
+    queue->count = 0;
+
+    for (i = 0; i < num; i++)
+        queue->pos[i] = ERR;
+
+    return queue;
+}
+
+/**
+ * Inserts the given stop in the queue, or moves it up if it's already
+ * there, given the values of the stops.
+*/
+void stopQueuePush(StopQueue* queue, int stop, Values* values) {
+
+    int i = queue->pos[stop], parent;
+
+    if (i == ERR)
+        i = queue->count++;
+
+    for (; i > 0; i = parent) {
+
+        parent = (i - 1) / 2;
+
+        if (compareValues(values[queue->heap[parent]], values[stop]) <= 0)
+            break;
+
+        queue->heap[i] = queue->heap[parent];
+        queue->pos[queue->heap[i]] = i;
+    }
+
+    queue->heap[i] = stop;
+    queue->pos[stop] = i;
+}
+
+/**
+ * Removes the stop with the smallest value from the queue, returning it.
+ * If the queue is empty, returns ERR.
+*/
+int stopQueuePop(StopQueue* queue, Values* values) {
+
+    int top, last, i = 0, child;
+
+    if (queue->count == 0)
+        return ERR;
+
+    top = queue->heap[0];
+    last = queue->heap[--queue->count];
+    queue->pos[top] = ERR;
+
+    if (queue->count == 0)
+        return top;
+
+    while ((child = 2 * i + 1) < queue->count) {
+
+        if (child + 1 < queue->count && compareValues(
+                values[queue->heap[child + 1]], values[queue->heap[child]]) < 0)
+            child++;
+
+        if (compareValues(values[last], values[queue->heap[child]]) <= 0)
+            break;
+
+        queue->heap[i] = queue->heap[child];
+        queue->pos[queue->heap[i]] = i;
+        i = child;
+    }
+
+    queue->heap[i] = last;
+    queue->pos[last] = i;
+
+    return top;
+}
+
+/**
+ * Removes every stop from the queue.
+*/
+void clearStopQueue(StopQueue* queue) {
+
+    while (queue->count > 0)
+        queue->pos[queue->heap[--queue->count]] = ERR;
+}
+
+/**
+ * Frees all the allocated memory in the given queue.
+*/
+void destroyStopQueue(StopQueue* queue) {
+
+    free(queue->heap);
+    free(queue->pos);
+    free(queue);
+}
@@ -0,0 +1,697 @@
+/**
+ * IAED-23 Project 2
+ * File: import.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the bulk import of a
+ * network dump (a file of 'p', 'c' and 'l' commands). The dump is parsed in
+ * parallel, its stops and lines are created in order, the route of each line
+ * is built by a work-stealing pool and the stops' lines are merged at the
+ * end. The result, messages included, is the same as running the commands.
+*/
+
+/* The messages of each thread go to a memory stream (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/* ------------------------------ Bulk import ------------------------------- */
+
+/**
+ * Imports the network dump in the file with the given name, as if its
+ * commands were read from the standard input. A dump with other commands,
+ * or that would show a line, is run one command at a time. Returns 0 if the
+ * program should exit, or 1 otherwise.
+*/
+int importDump(System *sys, char* file_name) {
+
+    char* text = readDump(file_name);
+    Import* import;
+    int more = 1;
+
+    if (text == NULL) {
+        fprintf(sys->out, NO_SUCH_FILE, file_name);
+        return more;
+    }
+
+    import = createImport(sys, text);
+
+    if (!sys->batch && parseDump(import) && checkNewLines(import)) {
+
+        planImport(import);
+        runStealing(import->num_threads, import->num_lines, linkLineTask,
+                                                                    import);
+        runStealing(import->num_threads, import->num_threads, memberTask,
+                                                                    import);
+        writeImportMessages(import);
+
+    } else {
+
+        /* Parsing changed the dump, so it's read again. */
+        text = readDump(file_name);
+        more = replayDump(sys, text);
+        free(text);
+    }
+
+    destroyImport(import);
+
+    return more;
+}
+
+/**
+ * Reads the whole file with the given name. Returns its contents, ending in
+ * '\0', or NULL if it can't be read.
+*/
+char* readDump(char* file_name) {
+
+    FILE* file = fopen(file_name, "rb");
+    char* text;
+    long int size;
+
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    text = (char*)tryMalloc(size + 1);
+    size = fread(text, 1, size, file);
+    text[size] = '\0';
+    fclose(file);
+
+    return text;
+}
+
+/**
+ * Runs the commands of the given dump one at a time. Returns 0 if the
+ * program should exit, or 1 otherwise.
+*/
+int replayDump(System *sys, char* text) {
+
+    char* input = sys->input;
+    int more = runCommandLine(sys, text);
+
+    sys->input = input;
+
+    return more;
+}
+
+/**
+ * Creates a new bulk import of the given dump, split in chunks of whole
+ * lines, and returns its respective pointer.
+*/
+Import* createImport(System *sys, char* text) {
+
+    Import* import = (Import*)tryMalloc(sizeof(Import));
+    long int size = strlen(text), start, end;
+    int i;
+
+    import->sys = sys;
+    import->text = text;
+    import->num_chunks = size / IMPORT_CHUNK_SIZE + 1;
+    import->chunks = (char**)tryMalloc((import->num_chunks + 1) *
+                                                            sizeof(char*));
+
+    for (i = 0, start = 0; i < import->num_chunks; i++, start = end) {
+
+        end = start + IMPORT_CHUNK_SIZE < size ? start + IMPORT_CHUNK_SIZE :
+                                                                        size;
+        while (end < size && text[end - 1] != '\n')
+            end++;
+
+        import->chunks[i] = text + start;
+    }
+
+    import->chunks[i] = text + size;
+    import->records = (ImportRecord**)tryMalloc(import->num_chunks *
+                                                    sizeof(ImportRecord*));
+    import->num_records = (int*)tryMalloc(import->num_chunks * sizeof(int));
+    import->simple = YES;
+
+    for (i = 0; i < import->num_chunks; i++) {
+        import->records[i] = NULL;
+        import->num_records[i] = 0;
+    }
+
+    import->num_lines = 0;
+    import->size_lines = 0;
+    import->links = NULL;
+    import->num_links = NULL;
+
+    import->num_threads = sys->workers != NULL ? sys->workers->num_threads : 1;
+    import->streams = NULL;
+    import->outputs = NULL;
+    import->lengths = NULL;
+
+    return import;
+}
+
+/**
+ * Parses every chunk of the dump with the work-stealing pool. Returns YES
+ * if every command can be imported in bulk, or NO otherwise.
+*/
+int parseDump(Import* import) {
+
+    runStealing(import->num_threads, import->num_chunks, parseChunkTask,
+                                                                    import);
+
+    return import->simple;
+}
+
+/**
+ * Parses the commands of the given chunk of the dump into its records.
+ * Run by the work-stealing pool.
+*/
+void parseChunkTask(void* data, int chunk, int thread) {
+
+    Import* import = data;
+    char *ptr, *line, *end = import->chunks[chunk + 1];
+    ImportRecord* records;
+    int count = 0, i;
+
+    (void)thread;
+
+    for (ptr = import->chunks[chunk]; ptr < end; ptr++)
+        if (*ptr == '\n' || ptr + 1 == end)
+            count++;
+
+    records = (ImportRecord*)tryMalloc((count + 1) * sizeof(ImportRecord));
+    import->records[chunk] = records;
+    import->num_records[chunk] = count;
+
+    /* The arguments are written over the dump, so each line is found
+       before it's parsed. */
+    for (i = 0, ptr = import->chunks[chunk]; i < count; i++) {
+
+        line = ptr;
+
+        while (ptr < end && *ptr != '\n')
+            ptr++;
+        ptr++;
+
+        if (!parseDumpLine(line, &records[i]))
+            __atomic_store_n(&import->simple, NO, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Parses the given line of the dump into the given record, like the
+ * command handlers would read it. Returns NO if the command can't be
+ * imported in bulk, or YES otherwise.
+*/
+int parseDumpLine(char* line, ImportRecord* record) {
+
+    char* ptr = line + 1;
+    char* args[5];
+    int i, more;
+
+    record->kind = 0;
+    record->link = NULL;
+    record->line = NULL;
+    record->num_members = 0;
+    record->stream = 0;
+    record->message = 0;
+    record->length = 0;
+
+    switch (line[0]) {
+
+        case '\n':
+            return YES; /* Ignored, like undefined commands. */
+
+        case 'p':
+            if (line[1] == '\n' || line[1] == '\0')
+                return NO;
+
+            ptr = line + 2;
+
+            if (scanArg(&ptr, &record->name) != 1 ||
+                                        (more = scanArg(&ptr, &args[0])) == ERR)
+                return NO;
+
+            if (more == 0)
+                return YES; /* Without a longitude, nothing happens. */
+
+            if (scanArg(&ptr, &args[1]) != 0)
+                return NO;
+
+            record->kind = 'p';
+            record->first = atof(args[0]);
+            record->second = atof(args[1]);
+            return YES;
+
+        case 'c':
+            if (line[1] == '\n' || line[1] == '\0')
+                return NO;
+
+            ptr = line + 2;
+
+            if (scanArg(&ptr, &record->name) != 0)
+                return NO;
+
+            record->kind = 'c';
+            return YES;
+
+        case 'l':
+            for (i = 0; i < 5; i++) {
+
+                more = scanArg(&ptr, &args[i]);
+
+                if (more == ERR || (more == 1 && i == 4))
+                    return NO;
+
+                if (more == 0 && i < 4)
+                    return YES; /* Without every argument, nothing happens. */
+            }
+
+            record->kind = 'l';
+            record->name = args[0];
+            record->orig = args[1];
+            record->dest = args[2];
+            record->first = atof(args[3]);
+            record->second = atof(args[4]);
+            return YES;
+
+        default:
+            return NO;
+    }
+}
+
+/**
+ * Reads an argument of a line of the dump like 'getArg', from the position
+ * in 'ptr', which moves past it. The argument is written over the dump and
+ * kept in 'arg'. Returns 0 if the line ended, 1 if it didn't, or ERR if
+ * the argument goes past the line.
+*/
+int scanArg(char** ptr, char** arg) {
+
+    char *read = *ptr, *write;
+    char c;
+
+    while (isspace(*read) && *read != '\n')
+        read++;
+
+    write = *arg = read;
+
+    /* Argument can contain white spaces */
+    if (*read == '"') {
+
+        for (read++; *read != '"'; read++) {
+
+            if (*read == '\n' || *read == '\0')
+                return ERR;
+
+            *write++ = *read;
+        }
+
+        read++;
+        *write = '\0';
+
+    } else {
+
+        while (!isspace(*read) && *read != '\0')
+            read++;
+    }
+
+    /* The character after the argument is read as well. */
+    if ((c = *read) == '\0')
+        return ERR;
+
+    *read = '\0';
+    *ptr = read + 1;
+
+    return c == '\n' ? 0 : 1;
+}
+
+/**
+ * Checks that the lines created by the dump don't exist yet and aren't
+ * repeated, since otherwise they would be shown. Returns YES if so, or NO
+ * otherwise.
+*/
+int checkNewLines(Import* import) {
+
+    char** names;
+    int i, j, count = 0, ok = YES;
+
+    for (i = 0; i < import->num_chunks; i++)
+        for (j = 0; j < import->num_records[i]; j++)
+            if (import->records[i][j].kind == 'c')
+                count++;
+
+    names = (char**)tryMalloc((count + 1) * sizeof(char*));
+
+    for (i = 0, count = 0; i < import->num_chunks; i++)
+        for (j = 0; j < import->num_records[i]; j++)
+            if (import->records[i][j].kind == 'c')
+                names[count++] = import->records[i][j].name;
+
+    qsort(names, count, sizeof(char*), compareNames);
+
+    for (i = 0; i < count && ok; i++)
+        if (getLine(import->sys, names[i]) != NULL ||
+                            (i > 0 && strcmp(names[i - 1], names[i]) == 0))
+            ok = NO;
+
+    free(names);
+
+    return ok;
+}
+
+/**
+ * Compares two names alphabetically, given pointers to them.
+*/
+int compareNames(const void* first, const void* second) {
+
+    return strcmp(*(char**)first, *(char**)second);
+}
+
+/**
+ * Creates the stops and lines of the dump in order, and finds the line
+ * and stops of each link, keeping the messages of each command. The links
+ * of each line are gathered in order.
+*/
+void planImport(Import* import) {
+
+    System* sys = import->sys;
+    FILE* out = sys->out;
+    ImportRecord* record;
+    Link* link;
+    int i, j;
+
+    import->streams = (FILE**)tryMalloc((import->num_threads + 1) *
+                                                            sizeof(FILE*));
+    import->outputs = (char**)tryMalloc((import->num_threads + 1) *
+                                                            sizeof(char*));
+    import->lengths = (size_t*)tryMalloc((import->num_threads + 1) *
+                                                            sizeof(size_t));
+
+    for (i = 0; i <= import->num_threads; i++)
+        import->streams[i] = open_memstream(&import->outputs[i],
+                                                        &import->lengths[i]);
+
+    sys->out = import->streams[import->num_threads];
+
+    for (i = 0; i < import->num_chunks; i++) {
+        for (j = 0; j < import->num_records[i]; j++) {
+
+            record = &import->records[i][j];
+            record->stream = import->num_threads;
+            record->message = ftell(sys->out);
+
+            if (record->kind == 'p') {
+
+                addStop(sys, record->name, record->first, record->second);
+
+            } else if (record->kind == 'c') {
+
+                addLine(sys, record->name);
+
+            } else if (record->kind == 'l') {
+
+                link = (Link*)tagMalloc(sizeof(Link), MEM_LINK);
+
+                if (checkLinkArgsOK(sys, link, record->name, record->orig,
+                                                    record->dest) != NULL) {
+
+                    invalidateHierarchy(sys);
+                    link->value.cost = record->first;
+                    link->value.duration = record->second;
+                    record->link = link;
+                    record->line = (Line*)link->line;
+                    addImportLink(import, record);
+
+                } else {
+
+                    tagFree(link, sizeof(Link), MEM_LINK);
+                }
+            }
+
+            record->length = ftell(sys->out) - record->message;
+        }
+    }
+
+    sys->out = out;
+}
+
+/**
+ * Adds the given record to the links of its line, creating a task for
+ * the line if it has none yet.
+*/
+void addImportLink(Import* import, ImportRecord* record) {
+
+    Line* line = record->line;
+    int task = line->task, count;
+
+    if (task == ERR) {
+
+        if (import->num_lines == import->size_lines) {
+
+            import->size_lines = import->size_lines * 2 + 1;
+            import->links = (ImportRecord***)tryRealloc(import->links,
+                            import->size_lines * sizeof(ImportRecord**));
+            import->num_links = (int*)tryRealloc(import->num_links,
+                                        import->size_lines * sizeof(int));
+        }
+
+        task = line->task = import->num_lines++;
+        import->links[task] = NULL;
+        import->num_links[task] = 0;
+    }
+
+    /* The links of a line double when their number is a power of 2. */
+    count = import->num_links[task];
+
+    if ((count & (count - 1)) == 0)
+        import->links[task] = (ImportRecord**)tryRealloc(import->links[task],
+                                    (count * 2 + 1) * sizeof(ImportRecord*));
+
+    import->links[task][import->num_links[task]++] = record;
+}
+
+/**
+ * Adds the links of the given line task to the line's route, in order,
+ * keeping the stops to associate with the line in each record. Run by the
+ * work-stealing pool.
+*/
+void linkLineTask(void* data, int task, int thread) {
+
+    Import* import = data;
+    System view = *import->sys;
+    ImportRecord* record;
+    int i;
+
+    view.out = import->streams[thread];
+
+    for (i = 0; i < import->num_links[task]; i++) {
+
+        record = import->links[task][i];
+        view.importing = record;
+
+        record->stream = thread;
+        record->message = ftell(view.out);
+        addLink(&view, record->link);
+        record->length = ftell(view.out) - record->message;
+    }
+}
+
+/**
+ * Associates the lines of the imported links with the stops of the given
+ * part, in the order of the dump. Each part has the stops whose order of
+ * creation leaves that remainder. Run by the work-stealing pool.
+*/
+void memberTask(void* data, int part, int thread) {
+
+    Import* import = data;
+    ImportRecord* record;
+    int i, j, k;
+
+    (void)thread;
+
+    for (i = 0; i < import->num_chunks; i++) {
+        for (j = 0; j < import->num_records[i]; j++) {
+
+            record = &import->records[i][j];
+
+            for (k = 0; k < record->num_members; k++)
+                if ((int)(record->members[k]->order % import->num_threads) ==
+                                                                        part)
+                    addLineToStop(import->sys, record->line,
+                                                    record->members[k]);
+        }
+    }
+}
+
+/**
+ * Writes the messages of the imported commands to the output, in order.
+*/
+void writeImportMessages(Import* import) {
+
+    ImportRecord* record;
+    int i, j;
+
+    for (i = 0; i <= import->num_threads; i++)
+        fclose(import->streams[i]);
+
+    for (i = 0; i < import->num_chunks; i++) {
+        for (j = 0; j < import->num_records[i]; j++) {
+
+            record = &import->records[i][j];
+
+            if (record->length > 0)
+                fwrite(import->outputs[record->stream] + record->message, 1,
+                                        record->length, import->sys->out);
+        }
+    }
+}
+
+/**
+ * Frees all the allocated memory in the given bulk import, including
+ * the dump.
+*/
+void destroyImport(Import* import) {
+
+    int i;
+
+    for (i = 0; i < import->num_lines; i++) {
+        import->links[i][0]->line->task = ERR;
+        free(import->links[i]);
+    }
+
+    for (i = 0; i < import->num_chunks; i++)
+        free(import->records[i]);
+
+    if (import->outputs != NULL)
+        for (i = 0; i <= import->num_threads; i++)
+            free(import->outputs[i]);
+
+    free(import->links);
+    free(import->num_links);
+    free(import->streams);
+    free(import->outputs);
+    free(import->lengths);
+    free(import->records);
+    free(import->num_records);
+    free(import->chunks);
+    free(import->text);
+    free(import);
+}
+
+
+/* ----------------------------- Work stealing ------------------------------ */
+
+/**
+ * Runs the given number of tasks with the given number of threads, the
+ * main one included. Each thread starts with a block of tasks, taken from
+ * its end, and then steals the first tasks left to the other threads.
+ * The function 'run' receives the data, the task and the thread.
+*/
+void runStealing(int num_threads, int num_tasks,
+                            void (*run)(void*, int, int), void* data) {
+
+    StealPool pool;
+    StealThread* threads;
+    int i, t;
+
+    if (num_tasks == 0)
+        return;
+
+    pool.num_threads = num_threads;
+    pool.run = run;
+    pool.data = data;
+    pool.deques = (TaskDeque*)tryMalloc(num_threads * sizeof(TaskDeque));
+    threads = (StealThread*)tryMalloc(num_threads * sizeof(StealThread));
+
+    for (t = 0; t < num_threads; t++) {
+
+        TaskDeque* deque = &pool.deques[t];
+        int first = (long int)num_tasks * t / num_threads;
+        int last = (long int)num_tasks * (t + 1) / num_threads;
+
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->tasks = (int*)tryMalloc((last - first + 1) * sizeof(int));
+        deque->top = 0;
+        deque->bottom = last - first;
+
+        for (i = first; i < last; i++)
+            deque->tasks[i - first] = i;
+
+        threads[t].pool = &pool;
+        threads[t].index = t;
+    }
+
+    for (t = 1; t < num_threads; t++)
+        pthread_create(&threads[t].thread, NULL, stealThread, &threads[t]);
+
+    stealThread(&threads[0]);
+
+    for (t = 1; t < num_threads; t++)
+        pthread_join(threads[t].thread, NULL);
+
+    for (t = 0; t < num_threads; t++) {
+        pthread_mutex_destroy(&pool.deques[t].lock);
+        free(pool.deques[t].tasks);
+    }
+
+    free(pool.deques);
+    free(threads);
+}
+
+/**
+ * Runs the tasks of the pool until there are none left, first its own and
+ * then stolen ones. Run by each thread of a work-stealing pool.
+*/
+void* stealThread(void* arg) {
+
+    StealThread* self = arg;
+    StealPool* pool = self->pool;
+    int task;
+
+    while ((task = popTask(&pool->deques[self->index])) != ERR ||
+                                (task = stealTask(pool, self->index)) != ERR)
+        pool->run(pool->data, task, self->index);
+
+    return NULL;
+}
+
+/**
+ * Takes the last task of the given deque. Returns the task, or ERR if the
+ * deque is empty.
+*/
+int popTask(TaskDeque* deque) {
+
+    int task = ERR;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom > deque->top)
+        task = deque->tasks[--deque->bottom];
+
+    pthread_mutex_unlock(&deque->lock);
+
+    return task;
+}
+
+/**
+ * Steals the first task of another thread's deque, trying each one after
+ * the given thread's. Returns the task, or ERR if every deque is empty.
+*/
+int stealTask(StealPool* pool, int thread) {
+
+    TaskDeque* deque;
+    int i, task = ERR;
+
+    for (i = 1; i < pool->num_threads && task == ERR; i++) {
+
+        deque = &pool->deques[(thread + i) % pool->num_threads];
+
+        pthread_mutex_lock(&deque->lock);
+
+        if (deque->bottom > deque->top)
+            task = deque->tasks[deque->top++];
+
+        pthread_mutex_unlock(&deque->lock);
+    }
+
+    return task;
+}
@@ -11,12 +11,29 @@
 
 /* ----------------------------- Input functions ---------------------------- */
 
+/**
+ * Reads the next character of the command line read ahead, if there is
+ * one, or else of the standard input. Returns EOF at the end of the input.
+*/
+int nextChar(System* sys) {
+
+    if (sys->input != NULL) {
+
+        if (*sys->input != '\0')
+            return (unsigned char)*sys->input++;
+
+        sys->input = NULL;
+    }
+
+    return getchar();
+}
+
 /**
  * Indicates the end of input. If an '\n' is read, return NO. Else, return YES.
 */
 int hasArgs(System* sys) {
 
-    int c = getchar();
+    int c = nextChar(sys);
 
     sys->command_lenght--;
 
@@ -41,7 +58,7 @@ int getArgWithSpaces(System* sys, char* str) {
 
     sys->command_lenght--; 
 
-    while ((c = getchar()) != '"' && i < len) {
+    while ((c = nextChar(sys)) != '"' && i < len) {
 
         str[i++] = c; 
         sys->command_lenght--; 
@@ -78,7 +95,7 @@ int getArgWithNoSpaces(System* sys, char* str, int ch) {
 
         str[i++] = ch;
         sys->command_lenght--;
-        ch = getchar();
+        ch = nextChar(sys);
     }
 
     str[i] = '\0';
@@ -100,13 +117,13 @@ int getArgWithNoSpaces(System* sys, char* str, int ch) {
 */
 int getArg(System* sys, char* string) {
 
-    int c = getchar(), result;
+    int c = nextChar(sys), result;
     
     /* If white spaces are read */
     while(isspace(c) && c != '\n') {
         
         sys->command_lenght--;    
-        c = getchar(); 
+        c = nextChar(sys); 
     }
 
     /* Argument can contain white spaces */
@@ -0,0 +1,566 @@
+/**
+ * IAED-23 Project 2
+ * File: journal.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the journal, where
+ * every command that changes the network ('c' and 'p' adding, 'l', 'r',
+ * 'e' and 'a') is written in a compact binary form. Every so many commands
+ * a checkpoint saves a snapshot and empties the journal, so the network is
+ * recovered by loading the snapshot and running the commands after it.
+*/
+
+/* The journal is synced to the disk and its commands kept in a memory
+   stream when they're run again (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/* -------------------------------- Journal --------------------------------- */
+
+/**
+ * Opens the journal with the given name, recovering the network it holds
+ * into the system: its last checkpoint is loaded and the commands after it
+ * are run. Returns a pointer to the journal, or NULL if the network can't
+ * be recovered whole or the journal can't be written.
+*/
+Journal* openJournal(System *sys, char* file_name) {
+
+    Journal* journal = (Journal*)tryMalloc(sizeof(Journal));
+    struct timespec start, end;
+    long int replayed;
+    int recovered;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    journal->name = (char*)tryMalloc(strlen(file_name) + 1);
+    strcpy(journal->name, file_name);
+    journal->snapshot = (char*)tryMalloc(strlen(file_name) +
+                                            strlen(JOURNAL_SNAPSHOT) + 1);
+    strcat(strcpy(journal->snapshot, file_name), JOURNAL_SNAPSHOT);
+
+    journal->record = (char*)tryMalloc(JOURNAL_RECORD_SIZE);
+    journal->record_size = JOURNAL_RECORD_SIZE;
+    journal->length = 0;
+    journal->pending = 0;
+    journal->since_checkpoint = 0;
+    journal->group_size = JOURNAL_GROUP;
+    journal->checkpoint_every = JOURNAL_CHECKPOINT;
+    journal->written = 0;
+    journal->syncs = 0;
+    journal->checkpoints = 0;
+    journal->base = JOURNAL_NO_SNAPSHOT;
+    journal->file = NULL;
+
+    /* Errors go with the statistics, since the input isn't read yet. */
+    sys->out = stderr;
+    recovered = recoverJournal(sys, journal, &replayed);
+    sys->out = stdout;
+
+    if (!recovered || journal->file == NULL) {
+        fprintf(stderr, recovered ? CANT_WRITE : CANT_RECOVER, file_name);
+
+        if (journal->file != NULL)
+            fclose(journal->file);
+
+        destroyJournal(journal);
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, JOURNAL_STATS, replayed, (end.tv_sec - start.tv_sec) *
+                        1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+
+    return journal;
+}
+
+/**
+ * Loads the checkpoint of the journal, if there is one, and runs the
+ * commands after it, storing their number in 'replayed'. The journal file
+ * is then opened to append the next commands. It is only emptied when it
+ * holds no command, or when the checkpoint was saved over all of them but
+ * the program stopped before emptying it. Returns YES if the network was
+ * recovered, or NO if the checkpoint can't be loaded or the journal doesn't
+ * follow it, and then the journal is left as it is.
+*/
+int recoverJournal(System *sys, Journal* journal, long int* replayed) {
+
+    SnapshotHeader snapshot;
+    JournalHeader* header;
+    long int size, valid;
+    int checkpoint = access(journal->snapshot, F_OK) == 0;
+    char* data;
+
+    *replayed = 0;
+
+    if (checkpoint) {
+
+        if (!readSnapshotHeader(journal->snapshot, &snapshot) ||
+                                    !loadSnapshot(sys, journal->snapshot))
+            return NO;
+
+        journal->base = snapshot.checksum;
+    }
+
+    if (access(journal->name, F_OK) != 0) {
+        journal->file = startJournal(journal);
+        return YES;
+    }
+
+    if ((data = readJournal(journal->name, &size)) == NULL)
+        return NO;
+
+    header = (JournalHeader*)data;
+
+    /* Cut short before its header, the journal holds no command. */
+    if (size < (long int)sizeof(JournalHeader)) {
+        free(data);
+        journal->file = startJournal(journal);
+        return YES;
+    }
+
+    if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) != 0 ||
+                                header->version != JOURNAL_VERSION ||
+                                header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        free(data);
+        return NO;
+    }
+
+    if (header->base == journal->base) {
+
+        *replayed = replayJournal(sys, data, size, &valid);
+        free(data);
+
+        /* A command cut short by a crash is dropped. */
+        if (truncate(journal->name, valid) != 0)
+            return NO;
+
+        journal->file = fopen(journal->name, "ab");
+        return YES;
+    }
+
+    /* The checkpoint already holds the commands of an older journal. */
+    if (checkpoint && header->base == snapshot.covers) {
+        free(data);
+        journal->file = startJournal(journal);
+        return YES;
+    }
+
+    free(data);
+    return NO;
+}
+
+/**
+ * Empties the journal, writing a header that follows its last checkpoint.
+ * Returns the journal file, or NULL if it can't be written. The journal
+ * must hold no command the checkpoint doesn't.
+*/
+FILE* startJournal(Journal* journal) {
+
+    FILE* file = fopen(journal->name, "wb");
+    JournalHeader header;
+
+    if (file == NULL)
+        return NULL;
+
+    memset(&header, 0, sizeof(JournalHeader));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.base = journal->base;
+
+    if (fwrite(&header, sizeof(JournalHeader), 1, file) != 1 ||
+                        fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+/**
+ * Runs the commands of the journal in 'data', with the given size, after
+ * its header, with their output discarded. Stores in 'valid' the size of
+ * the journal up to its last whole command. Returns the number of commands
+ * run.
+*/
+long int replayJournal(System *sys, char* data, long int size,
+                                                        long int* valid) {
+
+    JournalRecord record;
+    char *output, *ptr, *end = data + size;
+    FILE* out = sys->out;
+    size_t length;
+    long int count = 0;
+
+    sys->out = open_memstream(&output, &length);
+
+    for (ptr = data + sizeof(JournalHeader); end - ptr >=
+                                    (long int)sizeof(JournalRecord); count++) {
+
+        memcpy(&record, ptr, sizeof(JournalRecord));
+
+        if (record.length > (unsigned long)(end - ptr) - sizeof(JournalRecord)
+                    || checksumBytes(SNAPSHOT_FNV_BASIS, ptr +
+                        sizeof(JournalRecord), record.length) != record.checksum
+                    || !replayRecord(sys, ptr + sizeof(JournalRecord),
+                                                            record.length))
+            break;
+
+        ptr += sizeof(JournalRecord) + record.length;
+    }
+
+    fclose(sys->out);
+    free(output);
+    sys->out = out;
+
+    *valid = ptr - data;
+
+    return count;
+}
+
+/**
+ * Reads the whole journal with the given name, storing its size in 'size'.
+ * Returns its contents, or NULL if it can't be read.
+*/
+char* readJournal(char* file_name, long int* size) {
+
+    FILE* file = fopen(file_name, "rb");
+    char* data;
+
+    *size = 0;
+
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = (char*)tryMalloc(*size + 1);
+    *size = fread(data, 1, *size, file);
+    fclose(file);
+
+    return data;
+}
+
+/**
+ * Runs the command in the given record of the journal, like its handler.
+ * Returns YES if it was run, or NO if the record is damaged.
+*/
+int replayRecord(System *sys, char* data, unsigned long length) {
+
+    char *end = data + length, *name, command;
+    double values[2];
+
+    if (length == 0)
+        return NO;
+
+    command = *data++;
+
+    if (command == 'l')
+        return replayLink(sys, data, end);
+
+    if (command == 'a') {
+        invalidateHierarchy(sys);
+        clearSystem(sys);
+        return YES;
+    }
+
+    if ((name = takeName(&data, end)) == NULL)
+        return NO;
+
+    switch (command) {
+
+        case 'c': addShowLine(sys, name, NO);
+            return YES;
+        case 'p': if (!takeValues(&data, end, values))
+                return NO;
+            addStop(sys, name, values[0], values[1]);
+            return YES;
+        case 'r': invalidateHierarchy(sys);
+            removeLine(sys, name);
+            return YES;
+        case 'e': invalidateHierarchy(sys);
+            removeStop(sys, name);
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+/**
+ * Runs the 'l' command in the given record data, like its handler.
+ * Returns YES if it was run, or NO if the record is damaged.
+*/
+int replayLink(System *sys, char* data, char* end) {
+
+    char *line, *orig, *dest;
+    double values[2];
+    Link* new_link;
+
+    if ((line = takeName(&data, end)) == NULL ||
+                                (orig = takeName(&data, end)) == NULL ||
+                                (dest = takeName(&data, end)) == NULL ||
+                                !takeValues(&data, end, values))
+        return NO;
+
+    new_link = (Link*)tagMalloc(sizeof(Link), MEM_LINK);
+
+    if (checkLinkArgsOK(sys, new_link, line, orig, dest) == NULL) {
+        tagFree(new_link, sizeof(Link), MEM_LINK);
+        return YES;
+    }
+
+    new_link->value.cost = values[0];
+    new_link->value.duration = values[1];
+
+    invalidateHierarchy(sys);
+    refreshLineValues(sys, (Line*)new_link->line);
+    addLink(sys, new_link);
+
+    return YES;
+}
+
+/**
+ * Takes a name, ending in '\0', from the record data at 'ptr', moving past
+ * it. Returns the name, or NULL if it doesn't end before 'end'.
+*/
+char* takeName(char** ptr, char* end) {
+
+    char* name = *ptr;
+
+    while (*ptr < end && **ptr != '\0')
+        (*ptr)++;
+
+    if (*ptr == end)
+        return NULL;
+
+    (*ptr)++;
+
+    return name;
+}
+
+/**
+ * Takes two values from the record data at 'ptr' into 'values', moving
+ * past them. Returns YES if they end before 'end', or NO otherwise.
+*/
+int takeValues(char** ptr, char* end, double values[2]) {
+
+    if (end - *ptr < (long int)(2 * sizeof(double)))
+        return NO;
+
+    memcpy(values, *ptr, 2 * sizeof(double));
+    *ptr += 2 * sizeof(double);
+
+    return YES;
+}
+
+/**
+ * Writes the command with the given letter and name (a 'c' adding a line,
+ * an 'r' or an 'e') to the journal of the system, if it has one.
+*/
+void journalName(System *sys, char command, char* name) {
+
+    if (!beginRecord(sys, command))
+        return;
+
+    putName(sys->journal, name);
+    endRecord(sys->journal);
+}
+
+/**
+ * Writes the 'p' command adding the stop with the given name and
+ * coordinates to the journal of the system, if it has one.
+*/
+void journalStop(System *sys, char* name, double latitude, double longitude) {
+
+    Journal* journal;
+
+    if (!beginRecord(sys, 'p'))
+        return;
+
+    journal = sys->journal;
+    putName(journal, name);
+    putValue(journal, latitude);
+    putValue(journal, longitude);
+    endRecord(journal);
+}
+
+/**
+ * Writes the 'l' command adding the given link to the journal of the
+ * system, if it has one.
+*/
+void journalLink(System *sys, Link* link) {
+
+    Journal* journal;
+
+    if (!beginRecord(sys, 'l'))
+        return;
+
+    journal = sys->journal;
+    putName(journal, nameChars(&((Line*)link->line)->name));
+    putName(journal, nameChars(&((Stop*)link->orig)->name));
+    putName(journal, nameChars(&((Stop*)link->dest)->name));
+    putValue(journal, link->value.cost);
+    putValue(journal, link->value.duration);
+    endRecord(journal);
+}
+
+/**
+ * Writes the 'a' command to the journal of the system, if it has one.
+*/
+void journalClear(System *sys) {
+
+    if (beginRecord(sys, 'a'))
+        endRecord(sys->journal);
+}
+
+/**
+ * Starts a new record with the given command letter in the journal of the
+ * system. The journal gets a checkpoint first if enough commands were
+ * written since the last one, since the system doesn't hold the new command
+ * yet. Returns YES if the system has a journal, or NO otherwise.
+*/
+int beginRecord(System *sys, char command) {
+
+    if (sys->journal != NULL &&
+            sys->journal->since_checkpoint >= sys->journal->checkpoint_every)
+        checkpointJournal(sys);
+
+    if (sys->journal == NULL)
+        return NO;
+
+    sys->journal->length = sizeof(JournalRecord);
+    putBytes(sys->journal, &command, 1);
+
+    return YES;
+}
+
+/**
+ * Appends the given name, with its '\0', to the record being written.
+*/
+void putName(Journal* journal, char* name) {
+
+    putBytes(journal, name, strlen(name) + 1);
+}
+
+/**
+ * Appends the given value to the record being written.
+*/
+void putValue(Journal* journal, double value) {
+
+    putBytes(journal, &value, sizeof(double));
+}
+
+/**
+ * Appends 'size' bytes of 'data' to the record being written, doubling its
+ * size if needed.
+*/
+void putBytes(Journal* journal, void* data, int size) {
+
+    while (journal->length + size > journal->record_size) {
+        journal->record_size *= 2;
+        journal->record = (char*)tryRealloc(journal->record,
+                                                    journal->record_size);
+    }
+
+    memcpy(journal->record + journal->length, data, size);
+    journal->length += size;
+}
+
+/**
+ * Writes the record, with its length and checksum, to the journal. Every
+ * 'group_size' records, the journal is synced to the disk at once.
+*/
+void endRecord(Journal* journal) {
+
+    JournalRecord record;
+
+    record.length = journal->length - sizeof(JournalRecord);
+    record.checksum = checksumBytes(SNAPSHOT_FNV_BASIS, journal->record +
+                                    sizeof(JournalRecord), record.length);
+    memcpy(journal->record, &record, sizeof(JournalRecord));
+
+    fwrite(journal->record, 1, journal->length, journal->file);
+    journal->written++;
+    journal->since_checkpoint++;
+
+    if (++journal->pending >= journal->group_size)
+        syncJournal(journal);
+}
+
+/**
+ * Writes the pending records of the journal to the disk.
+*/
+void syncJournal(Journal* journal) {
+
+    if (journal->pending == 0)
+        return;
+
+    fflush(journal->file);
+    fsync(fileno(journal->file));
+    journal->pending = 0;
+    journal->syncs++;
+}
+
+/**
+ * Saves the network in the checkpoint snapshot and empties the journal of
+ * the system, if it has one. The new journal follows the new snapshot, so
+ * if the program stops before it's emptied, the old journal is ignored.
+*/
+void checkpointJournal(System *sys) {
+
+    Journal* journal = sys->journal;
+    SnapshotHeader snapshot;
+    FILE* out = sys->out;
+
+    if (journal == NULL)
+        return;
+
+    sys->out = stderr;
+    journal->since_checkpoint = 0;
+
+    if (!saveSnapshot(sys, journal->snapshot) ||
+                        !readSnapshotHeader(journal->snapshot, &snapshot)) {
+        sys->out = out;
+        return;
+    }
+
+    sys->out = out;
+    journal->base = snapshot.checksum;
+    journal->checkpoints++;
+
+    fclose(journal->file);
+    journal->pending = 0;
+
+    if ((journal->file = startJournal(journal)) == NULL) {
+        fprintf(stderr, CANT_WRITE, journal->name);
+        destroyJournal(journal);
+        sys->journal = NULL;
+    }
+}
+
+/**
+ * Writes the pending records of the journal to the disk and frees all its
+ * allocated memory.
+*/
+void closeJournal(Journal* journal) {
+
+    syncJournal(journal);
+    fclose(journal->file);
+    destroyJournal(journal);
+}
+
+/**
+ * Frees all the allocated memory in the given journal. Its file must
+ * be closed.
+*/
+void destroyJournal(Journal* journal) {
+
+    free(journal->name);
+    free(journal->snapshot);
+    free(journal->record);
+    free(journal);
+}
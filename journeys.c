@@ -0,0 +1,348 @@
+/**
+ * IAED-23 Project 2
+ * File: journeys.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the journey queries,
+ * which find the journeys between two stops that are optimal in both cost
+ * and duration (Pareto front). The searches, and those of the routes, are
+ * counted and timed with the monotonic clock, and presented by the 'z'
+ * command.
+*/
+
+#include "main.h"
+
+
+/* --------------------------- Journey functions ---------------------------- */
+
+/**
+ * Shows in the standard output every journey between the two stops with the
+ * given names which is not dominated by another one, by increasing order of
+ * cost. A journey is dominated when another journey is cheaper and faster,
+ * or as cheap and as fast. The search is added to the search statistics.
+*/
+void showJourneys(System *sys, char* orig_name, char* dest_name) {
+
+    Stop *orig = getStop(sys, orig_name), *dest = getStop(sys, dest_name);
+    JourneySearch* search;
+    Node* ptr;
+    long int start = latencyClock();
+
+    if (orig == NULL) {
+        fprintf(sys->out, NO_SUCH_STOP, orig_name);
+        return;
+    } else if (dest == NULL) {
+        fprintf(sys->out, NO_SUCH_STOP, dest_name);
+        return;
+    }
+
+    search = createJourneySearch(sys);
+    searchJourneys(search, orig->index, dest->index);
+
+    if (search->front->count == 0)
+        fprintf(sys->out, NO_JOURNEY);
+
+    for (ptr = search->front->first; ptr != NULL; ptr = ptr->next)
+        printJourney(sys->out, search->graph, (Label*)ptr->data);
+
+    __atomic_add_fetch(&sys->searches->journeys, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&sys->searches->created, search->created,
+                                                        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&sys->searches->pruned, search->pruned,
+                                                        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&sys->searches->journey_ns, latencyClock() - start,
+                                                        __ATOMIC_RELAXED);
+
+    destroyJourneySearch(search);
+}
+
+/**
+ * Creates the structures of a journey search over the current network.
+ * Returns a pointer to the new search.
+*/
+JourneySearch* createJourneySearch(System *sys) {
+
+    JourneySearch* search = (JourneySearch*)tryMalloc(sizeof(JourneySearch));
+    int i;
+
+    search->graph = buildGraph(sys);
+    search->pool = createLabelPool();
+    search->queue = createHeap(search->graph->num_stops + 1);
+    search->front = createList();
+    search->created = 0;
+    search->pruned = 0;
+    search->best_duration =
+            (double*)tryMalloc((search->graph->num_stops + 1) * sizeof(double));
+
+    for (i = 0; i < search->graph->num_stops; i++)
+        search->best_duration[i] = NONE;
+
+    return search;
+}
+
+/**
+ * Multi-label setting search. Labels are settled by lexicographic order of
+ * cost and duration, so a label is dominated by the labels already settled in
+ * its stop if, and only if, one of them is as fast. Only the duration of the
+ * last settled label of each stop is kept. Dominated labels, including the
+ * ones dominated by journeys already found, are pruned.
+*/
+void searchJourneys(JourneySearch* search, int orig, int dest) {
+
+    Graph* graph = search->graph;
+    Label* label;
+    Values value;
+    int i;
+
+    value.cost = 0.00;
+    value.duration = 0.00;
+    addLabel(search, NULL, orig, ERR, value);
+
+    while ((label = (Label*)heapPop(search->queue, compareLabels)) != NULL) {
+
+        if (isLabelDominated(search, label->stop, label->value, dest)) {
+            freeLabel(search->pool, label);
+            search->pruned++;
+            continue;
+        }
+
+        /* Settle the label. */
+        search->best_duration[label->stop] = label->value.duration;
+
+        if (label->stop == dest) {
+            append(search->front, label);
+            continue;
+        }
+
+        for (i = graph->first_edge[label->stop];
+                                i < graph->first_edge[label->stop + 1]; i++) {
+
+            value.cost = label->value.cost + graph->edge_value[i].cost;
+            value.duration =
+                        label->value.duration + graph->edge_value[i].duration;
+
+            if (isLabelDominated(search, graph->edge_dest[i], value, dest)) {
+                search->pruned++;
+                continue;
+            }
+
+            addLabel(search, label, graph->edge_dest[i], i, value);
+        }
+    }
+}
+
+/**
+ * Checks if a label with the given value in the given stop is dominated by
+ * the labels settled in that stop or in the destination stop. Since settled
+ * labels are never more expensive, returns YES if one is as fast. Else,
+ * returns NO.
+*/
+int isLabelDominated(JourneySearch* search, int stop, Values value, int dest) {
+
+    double best = search->best_duration[stop];
+    double best_dest = search->best_duration[dest];
+
+    if ((best != NONE && best <= value.duration) ||
+                        (best_dest != NONE && best_dest <= value.duration))
+        return YES;
+
+    return NO;
+}
+
+/**
+ * Creates a new label from the pool and pushes it to the search queue.
+ * Returns a pointer to the new label.
+*/
+Label* addLabel(JourneySearch* search, Label* pred, int stop, int edge,
+                                                            Values value) {
+
+    Label* label = newLabel(search->pool);
+
+    label->value = value;
+    label->stop = stop;
+    label->edge = edge;
+    label->pred = pred;
+
+    heapPush(search->queue, label, compareLabels);
+    search->created++;
+
+    return label;
+}
+
+/**
+ * Compares two labels by their cost and, if tied, by their duration. Returns
+ * a negative value if the first label comes first, 0 if they're tied or a
+ * positive value if the second label comes first.
+*/
+int compareLabels(void* first, void* second) {
+
+    Values first_value = ((Label*)first)->value;
+    Values second_value = ((Label*)second)->value;
+
+    if (first_value.cost != second_value.cost)
+        return first_value.cost < second_value.cost ? -1 : 1;
+
+    if (first_value.duration != second_value.duration)
+        return first_value.duration < second_value.duration ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * Shows the given journey in the 'out' stream: its cost and duration,
+ * followed by the stops and, between them, the line used.
+*/
+void printJourney(FILE* out, Graph* graph, Label* label) {
+
+    Label* ptr;
+    List* path = createList();
+    Node* node;
+
+    /* The journey is rebuilt backwards from the destination. */
+    for (ptr = label; ptr != NULL; ptr = ptr->pred)
+        push(path, ptr);
+
+    ptr = (Label*)path->first->data;
+    fprintf(out, "%.2f %.2f: %s", label->value.cost, label->value.duration,
+                                nameChars(&graph->stops[ptr->stop]->name));
+
+    for (node = path->first->next; node != NULL; node = node->next) {
+
+        ptr = (Label*)node->data;
+        fprintf(out, " -> %s (%s)", nameChars(&graph->stops[ptr->stop]->name),
+                            nameChars(&graph->edge_line[ptr->edge]->name));
+    }
+
+    putc('\n', out);
+
+    while (path->first != NULL)
+        listRemoveNode(path, path->first);
+
+    listDestroy(path);
+}
+
+/**
+ * Frees all the allocated memory in the given journey search.
+*/
+void destroyJourneySearch(JourneySearch* search) {
+
+    while (search->front->first != NULL)
+        listRemoveNode(search->front, search->front->first);
+
+    listDestroy(search->front);
+    destroyHeap(search->queue);
+    destroyLabelPool(search->pool);
+    destroyGraph(search->graph);
+    free(search->best_duration);
+    free(search);
+}
+
+
+/* ------------------------------ Label pool -------------------------------- */
+
+/**
+ * Creates a new empty label pool and returns its respective pointer.
+ * Labels are allocated in blocks, and pruned labels are recycled.
+*/
+LabelPool* createLabelPool() {
+
+    LabelPool* pool = (LabelPool*)tryMalloc(sizeof(LabelPool));
+
+    pool->blocks = createList();
+    pool->free_label = NULL;
+    pool->used = LABEL_BLOCK;
+
+    return pool;
+}
+
+/**
+ * Gets a label from the pool, reusing a freed label if there's one. Returns
+ * a pointer to the label.
+*/
+Label* newLabel(LabelPool* pool) {
+
+    Label* label = pool->free_label;
+
+    if (label != NULL) {
+        pool->free_label = label->pred;
+        return label;
+    }
+
+    if (pool->used == LABEL_BLOCK) {
+        append(pool->blocks, tryMalloc(LABEL_BLOCK * sizeof(Label)));
+        pool->used = 0;
+    }
+
+    return (Label*)pool->blocks->last->data + pool->used++;
+}
+
+/**
+ * Returns the given label to the pool, to be reused.
+*/
+void freeLabel(LabelPool* pool, Label* label) {
+
+    label->pred = pool->free_label;
+    pool->free_label = label;
+}
+
+/**
+ * Frees all the allocated memory in the given pool, including its labels.
+*/
+void destroyLabelPool(LabelPool* pool) {
+
+    while (pool->blocks->first != NULL) {
+        free(pool->blocks->first->data);
+        listRemoveNode(pool->blocks, pool->blocks->first);
+    }
+
+    listDestroy(pool->blocks);
+    free(pool);
+}
+
+
+/* --------------------------- Search statistics ---------------------------- */
+
+/**
+ * Creates new search statistics, with no searches, and returns their
+ * respective pointer.
+*/
+SearchStats* createSearchStats() {
+
+    SearchStats* stats = (SearchStats*)tryMalloc(sizeof(SearchStats));
+
+    int plain;
+
+    stats->journeys = stats->created = stats->pruned = 0;
+    stats->journey_ns = 0;
+
+    for (plain = 0; plain < 2; plain++)
+        stats->routes[plain] = stats->settled[plain] =
+                                                stats->route_ns[plain] = 0;
+
+    stats->builds = stats->build_ns = 0;
+
+    return stats;
+}
+
+/**
+ * Presents the given search statistics in the 'out' stream: the journeys,
+ * and the routes over the plain network and over a hierarchy.
+*/
+void printSearchStats(FILE* out, SearchStats* stats) {
+
+    int plain;
+
+    fprintf(out, JOURNEY_STATS,
+                __atomic_load_n(&stats->journeys, __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->created, __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->pruned, __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->journey_ns, __ATOMIC_RELAXED) /
+                                                                1000000.0);
+
+    for (plain = 1; plain >= 0; plain--)
+        fprintf(out, ROUTE_STATS, plain ? "plain" : "hierarchy",
+                __atomic_load_n(&stats->routes[plain], __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->settled[plain], __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->route_ns[plain], __ATOMIC_RELAXED) /
+                                                                1000000.0);
+}
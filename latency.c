@@ -0,0 +1,255 @@
+/**
+ * IAED-23 Project 2
+ * File: latency.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the latency histograms of the commands, kept
+ * when built with -DLATENCY_HISTOGRAMS (otherwise, the commands aren't
+ * timed at all). Each command run by 'handleCommand' is timed with the
+ * monotonic clock, and counted in the histogram of its letter and size
+ * class (the lines of the stop removed, the stops of the line linked, shown
+ * or removed, in powers of 2), so that removing a hub and linking a new
+ * line fall apart. The buckets split each power of 2 of nanoseconds in 16
+ * (as HDR histograms), within 1/16 of the time. The histograms are
+ * presented by the 'z' command, and at the end.
+*/
+
+/* Monotonic clock (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/**
+ * Creates new empty latency histograms, and returns their respective
+ * pointer.
+*/
+Latencies* createLatencies() {
+
+    Latencies* latencies = (Latencies*)tryMalloc(sizeof(Latencies));
+    int command, size_class;
+
+    for (command = 0; command < LATENCY_COMMANDS; command++)
+        for (size_class = 0; size_class < LATENCY_CLASSES; size_class++)
+            latencies->histograms[command][size_class] = NULL;
+
+    return latencies;
+}
+
+/**
+ * Returns the nanoseconds of the monotonic clock.
+*/
+long int latencyClock() {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * Returns the bucket of the given time: the times below 16 ns have one
+ * each, and each power of 2 above has 16.
+*/
+int latencyBucket(long int ns) {
+
+    int exponent = 0;
+
+    if (ns < LATENCY_SUB_BUCKETS)
+        return ns < 0 ? 0 : ns;
+
+    while ((ns >> exponent) >= 2 * LATENCY_SUB_BUCKETS)
+        exponent++;
+
+    if (exponent * LATENCY_SUB_BUCKETS + (ns >> exponent) >= LATENCY_BUCKETS)
+        return LATENCY_BUCKETS - 1;
+
+    return exponent * LATENCY_SUB_BUCKETS + (ns >> exponent);
+}
+
+/**
+ * Returns the longest time of the given bucket.
+*/
+long int bucketLimit(int bucket) {
+
+    int exponent = bucket / LATENCY_SUB_BUCKETS - 1;
+
+    if (bucket < LATENCY_SUB_BUCKETS)
+        return bucket;
+
+    return ((long int)(bucket - exponent * LATENCY_SUB_BUCKETS + 1) <<
+                                                            exponent) - 1;
+}
+
+/**
+ * Returns the size class of the given size: 0 for none, or else 1 more
+ * than its power of 2.
+*/
+int sizeClass(long int size) {
+
+    int size_class = 0;
+
+    while (size > 0 && size_class < LATENCY_CLASSES - 1) {
+        size >>= 1;
+        size_class++;
+    }
+
+    return size_class;
+}
+
+/**
+ * Returns the histogram of the given command and size class, created if
+ * it's the first time. Threads may count at once.
+*/
+LatencyHistogram* getHistogram(Latencies* latencies, int command,
+                                                            int size_class) {
+
+    LatencyHistogram **slot = &latencies->histograms[command][size_class];
+    LatencyHistogram *histogram = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    LatencyHistogram *created;
+
+    if (histogram != NULL)
+        return histogram;
+
+    created = (LatencyHistogram*)tryMalloc(sizeof(LatencyHistogram));
+    memset(created, 0, sizeof(LatencyHistogram));
+    created->min = -1;
+
+    if (__atomic_compare_exchange_n(slot, &histogram, created, NO,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return created;
+
+    free(created);
+
+    return histogram;
+}
+
+/**
+ * Counts the given time of the given command (its letter), which ran on an
+ * object of the given size. Threads may count at once.
+*/
+void recordLatency(Latencies* latencies, int command, long int size,
+                                                                long int ns) {
+
+    LatencyHistogram* histogram;
+    long int seen;
+
+    if (command <= ' ' || command >= LATENCY_COMMANDS)
+        return;
+
+    histogram = getHistogram(latencies, command, sizeClass(size));
+
+    __atomic_add_fetch(&histogram->counts[latencyBucket(ns)], 1,
+                                                        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&histogram->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&histogram->total, ns, __ATOMIC_RELAXED);
+
+    seen = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+    while ((seen < 0 || ns < seen) && !__atomic_compare_exchange_n(
+                &histogram->min, &seen, ns, NO, __ATOMIC_RELAXED,
+                __ATOMIC_RELAXED)) { }
+
+    seen = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (ns > seen && !__atomic_compare_exchange_n(&histogram->max, &seen,
+                            ns, NO, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+}
+
+/**
+ * Returns the time below which the given fraction of the given counts
+ * falls, at most the longest time.
+*/
+long int latencyPercentile(long int* counts, long int count, long int max,
+                                                            double fraction) {
+
+    long int below = 0, target = (long int)(fraction * count + 0.5);
+    int bucket;
+
+    if (target < 1)
+        target = 1;
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+
+        below += counts[bucket];
+
+        if (below >= target)
+            return bucketLimit(bucket) < max ? bucketLimit(bucket) : max;
+    }
+
+    return max;
+}
+
+/**
+ * Presents the given histogram of the given command and size class in the
+ * 'out' stream: a line with its percentiles, and a line for each bucket
+ * with times.
+*/
+void printHistogram(FILE* out, LatencyHistogram* histogram, int command,
+                                                            int size_class) {
+
+    long int counts[LATENCY_BUCKETS], count = 0, max;
+    long int low = size_class == 0 ? 0 : 1L << (size_class - 1);
+    long int high = size_class == 0 ? 0 : (1L << size_class) - 1;
+    int bucket;
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        counts[bucket] = __atomic_load_n(&histogram->counts[bucket],
+                                                        __ATOMIC_RELAXED);
+        count += counts[bucket];
+    }
+
+    if (count == 0)
+        return;
+
+    max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+
+    fprintf(out, LATENCY_STATS, command, low, high, count,
+            __atomic_load_n(&histogram->min, __ATOMIC_RELAXED),
+            latencyPercentile(counts, count, max, 0.5),
+            latencyPercentile(counts, count, max, 0.9),
+            latencyPercentile(counts, count, max, 0.99),
+            latencyPercentile(counts, count, max, 0.999), max,
+            __atomic_load_n(&histogram->total, __ATOMIC_RELAXED) / count);
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+        if (counts[bucket] != 0)
+            fprintf(out, LATENCY_BUCKET, command, low, high,
+                                        bucketLimit(bucket), counts[bucket]);
+}
+
+/**
+ * Presents every histogram with times in the 'out' stream, by command and
+ * size class.
+*/
+void printLatencies(FILE* out, Latencies* latencies) {
+
+    LatencyHistogram* histogram;
+    int command, size_class;
+
+    for (command = 0; command < LATENCY_COMMANDS; command++) {
+
+        for (size_class = 0; size_class < LATENCY_CLASSES; size_class++) {
+
+            histogram = __atomic_load_n(
+                    &latencies->histograms[command][size_class],
+                    __ATOMIC_ACQUIRE);
+
+            if (histogram != NULL)
+                printHistogram(out, histogram, command, size_class);
+        }
+    }
+}
+
+/**
+ * Frees all the allocated memory in the given histograms.
+*/
+void destroyLatencies(Latencies* latencies) {
+
+    int command, size_class;
+
+    for (command = 0; command < LATENCY_COMMANDS; command++)
+        for (size_class = 0; size_class < LATENCY_CLASSES; size_class++)
+            free(latencies->histograms[command][size_class]);
+
+    free(latencies);
+}
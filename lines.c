@@ -20,33 +20,44 @@
 void listLines(System *sys) {
 
     Node* ptr;
-    Stop *orig, *dest;
     Line* line;
 
     if (sys->lines_list->count != 0) {
         for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
 
             line = (Line*)ptr->data;
+            refreshLineValues(sys, line);
+            printLine(sys->out, line);
+        }
+    } 
+}
+
+/**
+ * Presents the given line in the 'out' stream, as listed by the 'c'
+ * command: its name, first and last stops, number of stops and values.
+*/
+void printLine(FILE* out, Line* line) {
 
-            if (line->num_stops < 2) {
+    Stop *orig, *dest;
+
+    if (line->num_stops < 2) {
 
-                printf("%s %d %.2f %.2f\n", line->name, line->num_stops,
+        fprintf(out, "%s %d %.2f %.2f\n", nameChars(&line->name), 
+                                            line->num_stops,
                                             line->total_value.cost, 
                                             line->total_value.duration);
-            } else {
+    } else {
 
-                orig = (Stop*)((Link*)line->links_list->first->data)->orig;
-                dest = (Stop*)((Link*)line->links_list->last->data)->dest;
+        orig = (Stop*)((Link*)line->links_list->first->data)->orig;
+        dest = (Stop*)((Link*)line->links_list->last->data)->dest;
 
-                printf("%s %s %s %d %.2f %.2f\n", line->name,  
-                                                    orig->name,
-                                                    dest->name,
+        fprintf(out, "%s %s %s %d %.2f %.2f\n", nameChars(&line->name), 
+                                                    nameChars(&orig->name),
+                                                    nameChars(&dest->name),
                                                     line->num_stops,
                                                     line->total_value.cost, 
                                                     line->total_value.duration);
-            }
-        }
-    } 
+    }
 }
 
 /**
@@ -59,11 +70,13 @@ void addShowLine(System *sys, char* name, int sort) {
 
     if (line == NULL) {
 
+        journalName(sys, 'c', name);
         addLine(sys, name); 
 
     } else if (line->num_stops != 0) {
 
-        printLineStops(line, sort); 
+        LATENCY_SIZE(sys, line->num_stops);
+        printLineStops(sys->out, line, sort); 
     }
 }
 
@@ -86,11 +99,11 @@ Line* getLine(System *sys, char* name) {
 /**
  * Retrieves the name of a line.
 */
-char* getLineName(void* line) {
+Name* getLineName(void* line) {
 
     Node* line_node = line;
     Line* line_get = (Line*)line_node->data;
-    return line_get->name;
+    return &line_get->name;
 }
 
 /**
@@ -98,41 +111,45 @@ char* getLineName(void* line) {
 */
 void addLine(System *sys, char* name) {
 
-    Line* new_line = (Line*)tryMalloc(sizeof(Line));
+    Line* new_line = (Line*)tagMalloc(sizeof(Line), MEM_LINE);
     Node* new_node;
 
-    new_line = populateLine(new_line, name);
+    new_line = populateLine(new_line, name, sys->names);
+    new_line->removals = sys->removals;
         
     /* Saves line in the line list and the respective node in the hashtable. */
     new_node = listInsertEnd(sys->lines_list, new_line);
-    sys->lines_table = hashtableInsert(sys->lines_table, new_node, 
-                                        getLineName(new_node), getLineName);
+    hashtableInsert(sys->lines_table, new_node, getLineName(new_node),
+                                                                getLineName);
 
 }
 
 /**
- * Populates the given line with the given data. Returns the 
- * newly populated line.
+ * Populates the given line with the given data, its name inline if short 
+ * or else interned in the given arena. Returns the newly populated line.
 */
-Line* populateLine(Line* new_line, char* name) {
+Line* populateLine(Line* new_line, char* name, NameArena* names) {
 
-    new_line->name = (char*)tryMalloc((strlen(name) + 1) * sizeof(char));
-    strcpy(new_line->name, name);
+    populateName(&new_line->name, name, names);
 
     new_line->links_list = createList();
     new_line->num_stops = 0;
     new_line->total_value.cost = 0.00;
     new_line->total_value.duration = 0.00;
+    new_line->outdated = NO;
+    new_line->task = ERR;
+    new_line->position = ERR;
+    new_line->view = NULL;
 
     return new_line;
 }
 
 /**
- * Shows the itinerary of a given line in the standard output, being the 
+ * Shows the itinerary of a given line in the 'out' stream, being the 
  * variable 'sort' the sort indicator: if YES, the itinerary is presented 
  * backwards; if NO, is presented as default. 
 */
-void printLineStops(Line *line, int sort) {
+void printLineStops(FILE* out, Line *line, int sort) {
 
     Node* ptr;
     Stop* current;
@@ -140,33 +157,35 @@ void printLineStops(Line *line, int sort) {
     if (!sort) {
 
         for (ptr = line->links_list->first; ptr != NULL; ptr = ptr->next)
-            printf("%s, ", ((Stop*)((Link*)ptr->data)->orig)->name);
+            fprintf(out, "%s, ", 
+                        nameChars(&((Stop*)((Link*)ptr->data)->orig)->name));
 
         current = (Stop*)((Link*)line->links_list->last->data)->dest;
-        printf("%s\n", current->name);
+        fprintf(out, "%s\n", nameChars(&current->name));
 
     } else {
 
         for (ptr = line->links_list->last; ptr != NULL; ptr = ptr->prev) 
-            printf("%s, ",((Stop*)((Link*)ptr->data)->dest)->name);
+            fprintf(out, "%s, ",
+                        nameChars(&((Stop*)((Link*)ptr->data)->dest)->name));
 
         current = (Stop*)((Link*)line->links_list->first->data)->orig;
-        printf("%s\n", current->name);
+        fprintf(out, "%s\n", nameChars(&current->name));
     }
 }
 
 /**
- * Asserts if the input-read sort option is a valid one.
- * Returns YES if so. Returns NO otherwise.
+ * Asserts if the input-read sort option is a valid one, warning in the
+ * 'out' stream if not. Returns YES if so. Returns NO otherwise.
 */
-int assertSortOption(char opt[]) {
+int assertSortOption(FILE* out, char opt[]) {
 
     char sort[] = SORT;
     int i, len = strlen(opt);
 
     if (len < 3 || len > 7) {
 
-        printf(WRONG_SORT);
+        fprintf(out, WRONG_SORT);
         return NO;
     }
 
@@ -174,7 +193,7 @@ int assertSortOption(char opt[]) {
 
         if(opt[i] != sort[i]) {
 
-            printf(WRONG_SORT);
+            fprintf(out, WRONG_SORT);
             return NO;
         }
     }
@@ -197,18 +216,22 @@ void removeLine(System *sys, char* name) {
     Line* to_remove; 
 
     if (element == NULL) {
-        printf(NO_SUCH_LINE, name);
+        fprintf(sys->out, NO_SUCH_LINE, name);
         return;
     }
 
     line_node = (Node*)element->data;
     to_remove = (Line*)line_node->data;
+    LATENCY_SIZE(sys, to_remove->num_stops);
 
     removeAllLinksLine(to_remove);
 
     hashtableRemove(sys->lines_table, name, getLineName);
-    listRemoveNode(sys->lines_list, line_node);
-    deleteLine(to_remove);
+    listUnlinkNode(sys->lines_list, line_node);
+
+    /* Readers of the hashtable may still hold them. */
+    retireMemory(sys->epochs, line_node, freeNode);
+    retireMemory(sys->epochs, to_remove, deleteLine);
 }
 
 /**
@@ -285,7 +308,8 @@ void emptyLineRoute(Line* line) {
 void deleteLine(void* line) {
 
     Line* to_delete = line;
+    releaseView(to_delete->view);
     listDestroy(to_delete->links_list);
-    free(to_delete->name);
-    free(to_delete);
+    releaseName(&to_delete->name);
+    tagFree(to_delete, sizeof(Line), MEM_LINE);
 }
\ No newline at end of file
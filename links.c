@@ -21,7 +21,7 @@ Link* obtainLinkArgs(System *sys) {
 
     char line[BUFLEN], orig[BUFLEN], dest[BUFLEN], cost[BUFLEN], dura[BUFLEN];
     
-    Link* new_link = (Link*)tryMalloc(sizeof(Link));
+    Link* new_link = (Link*)tagMalloc(sizeof(Link), MEM_LINK);
 
     /* Read line name. */
     if (getArg(sys, line)) {
@@ -31,9 +31,7 @@ Link* obtainLinkArgs(System *sys) {
             if (getArg(sys, cost) && !getArg(sys, dura)) {
 
                 /* Command line read successfully. */
-                new_link = checkLinkArgsOK(sys, new_link, line, orig, dest);
-
-                if (new_link != NULL) {
+                if (checkLinkArgsOK(sys, new_link, line, orig, dest) != NULL) {
 
                     /* Convert strings to floating point variables. */
                     new_link->value.cost = atof(cost);
@@ -44,7 +42,7 @@ Link* obtainLinkArgs(System *sys) {
         } 
     }
 
-    free(new_link);
+    tagFree(new_link, sizeof(Link), MEM_LINK);
     return NULL;
 }
 
@@ -60,17 +58,17 @@ Link* checkLinkArgsOK(System *sys, Link* new_link, char* line, char* orig,
 
     if (line_ptr == NULL) {
 
-        printf(NO_SUCH_LINE, line);
+        fprintf(sys->out, NO_SUCH_LINE, line);
         return NULL;
 
     } else if (orig_ptr == NULL) {
 
-        printf(NO_SUCH_STOP, orig);
+        fprintf(sys->out, NO_SUCH_STOP, orig);
         return NULL;
 
     } else if (dest_ptr == NULL) {
 
-        printf(NO_SUCH_STOP, dest);
+        fprintf(sys->out, NO_SUCH_STOP, dest);
         return NULL;
     }
 
@@ -122,103 +120,142 @@ int processLinkData(Link* new_link) {
     return ERR;
 }
 
+/**
+ * Adds the given link to its line's route, at the beginning or at the end,
+ * or warns that it can't be associated with the line.
+*/
+void addLink(System *sys, Link* new_link) {
+
+    switch(processLinkData(new_link)) {
+
+        case FIRST_LINK: addFirstLink(sys, new_link);
+            break;
+        case APPEND: linkAppend(sys, new_link);
+            break;
+        case PUSH: linkPush(sys, new_link);
+            break;
+        default: tagFree(new_link, sizeof(Link), MEM_LINK);
+            fprintf(sys->out, CANT_LINK);
+            break;
+    }
+}
+
 /**
  * Creates the first link in a line after checking its values of cost 
  * and duration. If they happen to be negative, the link is not added.
 */
-void addFirstLink(Link* new_link) {
+void addFirstLink(System *sys, Link* new_link) {
 
     Line* line = (Line*)new_link->line;
     Stop* orig = (Stop*)new_link->orig;
     Stop* dest = (Stop*)new_link->dest;
 
-    if (!assertNegativeValue(new_link->value)) {
-        free(new_link);
+    if (!assertNegativeValue(sys->out, new_link->value)) {
+        tagFree(new_link, sizeof(Link), MEM_LINK);
         return;
     }
 
     line->total_value = new_link->value;
     line->num_stops = 2;
+    dropView(&line->view);
 
     append(line->links_list, (Link*)new_link);
     
     /* Associate line to origin stop. */
-    addLineToStop(line, orig); 
+    addLineToStop(sys, line, orig); 
 
     /* Associate line to destination stop. */
     if (orig != dest)
-        addLineToStop(line, dest); 
+        addLineToStop(sys, line, dest); 
 }
 
 /**
  * Adds a new link to the beginning of a line's route after checking its values
  * of cost and duration. If they happen to be negative, the link is not added.
 */
-void linkPush(Link* new_link) {
+void linkPush(System *sys, Link* new_link) {
 
     Line* line = (Line*)new_link->line;
     Stop* orig = (Stop*)new_link->orig;
 
-    if (!assertNegativeValue(new_link->value)) {
-        free(new_link);
+    if (!assertNegativeValue(sys->out, new_link->value)) {
+        tagFree(new_link, sizeof(Link), MEM_LINK);
         return;
     }
 
     line->total_value.cost += new_link->value.cost;
     line->total_value.duration += new_link->value.duration;
     line->num_stops += 1;
+    dropView(&line->view);
 
     /* Insert link in the beginning of the route. */
     push(line->links_list, (Link*)new_link);
     
     /* Associate line to origin stop */
-    addLineToStop(line, orig); 
+    addLineToStop(sys, line, orig); 
 }
 
 /**
  * Adds a new link to the end of a line's route after checking its values of 
  * cost and duration. If they happen to be negative, the link is not added.
 */
-void linkAppend(Link* new_link) {
+void linkAppend(System *sys, Link* new_link) {
 
     Line* line = (Line*)new_link->line;
     Stop* dest = (Stop*)new_link->dest;
 
-    if (!assertNegativeValue(new_link->value)) {
-        free(new_link);
+    if (!assertNegativeValue(sys->out, new_link->value)) {
+        tagFree(new_link, sizeof(Link), MEM_LINK);
         return;
     }
 
     line->total_value.cost += new_link->value.cost;
     line->total_value.duration += new_link->value.duration;
     line->num_stops += 1;
+    dropView(&line->view);
 
     /* Insert link in the end of the route. */
     append(line->links_list, (Link*)new_link);
 
     /* Associate line to destination stop. */
     if (dest != (Stop*)new_link->orig)
-        addLineToStop(line, dest); 
+        addLineToStop(sys, line, dest); 
 }
 
 /**
- * Associates the given line with the given stop. 
+ * Associates the given line with the given stop. Inside a batch, the line
+ * is appended without searching the stop's lines, which may then hold
+ * duplicates until they're cleaned. During a bulk import, the stop is kept
+ * in the record being imported, and associated later.
 */
-void addLineToStop(Line* line, Stop* stop) {
+void addLineToStop(System *sys, Line* line, Stop* stop) {
+
+    if (sys->importing != NULL) {
+
+        sys->importing->members[sys->importing->num_members++] = stop;
+
+    } else if (sys->batch) {
 
-    if (searchList(stop->lines, (Line*)line) == NULL) 
         append(stop->lines, line);
+        stop->duplicates = YES;
+        dropView(&stop->view);
+
+    } else if (searchList(stop->lines, (Line*)line) == NULL) {
+
+        append(stop->lines, line);
+        dropView(&stop->view);
+    }
 }
 
 /**
  * Assert if the input-read link values of cost and duration are positive,
- * returning YES if so. Else, returns NO.
+ * warning in the 'out' stream if not. Returns YES if so. Else, returns NO.
 */
-int assertNegativeValue(Values values) {
+int assertNegativeValue(FILE* out, Values values) {
 
     if (values.cost < 0 || values.duration < 0) {
 
-        printf(NEGATIVE_VALUE);
+        fprintf(out, NEGATIVE_VALUE);
         return NO;
     }
 
@@ -242,8 +279,9 @@ void removeLink(Line* line, Link* to_delete, Node* node) {
         line->total_value.duration -= to_delete->value.duration;
 
         listRemoveNode(line->links_list, node);
-        free(to_delete);
+        tagFree(to_delete, sizeof(Link), MEM_LINK);
         line->num_stops -= 1;
+        dropView(&line->view);
         
         if (line->num_stops <= 1) 
             line->num_stops = 0;
@@ -256,5 +294,9 @@ void removeLink(Line* line, Link* to_delete, Node* node) {
 */
 void removeLineFromStop(Line* line, Stop* stop) {
 
+    if (stop->duplicates)
+        cleanStopLines(stop);
+
     listRemoveData(stop->lines, (Line*)line);
+    dropView(&stop->view);
 }
\ No newline at end of file
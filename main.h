@@ -14,6 +14,13 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "structures.h"
 
 
@@ -25,6 +32,21 @@
 
 /* Words */
 #define SORT "inverso"      /* Sort option input. */
+#define BATCH_BEGIN "begin"     /* Option to begin a batch. */
+#define BATCH_COMMIT "commit"   /* Option to commit a batch. */
+#define PIPELINE_OPTION "-p"    /* Option to run in the pipelined mode. */
+#define WORKERS_OPTION "-j"     /* Option to use the worker pool. */
+#define JOURNAL_OPTION "-l"     /* Option to keep a journal. */
+#define SERVER_OPTION "-s"      /* Option to run as a local server. */
+#define TRACE_OPTION "-t"       /* Option to trace, exported at the end. */
+#define STATS_TABLES "tables"   /* Statistics of the hashtables. */
+#define STATS_LATENCY "latency" /* Latency histograms of the commands. */
+#define STATS_MEMORY "memory"   /* Memory of the network, by category. */
+#define STATS_TRACE "trace"     /* Tracer: "on", "off" or a file to export. */
+#define STATS_FREEZE "freeze"   /* Freezes the names, with a perfect hash. */
+#define STATS_SEARCHES "searches" /* Of the journeys and routes so far. */
+#define TRACE_ON "on"
+#define TRACE_OFF "off"
 
 /* Others */
 #define ERR -1              /* If an error occurs or a task is interrupted. */
@@ -33,6 +55,94 @@
 #define FIRST_LINK 2        /* To create the first link. */
 #define APPEND 3            /* To append a new link to a list. */
 #define PUSH 4              /* To push a new link into a list. */
+#define NONE -1.0           /* If a stop has no settled journey label. */
+#define LABEL_BLOCK 4096    /* Number of journey labels allocated at once. */
+#define GEO_PI 3.14159265358979323846  /* Pi. */
+#define GEO_EARTH_RADIUS 6371.0       /* Mean radius of the Earth (km). */
+#define GEO_SERIES_TERMS 15           /* Terms of the Taylor series. */
+#define GEO_NEWTON_STEPS 6            /* Newton's method iterations. */
+#define SPATIAL_START_SIZE 64         /* Starting nodes of the spatial index. */
+#define SPATIAL_DEPTH_SLACK 8         /* Extra depth before a rebuild. */
+#define RANGE_PAGE 16                 /* Children of a range tree node. */
+#define RANGE_MAX_TREES 32            /* Range trees of the range index. */
+#define RANGE_INFINITY 1e300          /* Bound of a rectangle with no bound. */
+#define DIST_SERIES_TERMS 26          /* Terms of the vector arc sine. */
+#define PIPE_CHUNK_SIZE 65536         /* Characters of a pipeline chunk. */
+#define PIPE_CHUNKS 16                /* Chunks of each pipeline direction. */
+#define PIPE_SPINS 1000               /* Tries before yielding the CPU. */
+#define PIPE_YIELDS 16                /* Yields before blocking. */
+#define CACHE_LINE 64                 /* Bytes of a cache line. */
+#define WORKER_MAX_RUN 1024           /* Reading commands run at once. */
+#define WORKER_MAX_THREADS 256        /* Threads of the worker pool. */
+#define WORKER_LINE_SIZE 64           /* Starting length of a read line. */
+#define IMPORT_CHUNK_SIZE 65536       /* Characters of a dump parsed at once. */
+#define SNAPSHOT_MAGIC "IAEDSNAP"     /* First bytes of a snapshot. */
+#define SNAPSHOT_VERSION 2            /* Version of the snapshot format. */
+#define SNAPSHOT_BYTE_ORDER 0x01020304  /* Written in the machine's order. */
+#define SNAPSHOT_TEMP ".tmp"          /* Suffix of a snapshot being saved. */
+#define SNAPSHOT_FNV_BASIS 2166136261U  /* Starting value of the checksum. */
+#define SNAPSHOT_FNV_PRIME 16777619U    /* Multiplier of the checksum. */
+#define JOURNAL_MAGIC "IAEDJRNL"      /* First bytes of a journal. */
+#define JOURNAL_VERSION 1             /* Version of the journal format. */
+#define JOURNAL_SNAPSHOT ".snap"      /* Suffix of the journal's checkpoint. */
+#define JOURNAL_NO_SNAPSHOT 0         /* Base of a journal with no snapshot. */
+#define JOURNAL_GROUP 256             /* Commands written at each sync. */
+#define JOURNAL_CHECKPOINT 100000     /* Commands between checkpoints. */
+#define JOURNAL_RECORD_SIZE 256       /* Starting length of a record. */
+#define VIEW_PARTS 3                  /* Parts of the text of a view. */
+#define VIEW_LISTING 0                /* Row listed by 'c', 'p'. */
+#define VIEW_SHOW 1                   /* Route or coordinates shown. */
+#define VIEW_EXTRA 2                  /* Inverse route or intersection. */
+#define SERVER_THREADS 4              /* Threads running client commands. */
+#define SERVER_BACKLOG 128            /* Connections waiting to be taken. */
+#define SERVER_EVENTS 64              /* Events taken at each wait. */
+#define SERVER_READ_SIZE 4096         /* Bytes read from a client at once. */
+#define SERVER_MAX_LINE 1048576       /* Longest line a client may send. */
+#define SERVER_STRIPES 64             /* Locks of the lines of the stops. */
+#define VALUES_EPSILON 1e-12        /* Relative rounding error of values. */
+#define HIER_SETTLE_LIMIT 500       /* Stops settled by a witness search. */
+#define HIER_CORE_BALANCE 200 /* Shortcuts that leave a stop in the core. */
+#define HIER_SIMULATE_LIMIT 50      /* ... when estimating the importance. */
+#define HIER_MAX_SEARCH 2000000000  /* Searches before the marks are reset. */
+#define LATENCY_SUB_BUCKETS 16      /* Buckets of each power of 2 of time. */
+#define LATENCY_BUCKETS 720         /* Buckets, up to 2^48 nanoseconds. */
+#define LATENCY_CLASSES 25          /* Size classes, up to 2^23. */
+#define LATENCY_COMMANDS 128        /* Commands, by their letter. */
+
+/* Categories of the memory accounted (see memory.c) */
+#define MEM_STOP 0
+#define MEM_LINE 1
+#define MEM_LINK 2
+#define MEM_NODE 3              /* Nodes of the lists. */
+#define MEM_HASH_ELEM 4         /* Elements of the hashtables. */
+#define MEM_NAME 5              /* Names of the stops and lines. */
+#define MEM_TABLE 6             /* Hashtables and their slots. */
+#define MEM_CATEGORIES 7
+#define MEM_CATEGORY_NAMES {"stop", "line", "link", "node", "hash_elem", \
+"name", "table"}
+
+#define TRACE_EVENTS_SIZE 65536   /* Events kept by the tracer (power of 2). */
+#define TRACE_THREADS 64            /* Threads told apart in the exports. */
+
+/* Size of the object of the command being timed or traced
+   (-DLATENCY_HISTOGRAMS or -DTRACE_EVENTS). */
+#if defined(LATENCY_HISTOGRAMS) || defined(TRACE_EVENTS)
+#define LATENCY_SIZE(sys, size) ((sys)->latency_size = (size))
+#else
+#define LATENCY_SIZE(sys, size)
+#endif
+
+/* Events of the tracer of the slowest paths (-DTRACE_EVENTS). */
+#ifdef TRACE_EVENTS
+#define TRACE_BEGIN(name, size) traceEvent(name, 'B', 0, size)
+#define TRACE_END(name, size) traceEvent(name, 'E', 0, size)
+#define TRACE_COMMAND(c, phase, size) \
+traceEvent("handleCommand", phase, c, size)
+#else
+#define TRACE_BEGIN(name, size)
+#define TRACE_END(name, size)
+#define TRACE_COMMAND(c, phase, size)
+#endif
 
                                 
 /* -------------------------------- Warnings -------------------------------- */
@@ -45,6 +155,41 @@
 #define NO_SUCH_LINE "%s: no such line.\n" 
 #define CANT_LINK "link cannot be associated with bus line.\n" 
 #define NEGATIVE_VALUE "negative cost or duration.\n"
+#define NO_JOURNEY "no journey between stops.\n"
+#define NO_SUCH_FILE "%s: no such file.\n"
+#define CANT_WRITE "%s: cannot write file.\n"
+#define CANT_FREEZE "%s: cannot freeze.\n"
+#define INVALID_SNAPSHOT "%s: invalid snapshot.\n"
+#define CANT_RECOVER "%s: cannot recover journal.\n"
+#define CANT_LISTEN "%s: cannot listen.\n"
+
+/* Statistics (standard error) */
+#define JOURNAL_STATS "journal: %ld commands replayed, %.3f ms\n"
+#define SERVER_STATS "server: %ld clients, %ld commands (%ld with no locks, \
+%ld shared, %ld of them edits, %ld exclusive)\n"
+#define LATENCY_STATS "latency %c %ld %ld count %ld min %ld p50 %ld p90 %ld \
+p99 %ld p999 %ld max %ld mean %ld\n"
+#define LATENCY_BUCKET "bucket %c %ld %ld %ld %ld\n"
+#define HASHTABLE_STATS "table %s elements %d slots %d load %.4f occupancy \
+%.4f tombstones %d hits %ld misses %ld inserts %ld probes %.3f removals %ld \
+resizes %ld resize_ms %.3f\n"
+#define HASHTABLE_PROBES "probes %s %d%s %ld\n"
+#define FROZEN_STATS "frozen %s keys %d slots %d buckets %d bytes %ld \
+inserted %d removed %d hits %ld fallbacks %ld\n"
+#define NAME_STATS "names interned %d shared_by %ld chunks %d bytes %ld \
+used %ld name_bytes %ld inline %d\n"
+#define MEMORY_STATS "memory %s bytes %ld blocks %ld peak_bytes %ld \
+peak_blocks %ld allocations %ld bytes_per_block %.1f\n"
+#define TRACE_STATS "trace %s events %ld kept %ld\n"
+#define JOURNEY_STATS "searches journeys %ld labels_created %ld \
+labels_pruned %ld ms %.3f\n"
+#define ROUTE_STATS "searches routes %s %ld settled %ld ms %.3f\n"
+#define HIERARCHY_STATS "hierarchy builds %ld stops %d edges %d shortcuts %d \
+bytes %ld ms %.3f\n"
+#define TRACE_EVENT "%s  {\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \
+\"pid\": 1, \"tid\": %d, \"args\": {\"size\": %ld%s%s%s}}"
+#define MEMORY_TOTAL "memory total bytes %ld peak_bytes %ld rss_kb %ld \
+peak_rss_kb %ld\n"
 
 
 /* ------------------------------- Structures ------------------------------- */
@@ -58,18 +203,31 @@ typedef struct {
 
 /* Structure of stop. */  
 typedef struct {              
-    char* name;
+    Name name;
     double longitude;
     double latitude;
     List* lines;
+    int index;                  /* Position in the network graph. */
+    int spatial;                /* Node in the spatial index. */
+    int range_pos;              /* Entry in the range index, */
+    short range_tree;           /* in the tree of this level. */
+    short duplicates;           /* If the lines may have duplicates. */
+    unsigned int order;         /* Order of creation (modulo 2^32). */
+    int column;                 /* Position in the distance columns. */
+    struct view_t* view;        /* Text last presented, if still valid. */
 } Stop;
 
 /* Structure of line. */
 typedef struct {              
-    char* name;
+    Name name;
     int num_stops;  
+    int position;               /* Position in the lines, when numbered. */
     List* links_list;              
     Values total_value;
+    long int removals;          /* Batch removals its values account for. */
+    int outdated;               /* If its values must be updated. */
+    int task;                   /* Bulk import task of its links, if any. */
+    struct view_t* view;        /* Text last presented, if still valid. */
 } Line;
 
 /* Structure of link. */
@@ -78,6 +236,317 @@ typedef struct {
     Values value;             
 } Link;
 
+/* Structure of network graph (edges grouped by origin stop). */
+typedef struct {
+    int num_stops;
+    int num_edges;
+    Stop** stops;               /* Stops by order of creation. */
+    int* first_edge;            /* First edge of each stop (and the end). */
+    int* edge_dest;             /* Destination stop of each edge. */
+    Values* edge_value;         /* Cost and duration of each edge. */
+    Line** edge_line;           /* Line of each edge. */
+} Graph;
+
+/* Structure of journey label. */
+typedef struct label_t {
+    Values value;               /* Cost and duration since the origin. */
+    int stop;
+    int edge;                   /* Edge used to reach the stop. */
+    struct label_t* pred;       /* Previous label (or next free label). */
+} Label;
+
+/* Structure of journey label pool. */
+typedef struct {
+    List* blocks;               /* Blocks of labels allocated so far. */
+    Label* free_label;          /* Pruned labels, ready to be reused. */
+    int used;                   /* Labels used in the last block. */
+} LabelPool;
+
+/* Structure of journey search. */
+typedef struct {
+    Graph* graph;
+    LabelPool* pool;
+    Heap* queue;                /* Labels yet to be settled. */
+    List* front;                /* Settled labels of the destination. */
+    double* best_duration;      /* Duration of each stop's last label. */
+    long int created;           /* Labels created. */
+    long int pruned;            /* Labels dominated. */
+} JourneySearch;
+
+/* Structure of search statistics (totals of the searches shown so far,
+   added to atomically, since the readers may share them). */
+typedef struct {
+    long int journeys;          /* Journey searches ('j'). */
+    long int created, pruned;   /* Labels of the journey searches. */
+    long int journey_ns;        /* Time of the journey searches. */
+    long int routes[2];         /* Route searches ('s'), plain or not. */
+    long int settled[2];        /* Stops settled by them. */
+    long int route_ns[2];       /* Time of them. */
+    long int builds;            /* Hierarchies built ('h'). */
+    long int build_ns;          /* Time of the hierarchies built. */
+} SearchStats;
+
+/* Structure of hierarchy edge (a link or a shortcut). */
+typedef struct {
+    int from, to;
+    Values value;
+    Line* line;                 /* Line of the link. */
+    int first, second;          /* Edges replaced by the shortcut. */
+} HierEdge;
+
+/* Structure of list of edge indexes. */
+typedef struct {
+    int* items;
+    int count;
+    int size;
+} EdgeList;
+
+/* Structure of stop queue (binary heap of stop indexes). */
+typedef struct {
+    int* heap;
+    int* pos;                   /* Position of each stop in the heap. */
+    int count;
+} StopQueue;
+
+/* Structure of contraction hierarchy (or plain network). */
+typedef struct {
+    int num_stops;
+    int num_edges;
+    int size_edges;
+    int shortcuts;
+    int contracted;             /* If the stops were contracted. */
+    long int settled;           /* Stops settled by the last search. */
+    long int memory;            /* Bytes used by the hierarchy. */
+    Stop** stops;               /* Stops by order of creation. */
+    HierEdge* edges;
+    int* rank;                  /* Contraction order of each stop. */
+    int *first_fwd, *fwd_edge;  /* Forward search edges of each stop. */
+    int *first_bwd, *bwd_edge;  /* Backward search edges of each stop. */
+    EdgeList *out_edges, *in_edges; /* Edges during the contraction. */
+    Values* dist;               /* Distance of each stop in each search. */
+    int* parent;                /* Edge used to reach each stop. */
+    int* reached;               /* Search in which each stop was reached. */
+    int search_id;
+    StopQueue *queue, *queue_bwd;
+} Hierarchy;
+
+/* Structure of spatial index node (k-d tree node). */
+typedef struct {
+    double point[3];            /* Position of the stop in the unit sphere. */
+    Stop* stop;
+    int left, right;            /* Children (before and after the split). */
+    int axis;                   /* Axis where the children are split. */
+    int removed;                /* If the stop was removed. */
+} SpatialNode;
+
+/* Structure of spatial index (k-d tree of the stops). */
+typedef struct {
+    SpatialNode* nodes;
+    int count;                  /* Nodes used, including removed ones. */
+    int size;                   /* Nodes allocated. */
+    int live;                   /* Nodes not removed. */
+    int root;
+    int rebuild_count;          /* Nodes that trigger a rebuild. */
+} SpatialIndex;
+
+/* Structure of stop found by a nearest stops query. */
+typedef struct {
+    Stop* stop;
+    double dist;                /* Squared chord to the query point. */
+} Neighbour;
+
+/* Structure of range tree entry. */
+typedef struct {
+    double coord[2];            /* Latitude and longitude of the stop. */
+    Stop* stop;                 /* NULL if the stop was removed. */
+} RangeEntry;
+
+/* Structure of range tree node (rectangle covering its children). */
+typedef struct {
+    double low[2], high[2];     /* Lowest and highest coordinates. */
+    int first, count;           /* Children (entries, if it's a leaf). */
+} RangeNode;
+
+/* Structure of range tree (packed R-tree). */
+typedef struct {
+    RangeEntry* entries;        /* Sorted so that each leaf is contiguous. */
+    RangeNode* nodes;           /* Leaves first, then each level. */
+    int count;                  /* Entries, including removed ones. */
+    int num_leaves;
+    int num_nodes;
+    int root;
+} RangeTree;
+
+/* Structure of range index (range trees of the stops). */
+typedef struct {
+    RangeTree* trees[RANGE_MAX_TREES];  /* Tree i has up to 2^i entries. */
+    int live;                   /* Entries not removed. */
+    int removed;                /* Entries removed since the last rebuild. */
+} RangeIndex;
+
+/* Structure of growing array of stops. */
+typedef struct {
+    Stop** items;
+    int count;
+    int size;
+} StopArray;
+
+/* Structure of distance columns (positions of the stops, one array per
+   coordinate, so that the distance kernels read them in bulk). */
+typedef struct columns_t {
+    double *x, *y, *z;          /* Positions in the unit sphere. */
+    double* dist;               /* Distances computed by the last query. */
+    Stop** stops;
+    int count;
+    int size;
+    void (*kernel)(struct columns_t*, double*, double*);
+} StopColumns;
+
+/* Type of distance kernel. */
+typedef void (*DistanceKernel)(StopColumns*, double*, double*);
+
+/* Structure of chunk of characters exchanged by the pipeline threads. */
+typedef struct {
+    char* data;
+    int length;
+    int offset;                 /* Characters already read. */
+    int last;                   /* If it ends the input or the output. */
+} Chunk;
+
+/* Structure of single producer, single consumer ring. */
+typedef struct {
+    void** slots;
+    unsigned long size;         /* Slots (a power of 2). */
+    char pad1[CACHE_LINE];      /* Keeps the head and tail apart. */
+    unsigned long head;         /* Pops so far (by the consumer). */
+    char pad2[CACHE_LINE];
+    unsigned long tail;         /* Pushes so far (by the producer). */
+    char pad3[CACHE_LINE];
+    int waiting;                /* If a thread is blocked until it changes. */
+    pthread_mutex_t lock;       /* Only taken to block or to wake. */
+    pthread_cond_t changed;
+} Ring;
+
+/* Structure of pipeline (threads and rings of the pipelined mode). */
+typedef struct {
+    pthread_t reader, writer;
+    Ring *input, *output;       /* Chunks to read and to write. */
+    Ring *free_in, *free_out;   /* Chunks given back. */
+    Chunk* reading;             /* Chunk being read by the main thread. */
+    Chunk* filling;             /* Chunk being filled by the reader. */
+    int input_done;             /* If the last chunk was read. */
+    int stop;                   /* If the reader must stop. */
+    int spins;                  /* Tries on a ring before yielding. */
+} Pipeline;
+
+/* Structure of imported command (a line of a network dump). */
+typedef struct {
+    int kind;                   /* Command ('p', 'c' or 'l'), or 0 if none. */
+    char *name, *orig, *dest;   /* Arguments, inside the dump. */
+    double first, second;       /* Coordinates, or cost and duration. */
+    Link* link;                 /* Link to add, once its names are found. */
+    Line* line;                 /* Line of the link. */
+    Stop* members[2];           /* Stops to associate with its line. */
+    int num_members;
+    int stream;                 /* Stream holding its message, if any. */
+    long int message, length;   /* Position and length of its message. */
+} ImportRecord;
+
+/* Structure of journal header. */
+typedef struct {
+    char magic[8];              /* JOURNAL_MAGIC, without the '\0'. */
+    unsigned int version;
+    unsigned int byte_order;    /* SNAPSHOT_BYTE_ORDER. */
+    unsigned int base;          /* Checksum of the snapshot it follows. */
+} JournalHeader;
+
+/* Structure of journal record header (the command follows it). */
+typedef struct {
+    unsigned int length;        /* Bytes of the command. */
+    unsigned int checksum;      /* Of the command. */
+} JournalRecord;
+
+/* Structure of journal (commands that changed the network since the last
+   checkpoint). */
+typedef struct {
+    FILE* file;
+    char* name;
+    char* snapshot;             /* Name of the checkpoint snapshot. */
+    unsigned int base;          /* Checksum of the checkpoint. */
+    char* record;               /* Record being written. */
+    int length, record_size;
+    long int pending;           /* Records not synced yet. */
+    long int since_checkpoint;  /* Records since the last checkpoint. */
+    long int group_size;        /* Records synced at once. */
+    long int checkpoint_every;  /* Records between checkpoints. */
+    long int written, syncs, checkpoints;
+} Journal;
+
+/* Structure of retired memory (freed once no reader may still hold it). */
+typedef struct retired_t {
+    void* ptr;
+    void (*destroy)(void*);
+    long int epoch;             /* Epoch it was retired in. */
+    struct retired_t* next;
+} Retired;
+
+/* Structure of grace periods (epochs entered by the readers that take no
+   locks, and the memory retired meanwhile by the single writer). */
+typedef struct epochs_t {
+    long int epoch;
+    long int* pinned;           /* Epoch of each reader (a cache line each). */
+    int num_readers;
+    Retired* retired;
+    long int retired_count, reclaimed;
+} Epochs;
+
+/* Structure of latency histogram (times of a command, in nanoseconds). */
+typedef struct {
+    long int counts[LATENCY_BUCKETS];
+    long int count, total;
+    long int min, max;          /* Shortest (-1 if none) and longest time. */
+} LatencyHistogram;
+
+/* Structure of latencies (histogram of each command and size class, each
+   created with its first time). */
+typedef struct {
+    LatencyHistogram* histograms[LATENCY_COMMANDS][LATENCY_CLASSES];
+} Latencies;
+
+/* Structure of the memory of a category (bytes and blocks allocated and not
+   freed, now and at their peak). */
+typedef struct {
+    long int bytes, blocks;
+    long int peak_bytes, peak_blocks;
+    long int allocations;       /* Blocks allocated so far. */
+} MemoryCategory;
+
+/* Structure of the memory accounts of the process. */
+typedef struct {
+    MemoryCategory categories[MEM_CATEGORIES];
+    long int bytes, peak_bytes; /* Of every category. */
+} MemoryAccount;
+
+/* Structure of traced event (written whole before its position is). */
+typedef struct {
+    long int position;          /* In the tracer, or -1 while written. */
+    char* name;
+    int phase;                  /* 'B'egin or 'E'nd. */
+    int command;                /* Letter of the command, or 0. */
+    long int size;              /* Of the object worked on. */
+    long int ns;
+    pthread_t thread;
+} TraceEvent;
+
+/* Structure of tracer (ring of the latest events, recorded by every thread
+   at once). */
+typedef struct {
+    TraceEvent events[TRACE_EVENTS_SIZE];
+    long int next;              /* Position of the next event. */
+    int enabled;
+    long int origin;            /* Time it was first enabled. */
+} Tracer;
+
 /* Structure of global system. */
 typedef struct {  
     long int command_lenght;    /* Current length of command line. */         
@@ -85,8 +554,217 @@ typedef struct {
     List* stops_list;           /* To store stops by order of creation. */
     Hashtable* stops_table;     /* To store all the stops by their name. */
     Hashtable* lines_table;     /* To store all the lines by their name. */ 
+    NameArena* names;           /* Long names of the stops and lines. */
+    Hierarchy* hierarchy;       /* Preprocessed network, if up to date. */
+    SpatialIndex* spatial;      /* To find the stops by their coordinates. */
+    RangeIndex* ranges;         /* To find the stops inside a region. */
+    StopColumns* columns;       /* To compute distances to every stop. */
+    long int stops_created;     /* Stops created so far. */
+    int batch;                  /* If a batch of commands is running. */
+    long int removals;          /* Stops removed from lines in batches. */
+    char* input;                /* Rest of the command line read ahead. */
+    FILE* out;                  /* Output of the reading commands. */
+    struct pool_t* workers;     /* Threads of the reading commands, if any. */
+    ImportRecord* importing;    /* Record of a bulk import being linked. */
+    Journal* journal;           /* Journal of the changes, if any. */
+    Epochs* epochs;             /* Of the readers taking no locks, if any. */
+    Latencies* latencies;       /* Of the commands, if they're timed. */
+    SearchStats* searches;      /* Of the journeys and routes. */
+    long int latency_size;      /* Of the object of the command timed. */
+    char* trace_file;           /* Where the events are exported at the end. */
 } System;
 
+/* Structure of query (reading command run by the worker pool). */
+typedef struct {
+    char* line;                 /* Command line, ending in '\n'. */
+    char *name, *option;        /* Arguments, inside the line, if any. */
+    struct view_t* view;        /* Line or stop named, if it exists. */
+    char* output;               /* Output of the command. */
+    size_t length;              /* Characters of the output. */
+} Query;
+
+
+/* Structure of worker pool (threads that run a sequence of reading commands
+   at once, on the same version of the network, while the main thread runs
+   the next commands). */
+typedef struct pool_t {
+    System* sys;
+    pthread_t* threads;
+    int num_threads;            /* Threads, including the main one. */
+    pthread_mutex_t lock;
+    pthread_cond_t start;       /* Signaled when a sequence is given. */
+    pthread_cond_t done;        /* Signaled when a sequence is finished. */
+    Query* queries;
+    int count;
+    int next;                   /* Next query to take (atomic). */
+    int finished;               /* Queries finished. */
+    int active;                 /* Threads taking queries. */
+    long int generation;        /* Sequences given so far. */
+    int stop;                   /* If the threads must stop. */
+    int running;                /* If a sequence wasn't written yet. */
+    struct versions_t* versions;    /* Versions listed by the sequences. */
+    struct version_t* version;  /* Version listed by the sequence, if any. */
+    FILE* out;                  /* Output, while the sequence runs. */
+    char* deferred;             /* Output of the commands run meanwhile. */
+    size_t deferred_length;
+} WorkerPool;
+
+/* Structure of deque of tasks (taken from the bottom by its thread, and
+   stolen from the top by the other threads). */
+typedef struct {
+    pthread_mutex_t lock;
+    int* tasks;
+    int top, bottom;
+} TaskDeque;
+
+/* Structure of work-stealing pool (threads running a set of tasks). */
+typedef struct {
+    int num_threads;
+    TaskDeque* deques;          /* Tasks left to each thread. */
+    void (*run)(void*, int, int);   /* Runs a task (data, task, thread). */
+    void* data;
+} StealPool;
+
+/* Structure of thread of a work-stealing pool. */
+typedef struct {
+    StealPool* pool;
+    int index;
+    pthread_t thread;
+} StealThread;
+
+/* Structure of bulk import (network dump imported in parallel). */
+typedef struct {
+    System* sys;
+    char* text;                 /* Contents of the dump. */
+    int num_chunks;
+    char** chunks;              /* Start of each chunk (and the end). */
+    ImportRecord** records;     /* Commands of each chunk. */
+    int* num_records;
+    int simple;                 /* If every command can be imported. */
+    ImportRecord*** links;      /* Links of each line, in order. */
+    int* num_links;
+    int num_lines, size_lines;
+    int num_threads;
+    FILE** streams;             /* Messages of each thread and the plan. */
+    char** outputs;
+    size_t* lengths;
+} Import;
+
+/* Structure of snapshot header (the sections follow it in this order). */
+typedef struct {
+    char magic[8];              /* SNAPSHOT_MAGIC, without the '\0'. */
+    unsigned int version;
+    unsigned int byte_order;    /* SNAPSHOT_BYTE_ORDER. */
+    unsigned int checksum;      /* Of the sections. */
+    unsigned int covers;        /* Base of the journal it holds, if any. */
+    unsigned int num_stops, num_lines, num_links, num_members;
+    unsigned int names_size;    /* Bytes of the names. */
+    unsigned int padding;       /* Keeps the sections aligned. */
+} SnapshotHeader;
+
+/* Structure of snapshot stop. */
+typedef struct {
+    double latitude, longitude;
+    unsigned int name;          /* Position in the names. */
+    unsigned int first_line;    /* Its lines, in the members. */
+    unsigned int num_lines;
+    unsigned int sorted;        /* If its lines are sorted. */
+} SnapshotStop;
+
+/* Structure of snapshot line. */
+typedef struct {
+    double cost, duration;      /* Total values of the route. */
+    unsigned int name;          /* Position in the names. */
+    unsigned int first_link;    /* Its route, in the links. */
+    unsigned int num_links;
+    unsigned int num_stops;
+} SnapshotLine;
+
+/* Structure of snapshot link (its stops are numbered by creation). */
+typedef struct {
+    double cost, duration;
+    unsigned int orig, dest;
+} SnapshotLink;
+
+/* Structure of snapshot sections (in memory, or mapped from a file). */
+typedef struct {
+    SnapshotStop* stops;
+    SnapshotLine* lines;
+    SnapshotLink* links;
+    unsigned int* members;      /* Lines of each stop, by their number. */
+    char* names;                /* Names of the stops and lines. */
+    unsigned int num_stops, num_lines, num_links, num_members;
+    unsigned int names_size;
+} Snapshot;
+
+/* Structure of reader-writer lock (many readers or a single writer, the
+   writers waiting going first). */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t readers_ok, writers_ok;
+    int readers;                /* Readers holding it. */
+    int writer;                 /* If a writer holds it. */
+    int writers_waiting;
+} RWLock;
+
+/* Structure of server client (connection to the local server, handled by
+   a single thread at a time: the loop, or the thread running its command). */
+typedef struct {
+    int fd;
+    char* input;                /* Characters read, not run yet. */
+    int length, size;
+    int ended;                  /* If its input ended. */
+    char* output;               /* Reply not sent yet, if any. */
+    size_t output_length, sent;
+    int closing;                /* If it's closed once the reply is sent. */
+} Client;
+
+/* Structure of local server (system serving the clients of a socket). */
+typedef struct {
+    System* sys;
+    char* path;                 /* Of the socket. */
+    int listener, epoll, signals;
+    RWLock lock;                /* Exclusive to add or remove lines or stops. */
+    pthread_mutex_t stripes[SERVER_STRIPES]; /* Of stops' lines, by order. */
+    pthread_mutex_t line_stripes[SERVER_STRIPES]; /* Of routes, by name. */
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_ready;
+    List* queue;                /* Clients with a command to run. */
+    Client** clients;           /* By their descriptor. */
+    int size_clients;
+    pthread_t* threads;
+    int num_threads;
+    int stop;                   /* If the threads must stop. */
+    long int accepted, commands, shared, exclusive;
+    long int edits;             /* Of the shared commands, editing lines. */
+    long int lock_free;         /* Commands that took no locks. */
+    int readers;                /* Threads numbered so far. */
+    int plain_input;            /* If plain arguments are read as they are. */
+} Server;
+
+/* Structure of view (text of a line or a stop as the reading commands
+   present it, never changed once built, and shared by whoever holds it). */
+typedef struct view_t {
+    int refs;                   /* Holders: its object, versions, queries. */
+    char* text;                 /* Its parts, one after the other. */
+    size_t start[VIEW_PARTS + 1];   /* Where each part starts and ends. */
+} View;
+
+/* Structure of version (views of every line and stop, listed by reading
+   commands while the network keeps changing). */
+typedef struct version_t {
+    View** lines;               /* By order of creation. */
+    View** stops;               /* By order of creation. */
+    int num_lines, num_stops;
+} Version;
+
+/* Structure of version set (the version published for the last sequence
+   of reading commands, freed once the next one replaces it). */
+typedef struct versions_t {
+    Version* current;           /* Last version published. */
+    long int published, reused, replaced;
+    double publish_ms;          /* Spent publishing, in wall time. */
+} VersionSet;
 
 /* ------------------------------- Prototypes ------------------------------- */
 
@@ -95,6 +773,12 @@ typedef struct {
 
 void* tryMalloc(unsigned int alloc);
 
+void* tryRealloc(void* ptr, unsigned int alloc);
+
+void* tagMalloc(unsigned int alloc, int tag);
+
+void tagFree(void* ptr, unsigned int alloc, int tag);
+
 System* systemInit();
 
 void exitProgram(System *sys);
@@ -108,6 +792,8 @@ void removeAllStopsSystem(System *sys);
 
 /* input.c */
 
+int nextChar(System* sys);
+
 int hasArgs(System* sys);
 
 int getArgWithSpaces(System* sys, char* str);
@@ -123,6 +809,10 @@ void untilEndOfLine(System* sys);
 
 int handleCommand(System *sys);
 
+int runCommand(System *sys, int c);
+
+void runCommands(System *sys);
+
 void handleLineCommand(System *sys);
 
 void handleStopCommand(System *sys);
@@ -137,24 +827,50 @@ void handleRemoveStopCommand(System *sys);
 
 void handleClearSystemCommand(System *sys);
 
+void handleJourneyCommand(System *sys);
+
+void handleHierarchyCommand(System *sys);
+
+void handleRouteCommand(System *sys);
+
+void handleNearestCommand(System *sys);
+
+void handleBoxCommand(System *sys);
+
+void handleWithinCommand(System *sys);
+
+void handleDistanceCommand(System *sys);
+
+void handleBatchCommand(System *sys);
+
+int handleImportCommand(System *sys);
+
+void handleSaveCommand(System *sys);
+
+void handleLoadCommand(System *sys);
+
+void handleStatsCommand(System *sys);
+
 
 /* lines.c */
 
 void listLines(System *sys);
 
+void printLine(FILE* out, Line* line);
+
 void addShowLine(System *sys, char* name, int sort);
 
 Line* getLine(System *sys, char* name);
 
-char* getLineName(void* line);
+Name* getLineName(void* line);
 
 void addLine(System *sys, char* name);
 
-Line* populateLine(Line* new_line, char* name);
+Line* populateLine(Line* new_line, char* name, NameArena* names);
 
-void printLineStops(Line *line, int sort);
+void printLineStops(FILE* out, Line *line, int sort);
 
-int assertSortOption(char opt[]);
+int assertSortOption(FILE* out, char opt[]);
 
 void removeLine(System *sys, char* name);
 
@@ -171,17 +887,24 @@ void deleteLine(void* line);
 
 void listStops(System *sys);
 
+void printStop(FILE* out, Stop* stop);
+
 void showStop(System *sys, char* name);
 
+void printStopCoordinates(FILE* out, Stop* stop);
+
 Stop* getStop(System *sys, char* name);
 
-char* getStopName(void* stop);
+Name* getStopName(void* stop);
 
 void addStop(System *sys, char* name, double latitude, double longitude);
 
-Stop* populateStop(Stop* new_stop, char* name, double lat, double lon);
+Stop* populateStop(Stop* new_stop, char* name, double lat, double lon,
+                                                        NameArena* names);
 
-void showStopLines(Stop* stop);
+void printIntersection(FILE* out, Stop* stop);
+
+void showStopLines(FILE* out, Stop* stop);
 
 int compareLines(void* first, void* second);
 
@@ -189,7 +912,9 @@ void removeStop(System *sys, char* name);
 
 void rearrangeAll(System *sys, Stop* stop);
 
-void rearrangeLine(Line* line, Stop* stop);
+int rearrangeLine(Line* line, Stop* stop, int update);
+
+Stop** routeStops(Line* line, int* count);
 
 void deleteStopFromBeginning(Line* line, Stop* stop);
 
@@ -215,19 +940,651 @@ Link* populateLink(Link* new_link, Line* line, Stop* orig, Stop* dest);
 
 int processLinkData(Link* new_link);
 
-void addFirstLink(Link* new_link);
+void addLink(System *sys, Link* new_link);
+
+void addFirstLink(System *sys, Link* new_link);
 
-void linkPush(Link* new_link);
+void linkPush(System *sys, Link* new_link);
 
-void linkAppend(Link* new_link);
+void linkAppend(System *sys, Link* new_link);
 
-int assertNegativeValue(Values values);
+int assertNegativeValue(FILE* out, Values values);
 
-void addLineToStop(Line* line, Stop* stop);
+void addLineToStop(System *sys, Line* line, Stop* stop);
 
 void removeLink(Line* line, Link* to_delete, Node* node);
 
 void removeLineFromStop(Line* line, Stop* stop);
 
 
+
+/* graph.c */
+
+Graph* buildGraph(System *sys);
+
+void destroyGraph(Graph* graph);
+
+
+/* journeys.c */
+
+void showJourneys(System *sys, char* orig_name, char* dest_name);
+
+JourneySearch* createJourneySearch(System *sys);
+
+void searchJourneys(JourneySearch* search, int orig, int dest);
+
+int isLabelDominated(JourneySearch* search, int stop, Values value, int dest);
+
+Label* addLabel(JourneySearch* search, Label* pred, int stop, int edge, 
+                                                            Values value);
+
+int compareLabels(void* first, void* second);
+
+void printJourney(FILE* out, Graph* graph, Label* label);
+
+void destroyJourneySearch(JourneySearch* search);
+
+LabelPool* createLabelPool();
+
+Label* newLabel(LabelPool* pool);
+
+void freeLabel(LabelPool* pool, Label* label);
+
+void destroyLabelPool(LabelPool* pool);
+
+SearchStats* createSearchStats();
+
+void printSearchStats(FILE* out, SearchStats* stats);
+
+
+
+/* hierarchy.c */
+
+void showRoute(System *sys, char* orig_name, char* dest_name);
+
+void buildSystemHierarchy(System *sys);
+
+void printHierarchyStats(FILE* out, System *sys);
+
+void invalidateHierarchy(System *sys);
+
+int isStopInHierarchy(Hierarchy* hier, Stop* stop);
+
+Hierarchy* createHierarchy(System *sys);
+
+int addHierEdge(Hierarchy* hier, int from, int to, Values value, Line* line,
+                                                    int first, int second);
+
+void indexHierarchy(Hierarchy* hier);
+
+void destroyHierarchy(Hierarchy* hier);
+
+void contractHierarchy(Hierarchy* hier);
+
+int contractStop(Hierarchy* hier, int stop, int simulate);
+
+void witnessSearch(Hierarchy* hier, int orig, int skip, Values limit, 
+                                                        int max_settled);
+
+void dropContractedEdges(Hierarchy* hier, EdgeList* list, int out);
+
+EdgeList* createEdgeLists(int num);
+
+void addToEdgeLists(Hierarchy* hier, int edge);
+
+void appendEdge(EdgeList* list, int edge);
+
+void destroyEdgeLists(EdgeList* lists, int num);
+
+int searchRoute(Hierarchy* hier, int orig, int dest);
+
+void relaxRouteEdges(Hierarchy* hier, int stop, int* meet, Values* best);
+
+void printRoute(FILE* out, Hierarchy* hier, int orig, int dest, int meet);
+
+void unpackEdge(Hierarchy* hier, List* path, int edge, int to_end);
+
+void startSearch(Hierarchy* hier);
+
+void reachStop(Hierarchy* hier, StopQueue* queue, int stop, Values dist, 
+                                                                int edge);
+
+int compareValues(Values first, Values second);
+
+int compareDoubles(double first, double second);
+
+Values addValues(Values first, Values second);
+
+Values zeroValues();
+
+StopQueue* createStopQueue(int num);
+
+void stopQueuePush(StopQueue* queue, int stop, Values* values);
+
+int stopQueuePop(StopQueue* queue, Values* values);
+
+void clearStopQueue(StopQueue* queue);
+
+void destroyStopQueue(StopQueue* queue);
+
+
+
+/* geography.c */
+
+void geoPosition(double latitude, double longitude, double point[3]);
+
+double geoChord(double first[3], double second[3]);
+
+double geoChordToKm(double chord);
+
+double geoDistance(double lat1, double lon1, double lat2, double lon2);
+
+double geoSin(double x);
+
+double geoCos(double x);
+
+double geoSqrt(double x);
+
+double geoAsin(double x);
+
+
+/* spatial.c */
+
+void showNearestStops(System *sys, double latitude, double longitude, int k);
+
+int nearestStops(SpatialIndex* index, double latitude, double longitude,
+                                                int k, Neighbour* result);
+
+void searchNearest(SpatialIndex* index, int node, double point[3], int k,
+                                            Heap* best, Neighbour* pool);
+
+void keepNeighbour(Heap* best, Neighbour* pool, int k, Stop* stop,
+                                                            double dist);
+
+int popNeighbours(Heap* best, Neighbour* pool, Neighbour* result);
+
+int compareFarthest(void* first, void* second);
+
+int nearestStopsScan(System *sys, double latitude, double longitude, int k,
+                                                        Neighbour* result);
+
+SpatialIndex* createSpatialIndex();
+
+void spatialInsert(SpatialIndex* index, Stop* stop);
+
+void spatialInsertMany(SpatialIndex* index, Stop** stops, int count);
+
+void spatialRemove(SpatialIndex* index, Stop* stop);
+
+void rebuildSpatialIndex(SpatialIndex* index);
+
+int buildSpatialTree(SpatialIndex* index, int first, int last);
+
+void selectSpatialMedian(SpatialNode* nodes, int first, int last, int k,
+                                                                int axis);
+
+int spatialMaxDepth(int count);
+
+void destroySpatialIndex(SpatialIndex* index);
+
+
+/* ranges.c */
+
+void showStopsInBox(System *sys, double lat1, double lon1, double lat2,
+                                                            double lon2);
+
+void showStopsWithin(System *sys, double latitude, double longitude,
+                                                            double km);
+
+void stopsWithin(RangeIndex* index, double latitude, double longitude,
+                                            double km, StopArray* found);
+
+void rangeSearch(RangeIndex* index, double low[2], double high[2],
+                                                        StopArray* found);
+
+void searchRangeTree(RangeTree* tree, int node, double low[2],
+                                        double high[2], StopArray* found);
+
+RangeIndex* createRangeIndex();
+
+void rangeInsert(RangeIndex* index, Stop* stop);
+
+void rangeRemove(RangeIndex* index, Stop* stop);
+
+void rebuildRangeIndex(RangeIndex* index);
+
+void rangeInsertMany(RangeIndex* index, Stop** stops, int num_stops);
+
+int takeRangeEntries(RangeTree* tree, RangeEntry* entries, int count);
+
+void destroyRangeIndex(RangeIndex* index);
+
+long int rangeIndexMemory(RangeIndex* index);
+
+RangeTree* buildRangeTree(RangeEntry* entries, int count, int level);
+
+void packRangeNode(RangeTree* tree, int node, int first, int count,
+                                                                int leaf);
+
+int compareLongitudes(const void* first, const void* second);
+
+int compareLatitudes(const void* first, const void* second);
+
+void destroyRangeTree(RangeTree* tree);
+
+StopArray* createStopArray();
+
+void appendStop(StopArray* array, Stop* stop);
+
+void sortStopArray(StopArray* array);
+
+int compareCreation(const void* first, const void* second);
+
+void destroyStopArray(StopArray* array);
+
+
+
+/* distances.c */
+
+void showStopsInDistance(System *sys, double latitude, double longitude,
+                                                                double km);
+
+StopColumns* createStopColumns();
+
+void columnsInsert(StopColumns* columns, Stop* stop);
+
+void columnsRemove(StopColumns* columns, Stop* stop);
+
+void destroyStopColumns(StopColumns* columns);
+
+DistanceKernel selectDistanceKernel();
+
+void asinCoefficients(double coef[DIST_SERIES_TERMS]);
+
+double columnDistance(StopColumns* columns, int i, double point[3],
+                                        double coef[DIST_SERIES_TERMS]);
+
+void distancesScalar(StopColumns* columns, double point[3], double* dist);
+
+void distancesSSE2(StopColumns* columns, double point[3], double* dist);
+
+void distancesAVX2(StopColumns* columns, double point[3], double* dist);
+
+
+/* batch.c */
+
+void beginBatch(System *sys);
+
+void commitBatch(System *sys);
+
+void refreshLineValues(System *sys, Line* line);
+
+void cleanStopLines(Stop* stop);
+
+void rearrangeStopLines(System *sys, Stop* stop);
+
+
+/* pipeline.c */
+
+void runPipeline(System *sys);
+
+void* readerThread(void* arg);
+
+void* writerThread(void* arg);
+
+ssize_t pipelineRead(void* cookie, char* buf, size_t size);
+
+ssize_t pipelineWrite(void* cookie, const char* buf, size_t size);
+
+Pipeline* createPipeline();
+
+Chunk* takeChunk(Pipeline* pipeline, Ring* ring);
+
+int waitPush(Pipeline* pipeline, Ring* ring, Chunk* chunk);
+
+Chunk* waitPop(Pipeline* pipeline, Ring* ring);
+
+void destroyPipeline(Pipeline* pipeline);
+
+Chunk* createChunk();
+
+void destroyChunk(Chunk* chunk);
+
+Ring* createRing(unsigned long size);
+
+int ringPush(Ring* ring, void* data);
+
+void* ringPop(Ring* ring);
+
+void blockOnRing(Ring* ring, int push);
+
+void wakeRing(Ring* ring);
+
+void unlockRing(void* ring);
+
+void destroyRing(Ring* ring);
+
+
+/* workers.c */
+
+void runWorkers(System *sys);
+
+char* readCommandLine();
+
+int isReadingCommand(System *sys, char* line);
+
+int countPlainArgs(char* line);
+
+Line* getCommandLine(System *sys, char* line);
+
+int runCommandLine(System *sys, char* line);
+
+WorkerPool* createWorkerPool(System *sys, int num_threads);
+
+void runQueries(WorkerPool* pool, Query* queries, int count);
+
+void prepareQueries(WorkerPool* pool, Query* queries, int count);
+
+void finishQueries(WorkerPool* pool, int wait);
+
+void* workerThread(void* arg);
+
+int takeQueries(WorkerPool* pool, Query* queries, int count);
+
+void runQuery(Version* version, Query* query);
+
+void writeQueries(FILE* out, Query* queries, int count);
+
+void destroyWorkerPool(WorkerPool* pool);
+
+
+/* import.c */
+
+int importDump(System *sys, char* file_name);
+
+char* readDump(char* file_name);
+
+int replayDump(System *sys, char* text);
+
+Import* createImport(System *sys, char* text);
+
+int parseDump(Import* import);
+
+void parseChunkTask(void* data, int chunk, int thread);
+
+int parseDumpLine(char* line, ImportRecord* record);
+
+int scanArg(char** ptr, char** arg);
+
+int checkNewLines(Import* import);
+
+int compareNames(const void* first, const void* second);
+
+void planImport(Import* import);
+
+void addImportLink(Import* import, ImportRecord* record);
+
+void linkLineTask(void* data, int task, int thread);
+
+void memberTask(void* data, int part, int thread);
+
+void writeImportMessages(Import* import);
+
+void destroyImport(Import* import);
+
+void runStealing(int num_threads, int num_tasks,
+                            void (*run)(void*, int, int), void* data);
+
+void* stealThread(void* arg);
+
+int popTask(TaskDeque* deque);
+
+int stealTask(StealPool* pool, int thread);
+
+
+/* snapshot.c */
+
+int saveSnapshot(System *sys, char* file_name);
+
+void prepareSnapshot(System *sys);
+
+int writeSnapshot(System *sys, FILE* file);
+
+int writeSection(FILE* file, void* data, unsigned int count, size_t size);
+
+void fillSnapshot(System *sys, SnapshotHeader* header, Snapshot* snap);
+
+int loadSnapshot(System *sys, char* file_name);
+
+int readSnapshotHeader(char* file_name, SnapshotHeader* header);
+
+int mapSnapshot(char* data, long int size, Snapshot* snap);
+
+int checkSnapshot(Snapshot* snap);
+
+void rebuildSnapshot(System *sys, Snapshot* snap);
+
+void resizeHashtable(Hashtable* hash, unsigned int count);
+
+unsigned int snapshotChecksum(Snapshot* snap);
+
+unsigned int checksumBytes(unsigned int hash, void* data, unsigned long size);
+
+
+/* journal.c */
+
+Journal* openJournal(System *sys, char* file_name);
+
+int recoverJournal(System *sys, Journal* journal, long int* replayed);
+
+FILE* startJournal(Journal* journal);
+
+long int replayJournal(System *sys, char* data, long int size,
+                                                        long int* valid);
+
+char* readJournal(char* file_name, long int* size);
+
+int replayRecord(System *sys, char* data, unsigned long length);
+
+int replayLink(System *sys, char* data, char* end);
+
+char* takeName(char** ptr, char* end);
+
+int takeValues(char** ptr, char* end, double values[2]);
+
+void journalName(System *sys, char command, char* name);
+
+void journalStop(System *sys, char* name, double latitude, double longitude);
+
+void journalLink(System *sys, Link* link);
+
+void journalClear(System *sys);
+
+int beginRecord(System *sys, char command);
+
+void putName(Journal* journal, char* name);
+
+void putValue(Journal* journal, double value);
+
+void putBytes(Journal* journal, void* data, int size);
+
+void endRecord(Journal* journal);
+
+void syncJournal(Journal* journal);
+
+void checkpointJournal(System *sys);
+
+void closeJournal(Journal* journal);
+
+void destroyJournal(Journal* journal);
+
+
+/* versions.c */
+
+VersionSet* createVersionSet();
+
+Version* publishVersion(System *sys, VersionSet* set);
+
+void destroyVersion(Version* version);
+
+void destroyVersionSet(VersionSet* set);
+
+View* lineView(System *sys, Line* line);
+
+View* stopView(Stop* stop);
+
+View* createView(FILE** out);
+
+void writeView(FILE* out, View* view, int part);
+
+void listViews(FILE* out, View** views, int count, int part);
+
+void releaseView(View* view);
+
+void dropView(View** view);
+
+
+/* server.c */
+
+void runServer(System *sys, char* path, int num_threads);
+
+Server* createServer(System *sys, char* path, int num_threads);
+
+int openListener(char* path);
+
+void serverLoop(Server* server);
+
+void acceptClients(Server* server);
+
+int hasOutput(Server* server, Client* client);
+
+void readClient(Server* server, Client* client);
+
+int nextCommand(Client* client);
+
+void queueClient(Server* server, Client* client);
+
+void* serverThread(void* arg);
+
+void serveClient(Server* server, Client* client, int reader);
+
+int runServerCommand(Server* server, char* line, FILE* out, int reader);
+
+int isStopLookup(Server* server, char* line);
+
+void lookupStop(Server* server, char* line, FILE* out, int reader);
+
+int isSharedEdit(System *sys, char* line);
+
+void runReadingCommand(Server* server, System *view);
+
+void listLockedLines(Server* server, System *view);
+
+void runLinkCommand(Server* server, System *view);
+
+void lockAllStripes(Server* server, int lock);
+
+void lockStops(Server* server, Stop* first, Stop* second, int lock);
+
+pthread_mutex_t* lineLock(Server* server, Line* line);
+
+void writeClient(Server* server, Client* client);
+
+int sendOutput(Client* client);
+
+void rearmClient(Server* server, Client* client, int events);
+
+void closeClient(Server* server, Client* client);
+
+void destroyServer(Server* server);
+
+void initRWLock(RWLock* rw);
+
+void readLock(RWLock* rw);
+
+void readUnlock(RWLock* rw);
+
+void writeLock(RWLock* rw);
+
+void writeUnlock(RWLock* rw);
+
+void destroyRWLock(RWLock* rw);
+
+
+/* epochs.c */
+
+Epochs* createEpochs(int num_readers);
+
+void enterEpoch(Epochs* epochs, int reader);
+
+void leaveEpoch(Epochs* epochs, int reader);
+
+void retireMemory(Epochs* epochs, void* ptr, void (*destroy)(void*));
+
+void reclaimMemory(Epochs* epochs);
+
+void destroyEpochs(Epochs* epochs);
+
+
+/* latency.c */
+
+Latencies* createLatencies();
+
+long int latencyClock();
+
+int latencyBucket(long int ns);
+
+long int bucketLimit(int bucket);
+
+int sizeClass(long int size);
+
+LatencyHistogram* getHistogram(Latencies* latencies, int command,
+                                                            int size_class);
+
+void recordLatency(Latencies* latencies, int command, long int size,
+                                                                long int ns);
+
+long int latencyPercentile(long int* counts, long int count, long int max,
+                                                            double fraction);
+
+void printHistogram(FILE* out, LatencyHistogram* histogram, int command,
+                                                            int size_class);
+
+void printLatencies(FILE* out, Latencies* latencies);
+
+void destroyLatencies(Latencies* latencies);
+
+
+/* memory.c */
+
+MemoryAccount* memoryAccount();
+
+void raisePeak(long int* peak, long int value);
+
+void countAllocation(int tag, long int bytes);
+
+void countFree(int tag, long int bytes);
+
+void freeNode(void* node);
+
+void freeHashElem(void* elem);
+
+long int residentMemory();
+
+void printMemory(FILE* out);
+
+
+/* trace.c */
+
+Tracer* tracer();
+
+void enableTrace(int enabled);
+
+void traceEvent(char* name, int phase, int command, long int size);
+
+int traceThread(pthread_t* threads, int* count, pthread_t thread);
+
+int exportTrace(char* file_name);
+
+
 #endif
@@ -0,0 +1,151 @@
+/**
+ * IAED-23 Project 2
+ * File: memory.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the accounting of the memory of the network,
+ * by category: stops, lines, links, list nodes, hash elements, names and
+ * hashtables. Their memory is allocated by 'tagMalloc' and freed by
+ * 'tagFree', which count the bytes and blocks of each category, now and at
+ * their peak. The allocations have no system to count them in, so the
+ * accounts are the process's, counted by every thread at once. Presented by
+ * the 'z memory' command, next to the resident memory of the process, so
+ * that the memory of other structures and of the allocator shows apart.
+*/
+
+/* Resource usage (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+#include <sys/resource.h>
+
+
+/**
+ * Returns the memory accounts of the process.
+*/
+MemoryAccount* memoryAccount() {
+
+    static MemoryAccount account;
+
+    return &account;
+}
+
+/**
+ * Raises the given peak to the given value, if it's higher.
+*/
+void raisePeak(long int* peak, long int value) {
+
+    long int seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while (value > seen && !__atomic_compare_exchange_n(peak, &seen, value,
+                                NO, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+}
+
+/**
+ * Counts a block of the given bytes allocated in the given category.
+*/
+void countAllocation(int tag, long int bytes) {
+
+    MemoryAccount* account = memoryAccount();
+    MemoryCategory* category = &account->categories[tag];
+
+    raisePeak(&category->peak_bytes, __atomic_add_fetch(&category->bytes,
+                                                    bytes, __ATOMIC_RELAXED));
+    raisePeak(&category->peak_blocks, __atomic_add_fetch(&category->blocks,
+                                                    1, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&category->allocations, 1, __ATOMIC_RELAXED);
+    raisePeak(&account->peak_bytes, __atomic_add_fetch(&account->bytes,
+                                                    bytes, __ATOMIC_RELAXED));
+}
+
+/**
+ * Counts a block of the given bytes of the given category freed.
+*/
+void countFree(int tag, long int bytes) {
+
+    MemoryAccount* account = memoryAccount();
+    MemoryCategory* category = &account->categories[tag];
+
+    __atomic_sub_fetch(&category->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&category->blocks, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&account->bytes, bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * Frees the given list node, counting it. Given to those freeing nodes
+ * later, like 'free'.
+*/
+void freeNode(void* node) {
+
+    tagFree(node, sizeof(Node), MEM_NODE);
+}
+
+/**
+ * Frees the given hash element, counting it. Given to those freeing
+ * elements later, like 'free'.
+*/
+void freeHashElem(void* elem) {
+
+    tagFree(elem, sizeof(HashElem), MEM_HASH_ELEM);
+}
+
+/**
+ * Returns the resident memory of the process, in kilobytes, or 0 if it
+ * can't be read (it's read from /proc, in Linux).
+*/
+long int residentMemory() {
+
+    FILE* statm = fopen("/proc/self/statm", "r");
+    long int size, resident = 0;
+
+    if (statm == NULL)
+        return 0;
+
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+
+    fclose(statm);
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Presents the memory accounts in the 'out' stream: a line for each
+ * category, with its bytes and blocks now and at their peak, the blocks
+ * allocated so far and the bytes of each block, and a line with the whole
+ * memory accounted, next to the resident memory of the process, now and at
+ * its peak.
+*/
+void printMemory(FILE* out) {
+
+    MemoryAccount* account = memoryAccount();
+    MemoryCategory* category;
+    char* names[MEM_CATEGORIES] = MEM_CATEGORY_NAMES;
+    struct rusage usage;
+    long int bytes, blocks, resident = residentMemory();
+    int tag;
+
+    for (tag = 0; tag < MEM_CATEGORIES; tag++) {
+
+        category = &account->categories[tag];
+        bytes = __atomic_load_n(&category->bytes, __ATOMIC_RELAXED);
+        blocks = __atomic_load_n(&category->blocks, __ATOMIC_RELAXED);
+
+        fprintf(out, MEMORY_STATS, names[tag], bytes, blocks,
+                __atomic_load_n(&category->peak_bytes, __ATOMIC_RELAXED),
+                __atomic_load_n(&category->peak_blocks, __ATOMIC_RELAXED),
+                __atomic_load_n(&category->allocations, __ATOMIC_RELAXED),
+                blocks == 0 ? 0.0 : (double)bytes / blocks);
+    }
+
+    /* The peak is updated by the kernel now and then, behind the present. */
+    getrusage(RUSAGE_SELF, &usage);
+
+    if (usage.ru_maxrss < resident)
+        usage.ru_maxrss = resident;
+
+    fprintf(out, MEMORY_TOTAL,
+            __atomic_load_n(&account->bytes, __ATOMIC_RELAXED),
+            __atomic_load_n(&account->peak_bytes, __ATOMIC_RELAXED),
+            resident, usage.ru_maxrss);
+}
@@ -0,0 +1,523 @@
+/**
+ * IAED-23 Project 2
+ * File: pipeline.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the pipelined mode,
+ * where a reader thread reads the commands, the main thread runs them and
+ * a writer thread writes their output. The threads exchange chunks of
+ * characters through lock-free single producer, single consumer rings. A
+ * thread that waits on a ring for long blocks until the other one wakes
+ * it up.
+*/
+
+/* The standard streams are replaced with custom streams (a GNU extension). */
+#define _GNU_SOURCE
+
+#include "main.h"
+
+
+/* ---------------------------- Pipelined mode ------------------------------ */
+
+/**
+ * Runs the commands until the 'q' command like 'main', in the pipelined
+ * mode. The standard input and output are replaced by streams that take
+ * and give chunks to the reader and writer threads, so the commands run
+ * unchanged and their output keeps its order.
+*/
+void runPipeline(System *sys) {
+
+    Pipeline* pipeline = createPipeline();
+    cookie_io_functions_t input = {NULL, NULL, NULL, NULL};
+    cookie_io_functions_t output = {NULL, NULL, NULL, NULL};
+    FILE *original_in = stdin, *original_out = stdout;
+    Chunk* chunk;
+
+    input.read = pipelineRead;
+    output.write = pipelineWrite;
+
+    fflush(stdout);
+    stdin = fopencookie(pipeline, "r", input);
+    stdout = fopencookie(pipeline, "w", output);
+    setvbuf(stdin, NULL, _IOFBF, PIPE_CHUNK_SIZE);
+    setvbuf(stdout, NULL, _IOFBF, PIPE_CHUNK_SIZE);
+    sys->out = stdout;
+
+    pthread_create(&pipeline->reader, NULL, readerThread, pipeline);
+    pthread_create(&pipeline->writer, NULL, writerThread, pipeline);
+
+    runCommands(sys);
+
+    /* The reader may be waiting for input that will never be used. */
+    __atomic_store_n(&pipeline->stop, YES, __ATOMIC_RELEASE);
+    pthread_cancel(pipeline->reader);
+    pthread_join(pipeline->reader, NULL);
+
+    /* The writer stops after writing the last chunk. */
+    fclose(stdout);
+    chunk = takeChunk(pipeline, pipeline->free_out);
+    chunk->last = YES;
+    waitPush(pipeline, pipeline->output, chunk);
+    pthread_join(pipeline->writer, NULL);
+
+    fclose(stdin);
+    stdin = original_in;
+    stdout = original_out;
+    sys->out = stdout;
+
+    destroyPipeline(pipeline);
+}
+
+/**
+ * Reads the standard input into chunks, which are given to the main thread.
+ * Each chunk ends with a complete command, if it fits, and the rest of the
+ * last line goes to the next chunk. The last chunk is empty.
+*/
+void* readerThread(void* arg) {
+
+    Pipeline* pipeline = arg;
+    Chunk *chunk, *next;
+    int count, end;
+
+    chunk = pipeline->filling = takeChunk(pipeline, pipeline->free_in);
+
+    while (!__atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE)) {
+
+        count = read(STDIN_FILENO, chunk->data + chunk->length,
+                                        PIPE_CHUNK_SIZE - chunk->length);
+
+        if (count <= 0)
+            break;
+
+        chunk->length += count;
+
+        /* Find the end of the last complete command. */
+        for (end = chunk->length; end > 0 && chunk->data[end - 1] != '\n';
+                                                                    end--) { }
+
+        if (end == 0 && chunk->length < PIPE_CHUNK_SIZE)
+            continue;
+
+        if (end == 0)
+            end = chunk->length;
+
+        if ((next = takeChunk(pipeline, pipeline->free_in)) == NULL)
+            return NULL;
+
+        next->length = chunk->length - end;
+        memcpy(next->data, chunk->data + end, next->length);
+        chunk->length = end;
+
+        /* The chunk being filled is freed with the pipeline if the
+           thread is cancelled. */
+        pipeline->filling = next;
+
+        if (!waitPush(pipeline, pipeline->input, chunk)) {
+            destroyChunk(chunk);
+            return NULL;
+        }
+
+        chunk = next;
+    }
+
+    /* Whatever is left, and then the end of the input. */
+    if (chunk->length != 0) {
+
+        if ((next = takeChunk(pipeline, pipeline->free_in)) == NULL)
+            return NULL;
+
+        pipeline->filling = next;
+
+        if (!waitPush(pipeline, pipeline->input, chunk)) {
+            destroyChunk(chunk);
+            return NULL;
+        }
+
+        chunk = next;
+    }
+
+    chunk->last = YES;
+
+    if (waitPush(pipeline, pipeline->input, chunk))
+        pipeline->filling = NULL;
+
+    return NULL;
+}
+
+/**
+ * Writes the chunks given by the main thread to the standard output, until
+ * the last one, giving them back.
+*/
+void* writerThread(void* arg) {
+
+    Pipeline* pipeline = arg;
+    Chunk* chunk;
+    int done, count, last = NO;
+
+    while (!last) {
+
+        chunk = waitPop(pipeline, pipeline->output);
+        last = chunk->last;
+
+        for (done = 0; done < chunk->length; done += count)
+            if ((count = write(STDOUT_FILENO, chunk->data + done,
+                                                chunk->length - done)) < 0)
+                break;
+
+        chunk->length = 0;
+        waitPush(pipeline, pipeline->free_out, chunk);
+    }
+
+    return NULL;
+}
+
+/**
+ * Reads up to 'size' characters of the chunks given by the reader thread
+ * into 'buf'. Called by the standard input stream. Returns the number of
+ * characters read, or 0 at the end of the input.
+*/
+ssize_t pipelineRead(void* cookie, char* buf, size_t size) {
+
+    Pipeline* pipeline = cookie;
+    Chunk* chunk;
+    size_t count;
+
+    if (pipeline->input_done)
+        return 0;
+
+    if (pipeline->reading == NULL)
+        pipeline->reading = waitPop(pipeline, pipeline->input);
+
+    chunk = pipeline->reading;
+
+    if (chunk->last) {
+        pipeline->input_done = YES;
+        return 0;
+    }
+
+    count = chunk->length - chunk->offset;
+    count = count < size ? count : size;
+    memcpy(buf, chunk->data + chunk->offset, count);
+    chunk->offset += count;
+
+    /* Give the chunk back once it's read. */
+    if (chunk->offset == chunk->length) {
+        chunk->length = 0;
+        chunk->offset = 0;
+        pipeline->reading = NULL;
+        waitPush(pipeline, pipeline->free_in, chunk);
+    }
+
+    return count;
+}
+
+/**
+ * Copies the 'size' characters of 'buf' to chunks given to the writer
+ * thread. Called by the standard output stream. Returns the number of
+ * characters written.
+*/
+ssize_t pipelineWrite(void* cookie, const char* buf, size_t size) {
+
+    Pipeline* pipeline = cookie;
+    Chunk* chunk;
+    size_t done, count;
+
+    for (done = 0; done < size; done += count) {
+
+        chunk = takeChunk(pipeline, pipeline->free_out);
+        count = size - done < PIPE_CHUNK_SIZE ? size - done : PIPE_CHUNK_SIZE;
+        memcpy(chunk->data, buf + done, count);
+        chunk->length = count;
+        waitPush(pipeline, pipeline->output, chunk);
+    }
+
+    return size;
+}
+
+
+/* ------------------------------- Pipeline --------------------------------- */
+
+/**
+ * Creates a new pipeline, with its rings and free chunks, and returns its
+ * respective pointer.
+*/
+Pipeline* createPipeline() {
+
+    Pipeline* pipeline = (Pipeline*)tryMalloc(sizeof(Pipeline));
+    int i;
+
+    pipeline->input = createRing(PIPE_CHUNKS);
+    pipeline->output = createRing(PIPE_CHUNKS);
+    pipeline->free_in = createRing(PIPE_CHUNKS);
+    pipeline->free_out = createRing(PIPE_CHUNKS);
+    pipeline->reading = NULL;
+    pipeline->filling = NULL;
+    pipeline->input_done = NO;
+    pipeline->stop = NO;
+
+    /* On a single processor, the other thread can't change a ring while
+       this one spins on it. */
+    pipeline->spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? PIPE_SPINS : 1;
+
+    for (i = 0; i < PIPE_CHUNKS; i++) {
+        ringPush(pipeline->free_in, createChunk());
+        ringPush(pipeline->free_out, createChunk());
+    }
+
+    return pipeline;
+}
+
+/**
+ * Takes a free chunk from the given ring, waiting for one if needed.
+ * Returns NULL if the pipeline is stopping.
+*/
+Chunk* takeChunk(Pipeline* pipeline, Ring* ring) {
+
+    Chunk* chunk = waitPop(pipeline, ring);
+
+    if (chunk != NULL) {
+        chunk->length = 0;
+        chunk->offset = 0;
+        chunk->last = NO;
+    }
+
+    return chunk;
+}
+
+/**
+ * Pushes the given chunk into the ring, waiting while it's full. Returns
+ * NO if the pipeline stopped meanwhile, or YES otherwise.
+*/
+int waitPush(Pipeline* pipeline, Ring* ring, Chunk* chunk) {
+
+    int spins = 0;
+
+    while (!ringPush(ring, chunk)) {
+
+        if (__atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE) &&
+                                        pthread_equal(pthread_self(),
+                                                            pipeline->reader))
+            return NO;
+
+        if (++spins >= pipeline->spins + PIPE_YIELDS) {
+            blockOnRing(ring, YES);
+            spins = 0;
+        } else if (spins >= pipeline->spins) {
+            sched_yield();
+        }
+    }
+
+    wakeRing(ring);
+
+    return YES;
+}
+
+/**
+ * Pops a chunk from the ring, waiting while it's empty. Returns NULL if the
+ * pipeline stopped meanwhile.
+*/
+Chunk* waitPop(Pipeline* pipeline, Ring* ring) {
+
+    Chunk* chunk;
+    int spins = 0;
+
+    while ((chunk = (Chunk*)ringPop(ring)) == NULL) {
+
+        if (__atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE) &&
+                                        pthread_equal(pthread_self(),
+                                                            pipeline->reader))
+            return NULL;
+
+        if (++spins >= pipeline->spins + PIPE_YIELDS) {
+            blockOnRing(ring, NO);
+            spins = 0;
+        } else if (spins >= pipeline->spins) {
+            sched_yield();
+        }
+    }
+
+    wakeRing(ring);
+
+    return chunk;
+}
+
+/**
+ * Frees all the allocated memory in the given pipeline, including the
+ * chunks in its rings.
+*/
+void destroyPipeline(Pipeline* pipeline) {
+
+    Ring* rings[4];
+    Chunk* chunk;
+    int i;
+
+    rings[0] = pipeline->input;
+    rings[1] = pipeline->output;
+    rings[2] = pipeline->free_in;
+    rings[3] = pipeline->free_out;
+
+    if (pipeline->reading != NULL)
+        destroyChunk(pipeline->reading);
+
+    if (pipeline->filling != NULL)
+        destroyChunk(pipeline->filling);
+
+    for (i = 0; i < 4; i++) {
+        while ((chunk = (Chunk*)ringPop(rings[i])) != NULL)
+            destroyChunk(chunk);
+        destroyRing(rings[i]);
+    }
+
+    free(pipeline);
+}
+
+/**
+ * Creates a new empty chunk and returns its respective pointer.
+*/
+Chunk* createChunk() {
+
+    Chunk* chunk = (Chunk*)tryMalloc(sizeof(Chunk));
+
+    chunk->data = (char*)tryMalloc(PIPE_CHUNK_SIZE);
+    chunk->length = 0;
+    chunk->offset = 0;
+    chunk->last = NO;
+
+    return chunk;
+}
+
+/**
+ * Frees all the allocated memory in the given chunk.
+*/
+void destroyChunk(Chunk* chunk) {
+
+    free(chunk->data);
+    free(chunk);
+}
+
+
+/* --------------------------------- Rings ---------------------------------- */
+
+/**
+ * Creates a new empty ring with the given number of slots, a power of 2,
+ * and returns its respective pointer.
+*/
+Ring* createRing(unsigned long size) {
+
+    Ring* ring = (Ring*)tryMalloc(sizeof(Ring));
+
+    ring->slots = (void**)tryMalloc(size * sizeof(void*));
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->waiting = NO;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->changed, NULL);
+
+    return ring;
+}
+
+/**
+ * Pushes the given data into the ring. Only one thread may push into a
+ * ring. Returns NO if the ring is full, or YES otherwise.
+*/
+int ringPush(Ring* ring, void* data) {
+
+    unsigned long tail = ring->tail;
+
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->size)
+        return NO;
+
+    ring->slots[tail & (ring->size - 1)] = data;
+
+    /* The slot is written before the consumer may see it. */
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    return YES;
+}
+
+/**
+ * Pops the oldest data from the ring. Only one thread may pop from a ring.
+ * Returns NULL if the ring is empty.
+*/
+void* ringPop(Ring* ring) {
+
+    unsigned long head = ring->head;
+    void* data;
+
+    if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    data = ring->slots[head & (ring->size - 1)];
+
+    /* The slot is read before the producer may reuse it. */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+
+    return data;
+}
+
+/**
+ * Blocks until the ring has a free slot, if 'push' is YES, or some data,
+ * if 'push' is NO. The other thread of the ring wakes it up when it pops
+ * or pushes.
+*/
+void blockOnRing(Ring* ring, int push) {
+
+    unsigned long head, tail;
+
+    pthread_mutex_lock(&ring->lock);
+    pthread_cleanup_push(unlockRing, ring);
+
+    /* Either the other thread sees the wait after its change, or the
+       change is seen here before waiting (both are sequentially
+       consistent). */
+    __atomic_store_n(&ring->waiting, YES, __ATOMIC_SEQ_CST);
+
+    for (;;) {
+
+        head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+
+        if (push ? tail - head < ring->size : head != tail)
+            break;
+
+        pthread_cond_wait(&ring->changed, &ring->lock);
+    }
+
+    __atomic_store_n(&ring->waiting, NO, __ATOMIC_RELAXED);
+    pthread_cleanup_pop(1);
+}
+
+/**
+ * Wakes up the thread blocked on the ring, if there is one, after a push
+ * or a pop.
+*/
+void wakeRing(Ring* ring) {
+
+    if (!__atomic_load_n(&ring->waiting, __ATOMIC_SEQ_CST))
+        return;
+
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_signal(&ring->changed);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/**
+ * Unlocks the given ring. Called when a thread blocked on it is cancelled.
+*/
+void unlockRing(void* ring) {
+
+    pthread_mutex_unlock(&((Ring*)ring)->lock);
+}
+
+/**
+ * Frees all the allocated memory in the given ring. The data is
+ * not deleted.
+*/
+void destroyRing(Ring* ring) {
+
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->changed);
+    free(ring->slots);
+    free(ring);
+}
@@ -13,13 +13,42 @@
 /* ----------------------------- Handle command ----------------------------- */
 
 /**
- * Handles command input.
+ * Handles command input, timing it if the commands are timed, and tracing
+ * it if they're traced.
  * Returns 1 if the program should continue after running the command.
  * Otherwise, returns 0.
  */
 int handleCommand(System *sys) {
 
-	char c = getchar();
+#if defined(LATENCY_HISTOGRAMS) || defined(TRACE_EVENTS)
+
+    long int start = sys->latencies != NULL ? latencyClock() : 0;
+    int c = nextChar(sys), more;
+
+    sys->latency_size = 0;
+    TRACE_COMMAND(c, 'B', 0);
+    more = runCommand(sys, c);
+    TRACE_COMMAND(c, 'E', sys->latency_size);
+
+    if (sys->latencies != NULL)
+        recordLatency(sys->latencies, c, sys->latency_size,
+                                                latencyClock() - start);
+
+    return more;
+
+#else
+
+    return runCommand(sys, nextChar(sys));
+
+#endif
+}
+
+/**
+ * Runs the command of the given letter.
+ * Returns 1 if the program should continue after running the command.
+ * Otherwise, returns 0.
+ */
+int runCommand(System *sys, int c) {
 
 	switch (c) {
 
@@ -37,6 +66,30 @@ int handleCommand(System *sys) {
             return 1;
         case 'a': handleClearSystemCommand(sys);
             return 1;
+        case 'j': handleJourneyCommand(sys);
+            return 1;
+        case 'h': handleHierarchyCommand(sys);
+            return 1;
+        case 's': handleRouteCommand(sys);
+            return 1;
+        case 'n': handleNearestCommand(sys);
+            return 1;
+        case 'b': handleBoxCommand(sys);
+            return 1;
+        case 'w': handleWithinCommand(sys);
+            return 1;
+        case 'd': handleDistanceCommand(sys);
+            return 1;
+        case 't': handleBatchCommand(sys);
+            return 1;
+        case 'm': 
+            return handleImportCommand(sys);
+        case 'g': handleSaveCommand(sys);
+            return 1;
+        case 'o': handleLoadCommand(sys);
+            return 1;
+        case 'z': handleStatsCommand(sys);
+            return 1;
         case 'q': 
 			return 0; /* Exit the program. */
 		default:
@@ -44,6 +97,18 @@ int handleCommand(System *sys) {
 	}
 }
 
+/**
+ * Runs the commands until the 'q' command, with the worker pool if there
+ * is one.
+*/
+void runCommands(System *sys) {
+
+    if (sys->workers != NULL)
+        runWorkers(sys);
+    else
+        while (handleCommand(sys) > 0) { }
+}
+
 /**
  * Handles the 'p' command.
 */
@@ -63,6 +128,7 @@ void handleStopCommand(System *sys) {
             /* Convert strings to floating point variables */
             latitude = atof(val1);
             longitude = atof(val2);
+            journalStop(sys, name, latitude, longitude);
             addStop(sys, name, latitude, longitude);
         }
 
@@ -96,7 +162,7 @@ void handleLineCommand(System *sys) {
             } 
                 
             /* Check if the non-empty word is a valid sort option. */
-            if (assertSortOption(option))
+            if (assertSortOption(sys->out, option))
                 addShowLine(sys, name, YES);        
         }
 
@@ -114,19 +180,12 @@ void handleLinkCommand(System *sys) {
     Link* new_link = obtainLinkArgs(sys);
 
     if (new_link != NULL) {
-        
-        switch(processLinkData(new_link)) {
-
-            case FIRST_LINK: addFirstLink(new_link);
-                break;
-            case APPEND: linkAppend(new_link);
-                break;
-            case PUSH: linkPush(new_link);
-                break;
-            default: free(new_link);
-                printf(CANT_LINK);
-                break;
-        }  
+
+        LATENCY_SIZE(sys, ((Line*)new_link->line)->num_stops);
+        journalLink(sys, new_link);
+        invalidateHierarchy(sys);
+        refreshLineValues(sys, (Line*)new_link->line);
+        addLink(sys, new_link);
     }
 }
 
@@ -137,20 +196,11 @@ void handleIntersectionCommand(System *sys) {
 
     List* list = sys->stops_list;
     Node* ptr;
-    Stop* stop;
 
     untilEndOfLine(sys);
 
-    for (ptr = list->first; ptr != NULL; ptr = ptr->next) {
-
-        stop = (Stop*)ptr->data;
-
-        if (stop->lines->count > 1) {
-
-            printf("%s %d: ", stop->name, stop->lines->count);
-            showStopLines(stop);
-        }
-    }
+    for (ptr = list->first; ptr != NULL; ptr = ptr->next)
+        printIntersection(sys->out, (Stop*)ptr->data);
 }
 
 /**
@@ -160,8 +210,11 @@ void handleRemoveLineCommand(System *sys) {
 
     char name[BUFLEN];
 
-    if (!getArg(sys, name)) 
+    if (!getArg(sys, name)) {
+        journalName(sys, 'r', name);
+        invalidateHierarchy(sys);
         removeLine(sys, name);
+    }
 }
 
 /**
@@ -171,8 +224,11 @@ void handleRemoveStopCommand(System *sys) {
 
     char name[BUFLEN];
 
-    if (!getArg(sys, name)) 
+    if (!getArg(sys, name)) {
+        journalName(sys, 'e', name);
+        invalidateHierarchy(sys);
         removeStop(sys, name);
+    }
 }    
 
 /**
@@ -181,21 +237,276 @@ void handleRemoveStopCommand(System *sys) {
 void handleClearSystemCommand(System *sys) {
 
     untilEndOfLine(sys);
+    journalClear(sys);
+    invalidateHierarchy(sys);
     clearSystem(sys);
 }
 
 
+/**
+ * Handles the 'j' command.
+*/
+void handleJourneyCommand(System *sys) {
+
+    char orig[BUFLEN], dest[BUFLEN];
+
+    if (getArg(sys, orig) && !getArg(sys, dest))
+        showJourneys(sys, orig, dest);
+}
+
+
+/**
+ * Handles the 'h' command.
+*/
+void handleHierarchyCommand(System *sys) {
+
+    untilEndOfLine(sys);
+    buildSystemHierarchy(sys);
+}
+
+/**
+ * Handles the 's' command.
+*/
+void handleRouteCommand(System *sys) {
+
+    char orig[BUFLEN], dest[BUFLEN];
+
+    if (getArg(sys, orig) && !getArg(sys, dest))
+        showRoute(sys, orig, dest);
+}
+
+
+/**
+ * Handles the 'n' command.
+*/
+void handleNearestCommand(System *sys) {
+
+    char val1[BUFLEN], val2[BUFLEN], val3[BUFLEN];
+
+    if (getArg(sys, val1)) {
+
+        if (!getArg(sys, val2)) {
+
+            /* Without the number of stops, shows the nearest one. */
+            showNearestStops(sys, atof(val1), atof(val2), 1);
+
+        } else if (!getArg(sys, val3)) {
+
+            showNearestStops(sys, atof(val1), atof(val2), atoi(val3));
+        }
+    }
+}
+
+/**
+ * Handles the 'b' command.
+*/
+void handleBoxCommand(System *sys) {
+
+    char val1[BUFLEN], val2[BUFLEN], val3[BUFLEN], val4[BUFLEN];
+
+    if (getArg(sys, val1) && getArg(sys, val2) && getArg(sys, val3) &&
+                                                        !getArg(sys, val4))
+        showStopsInBox(sys, atof(val1), atof(val2), atof(val3), atof(val4));
+}
+
+/**
+ * Handles the 'w' command.
+*/
+void handleWithinCommand(System *sys) {
+
+    char val1[BUFLEN], val2[BUFLEN], val3[BUFLEN];
+
+    if (getArg(sys, val1) && getArg(sys, val2) && !getArg(sys, val3))
+        showStopsWithin(sys, atof(val1), atof(val2), atof(val3));
+}
+
+/**
+ * Handles the 'd' command.
+*/
+void handleDistanceCommand(System *sys) {
+
+    char val1[BUFLEN], val2[BUFLEN], val3[BUFLEN];
+
+    if (getArg(sys, val1) && getArg(sys, val2) && !getArg(sys, val3))
+        showStopsInDistance(sys, atof(val1), atof(val2), atof(val3));
+}
+
+/**
+ * Handles the 't' command.
+*/
+void handleBatchCommand(System *sys) {
+
+    char option[BUFLEN];
+
+    if (!getArg(sys, option)) {
+
+        if (strcmp(option, BATCH_BEGIN) == 0)
+            beginBatch(sys);
+        else if (strcmp(option, BATCH_COMMIT) == 0)
+            commitBatch(sys);
+    }
+}
+
+/**
+ * Handles the 'm' command. Returns 0 if the program should exit after the
+ * imported commands. Otherwise, returns 1.
+*/
+int handleImportCommand(System *sys) {
+
+    char name[BUFLEN];
+    int more = 1;
+
+    /* The journal can't hold the import, so it gets a checkpoint. */
+    if (!getArg(sys, name)) {
+        more = importDump(sys, name);
+        checkpointJournal(sys);
+    }
+
+    return more;
+}
+
+/**
+ * Handles the 'g' command.
+*/
+void handleSaveCommand(System *sys) {
+
+    char name[BUFLEN];
+
+    if (!getArg(sys, name))
+        saveSnapshot(sys, name);
+}
+
+/**
+ * Handles the 'o' command.
+*/
+void handleLoadCommand(System *sys) {
+
+    char name[BUFLEN];
+
+    /* The journal can't hold the snapshot, so it gets a checkpoint. */
+    if (!getArg(sys, name) && loadSnapshot(sys, name))
+        checkpointJournal(sys);
+}
+
+/**
+ * Handles the 'z' command: presents the statistics with the given name
+ * ("tables", "latency", "memory", with the names interned, "searches", or
+ * "trace"), or all of them. With "trace", an option enables ("on") or
+ * disables ("off") the tracer, or exports its events to the file with the
+ * given name. "freeze" freezes the names of the stops and lines, presenting
+ * their frozen indexes.
+*/
+void handleStatsCommand(System *sys) {
+
+    char name[BUFLEN], option[BUFLEN];
+    int all = YES, has_option = NO;
+
+    if (hasArgs(sys)) {
+
+        all = NO;
+
+        if (getArg(sys, name)) {
+
+            has_option = YES;
+
+            if (getArg(sys, option))
+                untilEndOfLine(sys);
+        }
+    }
+
+    if (all || strcmp(name, STATS_TABLES) == 0) {
+        printHashtableStats(sys->out, sys->stops_table, "stops");
+        printHashtableStats(sys->out, sys->lines_table, "lines");
+    }
+
+    if (sys->latencies != NULL && (all || strcmp(name, STATS_LATENCY) == 0))
+        printLatencies(sys->out, sys->latencies);
+
+    if (all || strcmp(name, STATS_MEMORY) == 0) {
+        printMemory(sys->out);
+        printNameStats(sys->out, sys->names);
+    }
+
+    if (all || strcmp(name, STATS_SEARCHES) == 0) {
+        printSearchStats(sys->out, sys->searches);
+        printHierarchyStats(sys->out, sys);
+    }
+
+    if (!all && strcmp(name, STATS_FREEZE) == 0) {
+
+        if (!freezeHashtable(sys->stops_table, getStopName))
+            fprintf(sys->out, CANT_FREEZE, "stops");
+
+        if (!freezeHashtable(sys->lines_table, getLineName))
+            fprintf(sys->out, CANT_FREEZE, "lines");
+
+        printFrozenStats(sys->out, sys->stops_table, "stops");
+        printFrozenStats(sys->out, sys->lines_table, "lines");
+    }
+
+    if (!all && strcmp(name, STATS_TRACE) == 0 && has_option) {
+
+        if (strcmp(option, TRACE_ON) == 0 || strcmp(option, TRACE_OFF) == 0)
+            enableTrace(strcmp(option, TRACE_ON) == 0);
+        else if (!exportTrace(option))
+            fprintf(sys->out, CANT_WRITE, option);
+
+    } else if (all || strcmp(name, STATS_TRACE) == 0) {
+
+        fprintf(sys->out, TRACE_STATS, __atomic_load_n(&tracer()->enabled,
+                    __ATOMIC_RELAXED) ? TRACE_ON : TRACE_OFF,
+                    __atomic_load_n(&tracer()->next, __ATOMIC_RELAXED),
+                    (long int)TRACE_EVENTS_SIZE);
+    }
+}
+
 /* ---------------------------------- Main ---------------------------------- */
 
+/* The benchmarks are linked with every file, without the 'main' function. */
+#ifndef NO_MAIN
 
-int main() {
+int main(int argc, char* argv[]) {
 
     System* sys = systemInit();
-    
-	/* Execute program until the user sends the 'q' command. */
-	while (handleCommand(sys) > 0) { }
+    char* server = NULL;
+    int i, pipelined = NO;
+
+    for (i = 1; i < argc; i++) {
+
+        if (strcmp(argv[i], PIPELINE_OPTION) == 0)
+            pipelined = YES;
+        else if (strcmp(argv[i], WORKERS_OPTION) == 0 && i + 1 < argc &&
+                                                        sys->workers == NULL)
+            sys->workers = createWorkerPool(sys, atoi(argv[++i]));
+        else if (strcmp(argv[i], JOURNAL_OPTION) == 0 && i + 1 < argc &&
+                                                        sys->journal == NULL) {
+
+            /* Without the network it held, its commands would be lost. */
+            if ((sys->journal = openJournal(sys, argv[++i])) == NULL) {
+                exitProgram(sys);
+                return ERR;
+            }
+        }
+        else if (strcmp(argv[i], SERVER_OPTION) == 0 && i + 1 < argc)
+            server = argv[++i];
+        else if (strcmp(argv[i], TRACE_OPTION) == 0 && i + 1 < argc) {
+            sys->trace_file = argv[++i];
+            enableTrace(YES);
+        }
+    }
+
+    /* Execute program until the user sends the 'q' command. */
+    if (server != NULL)
+        runServer(sys, server, sys->workers != NULL ?
+                            sys->workers->num_threads : SERVER_THREADS);
+    else if (pipelined)
+        runPipeline(sys);
+    else
+        runCommands(sys);
 
     exitProgram(sys);
     
 	return 0;
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,515 @@
+/**
+ * IAED-23 Project 2
+ * File: ranges.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the range index of the
+ * stops, a set of packed R-trees over their coordinates, and of the range
+ * queries (stops inside a rectangle or within a distance of a point).
+*/
+
+#include "main.h"
+
+
+/* ----------------------------- Range queries ------------------------------ */
+
+/**
+ * Shows in the standard output, by order of creation, the stops whose
+ * coordinates are inside the rectangle with the two given corners.
+*/
+void showStopsInBox(System *sys, double lat1, double lon1, double lat2,
+                                                            double lon2) {
+
+    StopArray* found = createStopArray();
+    double low[2], high[2];
+    int i;
+
+    low[0] = lat1 < lat2 ? lat1 : lat2;
+    high[0] = lat1 < lat2 ? lat2 : lat1;
+    low[1] = lon1 < lon2 ? lon1 : lon2;
+    high[1] = lon1 < lon2 ? lon2 : lon1;
+
+    rangeSearch(sys->ranges, low, high, found);
+    sortStopArray(found);
+
+    for (i = 0; i < found->count; i++)
+        printStop(sys->out, found->items[i]);
+
+    destroyStopArray(found);
+}
+
+/**
+ * Shows in the standard output, by order of creation, the stops within the
+ * given distance (in kilometres) of the given coordinates.
+*/
+void showStopsWithin(System *sys, double latitude, double longitude,
+                                                            double km) {
+
+    StopArray* found = createStopArray();
+    int i;
+
+    stopsWithin(sys->ranges, latitude, longitude, km, found);
+    sortStopArray(found);
+
+    for (i = 0; i < found->count; i++)
+        printStop(sys->out, found->items[i]);
+
+    destroyStopArray(found);
+}
+
+/**
+ * Adds to 'found' the stops within the given distance (in kilometres) of the
+ * given coordinates. The candidates are the stops inside the rectangle of
+ * coordinates around the point, shifted by a full turn east and west so that
+ * longitudes given in another turn are also found.
+*/
+void stopsWithin(RangeIndex* index, double latitude, double longitude,
+                                            double km, StopArray* found) {
+
+    StopArray* candidates;
+    double low[2], high[2], angle, dlat, dlon, ratio;
+    int i, turn;
+    Stop* stop;
+
+    if (km < 0)
+        return;
+
+    /* Bounding coordinates of the circle: its latitudes span the angle it
+       covers, and its longitudes the arc sine of its sine over the cosine of
+       the latitude, unless it reaches a pole. */
+    angle = km / GEO_EARTH_RADIUS;
+    dlat = angle * 180.0 / GEO_PI;
+    ratio = geoSin(angle < GEO_PI / 2.0 ? angle : GEO_PI / 2.0) /
+                                        geoCos(latitude * GEO_PI / 180.0);
+
+    if (latitude + dlat >= 90.0 || latitude - dlat <= -90.0 || ratio < 0 ||
+                                                                ratio >= 1.0)
+        dlon = 180.0;
+    else
+        dlon = geoAsin(ratio) * 180.0 / GEO_PI;
+
+    candidates = createStopArray();
+    low[0] = latitude - dlat;
+    high[0] = latitude + dlat;
+
+    if (dlon >= 180.0) {
+
+        low[1] = -RANGE_INFINITY;
+        high[1] = RANGE_INFINITY;
+        rangeSearch(index, low, high, candidates);
+
+    } else {
+
+        for (turn = -1; turn <= 1; turn++) {
+            low[1] = longitude - dlon + turn * 360.0;
+            high[1] = longitude + dlon + turn * 360.0;
+            rangeSearch(index, low, high, candidates);
+        }
+    }
+
+    for (i = 0; i < candidates->count; i++) {
+
+        stop = candidates->items[i];
+
+        if (geoDistance(latitude, longitude, stop->latitude,
+                                                    stop->longitude) <= km)
+            appendStop(found, stop);
+    }
+
+    destroyStopArray(candidates);
+}
+
+/**
+ * Adds to 'found' the stops of the range index inside the rectangle with the
+ * given lowest and highest coordinates (latitude first).
+*/
+void rangeSearch(RangeIndex* index, double low[2], double high[2],
+                                                        StopArray* found) {
+
+    int i;
+
+    for (i = 0; i < RANGE_MAX_TREES; i++)
+        if (index->trees[i] != NULL)
+            searchRangeTree(index->trees[i], index->trees[i]->root, low,
+                                                            high, found);
+}
+
+/**
+ * Visits the subtree of the given node, adding to 'found' the stops inside
+ * the rectangle. Only the children whose rectangles overlap it are visited.
+*/
+void searchRangeTree(RangeTree* tree, int node, double low[2],
+                                        double high[2], StopArray* found) {
+
+    RangeNode* ptr = &tree->nodes[node];
+    RangeEntry* entry;
+    int i;
+
+    if (ptr->high[0] < low[0] || ptr->low[0] > high[0] ||
+                        ptr->high[1] < low[1] || ptr->low[1] > high[1])
+        return;
+
+    if (node >= tree->num_leaves) {
+
+        for (i = ptr->first; i < ptr->first + ptr->count; i++)
+            searchRangeTree(tree, i, low, high, found);
+
+        return;
+    }
+
+    for (i = ptr->first; i < ptr->first + ptr->count; i++) {
+
+        entry = &tree->entries[i];
+
+        if (entry->stop != NULL && entry->coord[0] >= low[0] &&
+                entry->coord[0] <= high[0] && entry->coord[1] >= low[1] &&
+                entry->coord[1] <= high[1])
+            appendStop(found, entry->stop);
+    }
+}
+
+
+/* ------------------------------ Range index ------------------------------- */
+
+/**
+ * Creates a new empty range index and returns its respective pointer.
+ * The index keeps a packed tree of up to 2^i stops for each set bit i of
+ * the number of insertions, like the digits of a binary counter.
+*/
+RangeIndex* createRangeIndex() {
+
+    RangeIndex* index = (RangeIndex*)tryMalloc(sizeof(RangeIndex));
+    int i;
+
+    for (i = 0; i < RANGE_MAX_TREES; i++)
+        index->trees[i] = NULL;
+
+    index->live = 0;
+    index->removed = 0;
+
+    return index;
+}
+
+/**
+ * Inserts the given stop in the range index. The stop becomes a tree of its
+ * own, which is merged with the trees of the same size, from the smallest
+ * one, until there's no tree of its size.
+*/
+void rangeInsert(RangeIndex* index, Stop* stop) {
+
+    RangeEntry entry;
+    RangeEntry* entries;
+    int level, count = 1;
+
+    entry.coord[0] = stop->latitude;
+    entry.coord[1] = stop->longitude;
+    entry.stop = stop;
+
+    /* Find the first free level: the trees below it are merged. */
+    for (level = 0; index->trees[level] != NULL; level++)
+        count += index->trees[level]->count;
+
+    entries = (RangeEntry*)tryMalloc(count * sizeof(RangeEntry));
+    entries[0] = entry;
+    count = 1;
+
+    for (level = 0; index->trees[level] != NULL; level++) {
+
+        count = takeRangeEntries(index->trees[level], entries, count);
+        destroyRangeTree(index->trees[level]);
+        index->trees[level] = NULL;
+    }
+
+    index->trees[level] = buildRangeTree(entries, count, level);
+    index->live++;
+}
+
+/**
+ * Removes the given stop from the range index. Its entry is only marked as
+ * removed, until as many stops are removed as there are in the index, and
+ * the index is rebuilt with the remaining ones.
+*/
+void rangeRemove(RangeIndex* index, Stop* stop) {
+
+    index->trees[stop->range_tree]->entries[stop->range_pos].stop = NULL;
+    index->live--;
+
+    if (++index->removed > index->live)
+        rebuildRangeIndex(index);
+}
+
+/**
+ * Rebuilds the range index as a single tree with the stops not removed.
+*/
+void rebuildRangeIndex(RangeIndex* index) {
+
+    rangeInsertMany(index, NULL, 0);
+}
+
+/**
+ * Inserts the given stops in the range index at once, rebuilding it as a
+ * single tree with them and the stops not removed.
+*/
+void rangeInsertMany(RangeIndex* index, Stop** stops, int num_stops) {
+
+    RangeEntry* entries = (RangeEntry*)tryMalloc((index->live + num_stops
+                                                + 1) * sizeof(RangeEntry));
+    int i, count = 0, level = 0;
+
+    for (i = 0; i < RANGE_MAX_TREES; i++) {
+
+        if (index->trees[i] != NULL) {
+            count = takeRangeEntries(index->trees[i], entries, count);
+            destroyRangeTree(index->trees[i]);
+            index->trees[i] = NULL;
+        }
+    }
+
+    for (i = 0; i < num_stops; i++, count++) {
+        entries[count].coord[0] = stops[i]->latitude;
+        entries[count].coord[1] = stops[i]->longitude;
+        entries[count].stop = stops[i];
+    }
+
+    index->live += num_stops;
+    index->removed = 0;
+
+    if (count == 0) {
+        free(entries);
+        return;
+    }
+
+    /* The tree goes to the level where it fits. */
+    while ((1 << level) < count)
+        level++;
+
+    index->trees[level] = buildRangeTree(entries, count, level);
+}
+
+/**
+ * Copies the entries of the given tree that were not removed to 'entries',
+ * after the first 'count' ones. Returns the new number of entries.
+*/
+int takeRangeEntries(RangeTree* tree, RangeEntry* entries, int count) {
+
+    int i;
+
+    for (i = 0; i < tree->count; i++)
+        if (tree->entries[i].stop != NULL)
+            entries[count++] = tree->entries[i];
+
+    return count;
+}
+
+/**
+ * Frees all the allocated memory in the given range index. The stops
+ * are not deleted.
+*/
+void destroyRangeIndex(RangeIndex* index) {
+
+    int i;
+
+    for (i = 0; i < RANGE_MAX_TREES; i++)
+        if (index->trees[i] != NULL)
+            destroyRangeTree(index->trees[i]);
+
+    free(index);
+}
+
+/**
+ * Returns the number of bytes used by the range index.
+*/
+long int rangeIndexMemory(RangeIndex* index) {
+
+    long int bytes = sizeof(RangeIndex);
+    int i;
+
+    for (i = 0; i < RANGE_MAX_TREES; i++)
+        if (index->trees[i] != NULL)
+            bytes += sizeof(RangeTree) +
+                    index->trees[i]->count * sizeof(RangeEntry) +
+                    index->trees[i]->num_nodes * sizeof(RangeNode);
+
+    return bytes;
+}
+
+
+/* ------------------------------- Range tree ------------------------------- */
+
+/**
+ * Builds a packed R-tree with the given entries, which it keeps, using the
+ * Sort-Tile-Recursive method: the entries are sorted by longitude, split in
+ * vertical slices and each slice is sorted by latitude, so that each group
+ * of 'RANGE_PAGE' consecutive entries becomes a leaf. Each group of
+ * 'RANGE_PAGE' consecutive nodes of a level becomes a node of the next one,
+ * up to the root. Each stop is told its position. Returns the new tree.
+*/
+RangeTree* buildRangeTree(RangeEntry* entries, int count, int level) {
+
+    RangeTree* tree = (RangeTree*)tryMalloc(sizeof(RangeTree));
+    int i, pages, slices, slice_size, first, num;
+
+    tree->entries = entries;
+    tree->count = count;
+
+    /* Sort-Tile-Recursive ordering. */
+    pages = (count + RANGE_PAGE - 1) / RANGE_PAGE;
+    for (slices = 1; slices * slices < pages; slices++) { }
+    slice_size = slices * RANGE_PAGE;
+
+    qsort(entries, count, sizeof(RangeEntry), compareLongitudes);
+    for (first = 0; first < count; first += slice_size)
+        qsort(entries + first, count - first < slice_size ?
+                count - first : slice_size, sizeof(RangeEntry),
+                compareLatitudes);
+
+    for (i = 0; i < count; i++) {
+        entries[i].stop->range_tree = level;
+        entries[i].stop->range_pos = i;
+    }
+
+    /* A tree of 'pages' leaves has less than 2 * pages nodes. */
+    tree->nodes = (RangeNode*)tryMalloc(2 * (pages + 1) * sizeof(RangeNode));
+    tree->num_leaves = pages;
+
+    for (i = 0; i < pages; i++)
+        packRangeNode(tree, i, i * RANGE_PAGE, count - i * RANGE_PAGE <
+                    RANGE_PAGE ? count - i * RANGE_PAGE : RANGE_PAGE, YES);
+
+    /* Pack each level into the next, until there's only the root. */
+    for (first = 0, num = pages; num > 1; first += num,
+                            num = (num + RANGE_PAGE - 1) / RANGE_PAGE) {
+
+        for (i = 0; i < (num + RANGE_PAGE - 1) / RANGE_PAGE; i++)
+            packRangeNode(tree, first + num + i, first + i * RANGE_PAGE,
+                    num - i * RANGE_PAGE < RANGE_PAGE ?
+                    num - i * RANGE_PAGE : RANGE_PAGE, NO);
+    }
+
+    tree->root = first;
+    tree->num_nodes = first + 1;
+
+    return tree;
+}
+
+/**
+ * Sets the given node of the tree as the parent of 'count' consecutive
+ * entries (if 'leaf' is YES) or nodes, from 'first', covering them all.
+*/
+void packRangeNode(RangeTree* tree, int node, int first, int count,
+                                                                int leaf) {
+
+    RangeNode* ptr = &tree->nodes[node];
+    double *low, *high;
+    int i, axis;
+
+    ptr->first = first;
+    ptr->count = count;
+
+    for (i = first; i < first + count; i++) {
+
+        low = leaf ? tree->entries[i].coord : tree->nodes[i].low;
+        high = leaf ? tree->entries[i].coord : tree->nodes[i].high;
+
+        for (axis = 0; axis < 2; axis++) {
+            if (i == first || low[axis] < ptr->low[axis])
+                ptr->low[axis] = low[axis];
+            if (i == first || high[axis] > ptr->high[axis])
+                ptr->high[axis] = high[axis];
+        }
+    }
+}
+
+/**
+ * Compares the longitudes of two entries. Returns -1 if the first one is
+ * smaller, 1 if it's greater and 0 if they're equal.
+*/
+int compareLongitudes(const void* first, const void* second) {
+
+    double diff = ((RangeEntry*)first)->coord[1] -
+                    ((RangeEntry*)second)->coord[1];
+
+    return (diff > 0) - (diff < 0);
+}
+
+/**
+ * Compares the latitudes of two entries. Returns -1 if the first one is
+ * smaller, 1 if it's greater and 0 if they're equal.
+*/
+int compareLatitudes(const void* first, const void* second) {
+
+    double diff = ((RangeEntry*)first)->coord[0] -
+                    ((RangeEntry*)second)->coord[0];
+
+    return (diff > 0) - (diff < 0);
+}
+
+/**
+ * Frees all the allocated memory in the given range tree.
+*/
+void destroyRangeTree(RangeTree* tree) {
+
+    free(tree->entries);
+    free(tree->nodes);
+    free(tree);
+}
+
+
+/* ------------------------------ Stop arrays ------------------------------- */
+
+/**
+ * Creates a new empty array of stops and returns its respective pointer.
+*/
+StopArray* createStopArray() {
+
+    StopArray* array = (StopArray*)tryMalloc(sizeof(StopArray));
+
+    array->size = RANGE_PAGE;
+    array->items = (Stop**)tryMalloc(array->size * sizeof(Stop*));
+    array->count = 0;
+
+    return array;
+}
+
+/**
+ * Appends the given stop to the array, doubling its size if it's full.
+*/
+void appendStop(StopArray* array, Stop* stop) {
+
+    if (array->count == array->size) {
+        array->size *= 2;
+        array->items = (Stop**)tryRealloc(array->items,
+                                            array->size * sizeof(Stop*));
+    }
+
+    array->items[array->count++] = stop;
+}
+
+/**
+ * Sorts the stops of the array by order of creation.
+*/
+void sortStopArray(StopArray* array) {
+
+    qsort(array->items, array->count, sizeof(Stop*), compareCreation);
+}
+
+/**
+ * Compares the order of creation of two stops. Returns -1 if the first one
+ * was created first, 1 if it was created later and 0 if they're the same.
+*/
+int compareCreation(const void* first, const void* second) {
+
+    unsigned int a = (*(Stop**)first)->order, b = (*(Stop**)second)->order;
+
+    return (a > b) - (a < b);
+}
+
+/**
+ * Frees all the allocated memory in the given array. The stops are
+ * not deleted.
+*/
+void destroyStopArray(StopArray* array) {
+
+    free(array->items);
+    free(array);
+}
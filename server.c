@@ -0,0 +1,856 @@
+/**
+ * IAED-23 Project 2
+ * File: server.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the server mode, where the system stays
+ * resident and serves the clients connected to a Unix domain socket. An
+ * epoll loop reads the command lines of every client, and the threads of the
+ * server run them, one at a time for each client. The lock of the system is
+ * taken exclusive by the commands adding or removing lines or stops, and
+ * shared by the others: the reading commands, and the links ('l'), which
+ * take the lock of the line they change (one of a set of striped locks, by
+ * its name) and, for the lines of the stops, one of another set of striped
+ * locks. A line is locked before any stripe of the stops, no command holds
+ * two lines, and the stripes are taken in their order, so that no two
+ * commands wait for each other. Removing a stop ('e') rearranges the lines
+ * of other stops, so it takes the lock exclusive, and never runs beside the
+ * edits of lines. The coordinates of a stop ('p' with its name) are read
+ * with no locks at all, inside a grace period of the hashtables, which the
+ * writers never wait for. The reply to each command is the length of its
+ * output, in a line of its own, followed by the output. The sockets of the
+ * clients never block: a reply the socket can't take yet waits in the
+ * client, which is handed back to the loop until it can, and reads nothing
+ * meanwhile. A client sending a line longer than SERVER_MAX_LINE is closed.
+ * The 'q' command closes the client, and the server stops on SIGINT or
+ * SIGTERM.
+*/
+
+/* Sockets, signals and memory streams (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+
+/* ------------------------------- Event loop ------------------------------- */
+
+/**
+ * Serves the clients of the socket with the given path with the given
+ * number of threads, until the server is stopped by a signal.
+*/
+void runServer(System *sys, char* path, int num_threads) {
+
+    Server* server = createServer(sys, path, num_threads);
+
+    if (server == NULL) {
+        fprintf(stderr, CANT_LISTEN, path);
+        return;
+    }
+
+    serverLoop(server);
+    destroyServer(server);
+}
+
+/**
+ * Creates a new server listening on the socket with the given path, with
+ * the given number of threads, and returns its respective pointer, or NULL
+ * if it can't listen. SIGINT and SIGTERM are taken by the loop.
+*/
+Server* createServer(System *sys, char* path, int num_threads) {
+
+    Server* server;
+    struct epoll_event event;
+    sigset_t signals;
+    int listener, i;
+
+    if ((listener = openListener(path)) == ERR)
+        return NULL;
+
+    /* Blocked before the threads start, so that they inherit it. */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    if (num_threads < 1)
+        num_threads = 1;
+
+    server = (Server*)tryMalloc(sizeof(Server));
+    server->sys = sys;
+    server->path = path;
+    server->listener = listener;
+    server->signals = signalfd(-1, &signals, 0);
+    server->epoll = epoll_create1(0);
+    server->queue = createList();
+    server->size_clients = 0;
+    server->clients = NULL;
+    server->num_threads = num_threads;
+    server->threads = (pthread_t*)tryMalloc(num_threads * sizeof(pthread_t));
+    server->stop = NO;
+    server->accepted = server->commands = 0;
+    server->shared = server->exclusive = server->edits = 0;
+    server->lock_free = 0;
+    server->readers = 0;
+    server->plain_input = sys->command_lenght == BUFLEN;
+
+    /* The hashtables are read with no locks, in grace periods. */
+    sys->epochs = createEpochs(num_threads);
+    sys->stops_table->epochs = sys->lines_table->epochs = sys->epochs;
+
+    initRWLock(&server->lock);
+
+    for (i = 0; i < SERVER_STRIPES; i++) {
+        pthread_mutex_init(&server->stripes[i], NULL);
+        pthread_mutex_init(&server->line_stripes[i], NULL);
+    }
+
+    pthread_mutex_init(&server->queue_lock, NULL);
+    pthread_cond_init(&server->queue_ready, NULL);
+
+    event.events = EPOLLIN;
+    event.data.ptr = &server->listener;
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.ptr = &server->signals;
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->signals, &event);
+
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&server->threads[i], NULL, serverThread, server);
+
+    return server;
+}
+
+/**
+ * Opens a socket listening on the given path, replacing a socket left
+ * there, which doesn't block when there are no connections. Returns its
+ * descriptor, or ERR if it can't listen.
+*/
+int openListener(char* path) {
+
+    struct sockaddr_un address;
+    struct stat file;
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path) ||
+                            (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return ERR;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    if (stat(path, &file) == 0 && S_ISSOCK(file.st_mode))
+        unlink(path);
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+                                        listen(fd, SERVER_BACKLOG) < 0) {
+        close(fd);
+        return ERR;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    return fd;
+}
+
+/**
+ * Waits for events until a signal stops the server: new connections, input
+ * of the clients waiting for it, and room for the replies of the others.
+*/
+void serverLoop(Server* server) {
+
+    struct epoll_event events[SERVER_EVENTS];
+    int i, count;
+
+    while (YES) {
+
+        count = epoll_wait(server->epoll, events, SERVER_EVENTS, -1);
+
+        for (i = 0; i < count; i++) {
+
+            if (events[i].data.ptr == &server->signals)
+                return;
+            else if (events[i].data.ptr == &server->listener)
+                acceptClients(server);
+            else if (hasOutput(server, (Client*)events[i].data.ptr))
+                writeClient(server, (Client*)events[i].data.ptr);
+            else
+                readClient(server, (Client*)events[i].data.ptr);
+        }
+    }
+}
+
+/**
+ * Takes the connections waiting on the socket, which don't block, and waits
+ * for their input.
+*/
+void acceptClients(Server* server) {
+
+    struct epoll_event event;
+    Client* client;
+    int fd, size;
+
+    while ((fd = accept(server->listener, NULL, NULL)) >= 0) {
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        client = (Client*)tryMalloc(sizeof(Client));
+        client->fd = fd;
+        client->size = SERVER_READ_SIZE;
+        client->input = (char*)tryMalloc(client->size);
+        client->length = 0;
+        client->ended = NO;
+        client->output = NULL;
+        client->output_length = client->sent = 0;
+        client->closing = NO;
+
+        pthread_mutex_lock(&server->queue_lock);
+
+        if (fd >= server->size_clients) {
+
+            size = server->size_clients;
+            server->size_clients = fd * 2 + 1;
+            server->clients = (Client**)tryRealloc(server->clients,
+                                    server->size_clients * sizeof(Client*));
+
+            while (size < server->size_clients)
+                server->clients[size++] = NULL;
+        }
+
+        server->clients[fd] = client;
+        server->accepted++;
+        pthread_mutex_unlock(&server->queue_lock);
+
+        /* Each event hands the client over, until it's armed again. */
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = client;
+        epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+/**
+ * Checks if the given client, handed over by the loop, has a reply to send.
+ * Returns YES if so, or NO if it waits for input.
+*/
+int hasOutput(Server* server, Client* client) {
+
+    int output;
+
+    /* Taken by the thread that armed the client, the last time. */
+    pthread_mutex_lock(&server->queue_lock);
+    output = client->output != NULL;
+    pthread_mutex_unlock(&server->queue_lock);
+
+    return output;
+}
+
+/**
+ * Reads the input of the given client. If it holds a whole command line,
+ * the client waits for a thread to run it; otherwise, it waits for more
+ * input. A client whose input ended is closed after its last command, and
+ * one whose line grows past SERVER_MAX_LINE at once.
+*/
+void readClient(Server* server, Client* client) {
+
+    int count;
+
+    /* Taken by the thread that armed the client, the last time. */
+    pthread_mutex_lock(&server->queue_lock);
+
+    if (client->length + SERVER_READ_SIZE + 1 > client->size) {
+        client->size = (client->length + SERVER_READ_SIZE + 1) * 2;
+        client->input = (char*)tryRealloc(client->input, client->size);
+    }
+
+    count = read(client->fd, client->input + client->length,
+                                                        SERVER_READ_SIZE);
+
+    if (count > 0) {
+        client->length += count;
+    } else if (count == 0 || (errno != EINTR && errno != EAGAIN)) {
+
+        /* The last line may lack its '\n'. */
+        if (client->length > 0 && client->input[client->length - 1] != '\n')
+            client->input[client->length++] = '\n';
+
+        client->ended = YES;
+    }
+
+    pthread_mutex_unlock(&server->queue_lock);
+
+    if (nextCommand(client) > 0)
+        queueClient(server, client);
+    else if (client->ended || client->length > SERVER_MAX_LINE)
+        closeClient(server, client);
+    else
+        rearmClient(server, client, EPOLLIN);
+}
+
+/**
+ * Returns the length of the first command line of the given client's
+ * input, including its '\n', or 0 if it didn't read a whole line yet.
+*/
+int nextCommand(Client* client) {
+
+    char* end = memchr(client->input, '\n', client->length);
+
+    return end == NULL ? 0 : end - client->input + 1;
+}
+
+/**
+ * Puts the given client in the queue of clients with a command to run.
+*/
+void queueClient(Server* server, Client* client) {
+
+    pthread_mutex_lock(&server->queue_lock);
+    append(server->queue, client);
+    pthread_cond_signal(&server->queue_ready);
+    pthread_mutex_unlock(&server->queue_lock);
+}
+
+
+/* ------------------------------ Server threads ---------------------------- */
+
+/**
+ * Takes the clients of the queue and runs their next command, until the
+ * server is destroyed. Run by each thread of the server.
+*/
+void* serverThread(void* arg) {
+
+    Server* server = arg;
+    Client* client;
+    int reader = __atomic_fetch_add(&server->readers, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&server->queue_lock);
+
+    while (!server->stop) {
+
+        if (server->queue->first == NULL) {
+            pthread_cond_wait(&server->queue_ready, &server->queue_lock);
+            continue;
+        }
+
+        client = (Client*)server->queue->first->data;
+        listRemoveNode(server->queue, server->queue->first);
+        pthread_mutex_unlock(&server->queue_lock);
+
+        serveClient(server, client, reader);
+
+        pthread_mutex_lock(&server->queue_lock);
+    }
+
+    pthread_mutex_unlock(&server->queue_lock);
+
+    return NULL;
+}
+
+/**
+ * Runs the next command of the given client, as the given reader of the
+ * hashtables, and sends it the reply.
+*/
+void serveClient(Server* server, Client* client, int reader) {
+
+    int length = nextCommand(client), more;
+    char *line = (char*)tryMalloc(length + 1), *output, header[32];
+    size_t output_length, header_length;
+    FILE* out;
+
+    memcpy(line, client->input, length);
+    line[length] = '\0';
+    client->length -= length;
+    memmove(client->input, client->input + length, client->length);
+
+    out = open_memstream(&output, &output_length);
+    more = runServerCommand(server, line, out, reader);
+    fclose(out);
+    free(line);
+
+    sprintf(header, "%lu\n", (unsigned long)output_length);
+    header_length = strlen(header);
+
+    client->output = (char*)tryMalloc(header_length + output_length);
+    memcpy(client->output, header, header_length);
+    memcpy(client->output + header_length, output, output_length);
+    client->output_length = header_length + output_length;
+    client->sent = 0;
+    client->closing = !more;
+    free(output);
+
+    writeClient(server, client);
+}
+
+/**
+ * Runs the given command line, as the given reader of the hashtables,
+ * writing its output to the 'out' stream. The lookups of a stop take no
+ * locks. The reading commands and the edits of lines that may share the
+ * system run on a copy of it, with its lock shared; the other commands run
+ * with the lock exclusive. Those include 'z', since 'z freeze' replaces the
+ * index of the names (retired through the epochs, for the lookups taking no
+ * locks). Returns 0 if the client should be closed, or 1 otherwise.
+*/
+int runServerCommand(Server* server, char* line, FILE* out, int reader) {
+
+    System* sys = server->sys;
+    FILE* sys_out;
+    System view;
+    int more;
+
+    __atomic_add_fetch(&server->commands, 1, __ATOMIC_RELAXED);
+
+    if (isStopLookup(server, line)) {
+
+        lookupStop(server, line, out, reader);
+        __atomic_add_fetch(&server->lock_free, 1, __ATOMIC_RELAXED);
+
+        return 1;
+    }
+
+    readLock(&server->lock);
+
+    view = *sys;
+    view.input = line;
+    view.out = out;
+
+    if (isReadingCommand(sys, line)) {
+
+        runReadingCommand(server, &view);
+        readUnlock(&server->lock);
+        __atomic_add_fetch(&server->shared, 1, __ATOMIC_RELAXED);
+
+        return 1;
+    }
+
+    if (isSharedEdit(sys, line)) {
+
+        runLinkCommand(server, &view);
+        readUnlock(&server->lock);
+        __atomic_add_fetch(&server->shared, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&server->edits, 1, __ATOMIC_RELAXED);
+
+        return 1;
+    }
+
+    readUnlock(&server->lock);
+    writeLock(&server->lock);
+
+    sys_out = sys->out;
+    sys->out = out;
+    more = runCommandLine(sys, line);
+    sys->out = sys_out;
+
+    __atomic_store_n(&server->plain_input, sys->command_lenght == BUFLEN,
+                                                        __ATOMIC_RELEASE);
+    reclaimMemory(sys->epochs);
+
+    writeUnlock(&server->lock);
+    __atomic_add_fetch(&server->exclusive, 1, __ATOMIC_RELAXED);
+
+    return more;
+}
+
+/**
+ * Checks if the given command line only shows the coordinates of a stop:
+ * 'p' with a plain name, after a command that left none of its line unread.
+ * Returns YES if so, or NO otherwise.
+*/
+int isStopLookup(Server* server, char* line) {
+
+    return line[0] == 'p' && countPlainArgs(line) == 1 &&
+                __atomic_load_n(&server->plain_input, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Shows the coordinates of the stop named by the given command line, taking
+ * no locks: the stop is looked up, and its coordinates, which never change,
+ * read inside a grace period of the hashtables.
+*/
+void lookupStop(Server* server, char* line, FILE* out, int reader) {
+
+    System* sys = server->sys;
+    char* name = line + 2;
+    Stop* stop;
+
+    name[strlen(name) - 1] = '\0';
+    enterEpoch(sys->epochs, reader);
+
+    if ((stop = getStop(sys, name)) == NULL)
+        fprintf(out, NO_SUCH_STOP, name);
+    else
+        printStopCoordinates(out, stop);
+
+    leaveEpoch(sys->epochs, reader);
+}
+
+/**
+ * Checks if the given command line edits a line in a way that may share the
+ * system: 'l' with plain arguments, outside a batch, with no journal, whose
+ * records follow the order of the commands, and no hierarchy, which it
+ * would invalidate. Returns YES if so, or NO otherwise.
+*/
+int isSharedEdit(System *sys, char* line) {
+
+    if (sys->command_lenght != BUFLEN || sys->batch ||
+                            sys->journal != NULL || sys->hierarchy != NULL)
+        return NO;
+
+    return line[0] == 'l' && countPlainArgs(line) == 5;
+}
+
+/**
+ * Runs the reading command of the given copy of the system, with the locks
+ * of what it reads: the line shown by 'c' with its name, and every stripe
+ * for the listings of the stops and of the intersections, which clean and
+ * sort the lines of the stops. The listing of the lines takes the lock of
+ * each line in turn, while it's listed.
+*/
+void runReadingCommand(Server* server, System *view) {
+
+    char* line = view->input;
+    Line* shown = NULL;
+    int stops = line[0] == 'i' || (line[0] == 'p' && line[1] == '\n');
+
+    if (line[0] == 'c' && line[1] == '\n') {
+        listLockedLines(server, view);
+        return;
+    }
+
+    if (line[0] == 'c')
+        pthread_mutex_lock(lineLock(server,
+                                    shown = getCommandLine(view, line)));
+    else if (stops)
+        lockAllStripes(server, YES);
+
+    handleCommand(view);
+
+    if (shown != NULL)
+        pthread_mutex_unlock(lineLock(server, shown));
+    else if (stops)
+        lockAllStripes(server, NO);
+}
+
+/**
+ * Lists the lines of the given copy of the system, as 'c' does, each with
+ * its lock, so that a line is listed as it was before or after each link.
+*/
+void listLockedLines(Server* server, System *view) {
+
+    Node* ptr;
+    Line* line;
+
+    for (ptr = view->lines_list->first; ptr != NULL; ptr = ptr->next) {
+
+        line = (Line*)ptr->data;
+        pthread_mutex_lock(lineLock(server, line));
+        refreshLineValues(view, line);
+        printLine(view->out, line);
+        pthread_mutex_unlock(lineLock(server, line));
+    }
+}
+
+/**
+ * Runs the 'l' command of the given copy of the system with the lock of its
+ * line, and the stripes of its stops. The names are looked up before, since
+ * the tables only change with the lock of the system exclusive.
+*/
+void runLinkCommand(Server* server, System *view) {
+
+    Link* link;
+    Line* line;
+    Stop *orig, *dest;
+
+    nextChar(view);
+
+    if ((link = obtainLinkArgs(view)) == NULL)
+        return;
+
+    line = (Line*)link->line;
+    orig = (Stop*)link->orig;
+    dest = (Stop*)link->dest;
+
+    pthread_mutex_lock(lineLock(server, line));
+    lockStops(server, orig, dest, YES);
+
+    refreshLineValues(view, line);
+    addLink(view, link);
+
+    lockStops(server, orig, dest, NO);
+    pthread_mutex_unlock(lineLock(server, line));
+}
+
+/**
+ * Takes (if 'lock' is YES) or releases every stripe, in their order.
+*/
+void lockAllStripes(Server* server, int lock) {
+
+    int i;
+
+    for (i = 0; i < SERVER_STRIPES; i++) {
+
+        if (lock)
+            pthread_mutex_lock(&server->stripes[i]);
+        else
+            pthread_mutex_unlock(&server->stripes[i]);
+    }
+}
+
+/**
+ * Takes (if 'lock' is YES) or releases the stripes of the given stops, in
+ * their order, once if they're the same.
+*/
+void lockStops(Server* server, Stop* first, Stop* second, int lock) {
+
+    int a = first->order % SERVER_STRIPES, b = second->order % SERVER_STRIPES;
+
+    if (a > b) {
+        a = b;
+        b = first->order % SERVER_STRIPES;
+    }
+
+    if (lock) {
+        pthread_mutex_lock(&server->stripes[a]);
+        if (b != a)
+            pthread_mutex_lock(&server->stripes[b]);
+    } else {
+        if (b != a)
+            pthread_mutex_unlock(&server->stripes[b]);
+        pthread_mutex_unlock(&server->stripes[a]);
+    }
+}
+
+/**
+ * Returns the lock of the route of the given line: the stripe of its name.
+*/
+pthread_mutex_t* lineLock(Server* server, Line* line) {
+
+    return &server->line_stripes[line->name.hashes[0] % SERVER_STRIPES];
+}
+
+/**
+ * Sends the reply of the given client, as much of it as its socket takes.
+ * Once it's all sent, the client goes back to the queue if it has another
+ * command, or waits for more input; until then, it waits for room in its
+ * socket, handed back to the loop.
+*/
+void writeClient(Server* server, Client* client) {
+
+    int sent = sendOutput(client);
+
+    if (sent == NO) {
+        rearmClient(server, client, EPOLLOUT);
+        return;
+    }
+
+    free(client->output);
+    client->output = NULL;
+
+    if (sent == ERR || client->closing)
+        closeClient(server, client);
+    else if (nextCommand(client) > 0)
+        queueClient(server, client);
+    else if (client->ended)
+        closeClient(server, client);
+    else
+        rearmClient(server, client, EPOLLIN);
+}
+
+/**
+ * Sends the reply of the given client, without blocking. Returns YES if it
+ * was all sent, NO if the socket can't take the rest yet, or ERR if the
+ * client is gone.
+*/
+int sendOutput(Client* client) {
+
+    ssize_t count;
+
+    while (client->sent < client->output_length) {
+
+        count = send(client->fd, client->output + client->sent,
+                    client->output_length - client->sent, MSG_NOSIGNAL);
+
+        if (count < 0) {
+
+            if (errno == EINTR)
+                continue;
+
+            return errno == EAGAIN || errno == EWOULDBLOCK ? NO : ERR;
+        }
+
+        client->sent += count;
+    }
+
+    return YES;
+}
+
+/**
+ * Hands the given client back to the loop, to wait for the given events:
+ * its input, or room for its reply.
+*/
+void rearmClient(Server* server, Client* client, int events) {
+
+    struct epoll_event event;
+
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = client;
+
+    pthread_mutex_lock(&server->queue_lock);
+    epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event);
+    pthread_mutex_unlock(&server->queue_lock);
+}
+
+/**
+ * Closes the connection of the given client and frees it.
+*/
+void closeClient(Server* server, Client* client) {
+
+    pthread_mutex_lock(&server->queue_lock);
+    server->clients[client->fd] = NULL;
+    pthread_mutex_unlock(&server->queue_lock);
+
+    close(client->fd);
+    free(client->input);
+    free(client->output);
+    free(client);
+}
+
+/**
+ * Stops the threads of the given server, once they finish their commands,
+ * closes every client and the socket, and frees all its allocated memory.
+*/
+void destroyServer(Server* server) {
+
+    System* sys = server->sys;
+    int i;
+
+    pthread_mutex_lock(&server->queue_lock);
+    server->stop = YES;
+    pthread_cond_broadcast(&server->queue_ready);
+    pthread_mutex_unlock(&server->queue_lock);
+
+    for (i = 0; i < server->num_threads; i++)
+        pthread_join(server->threads[i], NULL);
+
+    for (i = 0; i < server->size_clients; i++)
+        if (server->clients[i] != NULL)
+            closeClient(server, server->clients[i]);
+
+    fprintf(stderr, SERVER_STATS, server->accepted, server->commands,
+                server->lock_free, server->shared, server->edits,
+                server->exclusive);
+
+    sys->stops_table->epochs = sys->lines_table->epochs = NULL;
+    destroyEpochs(sys->epochs);
+    sys->epochs = NULL;
+
+    close(server->listener);
+    close(server->signals);
+    close(server->epoll);
+    unlink(server->path);
+
+    destroyRWLock(&server->lock);
+
+    for (i = 0; i < SERVER_STRIPES; i++) {
+        pthread_mutex_destroy(&server->stripes[i]);
+        pthread_mutex_destroy(&server->line_stripes[i]);
+    }
+    pthread_mutex_destroy(&server->queue_lock);
+    pthread_cond_destroy(&server->queue_ready);
+
+    while (server->queue->first != NULL)
+        listRemoveNode(server->queue, server->queue->first);
+
+    listDestroy(server->queue);
+    free(server->clients);
+    free(server->threads);
+    free(server);
+}
+
+
+/* ---------------------------- Reader-writer lock -------------------------- */
+
+/**
+ * Initializes the given reader-writer lock, held by no one.
+*/
+void initRWLock(RWLock* rw) {
+
+    pthread_mutex_init(&rw->lock, NULL);
+    pthread_cond_init(&rw->readers_ok, NULL);
+    pthread_cond_init(&rw->writers_ok, NULL);
+    rw->readers = 0;
+    rw->writer = NO;
+    rw->writers_waiting = 0;
+}
+
+/**
+ * Takes the given lock shared, once no writer holds it or waits for it.
+*/
+void readLock(RWLock* rw) {
+
+    pthread_mutex_lock(&rw->lock);
+
+    while (rw->writer || rw->writers_waiting > 0)
+        pthread_cond_wait(&rw->readers_ok, &rw->lock);
+
+    rw->readers++;
+    pthread_mutex_unlock(&rw->lock);
+}
+
+/**
+ * Releases the given lock, taken shared.
+*/
+void readUnlock(RWLock* rw) {
+
+    pthread_mutex_lock(&rw->lock);
+
+    if (--rw->readers == 0 && rw->writers_waiting > 0)
+        pthread_cond_signal(&rw->writers_ok);
+
+    pthread_mutex_unlock(&rw->lock);
+}
+
+/**
+ * Takes the given lock exclusive, once no one else holds it.
+*/
+void writeLock(RWLock* rw) {
+
+    pthread_mutex_lock(&rw->lock);
+    rw->writers_waiting++;
+
+    while (rw->writer || rw->readers > 0)
+        pthread_cond_wait(&rw->writers_ok, &rw->lock);
+
+    rw->writers_waiting--;
+    rw->writer = YES;
+    pthread_mutex_unlock(&rw->lock);
+}
+
+/**
+ * Releases the given lock, taken exclusive. The next writer waiting goes
+ * first, or else every reader waiting.
+*/
+void writeUnlock(RWLock* rw) {
+
+    pthread_mutex_lock(&rw->lock);
+    rw->writer = NO;
+
+    if (rw->writers_waiting > 0)
+        pthread_cond_signal(&rw->writers_ok);
+    else
+        pthread_cond_broadcast(&rw->readers_ok);
+
+    pthread_mutex_unlock(&rw->lock);
+}
+
+/**
+ * Destroys the given reader-writer lock, held by no one.
+*/
+void destroyRWLock(RWLock* rw) {
+
+    pthread_mutex_destroy(&rw->lock);
+    pthread_cond_destroy(&rw->readers_ok);
+    pthread_cond_destroy(&rw->writers_ok);
+}
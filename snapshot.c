@@ -0,0 +1,479 @@
+/**
+ * IAED-23 Project 2
+ * File: snapshot.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the snapshots, binary
+ * files with the whole network (stops, lines, routes and the lines of each
+ * stop). A snapshot is a header followed by arrays of fixed size records and
+ * the names, so it's mapped into memory and read in place when loaded.
+*/
+
+/* The snapshot is mapped into memory (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/* ------------------------------- Snapshots -------------------------------- */
+
+/**
+ * Saves the network of the system in a snapshot with the given name. The
+ * snapshot is written to a temporary file first, which then replaces it,
+ * so a snapshot is never left half written. Returns YES if it was saved, or
+ * NO otherwise.
+*/
+int saveSnapshot(System *sys, char* file_name) {
+
+    char* temp_name = (char*)tryMalloc(strlen(file_name) +
+                                            strlen(SNAPSHOT_TEMP) + 1);
+    FILE* file;
+    int ok;
+
+    strcat(strcpy(temp_name, file_name), SNAPSHOT_TEMP);
+
+    if ((file = fopen(temp_name, "wb")) == NULL) {
+        fprintf(sys->out, CANT_WRITE, file_name);
+        free(temp_name);
+        return NO;
+    }
+
+    prepareSnapshot(sys);
+    ok = writeSnapshot(sys, file);
+
+    /* The snapshot is on the disk before it replaces the old one. */
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temp_name, file_name) != 0) {
+        fprintf(sys->out, CANT_WRITE, file_name);
+        remove(temp_name);
+        ok = NO;
+    }
+
+    free(temp_name);
+
+    return ok;
+}
+
+/**
+ * Brings up to date what a batch leaves for later, the values of the lines
+ * and the duplicates in the stops' lines, and numbers the stops and lines
+ * by order of creation, as they're referred to in the snapshot.
+*/
+void prepareSnapshot(System *sys) {
+
+    Node* ptr;
+    Stop* stop;
+    int i;
+
+    for (i = 0, ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
+        refreshLineValues(sys, (Line*)ptr->data);
+        ((Line*)ptr->data)->position = i++;
+    }
+
+    for (i = 0, ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next) {
+
+        stop = (Stop*)ptr->data;
+
+        if (stop->duplicates)
+            cleanStopLines(stop);
+
+        /* Same index as in the network graph. */
+        stop->index = i++;
+    }
+}
+
+/**
+ * Writes the snapshot of the system to the given file. Returns YES if it
+ * was written, or NO otherwise.
+*/
+int writeSnapshot(System *sys, FILE* file) {
+
+    SnapshotHeader header;
+    Snapshot snap;
+    int ok;
+
+    memset(&header, 0, sizeof(SnapshotHeader));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+
+    fillSnapshot(sys, &header, &snap);
+    header.checksum = snapshotChecksum(&snap);
+    header.covers = sys->journal != NULL ? sys->journal->base :
+                                                        JOURNAL_NO_SNAPSHOT;
+
+    ok = fwrite(&header, sizeof(SnapshotHeader), 1, file) == 1 &&
+            writeSection(file, snap.stops, snap.num_stops,
+                                                sizeof(SnapshotStop)) &&
+            writeSection(file, snap.lines, snap.num_lines,
+                                                sizeof(SnapshotLine)) &&
+            writeSection(file, snap.links, snap.num_links,
+                                                sizeof(SnapshotLink)) &&
+            writeSection(file, snap.members, snap.num_members,
+                                                sizeof(unsigned int)) &&
+            writeSection(file, snap.names, snap.names_size, 1);
+
+    free(snap.stops);
+    free(snap.lines);
+    free(snap.links);
+    free(snap.members);
+    free(snap.names);
+
+    return ok;
+}
+
+/**
+ * Writes the 'count' records of the given size in 'data' to the file.
+ * Returns YES if they were written, or NO otherwise.
+*/
+int writeSection(FILE* file, void* data, unsigned int count, size_t size) {
+
+    return count == 0 || fwrite(data, size, count, file) == count;
+}
+
+/**
+ * Fills the sections of the snapshot of the system, and their sizes in
+ * the header. The stops and lines must be numbered.
+*/
+void fillSnapshot(System *sys, SnapshotHeader* header, Snapshot* snap) {
+
+    unsigned int stop = 0, line = 0, link = 0, member = 0, name = 0;
+    Node *ptr, *aux;
+    Line* l;
+    Stop* s;
+
+    snap->num_stops = sys->stops_list->count;
+    snap->num_lines = sys->lines_list->count;
+    snap->num_links = 0;
+    snap->num_members = 0;
+    snap->names_size = 0;
+
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
+        l = (Line*)ptr->data;
+        snap->num_links += l->links_list->count;
+        snap->names_size += l->name.length + 1;
+    }
+
+    for (ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next) {
+        s = (Stop*)ptr->data;
+        snap->num_members += s->lines->count;
+        snap->names_size += s->name.length + 1;
+    }
+
+    snap->stops = (SnapshotStop*)tryMalloc(snap->num_stops *
+                                                sizeof(SnapshotStop) + 1);
+    snap->lines = (SnapshotLine*)tryMalloc(snap->num_lines *
+                                                sizeof(SnapshotLine) + 1);
+    snap->links = (SnapshotLink*)tryMalloc(snap->num_links *
+                                                sizeof(SnapshotLink) + 1);
+    snap->members = (unsigned int*)tryMalloc(snap->num_members *
+                                                sizeof(unsigned int) + 1);
+    snap->names = (char*)tryMalloc(snap->names_size + 1);
+
+    for (ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next, stop++) {
+
+        s = (Stop*)ptr->data;
+        snap->stops[stop].latitude = s->latitude;
+        snap->stops[stop].longitude = s->longitude;
+        snap->stops[stop].name = name;
+        snap->stops[stop].first_line = member;
+        snap->stops[stop].num_lines = s->lines->count;
+        snap->stops[stop].sorted = s->lines->sorted == SORTED;
+
+        strcpy(snap->names + name, nameChars(&s->name));
+        name += s->name.length + 1;
+
+        for (aux = s->lines->first; aux != NULL; aux = aux->next)
+            snap->members[member++] = ((Line*)aux->data)->position;
+    }
+
+    for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next, line++) {
+
+        l = (Line*)ptr->data;
+        snap->lines[line].cost = l->total_value.cost;
+        snap->lines[line].duration = l->total_value.duration;
+        snap->lines[line].name = name;
+        snap->lines[line].first_link = link;
+        snap->lines[line].num_links = l->links_list->count;
+        snap->lines[line].num_stops = l->num_stops;
+
+        strcpy(snap->names + name, nameChars(&l->name));
+        name += l->name.length + 1;
+
+        for (aux = l->links_list->first; aux != NULL; aux = aux->next) {
+            snap->links[link].cost = ((Link*)aux->data)->value.cost;
+            snap->links[link].duration = ((Link*)aux->data)->value.duration;
+            snap->links[link].orig = ((Stop*)((Link*)aux->data)->orig)->index;
+            snap->links[link++].dest =
+                                    ((Stop*)((Link*)aux->data)->dest)->index;
+        }
+    }
+
+    header->num_stops = snap->num_stops;
+    header->num_lines = snap->num_lines;
+    header->num_links = snap->num_links;
+    header->num_members = snap->num_members;
+    header->names_size = snap->names_size;
+}
+
+/**
+ * Loads the snapshot with the given name, which replaces the network of
+ * the system. The system is left as it was if the snapshot is missing or
+ * invalid. Returns YES if it was loaded, or NO otherwise.
+*/
+int loadSnapshot(System *sys, char* file_name) {
+
+    int file = open(file_name, O_RDONLY);
+    struct stat info;
+    Snapshot snap;
+    void* data;
+    int ok;
+
+    if (file < 0) {
+        fprintf(sys->out, NO_SUCH_FILE, file_name);
+        return NO;
+    }
+
+    if (fstat(file, &info) != 0 || info.st_size < (long int)
+                                                    sizeof(SnapshotHeader) ||
+            (data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0))
+                                                            == MAP_FAILED) {
+        fprintf(sys->out, INVALID_SNAPSHOT, file_name);
+        close(file);
+        return NO;
+    }
+
+    close(file);
+
+    if ((ok = mapSnapshot(data, info.st_size, &snap) && checkSnapshot(&snap))) {
+        invalidateHierarchy(sys);
+        clearSystem(sys);
+        rebuildSnapshot(sys, &snap);
+    } else {
+        fprintf(sys->out, INVALID_SNAPSHOT, file_name);
+    }
+
+    munmap(data, info.st_size);
+
+    return ok;
+}
+
+/**
+ * Reads the header of the snapshot with the given name into 'header'.
+ * Returns YES if it was read, or NO otherwise.
+*/
+int readSnapshotHeader(char* file_name, SnapshotHeader* header) {
+
+    FILE* file = fopen(file_name, "rb");
+    int ok;
+
+    if (file == NULL)
+        return NO;
+
+    ok = fread(header, sizeof(SnapshotHeader), 1, file) == 1;
+    fclose(file);
+
+    return ok;
+}
+
+/**
+ * Finds the sections of the snapshot mapped at 'data', with the given
+ * size, checking its header and its checksum. Returns YES if it's a
+ * snapshot of this version, or NO otherwise.
+*/
+int mapSnapshot(char* data, long int size, Snapshot* snap) {
+
+    SnapshotHeader* header = (SnapshotHeader*)data;
+    unsigned long int rest = size - sizeof(SnapshotHeader);
+
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+                                    header->version != SNAPSHOT_VERSION ||
+                                    header->byte_order != SNAPSHOT_BYTE_ORDER)
+        return NO;
+
+    /* Each section must fit in what's left, before it's added. */
+    if (header->num_stops > rest / sizeof(SnapshotStop))
+        return NO;
+    rest -= header->num_stops * sizeof(SnapshotStop);
+
+    if (header->num_lines > rest / sizeof(SnapshotLine))
+        return NO;
+    rest -= header->num_lines * sizeof(SnapshotLine);
+
+    if (header->num_links > rest / sizeof(SnapshotLink))
+        return NO;
+    rest -= header->num_links * sizeof(SnapshotLink);
+
+    if (header->num_members > rest / sizeof(unsigned int))
+        return NO;
+    rest -= header->num_members * sizeof(unsigned int);
+
+    if (header->names_size != rest)
+        return NO;
+
+    snap->num_stops = header->num_stops;
+    snap->num_lines = header->num_lines;
+    snap->num_links = header->num_links;
+    snap->num_members = header->num_members;
+    snap->names_size = header->names_size;
+
+    snap->stops = (SnapshotStop*)(data + sizeof(SnapshotHeader));
+    snap->lines = (SnapshotLine*)(snap->stops + snap->num_stops);
+    snap->links = (SnapshotLink*)(snap->lines + snap->num_lines);
+    snap->members = (unsigned int*)(snap->links + snap->num_links);
+    snap->names = (char*)(snap->members + snap->num_members);
+
+    return snapshotChecksum(snap) == header->checksum;
+}
+
+/**
+ * Checks that every name, stop, line and link referred to in the snapshot
+ * is inside its section. Returns YES if so, or NO otherwise.
+*/
+int checkSnapshot(Snapshot* snap) {
+
+    unsigned int i;
+
+    if (snap->names_size > 0 && snap->names[snap->names_size - 1] != '\0')
+        return NO;
+
+    for (i = 0; i < snap->num_stops; i++)
+        if (snap->stops[i].name >= snap->names_size ||
+                    snap->stops[i].num_lines > snap->num_members ||
+                    snap->stops[i].first_line > snap->num_members -
+                                                    snap->stops[i].num_lines)
+            return NO;
+
+    for (i = 0; i < snap->num_lines; i++)
+        if (snap->lines[i].name >= snap->names_size ||
+                    snap->lines[i].num_links > snap->num_links ||
+                    snap->lines[i].first_link > snap->num_links -
+                                                    snap->lines[i].num_links)
+            return NO;
+
+    for (i = 0; i < snap->num_links; i++)
+        if (snap->links[i].orig >= snap->num_stops ||
+                                    snap->links[i].dest >= snap->num_stops)
+            return NO;
+
+    for (i = 0; i < snap->num_members; i++)
+        if (snap->members[i] >= snap->num_lines)
+            return NO;
+
+    return YES;
+}
+
+/**
+ * Creates the stops, lines, routes and stops' lines of the given snapshot
+ * in the system, which must be empty. The hashtables get new slots with
+ * room for every name, so they're not expanded meanwhile.
+*/
+void rebuildSnapshot(System *sys, Snapshot* snap) {
+
+    Stop** stops = (Stop**)tryMalloc(snap->num_stops * sizeof(Stop*) + 1);
+    Line** lines = (Line**)tryMalloc(snap->num_lines * sizeof(Line*) + 1);
+    SnapshotLink* link;
+    Link* new_link;
+    Node* new_node;
+    unsigned int i, j;
+
+    resizeHashtable(sys->stops_table, snap->num_stops);
+    resizeHashtable(sys->lines_table, snap->num_lines);
+
+    for (i = 0; i < snap->num_stops; i++) {
+
+        stops[i] = populateStop((Stop*)tagMalloc(sizeof(Stop), MEM_STOP),
+                                snap->names + snap->stops[i].name,
+                                snap->stops[i].latitude,
+                                snap->stops[i].longitude, sys->names);
+        stops[i]->order = sys->stops_created++;
+
+        new_node = listInsertEnd(sys->stops_list, stops[i]);
+        hashtableInsert(sys->stops_table, new_node, getStopName(new_node),
+                                                                getStopName);
+        columnsInsert(sys->columns, stops[i]);
+    }
+
+    spatialInsertMany(sys->spatial, stops, snap->num_stops);
+    rangeInsertMany(sys->ranges, stops, snap->num_stops);
+
+    for (i = 0; i < snap->num_lines; i++) {
+
+        addLine(sys, snap->names + snap->lines[i].name);
+        lines[i] = (Line*)sys->lines_list->last->data;
+        lines[i]->total_value.cost = snap->lines[i].cost;
+        lines[i]->total_value.duration = snap->lines[i].duration;
+        lines[i]->num_stops = snap->lines[i].num_stops;
+
+        for (j = 0; j < snap->lines[i].num_links; j++) {
+
+            link = &snap->links[snap->lines[i].first_link + j];
+            new_link = populateLink((Link*)tagMalloc(sizeof(Link), MEM_LINK),
+                            lines[i], stops[link->orig], stops[link->dest]);
+            new_link->value.cost = link->cost;
+            new_link->value.duration = link->duration;
+            append(lines[i]->links_list, new_link);
+        }
+    }
+
+    for (i = 0; i < snap->num_stops; i++) {
+
+        for (j = 0; j < snap->stops[i].num_lines; j++)
+            append(stops[i]->lines,
+                        lines[snap->members[snap->stops[i].first_line + j]]);
+
+        if (snap->stops[i].sorted)
+            stops[i]->lines->sorted = SORTED;
+    }
+
+    free(stops);
+    free(lines);
+}
+
+/**
+ * Replaces the slots of the given hashtable, whose elements were all
+ * removed, with slots where 'count' elements fit without expanding it.
+*/
+void resizeHashtable(Hashtable* hash, unsigned int count) {
+
+    int size = getPrime((int)(count / HT_MAX_LOAD) + 1);
+
+    resetHashtable(hash, size > HT_START_SIZE ? size : HT_START_SIZE);
+}
+
+/**
+ * Calculates the checksum of the sections of the given snapshot (the 32 bit
+ * FNV-1a hash of their bytes). Returns the checksum.
+*/
+unsigned int snapshotChecksum(Snapshot* snap) {
+
+    unsigned int hash = SNAPSHOT_FNV_BASIS;
+
+    hash = checksumBytes(hash, snap->stops,
+                                    snap->num_stops * sizeof(SnapshotStop));
+    hash = checksumBytes(hash, snap->lines,
+                                    snap->num_lines * sizeof(SnapshotLine));
+    hash = checksumBytes(hash, snap->links,
+                                    snap->num_links * sizeof(SnapshotLink));
+    hash = checksumBytes(hash, snap->members,
+                                    snap->num_members * sizeof(unsigned int));
+
+    return checksumBytes(hash, snap->names, snap->names_size);
+}
+
+/**
+ * Adds the 'size' bytes of 'data' to the given FNV-1a hash. Returns the
+ * new hash.
+*/
+unsigned int checksumBytes(unsigned int hash, void* data, unsigned long size) {
+
+    unsigned char* bytes = data;
+    unsigned long i;
+
+    for (i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * SNAPSHOT_FNV_PRIME;
+
+    return hash;
+}
@@ -0,0 +1,428 @@
+/**
+ * IAED-23 Project 2
+ * File: spatial.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the spatial index of
+ * the stops, a k-d tree over their positions in the unit sphere, and of the
+ * nearest stops queries.
+*/
+
+#include "main.h"
+
+
+/* ---------------------------- Nearest stops ------------------------------- */
+
+/**
+ * Shows in the standard output the 'k' stops nearest to the given
+ * coordinates, from the nearest to the farthest, with their distance
+ * in kilometres.
+*/
+void showNearestStops(System *sys, double latitude, double longitude, int k) {
+
+    Neighbour* result;
+    int i, count;
+
+    if (k <= 0 || sys->stops_list->count == 0)
+        return;
+
+    if (k > sys->stops_list->count)
+        k = sys->stops_list->count;
+
+    result = (Neighbour*)tryMalloc(k * sizeof(Neighbour));
+    count = nearestStops(sys->spatial, latitude, longitude, k, result);
+
+    for (i = 0; i < count; i++)
+        fprintf(sys->out, "%s: %.3f\n", nameChars(&result[i].stop->name),
+                                        geoChordToKm(result[i].dist));
+
+    free(result);
+}
+
+/**
+ * Finds the 'k' stops nearest to the given coordinates in the spatial index,
+ * storing them in 'result' from the nearest to the farthest. Stops at the
+ * same distance are ordered by name. Returns the number of stops found.
+*/
+int nearestStops(SpatialIndex* index, double latitude, double longitude,
+                                                int k, Neighbour* result) {
+
+    Heap* best = createHeap(k + 1);
+    Neighbour* pool = (Neighbour*)tryMalloc(k * sizeof(Neighbour));
+    double point[3];
+
+    geoPosition(latitude, longitude, point);
+    searchNearest(index, index->root, point, k, best, pool);
+
+    return popNeighbours(best, pool, result);
+}
+
+/**
+ * Visits the subtree of the given node, keeping in the 'best' heap the 'k'
+ * stops nearest to the given point. The nearer child is visited first, and
+ * the farther child is only visited if it may hold a stop nearer than the
+ * farthest one kept.
+*/
+void searchNearest(SpatialIndex* index, int node, double point[3], int k,
+                                            Heap* best, Neighbour* pool) {
+
+    SpatialNode* ptr;
+    double diff;
+
+    if (node == ERR)
+        return;
+
+    ptr = &index->nodes[node];
+
+    if (!ptr->removed)
+        keepNeighbour(best, pool, k, ptr->stop, geoChord(point, ptr->point));
+
+    diff = point[ptr->axis] - ptr->point[ptr->axis];
+
+    searchNearest(index, diff < 0 ? ptr->left : ptr->right, point, k, best,
+                                                                    pool);
+
+    if (best->count < k || diff * diff <= ((Neighbour*)best->data[0])->dist)
+        searchNearest(index, diff < 0 ? ptr->right : ptr->left, point, k,
+                                                            best, pool);
+}
+
+/**
+ * Keeps the given stop in the 'best' heap if it has less than 'k' stops or
+ * the stop is nearer than the farthest one, which is then dropped. The
+ * entries of the heap are stored in 'pool'.
+*/
+void keepNeighbour(Heap* best, Neighbour* pool, int k, Stop* stop,
+                                                            double dist) {
+
+    Neighbour candidate, *entry;
+
+    candidate.stop = stop;
+    candidate.dist = dist;
+
+    if (best->count < k) {
+
+        entry = &pool[best->count];
+        *entry = candidate;
+        heapPush(best, entry, compareFarthest);
+
+    } else if (compareFarthest(&candidate, best->data[0]) > 0) {
+
+        entry = (Neighbour*)heapPop(best, compareFarthest);
+        *entry = candidate;
+        heapPush(best, entry, compareFarthest);
+    }
+}
+
+/**
+ * Moves the neighbours kept in the 'best' heap to 'result', from the nearest
+ * to the farthest, and frees the heap and its pool. Returns the number of
+ * neighbours.
+*/
+int popNeighbours(Heap* best, Neighbour* pool, Neighbour* result) {
+
+    int i, count = best->count;
+
+    /* The farthest stop is on top of the heap. */
+    for (i = count - 1; i >= 0; i--)
+        result[i] = *(Neighbour*)heapPop(best, compareFarthest);
+
+    destroyHeap(best);
+    free(pool);
+
+    return count;
+}
+
+/**
+ * Compares two neighbours so that the farthest comes first, and if tied,
+ * the one whose stop name comes last. Returns a negative value if the first
+ * neighbour comes first, 0 if they're tied or a positive value if the
+ * second one comes first.
+*/
+int compareFarthest(void* first, void* second) {
+
+    Neighbour *first_ngb = first, *second_ngb = second;
+
+    if (first_ngb->dist != second_ngb->dist)
+        return first_ngb->dist > second_ngb->dist ? -1 : 1;
+
+    return -strcmp(nameChars(&first_ngb->stop->name), 
+                                        nameChars(&second_ngb->stop->name));
+}
+
+/**
+ * Finds the 'k' stops nearest to the given coordinates by comparing every
+ * stop of the system, like 'nearestStops'. Used to check and measure the
+ * spatial index. Returns the number of stops found.
+*/
+int nearestStopsScan(System *sys, double latitude, double longitude, int k,
+                                                        Neighbour* result) {
+
+    Heap* best = createHeap(k + 1);
+    Neighbour* pool = (Neighbour*)tryMalloc(k * sizeof(Neighbour));
+    SpatialNode* nodes = sys->spatial->nodes;
+    double point[3];
+    Node* ptr;
+    Stop* stop;
+
+    geoPosition(latitude, longitude, point);
+
+    /* The positions computed by the index are reused. */
+    for (ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next) {
+
+        stop = (Stop*)ptr->data;
+        keepNeighbour(best, pool, k, stop,
+                                geoChord(point, nodes[stop->spatial].point));
+    }
+
+    return popNeighbours(best, pool, result);
+}
+
+
+/* ----------------------------- Spatial index ------------------------------ */
+
+/**
+ * Creates a new empty spatial index and returns its respective pointer.
+*/
+SpatialIndex* createSpatialIndex() {
+
+    SpatialIndex* index = (SpatialIndex*)tryMalloc(sizeof(SpatialIndex));
+
+    index->size = SPATIAL_START_SIZE;
+    index->nodes = (SpatialNode*)tryMalloc(index->size * sizeof(SpatialNode));
+    index->count = 0;
+    index->live = 0;
+    index->root = ERR;
+    index->rebuild_count = SPATIAL_START_SIZE;
+
+    return index;
+}
+
+/**
+ * Inserts the given stop in the spatial index as a new leaf. If the index
+ * doubled since it was last balanced, or the leaf is too deep, the index is
+ * rebuilt.
+*/
+void spatialInsert(SpatialIndex* index, Stop* stop) {
+
+    SpatialNode *new_node, *ptr;
+    int parent = ERR, node = index->root, depth = 0, go_left = NO;
+    double point[3];
+
+    geoPosition(stop->latitude, stop->longitude, point);
+
+    /* Find the leaf's parent. */
+    while (node != ERR) {
+
+        parent = node;
+        ptr = &index->nodes[node];
+        go_left = point[ptr->axis] < ptr->point[ptr->axis];
+        node = go_left ? ptr->left : ptr->right;
+        depth++;
+    }
+
+    if (index->count == index->size) {
+        index->size *= 2;
+        index->nodes = (SpatialNode*)tryRealloc(index->nodes,
+                                        index->size * sizeof(SpatialNode));
+    }
+
+    new_node = &index->nodes[index->count];
+    memcpy(new_node->point, point, sizeof(point));
+    new_node->stop = stop;
+    new_node->left = ERR;
+    new_node->right = ERR;
+    new_node->removed = NO;
+    new_node->axis = parent == ERR ? 0 : (index->nodes[parent].axis + 1) % 3;
+
+    if (parent == ERR)
+        index->root = index->count;
+    else if (go_left)
+        index->nodes[parent].left = index->count;
+    else
+        index->nodes[parent].right = index->count;
+
+    stop->spatial = index->count++;
+    index->live++;
+
+    if (index->count >= index->rebuild_count ||
+                                        depth > spatialMaxDepth(index->live))
+        rebuildSpatialIndex(index);
+}
+
+/**
+ * Inserts the given stops in the spatial index at once, rebuilding it only
+ * after the last one.
+*/
+void spatialInsertMany(SpatialIndex* index, Stop** stops, int count) {
+
+    SpatialNode* new_node;
+    int i;
+
+    if (count == 0)
+        return;
+
+    while (index->count + count > index->size)
+        index->size *= 2;
+
+    index->nodes = (SpatialNode*)tryRealloc(index->nodes,
+                                        index->size * sizeof(SpatialNode));
+
+    for (i = 0; i < count; i++) {
+
+        new_node = &index->nodes[index->count++];
+        geoPosition(stops[i]->latitude, stops[i]->longitude, new_node->point);
+        new_node->stop = stops[i];
+        new_node->removed = NO;
+    }
+
+    index->live += count;
+    rebuildSpatialIndex(index);
+}
+
+/**
+ * Removes the given stop from the spatial index. Its node is only marked as
+ * removed, until more than half of the nodes are, and the index is rebuilt.
+*/
+void spatialRemove(SpatialIndex* index, Stop* stop) {
+
+    index->nodes[stop->spatial].removed = YES;
+    index->live--;
+
+    if (index->live < index->count / 2)
+        rebuildSpatialIndex(index);
+}
+
+/**
+ * Rebuilds the spatial index as a balanced tree of the stops not removed,
+ * splitting each subtree by the median of the axis where its stops are most
+ * spread.
+*/
+void rebuildSpatialIndex(SpatialIndex* index) {
+
+    int i, live = 0;
+
+    /* Move the live nodes to the beginning. */
+    for (i = 0; i < index->count; i++)
+        if (!index->nodes[i].removed)
+            index->nodes[live++] = index->nodes[i];
+
+    index->count = live;
+    index->live = live;
+    index->rebuild_count = 2 * live > SPATIAL_START_SIZE ?
+                                        2 * live : SPATIAL_START_SIZE;
+    index->root = buildSpatialTree(index, 0, live);
+
+    for (i = 0; i < live; i++)
+        index->nodes[i].stop->spatial = i;
+}
+
+/**
+ * Builds a balanced tree with the nodes in [first, last), returning its
+ * root. The nodes are rearranged so that the median is the root, the left
+ * subtree comes before it and the right subtree after it.
+*/
+int buildSpatialTree(SpatialIndex* index, int first, int last) {
+
+    SpatialNode* nodes = index->nodes;
+    int i, axis, mid = first + (last - first) / 2;
+    double low[3], high[3], spread = -1.0;
+
+    if (first >= last)
+        return ERR;
+
+    for (axis = 0; axis < 3; axis++)
+        low[axis] = high[axis] = nodes[first].point[axis];
+
+    for (i = first + 1; i < last; i++) {
+        for (axis = 0; axis < 3; axis++) {
+            if (nodes[i].point[axis] < low[axis])
+                low[axis] = nodes[i].point[axis];
+            if (nodes[i].point[axis] > high[axis])
+                high[axis] = nodes[i].point[axis];
+        }
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (high[i] - low[i] > spread) {
+            spread = high[i] - low[i];
+            axis = i;
+        }
+    }
+
+    selectSpatialMedian(nodes, first, last - 1, mid, axis);
+
+    nodes[mid].axis = axis;
+    nodes[mid].left = buildSpatialTree(index, first, mid);
+    nodes[mid].right = buildSpatialTree(index, mid + 1, last);
+
+    return mid;
+}
+
+/**
+ * Rearranges the nodes in [first, last] so that the node at position 'k' is
+ * the one that would be there if they were sorted along the given axis, the
+ * ones before it being not greater and the ones after it not smaller.
+*/
+void selectSpatialMedian(SpatialNode* nodes, int first, int last, int k,
+                                                                int axis) {
+
+    SpatialNode tmp;
+    double pivot;
+    int i, j;
+
+    while (first < last) {
+
+        pivot = nodes[first + (last - first) / 2].point[axis];
+        i = first;
+        j = last;
+
+        /* Hoare partition. */
+        while (i <= j) {
+
+            while (nodes[i].point[axis] < pivot)
+                i++;
+            while (nodes[j].point[axis] > pivot)
+                j--;
+
+            if (i <= j) {
+                tmp = nodes[i];
+                nodes[i++] = nodes[j];
+                nodes[j--] = tmp;
+            }
+        }
+
+        if (k <= j)
+            last = j;
+        else if (k >= i)
+            first = i;
+        else
+            break;
+    }
+}
+
+/**
+ * Returns the maximum depth of a leaf in an index with the given number
+ * of stops before it's rebuilt: twice the depth of a balanced tree.
+*/
+int spatialMaxDepth(int count) {
+
+    int depth = SPATIAL_DEPTH_SLACK;
+
+    while (count > 1) {
+        count /= 2;
+        depth += 2;
+    }
+
+    return depth;
+}
+
+/**
+ * Frees all the allocated memory in the given spatial index. The stops
+ * are not deleted.
+*/
+void destroySpatialIndex(SpatialIndex* index) {
+
+    free(index->nodes);
+    free(index);
+}
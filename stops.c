@@ -26,13 +26,24 @@ void listStops(System *sys) {
         for (ptr = list->first; ptr != NULL; ptr = ptr->next) {
 
             stop = (Stop*)ptr->data;
-
-            printf("%s: %16.12f %16.12f %d\n", stop->name, stop->latitude, 
-                                        stop->longitude, stop->lines->count);
+            printStop(sys->out, stop);
         }
     }
 }
 
+/**
+ * Presents the name, coordinates and number of lines of the given stop
+ * in the 'out' stream.
+*/
+void printStop(FILE* out, Stop* stop) {
+
+    if (stop->duplicates)
+        cleanStopLines(stop);
+
+    fprintf(out, "%s: %16.12f %16.12f %d\n", nameChars(&stop->name), 
+                    stop->latitude, stop->longitude, stop->lines->count);
+}
+
 /**
  * Shows the coordinates of a given stop in the standard output. 
  * If the stop does not exist, a warning message is presented.
@@ -43,15 +54,23 @@ void showStop(System *sys, char* name) {
 
     if (stop == NULL) {
 
-        printf(NO_SUCH_STOP, name);
+        fprintf(sys->out, NO_SUCH_STOP, name);
         return;
 
     } else {
 
-        printf("%16.12f %16.12f\n", stop->latitude, stop->longitude);
+        printStopCoordinates(sys->out, stop);
     }
 }
 
+/**
+ * Presents the coordinates of the given stop in the 'out' stream.
+*/
+void printStopCoordinates(FILE* out, Stop* stop) {
+
+    fprintf(out, "%16.12f %16.12f\n", stop->latitude, stop->longitude);
+}
+
 /**
  * Check if the stop with the given name exists in the stops hashtable.
  * If the name is found, returns a pointer to that stop. Else, returns NULL.
@@ -71,11 +90,11 @@ Stop* getStop(System *sys, char* name) {
 /**
  * Retrieves the name of a stop.
 */
-char* getStopName(void* stop) {
+Name* getStopName(void* stop) {
 
     Node* stop_node = stop;
     Stop* stop_get = (Stop*)stop_node->data;
-    return stop_get->name;
+    return &stop_get->name;
 }
 
 /**
@@ -83,34 +102,43 @@ char* getStopName(void* stop) {
 */
 void addStop(System *sys, char* name, double latitude, double longitude) {
 
-    Stop* new_stop = (Stop*)tryMalloc(sizeof(Stop));
+    Stop* new_stop = (Stop*)tagMalloc(sizeof(Stop), MEM_STOP);
     Node* new_node;
 
     if (getStop(sys, name) != NULL) {
 
-        printf(STOP_ALREADY_EXISTS, name);
-        free(new_stop);
+        fprintf(sys->out, STOP_ALREADY_EXISTS, name);
+        tagFree(new_stop, sizeof(Stop), MEM_STOP);
         return;
     }
 
-    new_stop = populateStop(new_stop, name, latitude, longitude);
+    new_stop = populateStop(new_stop, name, latitude, longitude, 
+                                                                sys->names);
+    new_stop->order = sys->stops_created++;
 
     /* Saves stop in the stop list and saves the node in the hashtable. */
     new_node = listInsertEnd(sys->stops_list, new_stop);
-    sys->stops_table = hashtableInsert(sys->stops_table, new_node, 
-                                    getStopName(new_node), getStopName);
+    hashtableInsert(sys->stops_table, new_node, getStopName(new_node),
+                                                                getStopName);
+    spatialInsert(sys->spatial, new_stop);
+    rangeInsert(sys->ranges, new_stop);
+    columnsInsert(sys->columns, new_stop);
 }
 
 /**
- * Populates the given stop with the given data. Returns the newly 
- * populated stop.
+ * Populates the given stop with the given data, its name inline if short 
+ * or else interned in the given arena. Returns the newly populated stop.
 */
-Stop* populateStop(Stop* new_stop, char* name, double lat, double lon) {
+Stop* populateStop(Stop* new_stop, char* name, double lat, double lon,
+                                                        NameArena* names) {
 
-    new_stop->name = (char*)tryMalloc(sizeof(char) * (strlen(name) + 1));
-    strcpy(new_stop->name, name);
+    populateName(&new_stop->name, name, names);
 
     new_stop->lines = createList();
+    new_stop->index = ERR;
+    new_stop->order = 0;
+    new_stop->duplicates = NO;
+    new_stop->view = NULL;
     new_stop->latitude = lat;
     new_stop->longitude = lon;
 
@@ -118,10 +146,27 @@ Stop* populateStop(Stop* new_stop, char* name, double lat, double lon) {
 }
 
 /**
- * Presents the lines that intersect a given stop in alphabetic order.
- * Auxiliary function to the 'i' command.
+ * Presents the given stop in the 'out' stream as listed by the 'i' command,
+ * if it's an intersection of 2 or more lines: its name, number of lines and
+ * the lines in alphabetic order.
+*/
+void printIntersection(FILE* out, Stop* stop) {
+
+    if (stop->duplicates)
+        cleanStopLines(stop);
+
+    if (stop->lines->count > 1) {
+
+        fprintf(out, "%s %d: ", nameChars(&stop->name), stop->lines->count);
+        showStopLines(out, stop);
+    }
+}
+
+/**
+ * Presents the lines that intersect a given stop in alphabetic order, in the
+ * 'out' stream. Auxiliary function to the 'i' command.
 */
-void showStopLines(Stop* stop) {
+void showStopLines(FILE* out, Stop* stop) {
 
     Node* ptr;
     Line* line;
@@ -129,15 +174,15 @@ void showStopLines(Stop* stop) {
 
     sortList(list, compareLines);
     line = (Line*)list->first->data;
-    printf("%s", line->name);
+    fprintf(out, "%s", nameChars(&line->name));
 
     for (ptr = list->first->next; ptr != NULL; ptr = ptr->next) {
 
         line = (Line*)ptr->data;
-        printf(" %s", line->name);
+        fprintf(out, " %s", nameChars(&line->name));
     }
 
-    putchar('\n');
+    putc('\n', out);
 }
 
 /**
@@ -151,7 +196,7 @@ int compareLines(void* first, void* second) {
 	Line* first_line = first;
 	Line* second_line = second;
 
-	return strcmp(first_line->name, second_line->name);
+	return strcmp(nameChars(&first_line->name), nameChars(&second_line->name));
 }
 
 
@@ -168,18 +213,25 @@ void removeStop(System *sys, char* name) {
     Stop* to_remove;
 
     if (element == NULL) {
-        printf(NO_SUCH_STOP, name);
+        fprintf(sys->out, NO_SUCH_STOP, name);
         return;
     }
 
     stop_node = (Node*)element->data;
     to_remove = (Stop*)stop_node->data;
+    LATENCY_SIZE(sys, to_remove->lines->count);
     
     rearrangeAll(sys, to_remove);
 
     hashtableRemove(sys->stops_table, name, getStopName);
-    listRemoveNode(sys->stops_list, stop_node);
-    deleteStop(to_remove);
+    listUnlinkNode(sys->stops_list, stop_node);
+    spatialRemove(sys->spatial, to_remove);
+    rangeRemove(sys->ranges, to_remove);
+    columnsRemove(sys->columns, to_remove);
+
+    /* Readers of the hashtable may still hold them. */
+    retireMemory(sys->epochs, stop_node, freeNode);
+    retireMemory(sys->epochs, to_remove, deleteStop);
 }
 
 /**
@@ -191,6 +243,14 @@ void rearrangeAll(System *sys, Stop* stop) {
     Line* to_rearrange;
     Node* ptr;
 
+    TRACE_BEGIN("rearrangeAll", stop->lines->count);
+
+    if (sys->batch) {
+        rearrangeStopLines(sys, stop);
+        TRACE_END("rearrangeAll", stop->lines->count);
+        return;
+    }
+
     if (stop->lines->count != 0) {
 
         for (ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
@@ -198,18 +258,30 @@ void rearrangeAll(System *sys, Stop* stop) {
             to_rearrange = (Line*)ptr->data;
 
             if (to_rearrange->num_stops != 0)
-                rearrangeLine(to_rearrange, stop);
+                rearrangeLine(to_rearrange, stop, YES);
         }
     }
+
+    TRACE_END("rearrangeAll", stop->lines->count);
 }
 
 /**
  * Rearranges the links connections of the given line to skip the given stop
- * in their itinerary. Removes the association between the line and the stop.
+ * in their itinerary. Removes the association between the line and the stop,
+ * and with every other stop of the route, if no link is left. The line's
+ * values are only updated if 'update' is YES. Returns YES if they had to be
+ * updated, or NO otherwise.
 */
-void rearrangeLine(Line* line, Stop* stop) {
+int rearrangeLine(Line* line, Stop* stop, int update) {
+
+    Link *first = (Link*)line->links_list->first->data,
+         *last = (Link*)line->links_list->last->data;
+    Stop** route = NULL;
+    int outdated = NO, count = 0, i;
 
-    Link *first = (Link*)line->links_list->first->data, *last;
+    /* Only a line losing its ends may be left without links. */
+    if ((Stop*)first->orig == stop || (Stop*)last->dest == stop)
+        route = routeStops(line, &count);
     
     /* Delete links from the beginning of the route. */
     if ((Stop*)first->orig == stop) 
@@ -228,10 +300,42 @@ void rearrangeLine(Line* line, Stop* stop) {
     if (line->links_list->count >= 2) {
 
         deleteStopFromMiddle(line, stop); 
-        updateLineValues(line);
+        outdated = YES;
+
+        if (update)
+            updateLineValues(line);
     }
+
+    /* Without links, the line no longer goes through any stop of its route. */
+    if (line->links_list->count == 0)
+        for (i = 0; i < count; i++)
+            if (route[i] != stop)
+                removeLineFromStop(line, route[i]);
         
     removeLineFromStop(line, stop);
+    free(route);
+
+    return outdated;
+}
+
+/**
+ * Returns a new array with the stops of the route of the given line, from
+ * its first stop to its last, and saves their number in 'count'. Stops the
+ * route goes through more than once are repeated.
+*/
+Stop** routeStops(Line* line, int* count) {
+
+    Stop** route = (Stop**)tryMalloc((line->links_list->count + 1) * 
+                                                            sizeof(Stop*));
+    Node* ptr = line->links_list->first;
+
+    *count = 0;
+    route[(*count)++] = (Stop*)((Link*)ptr->data)->orig;
+
+    for (; ptr != NULL; ptr = ptr->next)
+        route[(*count)++] = (Stop*)((Link*)ptr->data)->dest;
+
+    return route;
 }
 
 /**
@@ -346,6 +450,11 @@ void updateLineValues(Line* line) {
         total_duration += link->value.duration;
     }
 
+    /* Summed again, the values may differ slightly. */
+    if (total_cost != line->total_value.cost ||
+                                total_duration != line->total_value.duration)
+        dropView(&line->view);
+
     line->total_value.cost = total_cost;
     line->total_value.duration = total_duration;
 }
@@ -356,7 +465,8 @@ void updateLineValues(Line* line) {
 void deleteStop(void* stop) {
 
     Stop* to_delete = (Stop*)stop;
+    releaseView(to_delete->view);
     listDestroy(to_delete->lines);
-    free(to_delete->name);
-    free(to_delete);
+    releaseName(&to_delete->name);
+    tagFree(to_delete, sizeof(Stop), MEM_STOP);
 }
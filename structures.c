@@ -4,11 +4,26 @@
  * Author: Bibiana Andre ist194158
  * 
  * Description: file containing the implementation of double linked lists,
- * merge sort and hashtables.
+ * merge sort, binary heaps and hashtables. The hashtables use open
+ * addressing with double hashing over a prime number of slots or, built
+ * with -DSWISS_TABLE, are Swiss tables: a power of 2 of slots in groups of
+ * 16, each slot with a control byte (empty, deleted or 7 bits of the hash
+ * of its key), so that a group is probed by comparing its 16 bytes at once.
+ * Either can be frozen, with a perfect hash of its keys for the lookups.
+ * Their keys are compact names, kept inline when short or else interned in
+ * an arena, with their length and hashes, so that a key is compared with
+ * another by them before their characters are.
 */
 
 #include "main.h"
 
+/* The control bytes of a group compared at once (SSE2), but for
+   ThreadSanitizer, which only sees them loaded one by one. */
+#if defined(SWISS_TABLE) && defined(__SSE2__) && !defined(__SANITIZE_THREAD__)
+#define HT_SSE2
+#include <emmintrin.h>
+#endif
+
 
 /* ------------------------- Double linked lists ------------------------- */
 
@@ -31,7 +46,7 @@ List* createList() {
 */
 Node* addNode(Node* prev, Node* next, void* data) {
 
-	Node* new_node = (Node*)tryMalloc(sizeof(Node));
+	Node* new_node = (Node*)tagMalloc(sizeof(Node), MEM_NODE);
 	new_node->data = data;
 	new_node->prev = prev;
 	new_node->next = next;
@@ -164,21 +179,28 @@ void listRemoveData(List* list, void* data) {
 void listRemoveNode(List* list, Node* node) {
 
 	if (node != NULL) {
-		
-		if (node->prev != NULL) 
-			node->prev->next = node->next;
-		else 
-			list->first = node->next;
+		listUnlinkNode(list, node);
+		freeNode(node);
+	}
+}
+
+/**
+ * Removes the given node from the given double linked list, like 
+ * listRemoveNode, without freeing it.
+ */
+void listUnlinkNode(List* list, Node* node) {
 
-		if (node->next != NULL) 
-			node->next->prev = node->prev;
-		else 
-			list->last = node->prev;
+	if (node->prev != NULL) 
+		node->prev->next = node->next;
+	else 
+		list->first = node->next;
 
-		free(node);
+	if (node->next != NULL) 
+		node->next->prev = node->prev;
+	else 
+		list->last = node->prev;
 
-		list->count--;
-	}
+	list->count--;
 }
 
 /**
@@ -207,11 +229,13 @@ void sortList(List* list, int(*cmp)(void*, void*)) {
 	else if (list->sorted != SORTED) 
 		list->sorted = SORTED;
 
+	TRACE_BEGIN("sortList", list->count);
 	list->first = mergesortList(list->first, cmp);
 
 	for (ptr = list->last; ptr->next != NULL; ptr = ptr->next) { }
 
 	list->last = ptr;
+	TRACE_END("sortList", list->count);
 }
 
 /**
@@ -285,6 +309,96 @@ Node* splitList(Node* head) {
 }
 
 
+/* ----------------------------- Binary heap ----------------------------- */
+
+/**
+ * Creates a new empty binary heap with room for the given number of 
+ * elements and returns its respective pointer.
+ */
+Heap* createHeap(int size) {
+
+	Heap* new_heap = (Heap*)tryMalloc(sizeof(Heap));
+
+	new_heap->data = (void**)tryMalloc(size * sizeof(void*));
+	new_heap->size = size;
+	new_heap->count = 0;
+
+	return new_heap;
+}
+
+/**
+ * Inserts the given data in the heap, doubling its size if it's full. The
+ * data is sifted up until its parent is smaller given the compare function.
+ */
+void heapPush(Heap* heap, void* data, int(*cmp)(void*, void*)) {
+
+	int i = heap->count++, parent;
+
+	if (heap->count > heap->size) {
+		heap->size *= 2;
+		heap->data = (void**)tryRealloc(heap->data, 
+										heap->size * sizeof(void*));
+	}
+
+	/* Move the parents down until the data's position is found. */
+	for (; i > 0; i = parent) {
+
+		parent = (i - 1) / 2;
+
+		if (cmp(heap->data[parent], data) <= 0)
+			break;
+
+		heap->data[i] = heap->data[parent];
+	}
+
+	heap->data[i] = data;
+}
+
+/**
+ * Removes the smallest data from the heap given the compare function, 
+ * returning it. If the heap is empty, returns NULL.
+ */
+void* heapPop(Heap* heap, int(*cmp)(void*, void*)) {
+
+	void *top, *last;
+	int i = 0, child;
+
+	if (heap->count == 0)
+		return NULL;
+
+	top = heap->data[0];
+	last = heap->data[--heap->count];
+
+	/* Move the smaller children up until the last data's position is found. */
+	while ((child = 2 * i + 1) < heap->count) {
+
+		if (child + 1 < heap->count && 
+			cmp(heap->data[child + 1], heap->data[child]) < 0)
+			child++;
+
+		if (cmp(last, heap->data[child]) <= 0)
+			break;
+
+		heap->data[i] = heap->data[child];
+		i = child;
+	}
+
+	heap->data[i] = last;
+
+	return top;
+}
+
+/**
+ * Frees the allocated memory of a given heap. The data must be 
+ * previously freed.
+ */
+void destroyHeap(Heap* heap) {
+
+	free(heap->data);
+	free(heap);
+}
+
+
 /* ------------------------------ Hashtable ------------------------------ */
 
 /**
@@ -293,19 +407,44 @@ Node* splitList(Node* head) {
  */
 Hashtable* createHashtable(int size) {
 
+	Hashtable* new_table = (Hashtable*)tagMalloc(sizeof(Hashtable), MEM_TABLE);
+
+	new_table->slots = createHashSlots(size);
+	new_table->elem_num = 0;
+	new_table->epochs = NULL;
+	new_table->frozen = NULL;
+	new_table->stats = (HashStats*)tagMalloc(sizeof(HashStats), MEM_TABLE);
+	memset(new_table->stats, 0, sizeof(HashStats));
+
+	return new_table;
+}
+
+/**
+ * Creates the given number of empty hashtable slots, returning a pointer 
+ * to them. The slots of Swiss tables are rounded up to a power of 2.
+ */
+HashSlots* createHashSlots(int size) {
+
 	int i;
 
-	Hashtable* new_table = (Hashtable*)tryMalloc(sizeof(Hashtable));
+	HashSlots* new_slots = (HashSlots*)tagMalloc(sizeof(HashSlots), MEM_TABLE);
 
-	new_table->table = (HashElem**)tryMalloc(size * sizeof(HashElem*));
-	new_table->size = size;
-	new_table->elem_num = 0;
+#ifdef SWISS_TABLE
+	size = swissSize(size);
+	new_slots->ctrl = (unsigned char*)tagMalloc(size, MEM_TABLE);
+	memset(new_slots->ctrl, HT_CTRL_EMPTY, size);
+#else
+	new_slots->ctrl = NULL;
+#endif
 
-	for(i = 0; i < size; i++) 
-		new_table->table[i] = NULL;
+	new_slots->elems = (HashElem**)tagMalloc(size * sizeof(HashElem*),
+															MEM_TABLE);
+	new_slots->size = size;
 
-	return new_table;
+	for(i = 0; i < size; i++) 
+		new_slots->elems[i] = NULL;
 
+	return new_slots;
 }
 
 /**
@@ -315,7 +454,7 @@ Hashtable* createHashtable(int size) {
  */
 HashElem* createHashtableElement(void* data) {
 
-	HashElem* elem = (HashElem*)tryMalloc(sizeof(HashElem));
+	HashElem* elem = (HashElem*)tagMalloc(sizeof(HashElem), MEM_HASH_ELEM);
 
 	elem->data = data;
 	elem->state = HT_TAKEN;
@@ -324,95 +463,201 @@ HashElem* createHashtableElement(void* data) {
 
 /**
  * Calculates the position to store the data with the given key. If the        
- * hashtable reaches its threshold, then it'll be expandeded. Since it 
- * can expand, it always returns a pointer to the table.
+ * hashtable reaches its threshold, then it'll be expanded. The element is
+ * published once whole, for the readers taking no locks.
  */
-Hashtable* hashtableInsert(Hashtable* hash, void* data, char* key, 
-                                            char*(*get_key)(void*)) {
-	
+void hashtableInsert(Hashtable* hash, void* data, Name* key, 
+                                            Name*(*get_key)(void*)) {
+
+	hash->stats->insert_probes += placeHashElem(hash, hash->slots,
+										createHashtableElement(data), key);
+	hash->stats->inserts++;
+
+	/* Published after the element, for the lookups the index misses. */
+	if (hash->frozen != NULL)
+		__atomic_add_fetch(&hash->frozen->inserted, 1, __ATOMIC_RELEASE);
+
+#ifdef SWISS_TABLE
+	/* The tombstones lengthen the probes as the elements do. */
+	if (++hash->elem_num + hash->stats->tombstones >= 
+											hash->slots->size * HT_MAX_LOAD)
+		expandHashtable(hash, get_key);
+#else
+	/* Expand the hashtable if necessary */
+	if (++hash->elem_num >= hash->slots->size * HT_MAX_LOAD) 
+		expandHashtable(hash, get_key);
+#endif
+}
+
+#ifndef SWISS_TABLE
+
+/**
+ * Stores the given element with the given key in the first free or deleted
+ * slot of its probe sequence, from the hashes of the key. A deleted element
+ * replaced is retired. Returns the number of slots probed.
+ */
+int placeHashElem(Hashtable* hash, HashSlots* slots, HashElem* elem, 
+                                                                Name* key) {
+
 	int i = 1;
-	unsigned int* hashes = calcHashtableHashes(key, hash->size);
-	unsigned int h = hashes[0] % hash->size, phi = hashes[2];
+	unsigned int hashes[3], h;
+
+	hashes[0] = key->hashes[0];
+	hashes[2] = key->hashes[1] % slots->size;
+	hashes[2] = hashes[2] == 0 ? 1 : hashes[2]; /* Phi, as calculated */
+	h = hashes[0] % slots->size;
 
 	/* Find the spot to insert the new data */
-	while (hash->table[h] != NULL) {
+	while (slots->elems[h] != NULL) {
 
-		if (hash->table[h]->state == HT_DELETED) {
-			free(hash->table[h]);
+		if (slots->elems[h]->state == HT_DELETED) {
+			retireMemory(hash->epochs, slots->elems[h], freeHashElem);
+			hash->stats->tombstones--;
 			break;
 		}
 
-		h = (hashes[0] + i * phi) % hash->size;
+		h = (hashes[0] + i * hashes[2]) % slots->size;
 		i++;
 	}
 
-	hash->table[h] = createHashtableElement(data);
-	free(hashes);
+	__atomic_store_n(&slots->elems[h], elem, __ATOMIC_RELEASE);
 
-	/* Expand the hashtable if necessary */
-	if (++hash->elem_num >= hash->size * HT_MAX_LOAD) 
-		hash = expandHashtable(hash, get_key);
-
-	return hash;
+	return i;
 }
 
+#endif
+
 /**
- * Expands the hashtable, creating a new hashtable with close to double 
- * the size and reinserting all of the info in the new table. Returns a 
- * pointer to the new expanded table.
+ * Expands the hashtable, moving its elements to new slots with close to 
+ * double the size, which replace the old ones at once (their keys aren't 
+ * hashed again). The old slots and their deleted elements are retired. A 
+ * Swiss table mostly of tombstones gets new slots of the same size 
+ * instead, without them.
  */
-Hashtable* expandHashtable(Hashtable* hash, char*(*get_key)(void*)) {
+void expandHashtable(Hashtable* hash, Name*(*get_key)(void*)) {
 
 	int i;
-	Hashtable* new_hash = createHashtable(getPrime(hash->size * 2));
+	long int start = latencyClock();
+	HashSlots *old = hash->slots, *new_slots;
+	HashElem* elem;
 
-	for (i = 0; i < hash->size; i++) {
+#ifdef SWISS_TABLE
+	new_slots = createHashSlots(hash->elem_num < old->size * HT_MAX_LOAD / 2 ?
+												old->size : old->size * 2);
+#else
+	new_slots = createHashSlots(getPrime(old->size * 2));
+#endif
 
-    if (hash->table[i] != NULL && hash->table[i]->state != HT_DELETED) {
+	TRACE_BEGIN("expandHashtable", old->size);
 
-			hashtableInsert(new_hash, hash->table[i]->data, 
-                            get_key(hash->table[i]->data), get_key);
-		}
+	for (i = 0; i < old->size; i++) {
+
+		if ((elem = old->elems[i]) == NULL)
+			continue;
+
+		if (elem->state != HT_DELETED)
+			placeHashElem(hash, new_slots, elem, get_key(elem->data));
+		else
+			retireMemory(hash->epochs, elem, freeHashElem);
 	}
 
-	destroyHashtable(hash);
-	return new_hash;
+	__atomic_store_n(&hash->slots, new_slots, __ATOMIC_RELEASE);
+	retireMemory(hash->epochs, old, destroyHashSlots);
+
+	hash->stats->tombstones = 0;
+	hash->stats->resizes++;
+	hash->stats->resize_ms += (latencyClock() - start) / 1000000.0;
+	TRACE_END("expandHashtable", new_slots->size);
+}
+
+/**
+ * Replaces the slots of the given hashtable, whose elements were all 
+ * removed, with the given number of empty slots.
+ */
+void resetHashtable(Hashtable* hash, int size) {
+
+	HashSlots* old = hash->slots;
+	int i;
+
+	dropFrozen(hash);
+
+	for (i = 0; i < old->size; i++)
+		if (old->elems[i] != NULL)
+			retireMemory(hash->epochs, old->elems[i], freeHashElem);
+
+	__atomic_store_n(&hash->slots, createHashSlots(size), __ATOMIC_RELEASE);
+	retireMemory(hash->epochs, old, destroyHashSlots);
+	hash->elem_num = 0;
+	hash->stats->tombstones = 0;
+	hash->stats->resizes++;
 }
 
+#ifndef SWISS_TABLE
+
 /**
  * Receives a key to spot the position of the data in the hashtable.
  * If the data is found, returns a pointer to the hash element storing 
- * the data. Else, returns NULL.
+ * the data. Else, returns NULL. Takes no locks: while a writer changes 
+ * the hashtable, it reads the slots and elements as they were, or as they 
+ * are, which are only freed after the grace period of the readers.
  */
-HashElem* hashtableGet(Hashtable* hash, char* key, char*(*get_key)(void*)) {
+HashElem* hashtableGet(Hashtable* hash, char* key, Name*(*get_key)(void*)) {
 
 	int i = 1;
-	unsigned int* hashes = calcHashtableHashes(key, hash->size);
-	unsigned int h = hashes[0] % hash->size, hash_1 = hashes[0];
-	unsigned int phi = hashes[2];
+	HashSlots* slots = __atomic_load_n(&hash->slots, __ATOMIC_ACQUIRE);
+	unsigned int hashes[3], h;
+	int length = calcHashtableHashes(key, slots->size, hashes);
+	HashElem* elem;
 
-	free(hashes);
+	if (frozenGet(hash, key, length, hashes, get_key, &elem))
+		return elem;
+
+	h = hashes[0] % slots->size;
 
 	/* Spot the position of the data in the hashtable */
-	while (hash->table[h] != NULL) {
+	while ((elem = __atomic_load_n(&slots->elems[h], __ATOMIC_ACQUIRE)) 
+																!= NULL) {
 
-		if (hash->table[h]->state != HT_DELETED && 
-            strcmp(get_key(hash->table[h]->data), key) == 0) {
+		if (__atomic_load_n(&elem->state, __ATOMIC_ACQUIRE) != HT_DELETED && 
+				nameEquals(get_key(elem->data), key, length, hashes[0])) {
 
-			return hash->table[h];
+			countLookup(hash, YES, i);
+			return elem;
 		}
 
-		h = (hash_1 + i * phi) % hash->size;
+		h = (hashes[0] + i * hashes[2]) % slots->size;
 		i++;
 	}
 
+	countLookup(hash, NO, i);
 	return NULL;
 }
 
+#endif
+
+/**
+ * Counts a lookup of the given hashtable that probed the given number of
+ * slots, and found its key or not. Readers may count at once.
+ */
+void countLookup(Hashtable* hash, int found, int probes) {
+
+	HashStats* stats = hash->stats;
+
+	if (probes > HT_PROBE_LENGTHS)
+		probes = HT_PROBE_LENGTHS;
+
+	__atomic_add_fetch(found ? &stats->hits : &stats->misses, 1,
+															__ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->probes[probes - 1], 1, __ATOMIC_RELAXED);
+}
+
+#ifndef SWISS_TABLE
+
 /**
  * Receives an element to delete from the hashtable and mark it as deleted.
+ * Its data must only be freed after the grace period of the readers.
  */
-void hashtableRemove(Hashtable* hash, char* key, char*(*get_key)(void*)) {
+void hashtableRemove(Hashtable* hash, char* key, Name*(*get_key)(void*)) {
 
 	HashElem* elem = hashtableGet(hash, key, get_key);
 
@@ -420,10 +665,15 @@ void hashtableRemove(Hashtable* hash, char* key, char*(*get_key)(void*)) {
 		return;
 	}
 
-	elem->state = HT_DELETED;
+	unfreezeElem(hash, elem, get_key(elem->data));
+	__atomic_store_n(&elem->state, HT_DELETED, __ATOMIC_RELEASE);
 	--hash->elem_num;
+	hash->stats->tombstones++;
+	hash->stats->removals++;
 }
 
+#endif
+
 /**
  * Clears all of the memory occupied by the hashtable and its elements.
  */
@@ -431,14 +681,62 @@ void destroyHashtable(Hashtable* hash) {
 
 	int i;
 
-	for (i = 0; i < hash->size; i++) {
+	for (i = 0; i < hash->slots->size; i++) {
 
-		if (hash->table[i] != NULL) 
-			free(hash->table[i]);
+		if (hash->slots->elems[i] != NULL) 
+			freeHashElem(hash->slots->elems[i]);
 	}
 
-	free(hash->table);
-	free(hash);
+	if (hash->frozen != NULL)
+		destroyFrozen(hash->frozen);
+
+	destroyHashSlots(hash->slots);
+	tagFree(hash->stats, sizeof(HashStats), MEM_TABLE);
+	tagFree(hash, sizeof(Hashtable), MEM_TABLE);
+}
+
+/**
+ * Frees the given hashtable slots, but not their elements.
+ */
+void destroyHashSlots(void* slots) {
+
+	HashSlots* old = (HashSlots*)slots;
+
+	if (old->ctrl != NULL)
+		tagFree(old->ctrl, old->size, MEM_TABLE);
+
+	tagFree(old->elems, old->size * sizeof(HashElem*), MEM_TABLE);
+	tagFree(old, sizeof(HashSlots), MEM_TABLE);
+}
+
+/**
+ * Presents the statistics of the given hashtable, with the given name, in
+ * the 'out' stream: its load (elements per slot) and occupancy (counting
+ * the deleted elements), lookups, insertions, removals and resizes, a
+ * line for each probe length of the lookups and its frozen index, if any.
+ */
+void printHashtableStats(FILE* out, Hashtable* hash, char* name) {
+
+	HashStats* stats = hash->stats;
+	int size = hash->slots->size, i;
+	long int count;
+
+	fprintf(out, HASHTABLE_STATS, name, hash->elem_num, size,
+			(double)hash->elem_num / size,
+			(double)(hash->elem_num + stats->tombstones) / size,
+			stats->tombstones,
+			__atomic_load_n(&stats->hits, __ATOMIC_RELAXED),
+			__atomic_load_n(&stats->misses, __ATOMIC_RELAXED),
+			stats->inserts, stats->inserts == 0 ? 0.0 :
+			(double)stats->insert_probes / stats->inserts, stats->removals,
+			stats->resizes, stats->resize_ms);
+
+	for (i = 0; i < HT_PROBE_LENGTHS; i++)
+		if ((count = __atomic_load_n(&stats->probes[i], __ATOMIC_RELAXED)))
+			fprintf(out, HASHTABLE_PROBES, name, i + 1,
+							i + 1 == HT_PROBE_LENGTHS ? "+" : "", count);
+
+	printFrozenStats(out, hash, name);
 }
 
 /**
@@ -454,52 +752,131 @@ int isElemDead(HashElem* elem) {
 }
 
 /**
- * Calculates the hash given a key string (based on DJB algorithm) 
- * and returns the hash.
+ * Returns the key of the hashes of the process, drawn the first time from 
+ * the system's random source, so that the slots of the names can't be 
+ * foreseen. It's taken from the HT_SEED_ENV variable instead, if set, to 
+ * repeat a run. Threads may ask for it at once.
+ */
+unsigned int* hashSeed() {
+
+	static unsigned int seed[2];
+	static int state = HT_SEED_NONE;
+	int none = HT_SEED_NONE;
+
+	if (__atomic_load_n(&state, __ATOMIC_ACQUIRE) == HT_SEED_DRAWN)
+		return seed;
+
+	if (__atomic_compare_exchange_n(&state, &none, HT_SEED_DRAWING, NO,
+										__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		drawHashSeed(seed);
+		__atomic_store_n(&state, HT_SEED_DRAWN, __ATOMIC_RELEASE);
+	}
+
+	while (__atomic_load_n(&state, __ATOMIC_ACQUIRE) != HT_SEED_DRAWN) { }
+
+	return seed;
+}
+
+/**
+ * Draws a new key of the hashes in the given seed: from the HT_SEED_ENV 
+ * variable, the system's random source or, if it can't be read, from the 
+ * clock and the addresses of the process.
  */
-unsigned int calculateHash(char* key) {
+void drawHashSeed(unsigned int* seed) {
 
-	unsigned int hash = 5381;
-	int c;
+	char* fixed = getenv(HT_SEED_ENV);
+	FILE* source;
 
-	while((c = *(key++)) != 0)
-		hash = ((hash << 5) + hash) + c;
+	if (fixed != NULL) {
+		seed[0] = (unsigned int)strtoul(fixed, NULL, 10);
+		seed[1] = ~seed[0];
+		return;
+	}
+
+	source = fopen(HT_SEED_SOURCE, "rb");
+
+	if (source == NULL || fread(seed, sizeof(unsigned int), 2, source) != 2) {
+		seed[0] = (unsigned int)time(NULL) ^ (unsigned int)clock();
+		seed[1] = (unsigned int)(unsigned long)&source ^ 
+									(unsigned int)(unsigned long)seed;
+	}
 
-	return hash;
+	if (source != NULL)
+		fclose(source);
 }
 
 /**
- * Calculate the hash step for a given key string and returns the 
- * hash step. (Based on Jenkins hash function).
+ * Runs a round of HalfSipHash on its state of 4 words.
  */
-unsigned int calcHashStep(char* key) {
+void sipRound(unsigned int* v) {
+
+	v[0] += v[1]; v[1] = HT_ROTATE(v[1], 5); v[1] ^= v[0];
+	v[0] = HT_ROTATE(v[0], 16);
+	v[2] += v[3]; v[3] = HT_ROTATE(v[3], 8); v[3] ^= v[2];
+	v[0] += v[3]; v[3] = HT_ROTATE(v[3], 7); v[3] ^= v[0];
+	v[2] += v[1]; v[1] = HT_ROTATE(v[1], 13); v[1] ^= v[2];
+	v[2] = HT_ROTATE(v[2], 16);
+}
 
-	unsigned int hash = 0;
-	int i = 0;
+/**
+ * Calculates the two hashes of the given key string with the key of the 
+ * process, in the given array: the 64 bits of HalfSipHash-1-3 (a keyed 
+ * hash, made for hashtables, whose collisions can't be found without the 
+ * key), in a single pass. Returns the length of the string.
+ */
+int keyedHash(char* key, unsigned int* hashes) {
 
-	while (key[i] != '\0') {
-		hash += key[i++];
-		hash += hash << 10;
-		hash ^= hash >> 6;
+	unsigned int* seed = hashSeed();
+	unsigned int v[4], word = 0, length = 0, shift = 0;
+
+	v[0] = seed[0];
+	v[1] = seed[1] ^ 0xee;
+	v[2] = seed[0] ^ 0x6c796765;
+	v[3] = seed[1] ^ 0x74656462;
+
+	/* Each 4 bytes, little endian, in a round */
+	for (; *key != '\0'; key++, length++) {
+
+		word |= (unsigned int)(unsigned char)*key << shift;
+
+		if ((shift += 8) == 32) {
+			v[3] ^= word;
+			sipRound(v);
+			v[0] ^= word;
+			word = shift = 0;
+		}
 	}
 
-	hash += hash << 3;
-	hash ^= hash >> 11;
-	hash += hash << 15;
-	return hash;
+	/* The last bytes and the length */
+	word |= length << 24;
+	v[3] ^= word;
+	sipRound(v);
+	v[0] ^= word;
+
+	v[2] ^= 0xee;
+	sipRound(v);
+	sipRound(v);
+	sipRound(v);
+	hashes[0] = v[1] ^ v[3];
+
+	v[1] ^= 0xdd;
+	sipRound(v);
+	sipRound(v);
+	sipRound(v);
+	hashes[1] = v[1] ^ v[3];
+
+	return length;
 }
 
 /**
  * Calculates the two hashes for double hashing implementation, given 
- * the key string and the hashtable size. Calculates the phi value, 
- * used to scale the hashtable's main hash. Returns the double hash.
+ * the key string and the hashtable size, in the given array. Calculates 
+ * the phi value, used to scale the hashtable's main hash. Returns the 
+ * length of the key string.
  */
-unsigned int* calcHashtableHashes(char* key, int size) {
-
-	unsigned int* hashes = (unsigned int*)tryMalloc(sizeof(unsigned int)*3);
+int calcHashtableHashes(char* key, int size, unsigned int* hashes) {
 
-	hashes[0] = calculateHash(key); /* First hash */
-	hashes[1] = calcHashStep(key); /* Second hash */
+	int length = keyedHash(key, hashes); /* First hash and second hash */
 	hashes[2] = hashes[1] % size; /* Phi */
 
 	/* If phi is zero, reset to 1 */
@@ -507,7 +884,7 @@ unsigned int* calcHashtableHashes(char* key, int size) {
 		hashes[2] = 1;
 	}
 
-	return hashes;
+	return length;
 }
 
 /**
@@ -537,4 +914,821 @@ int getPrime(int num) {
 		prime++;
 
 	return prime;
+}
+
+/* ----------------------------- Swiss tables ---------------------------- */
+
+#ifdef SWISS_TABLE
+
+/**
+ * Returns the number of slots of a Swiss table of at least the given size: 
+ * a power of 2, of whole groups.
+ */
+int swissSize(int size) {
+
+	int slots = HT_GROUP_WIDTH;
+
+	while (slots < size)
+		slots *= 2;
+
+	return slots;
+}
+
+/**
+ * Returns a mask of the slots of the given group whose control byte is the 
+ * given one, a bit for each (the first slot in the lowest bit). Readers 
+ * may match while the writer changes the group.
+ */
+unsigned int matchGroup(unsigned char* group, int ctrl) {
+
+#ifdef HT_SSE2
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)group),
+											_mm_set1_epi8((char)ctrl)));
+#else
+	unsigned int mask = 0;
+	int i;
+
+	for (i = 0; i < HT_GROUP_WIDTH; i++)
+		if (__atomic_load_n(&group[i], __ATOMIC_RELAXED) == ctrl)
+			mask |= 1u << i;
+
+	return mask;
+#endif
+}
+
+/**
+ * Returns a mask of the free slots (empty or deleted) of the given group: 
+ * those whose control byte has the highest bit set.
+ */
+unsigned int matchFree(unsigned char* group) {
+
+#ifdef HT_SSE2
+	return _mm_movemask_epi8(_mm_loadu_si128((__m128i*)group));
+#else
+	unsigned int mask = 0;
+	int i;
+
+	for (i = 0; i < HT_GROUP_WIDTH; i++)
+		if (__atomic_load_n(&group[i], __ATOMIC_RELAXED) & HT_CTRL_EMPTY)
+			mask |= 1u << i;
+
+	return mask;
+#endif
+}
+
+/**
+ * Stores the given element with the given key in the first free slot of 
+ * its probe sequence: the groups from the one of its hash, at triangular 
+ * steps (1, 2, 3...), which visit every group of a power of 2. The element 
+ * is published before its control byte. Returns the number of groups 
+ * probed.
+ */
+int placeHashElem(Hashtable* hash, HashSlots* slots, HashElem* elem, 
+                                                                Name* key) {
+
+	unsigned int* hashes = key->hashes, groups = slots->size / HT_GROUP_WIDTH;
+	unsigned int g = hashes[0] & (groups - 1), free;
+	int probes = 1, slot;
+
+
+	while ((free = matchFree(&slots->ctrl[g * HT_GROUP_WIDTH])) == 0)
+		g = (g + probes++) & (groups - 1);
+
+	slot = g * HT_GROUP_WIDTH + __builtin_ctz(free);
+
+	if (slots->ctrl[slot] == HT_CTRL_DELETED)
+		hash->stats->tombstones--;
+
+	__atomic_store_n(&slots->elems[slot], elem, __ATOMIC_RELEASE);
+	__atomic_store_n(&slots->ctrl[slot], 
+				(unsigned char)(hashes[1] & HT_CTRL_TAG), __ATOMIC_RELEASE);
+
+	return probes;
+}
+
+/**
+ * Finds the slot of the given key, of the given length and hashes, in the 
+ * given slots, counting the groups probed in 'probes': in each group, only 
+ * the slots with the tag of its hash are compared, and the search stops at 
+ * a group with an empty slot. Returns the slot, or -1 if the key isn't 
+ * there. Takes no locks, as 'hashtableGet'.
+ */
+int findSwissSlot(HashSlots* slots, char* key, int length, 
+            unsigned int* hashes, Name*(*get_key)(void*), int* probes) {
+
+	unsigned int groups = slots->size / HT_GROUP_WIDTH, mask;
+	unsigned int g = hashes[0] & (groups - 1);
+	unsigned char* group;
+	HashElem* elem;
+	int slot;
+
+
+	for (*probes = 1; ; g = (g + (*probes)++) & (groups - 1)) {
+
+		group = &slots->ctrl[g * HT_GROUP_WIDTH];
+
+		for (mask = matchGroup(group, hashes[1] & HT_CTRL_TAG); mask != 0; 
+														mask &= mask - 1) {
+
+			slot = g * HT_GROUP_WIDTH + __builtin_ctz(mask);
+			elem = __atomic_load_n(&slots->elems[slot], __ATOMIC_ACQUIRE);
+
+			if (elem != NULL && __atomic_load_n(&elem->state, 
+					__ATOMIC_ACQUIRE) != HT_DELETED && 
+					nameEquals(get_key(elem->data), key, length, hashes[0]))
+				return slot;
+		}
+
+		if (matchGroup(group, HT_CTRL_EMPTY) != 0)
+			return -1;
+	}
+}
+
+/**
+ * Receives a key to spot the position of the data in the hashtable.
+ * If the data is found, returns a pointer to the hash element storing 
+ * the data. Else, returns NULL. Takes no locks: while a writer changes 
+ * the hashtable, it reads the slots and elements as they were, or as they 
+ * are, which are only freed after the grace period of the readers.
+ */
+HashElem* hashtableGet(Hashtable* hash, char* key, Name*(*get_key)(void*)) {
+
+	HashSlots* slots = __atomic_load_n(&hash->slots, __ATOMIC_ACQUIRE);
+	unsigned int hashes[2];
+	int length = keyedHash(key, hashes), probes, slot;
+	HashElem* elem;
+
+	if (frozenGet(hash, key, length, hashes, get_key, &elem))
+		return elem;
+
+	slot = findSwissSlot(slots, key, length, hashes, get_key, &probes);
+	countLookup(hash, slot >= 0, probes);
+
+	if (slot < 0)
+		return NULL;
+
+	return __atomic_load_n(&slots->elems[slot], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Receives an element to delete from the hashtable, marking it as deleted 
+ * for the readers holding it, and retires it. Its slot becomes empty if 
+ * its group has an empty slot (no probe went past the group, so none 
+ * needs it), or else a tombstone. Its data must only be freed after the 
+ * grace period of the readers.
+ */
+void hashtableRemove(Hashtable* hash, char* key, Name*(*get_key)(void*)) {
+
+	HashSlots* slots = hash->slots;
+	unsigned int hashes[2];
+	int length = keyedHash(key, hashes), probes, slot;
+	HashElem* elem;
+
+	slot = findSwissSlot(slots, key, length, hashes, get_key, &probes);
+	countLookup(hash, slot >= 0, probes);
+
+	if (slot < 0)
+		return;
+
+	elem = slots->elems[slot];
+	unfreezeElem(hash, elem, get_key(elem->data));
+	__atomic_store_n(&elem->state, HT_DELETED, __ATOMIC_RELEASE);
+
+	if (matchGroup(&slots->ctrl[slot - slot % HT_GROUP_WIDTH], 
+												HT_CTRL_EMPTY) != 0) {
+		__atomic_store_n(&slots->ctrl[slot], HT_CTRL_EMPTY, __ATOMIC_RELEASE);
+	} else {
+		__atomic_store_n(&slots->ctrl[slot], HT_CTRL_DELETED, 
+															__ATOMIC_RELEASE);
+		hash->stats->tombstones++;
+	}
+
+	__atomic_store_n(&slots->elems[slot], NULL, __ATOMIC_RELEASE);
+	retireMemory(hash->epochs, elem, freeHashElem);
+	--hash->elem_num;
+	hash->stats->removals++;
+}
+
+#endif
+
+/* ---------------------------- Frozen indexes --------------------------- */
+
+/**
+ * Freezes the keys of the given hashtable in a new frozen index, which 
+ * replaces the one it had at once: a minimal perfect hash (hash and 
+ * displace, as CHD), where each key has a slot of its own, found with a 
+ * single probe and a single compare. The changes since are its delta: the 
+ * keys removed leave the index, and once keys are inserted, the lookups 
+ * it misses fall back to the hashtable, until it's frozen again. Returns 
+ * NO, leaving it unfrozen, if a bucket fits no displacements.
+ */
+int freezeHashtable(Hashtable* hash, Name*(*get_key)(void*)) {
+
+	HashSlots* slots = hash->slots;
+	Frozen* frozen = createFrozen(hash->elem_num);
+	HashElem** elems = (HashElem**)tryMalloc(frozen->size * sizeof(HashElem*));
+	unsigned int* hashes = (unsigned int*)tryMalloc(2 * frozen->size * 
+														sizeof(unsigned int));
+	int count = 0, i, placed;
+	Name* key;
+
+	TRACE_BEGIN("freezeHashtable", hash->elem_num);
+
+	/* The hashes of the keys, as they were calculated. */
+	for (i = 0; i < slots->size; i++) {
+
+		if (isElemDead(slots->elems[i]))
+			continue;
+
+		elems[count] = slots->elems[i];
+		key = get_key(elems[count]->data);
+		hashes[2 * count] = key->hashes[0];
+		hashes[2 * count + 1] = key->hashes[1];
+		count++;
+	}
+
+	placed = placeFrozenKeys(frozen, elems, hashes, count);
+	free(elems);
+	free(hashes);
+
+	if (!placed) {
+		destroyFrozen(frozen);
+		frozen = NULL;
+	}
+
+	dropFrozen(hash);
+	__atomic_store_n(&hash->frozen, frozen, __ATOMIC_RELEASE);
+
+	TRACE_END("freezeHashtable", count);
+	return placed;
+}
+
+/**
+ * Creates an empty frozen index for the given number of keys, returning a 
+ * pointer to it.
+ */
+Frozen* createFrozen(int count) {
+
+	Frozen* frozen = (Frozen*)tagMalloc(sizeof(Frozen), MEM_TABLE);
+	int i;
+
+	frozen->keys = count;
+	frozen->size = count > 0 ? count : 1;
+	frozen->buckets = count / HT_FROZEN_BUCKET + 1;
+	frozen->displacements = (unsigned int*)tagMalloc(2 * frozen->buckets * 
+										sizeof(unsigned int), MEM_TABLE);
+	frozen->slots = (FrozenSlot*)tagMalloc(frozen->size * sizeof(FrozenSlot),
+																MEM_TABLE);
+	frozen->inserted = frozen->removed = 0;
+	frozen->hits = frozen->fallbacks = 0;
+
+	for (i = 0; i < 2 * frozen->buckets; i++)
+		frozen->displacements[i] = 0;
+
+	for (i = 0; i < frozen->size; i++)
+		frozen->slots[i].elem = NULL;
+
+	return frozen;
+}
+
+/**
+ * Places the given elements, of the given hashes (two each), in the slots 
+ * of the given frozen index: their buckets from the largest, while most 
+ * slots are free, to those of a single key, which take the free slots 
+ * left in order. Returns NO if a bucket fits no displacements.
+ */
+int placeFrozenKeys(Frozen* frozen, HashElem** elems, unsigned int* hashes,
+                                                                int count) {
+
+	int* starts = (int*)tryMalloc((frozen->buckets + 1) * sizeof(int));
+	int* keys = (int*)tryMalloc(frozen->size * sizeof(int));
+	int i, bucket, size, max = 0, next_free = 0, placed = YES;
+
+	for (bucket = 0; bucket <= frozen->buckets; bucket++)
+		starts[bucket] = 0;
+
+	/* The keys by bucket (a counting sort), each bucket from its start. */
+	for (i = 0; i < count; i++)
+		starts[hashes[2 * i] % frozen->buckets + 1]++;
+
+	for (bucket = 0; bucket < frozen->buckets; bucket++) {
+		max = starts[bucket + 1] > max ? starts[bucket + 1] : max;
+		starts[bucket + 1] += starts[bucket];
+	}
+
+	for (i = 0; i < count; i++)
+		keys[starts[hashes[2 * i] % frozen->buckets]++] = i;
+
+	/* Each start moved to the next one, moved back. */
+	for (bucket = frozen->buckets; bucket > 0; bucket--)
+		starts[bucket] = starts[bucket - 1];
+
+	starts[0] = 0;
+
+	for (size = max; size > 0 && placed; size--)
+		for (bucket = 0; bucket < frozen->buckets && placed; bucket++)
+			if (starts[bucket + 1] - starts[bucket] == size)
+				placed = placeFrozenBucket(frozen, bucket, elems, hashes, 
+							&keys[starts[bucket]], size, &next_free);
+
+	free(starts);
+	free(keys);
+
+	return placed;
+}
+
+/**
+ * Finds the displacements of the given bucket, of the given keys (of the 
+ * given elements and hashes), that move each key to a free slot of its 
+ * own, and places them there. A single key takes the next free slot from 
+ * 'next_free'. Returns NO if none is found.
+ */
+int placeFrozenBucket(Frozen* frozen, int bucket, HashElem** elems, 
+				unsigned int* hashes, int* keys, int count, int* next_free) {
+
+	unsigned int* displacement = &frozen->displacements[2 * bucket];
+	unsigned int round, shift, slot, size = frozen->size;
+	int i;
+
+	if (count == 1) {
+
+		while (frozen->slots[*next_free].elem != NULL)
+			(*next_free)++;
+
+		displacement[1] = (*next_free + size - 
+							frozenBase(frozen, &hashes[2 * keys[0]], 0)) % size;
+		frozen->slots[*next_free].elem = elems[keys[0]];
+		frozen->slots[*next_free].hash = hashes[2 * keys[0]];
+
+		return YES;
+	}
+
+	/* A few rounds, or more in few slots, which fit fewer displacements. */
+	for (round = 0; round < HT_FROZEN_ROUNDS || round * size < HT_FROZEN_TRIES;
+																	round++) {
+
+		for (shift = 0; shift < size; shift++) {
+
+			/* Each key placed while its slot is free, or else unplaced. */
+			for (i = 0; i < count; i++) {
+
+				slot = (frozenBase(frozen, &hashes[2 * keys[i]], round) + 
+															shift) % size;
+
+				if (frozen->slots[slot].elem != NULL)
+					break;
+
+				frozen->slots[slot].elem = elems[keys[i]];
+				frozen->slots[slot].hash = hashes[2 * keys[i]];
+			}
+
+			if (i == count) {
+				displacement[0] = round;
+				displacement[1] = shift;
+				return YES;
+			}
+
+			while (i-- > 0)
+				frozen->slots[(frozenBase(frozen, &hashes[2 * keys[i]], 
+										round) + shift) % size].elem = NULL;
+		}
+	}
+
+	return NO;
+}
+
+/**
+ * Returns the slot of the given hashes in the given frozen index, before 
+ * the shift of their bucket, in the given round of displacements.
+ */
+unsigned int frozenBase(Frozen* frozen, unsigned int* hashes, 
+                                                        unsigned int round) {
+
+	unsigned int x = hashes[1] + round * HT_ROTATE(hashes[0], 16);
+
+	/* Mixed (as in MurmurHash3), so that each round moves the keys anew,
+	   even in few slots. */
+	x ^= x >> 16;
+	x *= 0x85EBCA6BU;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35U;
+	x ^= x >> 16;
+
+	return x % frozen->size;
+}
+
+/**
+ * Returns the slot of the given hashes in the given frozen index.
+ */
+int frozenSlot(Frozen* frozen, unsigned int* hashes) {
+
+	unsigned int* displacement = 
+				&frozen->displacements[2 * (hashes[0] % frozen->buckets)];
+
+	return (frozenBase(frozen, hashes, displacement[0]) + displacement[1]) %
+																frozen->size;
+}
+
+/**
+ * Looks up the given key, of the given length and hashes, in the frozen 
+ * index of the given hashtable, if any: in the slot of its hash, the only 
+ * one it may be in. If the index has it or, with no keys inserted since it 
+ * was frozen, can tell it's missing, writes the element (or NULL) in 
+ * 'found' and returns YES. Returns NO if the hashtable must be searched. 
+ * Takes no locks, as 'hashtableGet'.
+ */
+int frozenGet(Hashtable* hash, char* key, int length, unsigned int* hashes,
+                            Name*(*get_key)(void*), HashElem** found) {
+
+	Frozen* frozen = __atomic_load_n(&hash->frozen, __ATOMIC_ACQUIRE);
+	FrozenSlot* slot;
+	HashElem* elem;
+
+	if (frozen == NULL)
+		return NO;
+
+	slot = &frozen->slots[frozenSlot(frozen, hashes)];
+	elem = __atomic_load_n(&slot->elem, __ATOMIC_ACQUIRE);
+
+	/* The hash tells the other keys apart without reading them. */
+	if (elem != NULL && slot->hash == hashes[0] && __atomic_load_n(
+				&elem->state, __ATOMIC_ACQUIRE) != HT_DELETED && 
+				nameEquals(get_key(elem->data), key, length, hashes[0])) {
+
+		*found = elem;
+	} else if (__atomic_load_n(&frozen->inserted, __ATOMIC_ACQUIRE) == 0) {
+
+		*found = NULL;
+	} else {
+
+		__atomic_add_fetch(&frozen->fallbacks, 1, __ATOMIC_RELAXED);
+		return NO;
+	}
+
+	__atomic_add_fetch(&frozen->hits, 1, __ATOMIC_RELAXED);
+	countLookup(hash, *found != NULL, 1);
+	return YES;
+}
+
+/**
+ * Removes the given element, of the given key, from the frozen index of 
+ * the given hashtable, if it's there, before the element is retired.
+ */
+void unfreezeElem(Hashtable* hash, HashElem* elem, Name* key) {
+
+	int slot;
+
+	if (hash->frozen == NULL)
+		return;
+
+	slot = frozenSlot(hash->frozen, key->hashes);
+
+	if (hash->frozen->slots[slot].elem == elem) {
+		__atomic_store_n(&hash->frozen->slots[slot].elem, NULL, 
+															__ATOMIC_RELEASE);
+		hash->frozen->removed++;
+	}
+}
+
+/**
+ * Unfreezes the given hashtable, retiring its frozen index, if any.
+ */
+void dropFrozen(Hashtable* hash) {
+
+	Frozen* frozen = hash->frozen;
+
+	if (frozen == NULL)
+		return;
+
+	__atomic_store_n(&hash->frozen, NULL, __ATOMIC_RELEASE);
+	retireMemory(hash->epochs, frozen, destroyFrozen);
+}
+
+/**
+ * Frees the given frozen index, but not its elements.
+ */
+void destroyFrozen(void* frozen) {
+
+	Frozen* old = (Frozen*)frozen;
+
+	tagFree(old->displacements, 2 * old->buckets * sizeof(unsigned int),
+																MEM_TABLE);
+	tagFree(old->slots, old->size * sizeof(FrozenSlot), MEM_TABLE);
+	tagFree(old, sizeof(Frozen), MEM_TABLE);
+}
+
+/**
+ * Presents the frozen index of the given hashtable, with the given name, 
+ * in the 'out' stream, if it has one: its keys, slots, buckets and bytes, 
+ * the keys inserted and removed since it was frozen, and the lookups it 
+ * answered alone or left to the hashtable.
+ */
+void printFrozenStats(FILE* out, Hashtable* hash, char* name) {
+
+	Frozen* frozen = hash->frozen;
+
+	if (frozen == NULL)
+		return;
+
+	fprintf(out, FROZEN_STATS, name, frozen->keys, frozen->size, 
+			frozen->buckets, (long int)(sizeof(Frozen) + 2 * frozen->buckets * 
+			sizeof(unsigned int) + frozen->size * sizeof(FrozenSlot)), 
+			__atomic_load_n(&frozen->inserted, __ATOMIC_RELAXED), 
+			frozen->removed, __atomic_load_n(&frozen->hits, __ATOMIC_RELAXED),
+			__atomic_load_n(&frozen->fallbacks, __ATOMIC_RELAXED));
+}
+
+
+/* ---------------------------- Compact names ---------------------------- */
+
+/**
+ * Creates a new empty arena of interned names, returning a pointer to it.
+ */
+NameArena* createNameArena() {
+
+	NameArena* arena = (NameArena*)tagMalloc(sizeof(NameArena), MEM_NAME);
+	int i;
+
+	arena->chunks = createList();
+	arena->current = NULL;
+	arena->size = NAME_TABLE_START;
+	arena->table = (Interned**)tagMalloc(arena->size * sizeof(Interned*),
+																MEM_NAME);
+	arena->count = 0;
+	arena->names = arena->bytes = arena->used = 0;
+
+	for (i = 0; i < arena->size; i++)
+		arena->table[i] = NULL;
+
+	return arena;
+}
+
+/**
+ * Populates the given name with the given characters, and their length and 
+ * hashes: inline if they're short, or else interned in the given arena, 
+ * shared with the names alike.
+ */
+void populateName(Name* name, char* chars, NameArena* arena) {
+
+	Interned* interned;
+
+	name->length = keyedHash(chars, name->hashes);
+
+	if (name->length < NAME_INLINE) {
+		memcpy(name->text, chars, name->length + 1);
+	} else {
+		interned = internName(arena, chars, name->length, name->hashes[0]);
+		memcpy(name->text, &interned, sizeof(Interned*));
+	}
+}
+
+/**
+ * Returns the characters of the given name.
+ */
+char* nameChars(Name* name) {
+
+	if (name->length < NAME_INLINE)
+		return name->text;
+
+	return (char*)(nameInterned(name) + 1);
+}
+
+/**
+ * Checks if the given name is the given characters, of the given length 
+ * and first hash: by the length and hash first, and only if they're equal,
+ * by the characters. Returns YES if so and NO if else.
+ */
+int nameEquals(Name* name, char* chars, int length, unsigned int hash) {
+
+	return name->hashes[0] == hash && name->length == length && 
+								memcmp(nameChars(name), chars, length) == 0;
+}
+
+/**
+ * Releases the given name, whose characters are freed with it if inline, 
+ * or else once no name shares them.
+ */
+void releaseName(Name* name) {
+
+	if (name->length >= NAME_INLINE)
+		releaseInterned(nameInterned(name));
+}
+
+/**
+ * Returns the interned characters of the given long name.
+ */
+Interned* nameInterned(Name* name) {
+
+	Interned* interned;
+
+	memcpy(&interned, name->text, sizeof(Interned*));
+
+	return interned;
+}
+
+/**
+ * Interns the given characters, of the given length and hash, in the given
+ * arena: shared, if they already are, or else copied to its chunk being 
+ * filled (a new one, if full), or to a chunk of their own if larger. 
+ * Returns them interned.
+ */
+Interned* internName(NameArena* arena, char* chars, int length, 
+                                                        unsigned int hash) {
+
+	int slot = findInterned(arena, chars, hash), bytes = internedBytes(length);
+	NameChunk* chunk = arena->current;
+	Interned* interned = arena->table[slot];
+
+	arena->names++;
+
+	if (interned != NULL) {
+		interned->refs++;
+		return interned;
+	}
+
+	if (bytes > NAME_CHUNK_SIZE)
+		chunk = createNameChunk(arena, bytes);
+	else if (chunk == NULL || chunk->used + bytes > chunk->size)
+		chunk = arena->current = createNameChunk(arena, NAME_CHUNK_SIZE);
+
+	interned = (Interned*)((char*)(chunk + 1) + chunk->used);
+	interned->chunk = chunk;
+	interned->refs = 1;
+	interned->hash = hash;
+	memcpy(interned + 1, chars, length + 1);
+
+	chunk->used += bytes;
+	chunk->live++;
+	arena->used += bytes;
+	arena->table[slot] = interned;
+
+	if (++arena->count * 2 > arena->size)
+		growInterned(arena);
+
+	return interned;
+}
+
+/**
+ * Returns the bytes of an interned name of the given length, in its chunk.
+ */
+int internedBytes(int length) {
+
+	return (sizeof(Interned) + length + NAME_ALIGN) / NAME_ALIGN * NAME_ALIGN;
+}
+
+/**
+ * Returns the slot of the given characters, of the given hash, in the 
+ * interned names of the given arena, or of the first empty slot of their 
+ * probe sequence if they aren't interned.
+ */
+int findInterned(NameArena* arena, char* chars, unsigned int hash) {
+
+	int mask = arena->size - 1, slot = hash & mask;
+	Interned* interned;
+
+	while ((interned = arena->table[slot]) != NULL && 
+			(interned->hash != hash || strcmp((char*)(interned + 1), chars)))
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+/**
+ * Empties the given slot of the interned names of the given arena, moving 
+ * back the names after it that probed past it (no slot is left deleted).
+ */
+void removeInterned(NameArena* arena, int slot) {
+
+	int mask = arena->size - 1, next = slot, home;
+
+	arena->table[slot] = NULL;
+
+	while (arena->table[next = (next + 1) & mask] != NULL) {
+
+		home = arena->table[next]->hash & mask;
+
+		/* Its probe went past the empty slot, from its home. */
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			arena->table[slot] = arena->table[next];
+			arena->table[next] = NULL;
+			slot = next;
+		}
+	}
+}
+
+/**
+ * Doubles the slots of the interned names of the given arena.
+ */
+void growInterned(NameArena* arena) {
+
+	Interned** old = arena->table;
+	int old_size = arena->size, mask = 2 * old_size - 1, i, slot;
+
+	arena->size *= 2;
+	arena->table = (Interned**)tagMalloc(arena->size * sizeof(Interned*),
+																MEM_NAME);
+
+	for (i = 0; i < arena->size; i++)
+		arena->table[i] = NULL;
+
+	for (i = 0; i < old_size; i++) {
+
+		if (old[i] == NULL)
+			continue;
+
+		slot = old[i]->hash & mask;
+
+		while (arena->table[slot] != NULL)
+			slot = (slot + 1) & mask;
+
+		arena->table[slot] = old[i];
+	}
+
+	tagFree(old, old_size * sizeof(Interned*), MEM_NAME);
+}
+
+/**
+ * Releases the given interned name, removed from its arena once no name 
+ * shares it. Its chunk is freed once it has no names, or emptied to be 
+ * filled again if it's the one being filled. Its names must be released 
+ * after the grace period of the readers, as their stops and lines are.
+ */
+void releaseInterned(Interned* interned) {
+
+	NameChunk* chunk = interned->chunk;
+	NameArena* arena = chunk->arena;
+	char* chars = (char*)(interned + 1);
+
+	arena->names--;
+
+	if (--interned->refs > 0)
+		return;
+
+	removeInterned(arena, findInterned(arena, chars, interned->hash));
+	arena->count--;
+	arena->used -= internedBytes(strlen(chars));
+
+	if (--chunk->live > 0)
+		return;
+
+	if (chunk == arena->current)
+		chunk->used = 0;
+	else
+		destroyNameChunk(chunk);
+}
+
+/**
+ * Creates an empty chunk of the given bytes in the given arena, returning a 
+ * pointer to it.
+ */
+NameChunk* createNameChunk(NameArena* arena, int size) {
+
+	NameChunk* chunk = (NameChunk*)tagMalloc(sizeof(NameChunk) + size, 
+																MEM_NAME);
+
+	chunk->arena = arena;
+	chunk->node = listInsertEnd(arena->chunks, chunk);
+	chunk->size = size;
+	chunk->used = chunk->live = 0;
+	arena->bytes += size;
+
+	return chunk;
+}
+
+/**
+ * Frees the given chunk of interned names, removed from its arena.
+ */
+void destroyNameChunk(NameChunk* chunk) {
+
+	NameArena* arena = chunk->arena;
+
+	listRemoveNode(arena->chunks, chunk->node);
+	arena->bytes -= chunk->size;
+	tagFree(chunk, sizeof(NameChunk) + chunk->size, MEM_NAME);
+}
+
+/**
+ * Frees all the allocated memory in the given arena, with the names still 
+ * interned in it.
+ */
+void destroyNameArena(NameArena* arena) {
+
+	while (arena->chunks->first != NULL)
+		destroyNameChunk((NameChunk*)arena->chunks->first->data);
+
+	listDestroy(arena->chunks);
+	tagFree(arena->table, arena->size * sizeof(Interned*), MEM_NAME);
+	tagFree(arena, sizeof(NameArena), MEM_NAME);
+}
+
+/**
+ * Presents the given arena in the 'out' stream: its interned names, the 
+ * names sharing them, its chunks and their bytes, and the bytes of the 
+ * interned names, next to the bytes of a name (inline, if short).
+ */
+void printNameStats(FILE* out, NameArena* arena) {
+
+	fprintf(out, NAME_STATS, arena->count, arena->names, 
+			arena->chunks->count, arena->bytes, arena->used, 
+			(long int)sizeof(Name), NAME_INLINE - 1);
 }
\ No newline at end of file
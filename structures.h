@@ -13,30 +13,133 @@
 /* ------------------------------- Constants -------------------------------- */
 
 
+#ifdef SWISS_TABLE
+#define HT_MAX_LOAD 0.875   /* Hashtable max load, counting tombstones. */
+#else
 #define HT_MAX_LOAD 0.5	    /* Hashtable max load. */
+#endif
 #define HT_START_SIZE 20047 /* Starting size of hashtable. */
 #define HT_DELETED -8	    /* If the hash element state is of deleted. */
 #define HT_TAKEN -9	        /* If the hash element state is of taken. */
 #define SORTED -10	        /* If a double linked list is sorted. */
 #define UNSORTED -11        /* If a double linked list is unsorted. */
+#define HT_PROBE_LENGTHS 16 /* Probe lengths counted (the last, or longer). */
+#define HT_SEED_SOURCE "/dev/urandom"   /* Of the key of the hashes. */
+#define HT_SEED_ENV "HASH_SEED"         /* Fixes the key, to repeat a run. */
+#define HT_SEED_NONE 0		/* If the key of the hashes isn't drawn yet, */
+#define HT_SEED_DRAWING 1	/* is being drawn */
+#define HT_SEED_DRAWN 2		/* or was drawn. */
+#define HT_GROUP_WIDTH 16	/* Slots of a group, scanned at once (Swiss). */
+#define HT_CTRL_EMPTY 0x80	/* Control byte of an empty slot, */
+#define HT_CTRL_DELETED 0xFE	/* of a deleted one (a tombstone) */
+#define HT_CTRL_TAG 0x7F	/* or 7 bits of the hash of a full one. */
+#define HT_FROZEN_BUCKET 4	/* Keys of a frozen bucket, on average. */
+#define HT_FROZEN_ROUNDS 64	/* Rounds of displacements tried by a bucket, */
+#define HT_FROZEN_TRIES 1048576	/* or displacements, if more. */
+#define NAME_INLINE 20		/* Bytes of a name kept inline (with '\0'). */
+#define NAME_CHUNK_SIZE 65536	/* Bytes of a chunk of interned names. */
+#define NAME_TABLE_START 1024	/* Starting slots of the interned names. */
+#define NAME_ALIGN 8		/* Of the interned names in their chunks. */
+
+/* Rotation of a 32 bit word to the left */
+#define HT_ROTATE(x, b) (((x) << (b)) | ((x) >> (32 - (b))))
 
 
 /* -------------------------------- Structs --------------------------------- */
 
 
+/* Structure of a compact name: its characters inline if short or else 
+   interned, shared by the names alike, with their length and hashes, 
+   compared before the characters are. */
+typedef struct name_t {
+    unsigned int hashes[2];     /* Keyed, as the hashtables' hashes. */
+    int length;
+    char text[NAME_INLINE];     /* Its characters if shorter than 
+                                   NAME_INLINE, or else the address of 
+                                   them interned (unaligned, copied). */
+} Name;
+
+/* Structure of an interned name, followed by its characters in its chunk */
+typedef struct interned_t {
+    struct name_chunk_t* chunk;
+    int refs;                   /* Names sharing it. */
+    unsigned int hash;
+} Interned;
+
+/* Structure of a chunk of interned names, followed by their bytes */
+typedef struct name_chunk_t {
+    struct name_arena_t* arena;
+    struct node_t* node;        /* In the chunks of its arena. */
+    int size, used;             /* Bytes. */
+    int live;                   /* Interned names in it. */
+} NameChunk;
+
+/* Structure of an arena of interned names (changed by a single writer at
+   a time, while the readers read the names interned) */
+typedef struct name_arena_t {
+    struct list_t* chunks;
+    struct name_chunk_t* current;   /* Being filled, if any. */
+    struct interned_t** table;  /* Interned names, by hash (linear probing). */
+    int size, count;            /* Slots of the table, and names in it. */
+    long int names;             /* Names sharing them. */
+    long int bytes, used;       /* Of the chunks, and of their names. */
+} NameArena;
+
 /* Structure of hash element */
 typedef struct hash_elem_t {
     void* data;
     int state;
 } HashElem;
 
-/* Structure of hashtable */
-typedef struct hashtable_t {
+/* Structure of hashtable slots (replaced at once when the hashtable grows) */
+typedef struct hash_slots_t {
     int size;
+    struct hash_elem_t** elems;
+    unsigned char* ctrl;        /* Control bytes (Swiss tables), or NULL. */
+} HashSlots;
+
+/* Structure of hashtable statistics (the lookups counted by every reader,
+   the rest by the writer) */
+typedef struct hash_stats_t {
+    long int hits, misses;
+    long int probes[HT_PROBE_LENGTHS];  /* Lookups by slots probed. */
+    long int inserts, insert_probes;
+    long int removals;
+    int tombstones;             /* Slots of deleted elements. */
+    long int resizes;
+    double resize_ms;           /* Spent resizing, in wall time. */
+} HashStats;
+
+/* Structure of hashtable (changed by a single writer at a time, and read 
+   with no locks) */
+typedef struct hashtable_t {
     int elem_num;
-    struct hash_elem_t** table;
+    struct hash_slots_t* slots;
+    struct epochs_t* epochs;    /* Grace periods of its readers, if any. */
+    struct hash_stats_t* stats; /* Apart, as the readers change it. */
+    struct frozen_t* frozen;    /* Perfect hash of its keys, if frozen. */
 } Hashtable;
 
+/* Structure of a slot of a frozen index */
+typedef struct frozen_slot_t {
+    struct hash_elem_t* elem;   /* Or NULL once removed. */
+    unsigned int hash;          /* Its first hash, telling the others apart. */
+} FrozenSlot;
+
+/* Structure of a frozen index: a minimal perfect hash of the keys of a 
+   hashtable when frozen, each in a slot of its own. Each key goes to a 
+   bucket, whose pair of displacements moves its keys to their slots. */
+typedef struct frozen_t {
+    int keys;
+    int size;                   /* Slots: one for each key, or 1 if none. */
+    int buckets;
+    unsigned int* displacements;    /* Two for each bucket. */
+    struct frozen_slot_t* slots;
+    int inserted, removed;      /* Keys since frozen (the delta). */
+    long int hits;              /* Lookups answered by the index alone, */
+    long int fallbacks;         /* or by the hashtable. */
+} Frozen;
+
 /* Structure of double linked list */
 typedef struct list_t {
     struct node_t *first;
@@ -52,6 +155,13 @@ typedef struct node_t {
     struct node_t *next;
 } Node;
 
+/* Structure of binary heap */
+typedef struct heap_t {
+    void** data;
+    int count;
+    int size;
+} Heap;
+
 
 /* ------------------------------- Prototypes ------------------------------- */
 
@@ -76,6 +186,8 @@ void listRemoveData(List* list, void* data);
 
 void listRemoveNode(List* list, Node* node);
 
+void listUnlinkNode(List* list, Node* node);
+
 void listDestroy(List* list);
 
 
@@ -90,32 +202,143 @@ Node* mergesortList(Node* head, int(*cmp)(void*, void*));
 Node* splitList(Node* head);
 
 
+/* Binary heaps */
+
+Heap* createHeap(int size);
+
+void heapPush(Heap* heap, void* data, int(*cmp)(void*, void*));
+
+void* heapPop(Heap* heap, int(*cmp)(void*, void*));
+
+void destroyHeap(Heap* heap);
+
+
 /* Hashtables */
 
 Hashtable* createHashtable(int size);
 
-Hashtable* hashtableInsert(Hashtable* hash, void* data, char* key, 
-                                            char*(*get_key)(void*));
+HashSlots* createHashSlots(int size);
+
+HashElem* createHashtableElement(void* data);
+
+void hashtableInsert(Hashtable* hash, void* data, Name* key, 
+                                            Name*(*get_key)(void*));
 
-Hashtable* expandHashtable(Hashtable* hash, char*(*get_key)(void*));
+int placeHashElem(Hashtable* hash, HashSlots* slots, HashElem* elem, 
+                                                                Name* key);
 
-HashElem* hashtableGet(Hashtable* hash, char* key, char*(*get_key)(void*));
+void expandHashtable(Hashtable* hash, Name*(*get_key)(void*));
 
-void hashtableRemove(Hashtable* hash, char* key, char*(*get_key)(void*));
+void resetHashtable(Hashtable* hash, int size);
+
+HashElem* hashtableGet(Hashtable* hash, char* key, Name*(*get_key)(void*));
+
+void hashtableRemove(Hashtable* hash, char* key, Name*(*get_key)(void*));
 
 void destroyHashtable(Hashtable* hash);
 
+void destroyHashSlots(void* slots);
+
+void countLookup(Hashtable* hash, int found, int probes);
+
+void printHashtableStats(FILE* out, Hashtable* hash, char* name);
+
 int isElemDead(HashElem* elem);
 
-unsigned int calculateHash(char* key);
+unsigned int* hashSeed();
+
+void drawHashSeed(unsigned int* seed);
 
-unsigned int calcHashStep(char* key);
+void sipRound(unsigned int* v);
 
-unsigned int* calcHashtableHashes(char* key, int size);
+int keyedHash(char* key, unsigned int* hashes);
+
+int calcHashtableHashes(char* key, int size, unsigned int* hashes);
 
 int isPrime(int x);
 
 int getPrime(int num);
 
 
+/* Swiss tables (-DSWISS_TABLE) */
+
+#ifdef SWISS_TABLE
+
+int swissSize(int size);
+
+unsigned int matchGroup(unsigned char* group, int ctrl);
+
+unsigned int matchFree(unsigned char* group);
+
+int findSwissSlot(HashSlots* slots, char* key, int length, 
+            unsigned int* hashes, Name*(*get_key)(void*), int* probes);
+
+#endif
+
+
+/* Frozen indexes */
+
+int freezeHashtable(Hashtable* hash, Name*(*get_key)(void*));
+
+Frozen* createFrozen(int count);
+
+int placeFrozenKeys(Frozen* frozen, HashElem** elems, unsigned int* hashes,
+                                                                int count);
+
+int placeFrozenBucket(Frozen* frozen, int bucket, HashElem** elems, 
+                unsigned int* hashes, int* keys, int count, int* next_free);
+
+unsigned int frozenBase(Frozen* frozen, unsigned int* hashes, 
+                                                        unsigned int round);
+
+int frozenSlot(Frozen* frozen, unsigned int* hashes);
+
+int frozenGet(Hashtable* hash, char* key, int length, unsigned int* hashes,
+                            Name*(*get_key)(void*), HashElem** found);
+
+void unfreezeElem(Hashtable* hash, HashElem* elem, Name* key);
+
+void dropFrozen(Hashtable* hash);
+
+void destroyFrozen(void* frozen);
+
+void printFrozenStats(FILE* out, Hashtable* hash, char* name);
+
+
+/* Compact names */
+
+NameArena* createNameArena();
+
+void populateName(Name* name, char* chars, NameArena* arena);
+
+char* nameChars(Name* name);
+
+int nameEquals(Name* name, char* chars, int length, unsigned int hash);
+
+void releaseName(Name* name);
+
+Interned* nameInterned(Name* name);
+
+Interned* internName(NameArena* arena, char* chars, int length, 
+                                                        unsigned int hash);
+
+int internedBytes(int length);
+
+int findInterned(NameArena* arena, char* chars, unsigned int hash);
+
+void removeInterned(NameArena* arena, int slot);
+
+void growInterned(NameArena* arena);
+
+void releaseInterned(Interned* interned);
+
+NameChunk* createNameChunk(NameArena* arena, int size);
+
+void destroyNameChunk(NameChunk* chunk);
+
+void destroyNameArena(NameArena* arena);
+
+void printNameStats(FILE* out, NameArena* arena);
+
+
 #endif
\ No newline at end of file
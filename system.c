@@ -34,6 +34,53 @@ void* tryMalloc(unsigned int alloc) {
 	return NULL;
 }
 
+/**
+ * Controlled realloc. Resizes the given block of memory, checking if there is
+ * spare memory as in 'tryMalloc'. Returns a pointer to the resized block.
+ */
+void* tryRealloc(void* ptr, unsigned int alloc) {
+
+	void* p = realloc(ptr, alloc);
+
+	if (p != NULL) {
+
+		return p;
+
+	} else {
+
+		printf(NO_MEMORY);
+		exit(ERR);
+	}
+
+	return NULL;
+}
+
+/**
+ * Accounted malloc. Allocates memory as in 'tryMalloc', counting its bytes in
+ * the given category of the memory accounts (see memory.c).
+ */
+void* tagMalloc(unsigned int alloc, int tag) {
+
+	void* p = tryMalloc(alloc);
+
+	countAllocation(tag, alloc);
+
+	return p;
+}
+
+/**
+ * Accounted free. Frees the given block, allocated by 'tagMalloc' with the
+ * given size and category, taking it from the memory accounts.
+ */
+void tagFree(void* ptr, unsigned int alloc, int tag) {
+
+	if (ptr == NULL)
+		return;
+
+	countFree(tag, alloc);
+	free(ptr);
+}
+
 /**
  * Initializes the program's global system.
  */
@@ -47,6 +94,28 @@ System* systemInit() {
     new_system->stops_list = createList();
     new_system->stops_table = createHashtable(HT_START_SIZE);
     new_system->lines_table = createHashtable(HT_START_SIZE);
+    new_system->names = createNameArena();
+    new_system->hierarchy = NULL;
+    new_system->spatial = createSpatialIndex();
+    new_system->ranges = createRangeIndex();
+    new_system->columns = createStopColumns();
+    new_system->stops_created = 0;
+    new_system->batch = NO;
+    new_system->removals = 0;
+    new_system->input = NULL;
+    new_system->out = stdout;
+    new_system->workers = NULL;
+    new_system->importing = NULL;
+    new_system->journal = NULL;
+    new_system->epochs = NULL;
+    new_system->latencies = NULL;
+    new_system->searches = createSearchStats();
+    new_system->latency_size = 0;
+    new_system->trace_file = NULL;
+
+#ifdef LATENCY_HISTOGRAMS
+    new_system->latencies = createLatencies();
+#endif
 
     return new_system;
 
@@ -58,12 +127,33 @@ System* systemInit() {
  */
 void exitProgram(System *sys) {
     
+    if (sys->workers != NULL)
+        destroyWorkerPool(sys->workers);
+
+    if (sys->journal != NULL)
+        closeJournal(sys->journal);
+
+    if (sys->latencies != NULL) {
+        printLatencies(stderr, sys->latencies);
+        destroyLatencies(sys->latencies);
+    }
+
+    free(sys->searches);
+
+    if (sys->trace_file != NULL && !exportTrace(sys->trace_file))
+        fprintf(stderr, CANT_WRITE, sys->trace_file);
+
+    invalidateHierarchy(sys);
     clearSystem(sys);
 
     listDestroy(sys->lines_list);
     listDestroy(sys->stops_list);
     destroyHashtable(sys->lines_table);
     destroyHashtable(sys->stops_table);
+    destroySpatialIndex(sys->spatial);
+    destroyRangeIndex(sys->ranges);
+    destroyStopColumns(sys->columns);
+    destroyNameArena(sys->names);
 
     free(sys);
 }
@@ -74,6 +164,15 @@ void exitProgram(System *sys) {
  */
 void clearSystem(System* sys) {
 
+    int batch = sys->batch;
+
+    TRACE_BEGIN("clearSystem", sys->lines_list->count +
+                                                    sys->stops_list->count);
+
+    /* Inside a batch, each removed stop would visit its lines, which may
+       be removed already. Outside, only the existing lines are visited. */
+    sys->batch = NO;
+
     /* Empties the main lines list and hashtable. */
     if (sys->lines_list->count != 0) 
         removeAllLinesSystem(sys);
@@ -81,6 +180,9 @@ void clearSystem(System* sys) {
     /* Empties the main stops list and hashtable. */
     if (sys->stops_list->count != 0)
         removeAllStopsSystem(sys);
+
+    sys->batch = batch;
+    TRACE_END("clearSystem", 0);
 }
 
 /**
@@ -97,7 +199,7 @@ void removeAllLinesSystem(System *sys) {
 
         aux = ptr->next;
         to_delete = (Line*)ptr->data;
-        removeLine(sys, to_delete->name);
+        removeLine(sys, nameChars(&to_delete->name));
     }
 }
 
@@ -115,6 +217,6 @@ void removeAllStopsSystem(System *sys) {
 
         aux = ptr->next;
         to_delete = (Stop*)ptr->data;
-        removeStop(sys, to_delete->name);
+        removeStop(sys, nameChars(&to_delete->name));
     }
 }
\ No newline at end of file
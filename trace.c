@@ -0,0 +1,156 @@
+/**
+ * IAED-23 Project 2
+ * File: trace.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the tracer of the slowest paths, kept when
+ * built with -DTRACE_EVENTS (otherwise, no event is recorded): the begin
+ * and end of each command and of the hashtables growing, the lists sorted,
+ * the lines rearranged around a removed stop and the system cleared, with
+ * their time in nanoseconds and the size they started on (the slots, lines
+ * or elements) and ended with (the command's, as timed). Tracing starts
+ * disabled, costing a call for each event, until enabled by the option
+ * '-t file' or the 'z trace on' command. The events are kept in a ring,
+ * the oldest replaced by the newest, and exported in the JSON format of
+ * Chrome's traces (chrome://tracing, or Perfetto) by 'z trace file', or at
+ * the end with the option. The events have no system to be kept in, so the
+ * tracer is the process's, recorded by every thread at once.
+*/
+
+/* Monotonic clock (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/**
+ * Returns the tracer of the process.
+*/
+Tracer* tracer() {
+
+    static Tracer trace;
+
+    return &trace;
+}
+
+/**
+ * Enables or disables the tracer, as given. The times of its events count
+ * from the first time it's enabled.
+*/
+void enableTrace(int enabled) {
+
+    Tracer* trace = tracer();
+    long int none = 0;
+
+    if (enabled)
+        __atomic_compare_exchange_n(&trace->origin, &none, latencyClock(),
+                            NO, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&trace->enabled, enabled, __ATOMIC_RELAXED);
+}
+
+/**
+ * Records an event of the given phase ('B'egin or 'E'nd) of the given name
+ * and command (its letter, or 0), which worked on the given size, if the
+ * tracer is enabled. The name must outlive the tracer (a literal). Threads
+ * may record at once.
+*/
+void traceEvent(char* name, int phase, int command, long int size) {
+
+    Tracer* trace = tracer();
+    TraceEvent* event;
+    long int position;
+
+    if (!__atomic_load_n(&trace->enabled, __ATOMIC_RELAXED))
+        return;
+
+    position = __atomic_fetch_add(&trace->next, 1, __ATOMIC_RELAXED);
+    event = &trace->events[position & (TRACE_EVENTS_SIZE - 1)];
+
+    /* Invalid while written, for the exports meanwhile (each field written
+       after it). */
+    __atomic_store_n(&event->position, -1, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->name, name, __ATOMIC_RELEASE);
+    __atomic_store_n(&event->phase, phase, __ATOMIC_RELEASE);
+    __atomic_store_n(&event->command, command, __ATOMIC_RELEASE);
+    __atomic_store_n(&event->size, size, __ATOMIC_RELEASE);
+    __atomic_store_n(&event->thread, pthread_self(), __ATOMIC_RELEASE);
+    __atomic_store_n(&event->ns, latencyClock(), __ATOMIC_RELEASE);
+    __atomic_store_n(&event->position, position, __ATOMIC_RELEASE);
+}
+
+/**
+ * Returns the number of the given thread among the given threads, added
+ * to them if it's the first time. The threads past the last fit share it.
+*/
+int traceThread(pthread_t* threads, int* count, pthread_t thread) {
+
+    int i;
+
+    for (i = 0; i < *count; i++)
+        if (pthread_equal(threads[i], thread))
+            return i;
+
+    if (*count == TRACE_THREADS)
+        return TRACE_THREADS - 1;
+
+    threads[*count] = thread;
+
+    return (*count)++;
+}
+
+/**
+ * Exports the events in the ring, from the oldest, in the JSON format of
+ * Chrome's traces, to the file with the given name. The events being
+ * replaced meanwhile are skipped. Returns NO if the file can't be written.
+*/
+int exportTrace(char* file_name) {
+
+    Tracer* trace = tracer();
+    FILE* file = fopen(file_name, "w");
+    long int next = __atomic_load_n(&trace->next, __ATOMIC_RELAXED);
+    long int origin = __atomic_load_n(&trace->origin, __ATOMIC_RELAXED);
+    long int position, size, ns;
+    pthread_t threads[TRACE_THREADS], thread;
+    int count = 0, written = 0, phase, command;
+    char *name, letter[2] = {0, 0};
+    TraceEvent* event;
+
+    if (file == NULL)
+        return NO;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+    position = next > TRACE_EVENTS_SIZE ? next - TRACE_EVENTS_SIZE : 0;
+
+    for (; position < next; position++) {
+
+        event = &trace->events[position & (TRACE_EVENTS_SIZE - 1)];
+
+        if (__atomic_load_n(&event->position, __ATOMIC_ACQUIRE) != position)
+            continue;
+
+        /* Each field read before the position is read again. */
+        name = __atomic_load_n(&event->name, __ATOMIC_ACQUIRE);
+        phase = __atomic_load_n(&event->phase, __ATOMIC_ACQUIRE);
+        command = __atomic_load_n(&event->command, __ATOMIC_ACQUIRE);
+        size = __atomic_load_n(&event->size, __ATOMIC_ACQUIRE);
+        thread = __atomic_load_n(&event->thread, __ATOMIC_ACQUIRE);
+        ns = __atomic_load_n(&event->ns, __ATOMIC_ACQUIRE);
+
+        /* Replaced while read, or the first event being written. */
+        if (__atomic_load_n(&event->position, __ATOMIC_RELAXED) != position ||
+                                                                name == NULL)
+            continue;
+
+        letter[0] = command > ' ' && command < 127 ? command : 0;
+        fprintf(file, TRACE_EVENT, written++ ? ",\n" : "", name, phase,
+                (ns - origin) / 1000.0, traceThread(threads, &count, thread),
+                size, letter[0] ? ", \"command\": \"" : "", letter,
+                letter[0] ? "\"" : "");
+    }
+
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
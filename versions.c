@@ -0,0 +1,259 @@
+/**
+ * IAED-23 Project 2
+ * File: versions.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the versions of the network read by the
+ * worker pool. Each line and stop keeps a view, the text the reading
+ * commands present of it, which is never changed: when the line or stop
+ * changes, its view is dropped, and a new one is built on the next read
+ * (copy on write). A
+ * version holds the views of every line and stop, so that a sequence of
+ * reading commands lists it without locks while the main thread goes on
+ * changing the network. A version is only read by the sequence it was
+ * published for, which is written before the next sequence is prepared, so
+ * the version it replaces is freed at once: beside the live network, a
+ * single version is kept (double buffering), sharing the views that didn't
+ * change. Publishing walks every line and stop, but only builds again the
+ * views of those that changed, and the time it takes is kept in the set.
+*/
+
+/* The views are written to memory streams (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/* -------------------------------- Versions -------------------------------- */
+
+/**
+ * Creates a new empty version set, and returns its respective pointer.
+*/
+VersionSet* createVersionSet() {
+
+    VersionSet* set = (VersionSet*)tryMalloc(sizeof(VersionSet));
+
+    set->current = NULL;
+    set->published = set->reused = set->replaced = 0;
+    set->publish_ms = 0.0;
+
+    return set;
+}
+
+/**
+ * Publishes the version of the network as it is now, bringing the views of
+ * its lines and stops up to date, and returns it. If no view changed since
+ * the last version, that one is returned instead. The version replaced is
+ * freed, as the sequence that listed it was written already.
+*/
+Version* publishVersion(System *sys, VersionSet* set) {
+
+    Version* current = set->current;
+    Version* version = (Version*)tryMalloc(sizeof(Version));
+    long int start = latencyClock();
+    int i, same;
+    Node* ptr;
+
+    version->num_lines = sys->lines_list->count;
+    version->num_stops = sys->stops_list->count;
+    version->lines = (View**)tryMalloc((version->num_lines + 1) *
+                                                            sizeof(View*));
+    version->stops = (View**)tryMalloc((version->num_stops + 1) *
+                                                            sizeof(View*));
+
+    same = current != NULL && current->num_lines == version->num_lines &&
+                                    current->num_stops == version->num_stops;
+
+    for (i = 0, ptr = sys->lines_list->first; ptr != NULL; ptr = ptr->next) {
+        version->lines[i] = lineView(sys, (Line*)ptr->data);
+        same = same && version->lines[i] == current->lines[i];
+        i++;
+    }
+
+    for (i = 0, ptr = sys->stops_list->first; ptr != NULL; ptr = ptr->next) {
+        version->stops[i] = stopView((Stop*)ptr->data);
+        same = same && version->stops[i] == current->stops[i];
+        i++;
+    }
+
+    if (same) {
+        free(version->lines);
+        free(version->stops);
+        free(version);
+        set->reused++;
+        set->publish_ms += (latencyClock() - start) / 1000000.0;
+        return current;
+    }
+
+    for (i = 0; i < version->num_lines; i++)
+        version->lines[i]->refs++;
+
+    for (i = 0; i < version->num_stops; i++)
+        version->stops[i]->refs++;
+
+    set->published++;
+
+    if (current != NULL) {
+        destroyVersion(current);
+        set->replaced++;
+    }
+
+    set->current = version;
+    set->publish_ms += (latencyClock() - start) / 1000000.0;
+
+    return version;
+}
+
+/**
+ * Frees the given version, releasing its views.
+*/
+void destroyVersion(Version* version) {
+
+    int i;
+
+    for (i = 0; i < version->num_lines; i++)
+        releaseView(version->lines[i]);
+
+    for (i = 0; i < version->num_stops; i++)
+        releaseView(version->stops[i]);
+
+    free(version->lines);
+    free(version->stops);
+    free(version);
+}
+
+/**
+ * Frees all the allocated memory in the given version set, whose version
+ * no sequence reads anymore.
+*/
+void destroyVersionSet(VersionSet* set) {
+
+    if (set->current != NULL)
+        destroyVersion(set->current);
+
+    free(set);
+}
+
+
+/* ---------------------------------- Views --------------------------------- */
+
+/**
+ * Returns the view of the given line, built again if the line changed since
+ * its last view (which was dropped then). Its values are brought up to date
+ * first.
+*/
+View* lineView(System *sys, Line* line) {
+
+    View* view;
+    FILE* out;
+
+    refreshLineValues(sys, line);
+
+    if (line->view != NULL)
+        return line->view;
+
+    view = line->view = createView(&out);
+
+    printLine(out, line);
+    view->start[VIEW_SHOW] = ftell(out);
+
+    if (line->num_stops != 0)
+        printLineStops(out, line, NO);
+
+    view->start[VIEW_EXTRA] = ftell(out);
+
+    if (line->num_stops != 0)
+        printLineStops(out, line, YES);
+
+    fclose(out);
+
+    return view;
+}
+
+/**
+ * Returns the view of the given stop, built again if its lines changed since
+ * its last view. The duplicates left by a batch are removed first.
+*/
+View* stopView(Stop* stop) {
+
+    View* view;
+    FILE* out;
+
+    if (stop->duplicates)
+        cleanStopLines(stop);
+
+    if (stop->view != NULL)
+        return stop->view;
+
+    view = stop->view = createView(&out);
+
+    printStop(out, stop);
+    view->start[VIEW_SHOW] = ftell(out);
+    printStopCoordinates(out, stop);
+    view->start[VIEW_EXTRA] = ftell(out);
+    printIntersection(out, stop);
+
+    fclose(out);
+
+    return view;
+}
+
+/**
+ * Creates a new view of an object, held by the object, and opens in 'out'
+ * the stream its text is written to, which ends it once closed. Returns its
+ * respective pointer.
+*/
+View* createView(FILE** out) {
+
+    View* view = (View*)tryMalloc(sizeof(View));
+
+    view->refs = 1;
+    view->start[VIEW_LISTING] = 0;
+    *out = open_memstream(&view->text, &view->start[VIEW_PARTS]);
+
+    return view;
+}
+
+/**
+ * Writes the given part of the given view to the 'out' stream.
+*/
+void writeView(FILE* out, View* view, int part) {
+
+    fwrite(view->text + view->start[part], 1,
+                            view->start[part + 1] - view->start[part], out);
+}
+
+/**
+ * Writes the given part of each of the given views to the 'out' stream, in
+ * order.
+*/
+void listViews(FILE* out, View** views, int count, int part) {
+
+    int i;
+
+    for (i = 0; i < count; i++)
+        writeView(out, views[i], part);
+}
+
+/**
+ * Releases a holder of the given view, freeing it if it was the last.
+*/
+void releaseView(View* view) {
+
+    if (view != NULL && --view->refs == 0) {
+        free(view->text);
+        free(view);
+    }
+}
+
+/**
+ * Drops the view at the given address, of an object that changed, so that
+ * the next read builds it again. The versions holding it keep it.
+*/
+void dropView(View** view) {
+
+    if (*view != NULL) {
+        releaseView(*view);
+        *view = NULL;
+    }
+}
@@ -0,0 +1,488 @@
+/**
+ * IAED-23 Project 2
+ * File: workers.c
+ * Author: Bibiana Andre ist194158
+ *
+ * Description: file containing the implementation of the worker pool, which
+ * runs each sequence of consecutive reading commands ('c' and 'p' without
+ * arguments or with the name of an existing line or stop, and 'i') at once
+ * in several threads. They read the views of a version of the network, so
+ * the main thread goes on with the next commands meanwhile. Their output is
+ * kept apart and written in order.
+*/
+
+/* The output of each command goes to a memory stream (POSIX 2008). */
+#define _POSIX_C_SOURCE 200809L
+
+#include "main.h"
+
+
+/* ------------------------------ Worker mode ------------------------------- */
+
+/**
+ * Runs the commands until the 'q' command like 'main', reading them a line
+ * at a time. The reading commands are gathered until another command comes,
+ * and then given to the worker pool, which runs them while the next commands
+ * change the network.
+*/
+void runWorkers(System *sys) {
+
+    Query* queries = (Query*)tryMalloc(WORKER_MAX_RUN * sizeof(Query));
+    int count = 0, more = YES;
+    char* line;
+
+    while (more && (line = readCommandLine()) != NULL) {
+
+        if (isReadingCommand(sys, line)) {
+
+            queries[count++].line = line;
+
+            if (count == WORKER_MAX_RUN) {
+                runQueries(sys->workers, queries, count);
+                queries = (Query*)tryMalloc(WORKER_MAX_RUN * sizeof(Query));
+                count = 0;
+            }
+
+            continue;
+        }
+
+        /* The pool keeps the queries until their output is written. */
+        if (count > 0) {
+            runQueries(sys->workers, queries, count);
+            queries = (Query*)tryMalloc(WORKER_MAX_RUN * sizeof(Query));
+            count = 0;
+        }
+
+        more = runCommandLine(sys, line);
+        free(line);
+        finishQueries(sys->workers, NO);
+    }
+
+    if (count > 0)
+        runQueries(sys->workers, queries, count);
+    else
+        free(queries);
+
+    finishQueries(sys->workers, YES);
+}
+
+/**
+ * Reads a command line from the standard input, including its '\n'.
+ * Returns NULL at the end of the input.
+*/
+char* readCommandLine() {
+
+    int size = WORKER_LINE_SIZE, length = 0, c;
+    char* line = (char*)tryMalloc(size);
+
+    while ((c = getchar()) != EOF) {
+
+        if (length + 2 > size) {
+            size *= 2;
+            line = (char*)tryRealloc(line, size);
+        }
+
+        line[length++] = c;
+
+        if (c == '\n')
+            break;
+    }
+
+    if (length == 0) {
+        free(line);
+        return NULL;
+    }
+
+    line[length] = '\0';
+
+    return line;
+}
+
+/**
+ * Checks if the given command line only reads the system: 'i', 'c' or 'p'
+ * without arguments, 'p' with a single name, or 'c' with the name of an
+ * existing line and an optional sort option. Only plain arguments are
+ * accepted (see countPlainArgs), after a command that left none of its line
+ * unread. 'z' isn't one, since it may freeze the names. Returns YES if so,
+ * or NO otherwise.
+*/
+int isReadingCommand(System *sys, char* line) {
+
+    int words = countPlainArgs(line);
+
+    if (sys->command_lenght != BUFLEN || words == ERR ||
+                        (line[0] != 'i' && line[0] != 'c' && line[0] != 'p'))
+        return NO;
+
+    if (line[0] == 'i' || words == 0)
+        return YES;
+
+    if (line[0] == 'p')
+        return words == 1;
+
+    /* A missing line would be created. */
+    return words <= 2 && getCommandLine(sys, line) != NULL;
+}
+
+/**
+ * Returns the number of arguments of the given command line if they're all
+ * plain: words separated by a single space, with no spaces or quotes, in a
+ * line far from the maximum length, so that they're read exactly like by
+ * the command handlers. Returns ERR otherwise.
+*/
+int countPlainArgs(char* line) {
+
+    int length = strlen(line), words = 0, start = 2, i;
+
+    if (length >= BUFLEN / 2 || line[length - 1] != '\n')
+        return ERR;
+
+    if (line[1] == '\n')
+        return 0;
+
+    if (line[1] != ' ')
+        return ERR;
+
+    for (i = start; line[i] != '\n'; i++) {
+
+        if (line[i] == ' ') {
+
+            if (i == start)
+                return ERR;
+
+            words++;
+            start = i + 1;
+
+        } else if (isspace(line[i]) || line[i] == '"') {
+
+            return ERR;
+        }
+    }
+
+    return i == start ? ERR : words + 1;
+}
+
+/**
+ * Returns the line named by the first argument of the given command line,
+ * whose arguments are plain, or NULL if there's no such line.
+*/
+Line* getCommandLine(System *sys, char* line) {
+
+    int i = strcspn(line + 2, " \n") + 2;
+    char end = line[i];
+    Line* found;
+
+    line[i] = '\0';
+    found = getLine(sys, line + 2);
+    line[i] = end;
+
+    return found;
+}
+
+/**
+ * Runs the commands of the given command line, which was read ahead, as if
+ * they were read from the standard input. Returns 0 if the program should
+ * exit, or 1 otherwise.
+*/
+int runCommandLine(System *sys, char* line) {
+
+    int more = 1;
+
+    sys->input = line;
+
+    while (more && sys->input != NULL && *sys->input != '\0')
+        more = handleCommand(sys);
+
+    sys->input = NULL;
+
+    return more;
+}
+
+
+/* ------------------------------ Worker pool ------------------------------- */
+
+/**
+ * Creates a new worker pool with the given number of threads, counting the
+ * main one, and returns its respective pointer.
+*/
+WorkerPool* createWorkerPool(System *sys, int num_threads) {
+
+    WorkerPool* pool = (WorkerPool*)tryMalloc(sizeof(WorkerPool));
+    int i;
+
+    if (num_threads < 1)
+        num_threads = 1;
+    else if (num_threads > WORKER_MAX_THREADS)
+        num_threads = WORKER_MAX_THREADS;
+
+    pool->sys = sys;
+    pool->num_threads = num_threads;
+    pool->threads = (pthread_t*)tryMalloc(num_threads * sizeof(pthread_t));
+    pool->queries = NULL;
+    pool->count = 0;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->active = 0;
+    pool->generation = 0;
+    pool->stop = NO;
+    pool->running = NO;
+    pool->versions = createVersionSet();
+    pool->version = NULL;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (i = 1; i < num_threads; i++)
+        pthread_create(&pool->threads[i], NULL, workerThread, pool);
+
+    return pool;
+}
+
+/**
+ * Gives the given reading commands to the threads of the pool, once the
+ * previous ones are written. They read the network as it is now, and until
+ * they're written, the output of the system is kept apart to follow theirs.
+ * The commands and the array holding them are freed once written.
+*/
+void runQueries(WorkerPool* pool, Query* queries, int count) {
+
+    System* sys = pool->sys;
+
+    finishQueries(pool, YES);
+    prepareQueries(pool, queries, count);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->queries = queries;
+    pool->count = count;
+    pool->finished = 0;
+    __atomic_store_n(&pool->next, 0, __ATOMIC_RELAXED);
+    pool->generation++;
+    pool->running = YES;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool->out = sys->out;
+    sys->out = open_memstream(&pool->deferred, &pool->deferred_length);
+
+    /* With no other threads, the main one runs them right away. */
+    if (pool->num_threads == 1)
+        finishQueries(pool, YES);
+}
+
+/**
+ * Brings the given reading commands ready to run: the line or stop named by
+ * each one is replaced by its view, and if any lists the lines or stops, a
+ * version of the network is published.
+*/
+void prepareQueries(WorkerPool* pool, Query* queries, int count) {
+
+    System* sys = pool->sys;
+    Query* query;
+    Stop* stop;
+    int i, listing = NO;
+
+    for (i = 0; i < count; i++) {
+
+        query = &queries[i];
+        query->name = query->option = NULL;
+        query->view = NULL;
+
+        if (query->line[0] == 'i' || query->line[1] == '\n') {
+            listing = YES;
+            continue;
+        }
+
+        /* Split the arguments, which are separated by a single space. */
+        query->name = query->line + 2;
+        query->name[strcspn(query->name, "\n")] = '\0';
+
+        if ((query->option = strchr(query->name, ' ')) != NULL)
+            *query->option++ = '\0';
+
+        if (query->line[0] == 'c')
+            query->view = lineView(sys, getLine(sys, query->name));
+        else if ((stop = getStop(sys, query->name)) != NULL)
+            query->view = stopView(stop);
+
+        if (query->view != NULL)
+            query->view->refs++;
+    }
+
+    pool->version = listing ? publishVersion(sys, pool->versions) : NULL;
+}
+
+/**
+ * Waits for the reading commands given to the pool, taking part in running
+ * them, and writes their output in order, followed by the output of the
+ * commands run meanwhile. If 'wait' is NO, it only does so if they're done
+ * already.
+*/
+void finishQueries(WorkerPool* pool, int wait) {
+
+    System* sys = pool->sys;
+    int done;
+
+    if (!pool->running)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    done = pool->finished == pool->count && pool->active == 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!done && !wait)
+        return;
+
+    done = takeQueries(pool, pool->queries, pool->count);
+
+    /* The next sequence starts once no thread is taking queries. */
+    pthread_mutex_lock(&pool->lock);
+    pool->finished += done;
+    while (pool->finished < pool->count || pool->active > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pool->running = NO;
+    pthread_mutex_unlock(&pool->lock);
+
+    fclose(sys->out);
+    sys->out = pool->out;
+
+    writeQueries(sys->out, pool->queries, pool->count);
+    fwrite(pool->deferred, 1, pool->deferred_length, sys->out);
+
+    free(pool->deferred);
+    free(pool->queries);
+    pool->queries = NULL;
+}
+
+/**
+ * Waits for sequences of reading commands and takes part in running them,
+ * until the pool is destroyed. Run by each thread of the pool.
+*/
+void* workerThread(void* arg) {
+
+    WorkerPool* pool = arg;
+    long int seen = 0;
+    Query* queries;
+    int count, done;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (!pool->stop) {
+
+        if (pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+            continue;
+        }
+
+        seen = pool->generation;
+
+        /* The main thread may have run the whole sequence already. */
+        if (pool->finished == pool->count)
+            continue;
+
+        queries = pool->queries;
+        count = pool->count;
+        pool->active++;
+        pthread_mutex_unlock(&pool->lock);
+
+        done = takeQueries(pool, queries, count);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->finished += done;
+        pool->active--;
+
+        if (pool->finished == pool->count && pool->active == 0)
+            pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/**
+ * Runs the given queries of the current sequence that no other thread took
+ * yet, on the version it lists. Returns the number of queries run.
+*/
+int takeQueries(WorkerPool* pool, Query* queries, int count) {
+
+    Version* version = pool->version;
+    int i, done = 0;
+
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+                                                                    count) {
+        runQuery(version, &queries[i]);
+        done++;
+    }
+
+    return done;
+}
+
+/**
+ * Runs the given reading command on the views of the given version, or on
+ * the view of the line or stop it names, keeping its output in the query.
+ * The output is the same as the one of the command handlers.
+*/
+void runQuery(Version* version, Query* query) {
+
+    FILE* out = open_memstream(&query->output, &query->length);
+    char* line = query->line;
+
+    if (line[0] == 'i')
+        listViews(out, version->stops, version->num_stops, VIEW_EXTRA);
+    else if (line[1] == '\n' && line[0] == 'c')
+        listViews(out, version->lines, version->num_lines, VIEW_LISTING);
+    else if (line[1] == '\n')
+        listViews(out, version->stops, version->num_stops, VIEW_LISTING);
+    else if (line[0] == 'p' && query->view == NULL)
+        fprintf(out, NO_SUCH_STOP, query->name);
+    else if (line[0] == 'p' || query->option == NULL)
+        writeView(out, query->view, VIEW_SHOW);
+    else if (assertSortOption(out, query->option))
+        writeView(out, query->view, VIEW_EXTRA);
+
+    fclose(out);
+}
+
+/**
+ * Writes the output of the given queries to the 'out' stream, in order,
+ * and frees them.
+*/
+void writeQueries(FILE* out, Query* queries, int count) {
+
+    int i;
+
+    for (i = 0; i < count; i++) {
+        fwrite(queries[i].output, 1, queries[i].length, out);
+        free(queries[i].output);
+        free(queries[i].line);
+        releaseView(queries[i].view);
+    }
+}
+
+/**
+ * Stops the threads of the given worker pool, once the reading commands
+ * given to it are written, and frees all its allocated memory.
+*/
+void destroyWorkerPool(WorkerPool* pool) {
+
+    int i;
+
+    finishQueries(pool, YES);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = YES;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 1; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+
+    destroyVersionSet(pool->versions);
+    free(pool->threads);
+    free(pool);
+}